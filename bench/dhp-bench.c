@@ -0,0 +1,389 @@
+/*
+ * dhp-bench.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+
+/*
+ * Times the plugin's hot paths on the books under --data, which is normally
+ * written by gen-books:
+ *
+ *   load_parse		parsing every book, as on the first start
+ *   load_snapshot	loading them from the keyword snapshot, as on later ones
+ *   index_build	building the search index and its fuzzy index
+ *   index_load		mapping the saved search index, as on later starts
+ *   search_exact	looking up a symbol by its exact name
+ *   search_prefix	finding the range of keywords starting with some text
+ *   search_fuzzy	fuzzy search, the 50 best matches
+ *   clean_word		devhelp_plugin_clean_word() on a large selection
+ *   current_tag	devhelp_plugin_get_current_tag() on selections of a few
+ *					sizes, minus the Scintilla calls
+ *
+ * Every operation is timed on its own, so the 99th percentile is that of
+ * single searches.  The results are printed as a single line of JSON with
+ * the median, 99th percentile, minimum and maximum of each in microseconds,
+ * so runs can be compared by a script.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "book-index.h"
+#include "fuzzy-match.h"
+#include "index-snapshot.h"
+#include "search-index.h"
+#include "tag-util.h"
+
+/* same as Geany's GEANY_WORDCHARS, which needs all of Geany's headers */
+#define BENCH_WORDCHARS \
+	"_abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789"
+
+#define BENCH_FUZZY_MATCHES	50
+
+static gchar *data_dir = NULL;
+static gint iterations = 10;
+static gint n_queries = 10000;
+static gint selection_size = 1 << 20;
+
+static GOptionEntry entries[] = {
+	{ "data", 'd', 0, G_OPTION_ARG_FILENAME, &data_dir,
+	  "Directory the books were generated under", "DIR" },
+	{ "iterations", 'i', 0, G_OPTION_ARG_INT, &iterations,
+	  "Times to load the books and build the index (default 10)", "N" },
+	{ "queries", 'q', 0, G_OPTION_ARG_INT, &n_queries,
+	  "Searches of each kind (default 10000)", "N" },
+	{ "selection", 's', 0, G_OPTION_ARG_INT, &selection_size,
+	  "Bytes in the large selection (default 1048576)", "N" },
+	{ NULL }
+};
+
+/* Samples of one benchmark, in microseconds */
+typedef struct
+{
+	const gchar *name;
+	GArray *samples;
+} Bench;
+
+static Bench *bench_new(const gchar *name)
+{
+	Bench *bench = g_new0(Bench, 1);
+
+	bench->name = name;
+	bench->samples = g_array_new(FALSE, FALSE, sizeof(gdouble));
+	return bench;
+}
+
+/* Monotonic time in nanoseconds, single searches take less than a
+ * microsecond so g_get_monotonic_time() is too coarse for them */
+static inline gint64 bench_clock(void)
+{
+#ifdef CLOCK_MONOTONIC
+	struct timespec ts;
+
+	if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+		return (gint64) ts.tv_sec * G_GINT64_CONSTANT(1000000000) + ts.tv_nsec;
+#endif
+	return g_get_monotonic_time() * 1000;
+}
+
+static inline void bench_add(Bench *bench, gint64 start)
+{
+	gdouble us = (gdouble) (bench_clock() - start) / 1000.0;
+	g_array_append_val(bench->samples, us);
+}
+
+static gint compare_doubles(gconstpointer a, gconstpointer b)
+{
+	gdouble da = *(const gdouble *) a, db = *(const gdouble *) b;
+	return (da > db) - (da < db);
+}
+
+static void bench_print(Bench *bench, GString *json)
+{
+	gdouble *s = (gdouble *) bench->samples->data;
+	guint n = bench->samples->len, p99;
+
+	if (n == 0)
+		return;
+	g_array_sort(bench->samples, compare_doubles);
+	p99 = (guint) ((n * 99 + 99) / 100);
+	p99 = CLAMP(p99, 1, n) - 1;
+
+	if (json->str[json->len - 1] != '[')
+		g_string_append_c(json, ',');
+	g_string_append_printf(json, "{\"name\":\"%s\",\"samples\":%u,"
+		"\"median_us\":%.3f,\"p99_us\":%.3f,\"min_us\":%.3f,\"max_us\":%.3f}",
+		bench->name, n, s[n / 2], s[p99], s[0], s[n - 1]);
+}
+
+static void bench_free(Bench *bench)
+{
+	g_array_free(bench->samples, TRUE);
+	g_free(bench);
+}
+
+/* A selection of len bytes, mostly words with some punctuation around */
+static gchar *make_selection(gsize len)
+{
+	static const gchar text[] = "  (gtk_widget_show_all, &window->priv); ";
+	gchar *sel = g_malloc(len + 1);
+	gsize i;
+
+	for (i = 0; i < len; i++)
+		sel[i] = text[i % (sizeof(text) - 1)];
+	sel[len] = '\0';
+	return sel;
+}
+
+/* The text handling of devhelp_plugin_get_current_tag() */
+static gchar *current_tag(const gchar *selection, gsize len)
+{
+	if (len > TAG_UTIL_MAX_LENGTH)
+		return NULL;
+	return tag_util_take(g_strndup(selection, len), BENCH_WORDCHARS);
+}
+
+int main(int argc, char **argv)
+{
+	static const gsize tag_sizes[] = { 16, 256, 4096 };
+	GOptionContext *context;
+	GError *error = NULL;
+	Bench *load_parse, *load_snapshot, *index_build, *index_load, *exact,
+		  *prefix, *fuzzy, *clean, *tag;
+	GPtrArray *books = NULL, *names;
+	SearchIndex *index = NULL;
+	FuzzyMatch *matches;
+	GString *json;
+	GRand *rand;
+	gchar **files, *snapshot, *index_cache, *selection, *data_abs, *none, *cwd;
+	guint64 n_keywords = 0;
+	gint64 start;
+	gint i;
+	guint j, k, n_found = 0;
+
+	context = g_option_context_new("- time the Devhelp plugin's hot paths");
+	g_option_context_add_main_entries(context, entries, NULL);
+	if (!g_option_context_parse(context, &argc, &argv, &error))
+	{
+		g_printerr("%s\n", error->message);
+		return 1;
+	}
+	g_option_context_free(context);
+
+	if (data_dir == NULL || iterations < 1 || n_queries < 1 || selection_size < 1)
+	{
+		g_printerr("dhp-bench: --data is required and counts must be positive\n");
+		return 1;
+	}
+
+	g_thread_init(NULL);
+
+	/* only find the generated books, before GLib caches the directories */
+	cwd = g_get_current_dir();
+	data_abs = g_path_is_absolute(data_dir) ? g_strdup(data_dir) :
+		g_build_filename(cwd, data_dir, NULL);
+	g_free(cwd);
+	none = g_build_filename(data_abs, "none", NULL);
+	g_setenv("XDG_DATA_HOME", data_abs, TRUE);
+	g_setenv("XDG_DATA_DIRS", none, TRUE);
+
+	files = book_index_find_files();
+	if (files[0] == NULL)
+	{
+		g_printerr("dhp-bench: no books under '%s', run gen-books first\n", data_dir);
+		return 1;
+	}
+	snapshot = g_build_filename(data_abs, "keywords.cache", NULL);
+	g_unlink(snapshot);
+	index_cache = g_strconcat(snapshot, ".search", NULL);
+
+	load_parse = bench_new("load_parse");
+	load_snapshot = bench_new("load_snapshot");
+	index_build = bench_new("index_build");
+	index_load = bench_new("index_load");
+	exact = bench_new("search_exact");
+	prefix = bench_new("search_prefix");
+	fuzzy = bench_new("search_fuzzy");
+	clean = bench_new("clean_word");
+	tag = bench_new("current_tag");
+
+	for (i = 0; i < iterations; i++)
+	{
+		start = bench_clock();
+		books = index_snapshot_load(NULL, files, book_index_parse_file, NULL);
+		bench_add(load_parse, start);
+		g_ptr_array_unref(books);
+	}
+
+	books = index_snapshot_load(NULL, files, book_index_parse_file, NULL);
+	if (!index_snapshot_save(snapshot, books, &error))
+	{
+		g_printerr("dhp-bench: %s\n", error->message);
+		return 1;
+	}
+	g_ptr_array_unref(books);
+
+	for (i = 0; i < iterations; i++)
+	{
+		start = bench_clock();
+		books = index_snapshot_load(snapshot, files, book_index_parse_file, NULL);
+		bench_add(load_snapshot, start);
+		if (i + 1 < iterations)
+			g_ptr_array_unref(books);
+	}
+
+	for (i = 0; i < iterations; i++)
+	{
+		search_index_unref(index);
+		start = bench_clock();
+		index = search_index_new(books);
+		search_index_get_fuzzy(index);
+		bench_add(index_build, start);
+	}
+
+	if (!search_index_save(index, index_cache, &error))
+	{
+		g_printerr("dhp-bench: %s\n", error->message);
+		return 1;
+	}
+	for (i = 0; i < iterations; i++)
+	{
+		SearchIndex *loaded;
+
+		start = bench_clock();
+		loaded = search_index_load(index_cache, books);
+		bench_add(index_load, start);
+		search_index_unref(loaded);
+	}
+
+	for (j = 0; j < books->len; j++)
+		n_keywords += ((BookIndex *) g_ptr_array_index(books, j))->n_keywords;
+
+	/* the queries are names of random keywords */
+	rand = g_rand_new_with_seed(1);
+	names = g_ptr_array_new();
+	for (i = 0; i < n_queries; i++)
+		g_ptr_array_add(names, (gpointer) search_index_entry_name(index,
+			g_rand_int_range(rand, 0, index->n_entries)));
+	g_rand_free(rand);
+
+	for (j = 0; j < names->len; j++)
+	{
+		guint entry;
+
+		start = bench_clock();
+		n_found += search_index_lookup(index, names->pdata[j], &entry);
+		bench_add(exact, start);
+	}
+
+	for (j = 0; j < names->len; j++)
+	{
+		guint range_start, range_end;
+		gchar prefix_text[16];
+
+		g_strlcpy(prefix_text, names->pdata[j], 4 + j % 8);
+		start = bench_clock();
+		search_index_prefix_range(index, prefix_text, &range_start, &range_end);
+		bench_add(prefix, start);
+	}
+
+	/* every other character of a name, like "wdgtsow" for "widget_show" */
+	matches = g_new(FuzzyMatch, BENCH_FUZZY_MATCHES);
+	for (j = 0; j < names->len && j < 1000; j++)
+	{
+		const gchar *name = names->pdata[j];
+		gchar query[32];
+		guint q = 0;
+
+		for (k = 0; name[k] != '\0' && q < sizeof(query) - 1; k += 2)
+			query[q++] = name[k];
+		query[q] = '\0';
+
+		start = bench_clock();
+		fuzzy_index_search(search_index_get_fuzzy(index), query, matches,
+						   BENCH_FUZZY_MATCHES, NULL, NULL);
+		bench_add(fuzzy, start);
+	}
+	g_free(matches);
+
+	selection = make_selection(selection_size);
+	for (i = 0; i < iterations; i++)
+	{
+		gchar *copy = g_strdup(selection);
+
+		start = bench_clock();
+		tag_util_clean(copy, BENCH_WORDCHARS);
+		bench_add(clean, start);
+		g_free(copy);
+	}
+
+	for (i = 0; i < n_queries; i++)
+	{
+		gsize len = (i % 4 < 3) ? tag_sizes[i % 4] : (gsize) selection_size;
+
+		len = MIN(len, (gsize) selection_size);
+		start = bench_clock();
+		g_free(current_tag(selection, len));
+		bench_add(tag, start);
+	}
+	g_free(selection);
+
+	json = g_string_new(NULL);
+	g_string_append_printf(json, "{\"books\":%u,\"keywords\":%" G_GUINT64_FORMAT
+		",\"iterations\":%d,\"queries\":%d,\"found\":%u,\"results\":[",
+		books->len, n_keywords, iterations, n_queries, n_found);
+	bench_print(load_parse, json);
+	bench_print(load_snapshot, json);
+	bench_print(index_build, json);
+	bench_print(index_load, json);
+	bench_print(exact, json);
+	bench_print(prefix, json);
+	bench_print(fuzzy, json);
+	bench_print(clean, json);
+	bench_print(tag, json);
+	g_string_append(json, "]}");
+	g_print("%s\n", json->str);
+
+	g_string_free(json, TRUE);
+	bench_free(load_parse);
+	bench_free(load_snapshot);
+	bench_free(index_build);
+	bench_free(index_load);
+	bench_free(exact);
+	bench_free(prefix);
+	bench_free(fuzzy);
+	bench_free(clean);
+	bench_free(tag);
+	g_ptr_array_free(names, TRUE);
+	search_index_unref(index);
+	g_ptr_array_unref(books);
+	g_unlink(snapshot);
+	g_unlink(index_cache);
+	g_free(snapshot);
+	g_free(index_cache);
+	g_strfreev(files);
+	g_free(none);
+	g_free(data_abs);
+
+	return 0;
+}
@@ -0,0 +1,922 @@
+/*
+ * dhp-host.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+
+/*
+ * Stands in for Geany to load devhelp.so and replay a script of what a user
+ * does with it, so the plugin can be timed end to end without a real Geany.
+ * Only the parts of the plugin API the plugin uses are there: a main window
+ * laid out like Geany's, one document whose editor is a plain widget with a
+ * text buffer behind it, the signals the plugin connects to and its
+ * keybindings.
+ *
+ * Each line of the script is one action, blank lines and lines starting
+ * with '#' are skipped:
+ *
+ *   ready				wait for the books to load
+ *   wait MS			run the main loop for MS milliseconds, not reported
+ *   text TEXT			replace the document's text, escapes like \n work
+ *   cursor POS			move the cursor, dropping the selection
+ *   select START END	select the text between two positions
+ *   type TEXT			type TEXT at the cursor one key at a time
+ *   key NAME			activate a keybinding, eg. devhelp_search_symbol
+ *   popup				pop the editor menu up and take it down again
+ *   menu search|open	activate one of the plugin's editor menu items
+ *   search TEXT		search from the sidebar
+ *   click PATH			follow a link to PATH, relative to --data unless
+ *						it's a URI
+ *   hover POS			ask for the tooltip over POS
+ *   layout msgwin|main	move the documentation to the message window or
+ *						back to the main notebook
+ *
+ * An action is timed from when it starts until the main loop has nothing
+ * left to do, and for the ones that can open a page until the page has
+ * finished loading.  The times and the peak resident set size are printed
+ * as a single line of JSON.  It needs a display, "make replay" runs it
+ * under Xvfb.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include <gmodule.h>
+#include <gtk/gtk.h>
+#include <webkit/webkit.h>
+
+/* the plugin API functions are macros calling through geany_functions,
+ * which is what gets filled in here, so they mustn't be defined */
+#define GEANY_FUNCTIONS_H
+#include <geanyplugin.h>
+
+#include "devhelpplugin.h"
+#include "doc-tabs.h"
+
+/* the editor draws text in a grid of cells this big */
+#define HOST_CHAR_WIDTH		8
+#define HOST_LINE_HEIGHT	16
+
+#define HOST_READY_TIMEOUT_MS	120000
+#define HOST_LOAD_TIMEOUT_MS	30000
+
+typedef gboolean (*HostCondition) (void);
+
+/* A keybinding the plugin set */
+typedef struct
+{
+	GeanyKeyCallback callback;
+	guint key_id;
+} HostKey;
+
+/* What the host calls in the plugin, found when it's loaded */
+typedef struct
+{
+	gint (*version_check) (gint abi_version);
+	void (*set_info) (PluginInfo *info);
+	void (*init) (GeanyData *data);
+	void (*cleanup) (void);
+
+	DevhelpPlugin **dhplug;
+	void (*search) (DevhelpPlugin *dhplug, const gchar *text);
+	void (*open_uri) (DevhelpPlugin *dhplug, const gchar *uri);
+	GtkWidget *(*get_webview) (DevhelpPlugin *dhplug);
+	void (*set_in_message_window) (DevhelpPlugin *dhplug, gboolean in_msgwin);
+	guint (*get_n_tabs) (DocTabs *tabs);
+} HostPlugin;
+
+static gchar *plugin_path = NULL;
+static gchar *data_dir = NULL;
+static gchar *config_dir = NULL;
+static gchar *script_path = NULL;
+
+static GOptionEntry entries[] = {
+	{ "plugin", 'p', 0, G_OPTION_ARG_FILENAME, &plugin_path,
+	  "The plugin to load, usually src/.libs/devhelp.so", "FILE" },
+	{ "data", 'd', 0, G_OPTION_ARG_FILENAME, &data_dir,
+	  "Directory the books were generated under", "DIR" },
+	{ "config", 'c', 0, G_OPTION_ARG_FILENAME, &config_dir,
+	  "Geany configuration directory, created if needed", "DIR" },
+	{ "script", 's', 0, G_OPTION_ARG_FILENAME, &script_path,
+	  "The actions to replay", "FILE" },
+	{ NULL }
+};
+
+static GModule *module = NULL;
+static HostPlugin plug;
+
+static GeanyApp host_app;
+static GeanyMainWidgets host_widgets;
+static GeanyData host_data;
+static PluginInfo host_info;
+static GeanyPlugin host_plugin;
+static TMWorkspace host_workspace;
+static GeanyDocument host_doc;
+static GeanyEditor host_editor;
+
+static GObject *host_signals = NULL;	/* stands in for geany_object */
+static GHashTable *host_keys = NULL;	/* keybinding name -> HostKey */
+
+/* the document's text, the selection is between anchor and cursor */
+static GString *text = NULL;
+static gint cursor = 0;
+static gint anchor = 0;
+
+
+/*
+ * The object Geany emits its signals on.  Only the ones the plugin
+ * connects to are there.
+ */
+typedef GObject HostSignals;
+typedef GObjectClass HostSignalsClass;
+
+G_DEFINE_TYPE(HostSignals, host_signals, G_TYPE_OBJECT)
+
+static void host_signals_class_init(HostSignalsClass *klass)
+{
+	static const gchar *document_signals[] = {
+		"document-new", "document-open", "document-activate",
+		"document-save", "document-close"
+	};
+	guint i;
+
+	for (i = 0; i < G_N_ELEMENTS(document_signals); i++)
+		g_signal_new(document_signals[i], G_TYPE_FROM_CLASS(klass),
+			G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+			g_cclosure_marshal_VOID__POINTER, G_TYPE_NONE, 1, G_TYPE_POINTER);
+
+	g_signal_new("document-filetype-set", G_TYPE_FROM_CLASS(klass),
+		G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+		g_cclosure_marshal_generic, G_TYPE_NONE, 2, G_TYPE_POINTER, G_TYPE_POINTER);
+	g_signal_new("editor-notify", G_TYPE_FROM_CLASS(klass),
+		G_SIGNAL_RUN_LAST, 0, NULL, NULL,
+		g_cclosure_marshal_generic, G_TYPE_BOOLEAN, 2, G_TYPE_POINTER, G_TYPE_POINTER);
+}
+
+static void host_signals_init(HostSignals *self)
+{
+}
+
+
+/*
+ * SCINTILLA() checks editors are of this type, it's normally in Geany
+ * itself.  The editor here is only a drawing area, the text it "shows" is
+ * kept in text.
+ */
+GType scintilla_get_type(void)
+{
+	return GTK_TYPE_DRAWING_AREA;
+}
+
+static gint clamp_position(gint pos)
+{
+	return CLAMP(pos, 0, (gint) text->len);
+}
+
+static gint line_start(gint pos)
+{
+	while (pos > 0 && text->str[pos - 1] != '\n')
+		pos--;
+	return pos;
+}
+
+static gint line_from_position(gint pos)
+{
+	gint i, line = 0;
+
+	pos = clamp_position(pos);
+	for (i = 0; i < pos; i++)
+	{
+		if (text->str[i] == '\n')
+			line++;
+	}
+	return line;
+}
+
+/* Position in the cell at x, y, -1 if there's no text there */
+static gint position_from_point(glong x, glong y)
+{
+	glong line, column;
+	gint pos = 0;
+
+	if (x < 0 || y < 0)
+		return -1;
+
+	for (line = y / HOST_LINE_HEIGHT; line > 0; line--)
+	{
+		const gchar *nl = memchr(text->str + pos, '\n', text->len - pos);
+
+		if (nl == NULL)
+			return -1;
+		pos = nl - text->str + 1;
+	}
+
+	for (column = x / HOST_CHAR_WIDTH; column > 0; column--, pos++)
+	{
+		if (pos >= (gint) text->len || text->str[pos] == '\n')
+			return -1;
+	}
+
+	if (pos >= (gint) text->len || text->str[pos] == '\n')
+		return -1;
+	return pos;
+}
+
+static void word_bounds(gint pos, const gchar *wordchars, gint *start, gint *end)
+{
+	*start = *end = clamp_position(pos);
+	while (*start > 0 && strchr(wordchars, text->str[*start - 1]) != NULL)
+		(*start)--;
+	while (*end < (gint) text->len && strchr(wordchars, text->str[*end]) != NULL)
+		(*end)++;
+}
+
+
+static GeanyDocument *host_document_get_current(void)
+{
+	return &host_doc;
+}
+
+static gint host_sci_get_selection_start(ScintillaObject *sci)
+{
+	return MIN(anchor, cursor);
+}
+
+static gint host_sci_get_selection_end(ScintillaObject *sci)
+{
+	return MAX(anchor, cursor);
+}
+
+static gint host_sci_get_current_position(ScintillaObject *sci)
+{
+	return cursor;
+}
+
+static gboolean host_sci_has_selection(ScintillaObject *sci)
+{
+	return anchor != cursor;
+}
+
+static gchar *host_sci_get_selection_contents(ScintillaObject *sci)
+{
+	gint start = MIN(anchor, cursor);
+
+	return g_strndup(text->str + start, MAX(anchor, cursor) - start);
+}
+
+static gint host_sci_get_line_from_position(ScintillaObject *sci, gint position)
+{
+	return line_from_position(position);
+}
+
+static gchar *host_editor_get_word_at_pos(GeanyEditor *editor, gint pos,
+										  const gchar *wordchars)
+{
+	gint start, end;
+
+	word_bounds(pos < 0 ? cursor : pos,
+				wordchars != NULL ? wordchars : GEANY_WORDCHARS, &start, &end);
+	if (start == end)
+		return NULL;
+	return g_strndup(text->str + start, end - start);
+}
+
+/* Only the messages the plugin sends are understood */
+static long int host_scintilla_send_message(ScintillaObject *sci,
+											unsigned int message,
+											long unsigned int wparam,
+											long int lparam)
+{
+	gint start, end;
+
+	switch (message)
+	{
+		case SCI_POSITIONFROMPOINTCLOSE:
+			return position_from_point((glong) wparam, lparam);
+		case SCI_WORDSTARTPOSITION:
+		case SCI_WORDENDPOSITION:
+			word_bounds((gint) wparam, GEANY_WORDCHARS, &start, &end);
+			return message == SCI_WORDSTARTPOSITION ? start : end;
+		case SCI_POINTXFROMPOSITION:
+			lparam = clamp_position(lparam);
+			return (lparam - line_start(lparam)) * HOST_CHAR_WIDTH;
+		case SCI_POINTYFROMPOSITION:
+			return line_from_position(lparam) * HOST_LINE_HEIGHT;
+		case SCI_TEXTHEIGHT:
+			return HOST_LINE_HEIGHT;
+		default:
+			return 0;
+	}
+}
+
+static GtkWidget *host_ui_lookup_widget(GtkWidget *widget, const gchar *widget_name)
+{
+	return g_object_get_data(G_OBJECT(gtk_widget_get_toplevel(widget)), widget_name);
+}
+
+static void host_ui_set_statusbar(gboolean log, const gchar *format, ...)
+{
+	va_list args;
+	gchar *message;
+
+	va_start(args, format);
+	message = g_strdup_vprintf(format, args);
+	va_end(args);
+
+	g_printerr("dhp-host: status: %s\n", message);
+	g_free(message);
+}
+
+static GeanyKeyBinding *host_keybindings_set_item(GeanyKeyGroup *group,
+	gsize key_id, GeanyKeyCallback callback, guint key, GdkModifierType mod,
+	const gchar *name, const gchar *label, GtkWidget *menu_item)
+{
+	HostKey *host_key = g_new0(HostKey, 1);
+
+	host_key->callback = callback;
+	host_key->key_id = (guint) key_id;
+	g_hash_table_insert(host_keys, g_strdup(name), host_key);
+
+	return NULL;
+}
+
+static void host_plugin_signal_connect(GeanyPlugin *plugin, GObject *object,
+	const gchar *signal_name, gboolean after, GCallback callback,
+	gpointer user_data)
+{
+	if (object == NULL)
+		object = host_signals;
+
+	if (after)
+		g_signal_connect_after(object, signal_name, callback, user_data);
+	else
+		g_signal_connect(object, signal_name, callback, user_data);
+}
+
+static GeanyKeyGroup *host_plugin_set_key_group(GeanyPlugin *plugin,
+	const gchar *section_name, gsize count, GeanyKeyGroupCallback callback)
+{
+	static gint group;
+
+	/* the plugin only ever hands it back to keybindings_set_item() */
+	return (GeanyKeyGroup *) &group;
+}
+
+static void host_plugin_module_make_resident(GeanyPlugin *plugin)
+{
+	g_module_make_resident(module);
+}
+
+static DocumentFuncs document_funcs = {
+	.document_get_current = host_document_get_current
+};
+
+static SciFuncs sci_funcs = {
+	.sci_get_selection_start = host_sci_get_selection_start,
+	.sci_get_selection_end = host_sci_get_selection_end,
+	.sci_get_current_position = host_sci_get_current_position,
+	.sci_has_selection = host_sci_has_selection,
+	.sci_get_selection_contents = host_sci_get_selection_contents,
+	.sci_get_line_from_position = host_sci_get_line_from_position
+};
+
+static EditorFuncs editor_funcs = {
+	.editor_get_word_at_pos = host_editor_get_word_at_pos
+};
+
+static ScintillaFuncs scintilla_funcs = {
+	.scintilla_send_message = host_scintilla_send_message
+};
+
+static UIUtilsFuncs ui_funcs = {
+	.ui_lookup_widget = host_ui_lookup_widget,
+	.ui_set_statusbar = host_ui_set_statusbar
+};
+
+static KeybindingFuncs keybinding_funcs = {
+	.keybindings_set_item = host_keybindings_set_item
+};
+
+static PluginFuncs plugin_funcs = {
+	.plugin_signal_connect = host_plugin_signal_connect,
+	.plugin_set_key_group = host_plugin_set_key_group,
+	.plugin_module_make_resident = host_plugin_module_make_resident
+};
+
+static GeanyFunctions host_functions = {
+	.p_document = &document_funcs,
+	.p_sci = &sci_funcs,
+	.p_editor = &editor_funcs,
+	.p_scintilla = &scintilla_funcs,
+	.p_ui = &ui_funcs,
+	.p_keybindings = &keybinding_funcs,
+	.p_plugin = &plugin_funcs
+};
+
+
+/* Geany's window as far as the plugin sees it, with one document open */
+static void create_main_window(void)
+{
+	GtkWidget *vbox, *hpaned, *vpaned, *sci;
+
+	host_widgets.window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+	host_widgets.sidebar_notebook = gtk_notebook_new();
+	host_widgets.notebook = gtk_notebook_new();
+	host_widgets.message_window_notebook = gtk_notebook_new();
+	host_widgets.editor_menu = gtk_menu_new();
+
+	vbox = gtk_vbox_new(FALSE, 0);
+	hpaned = gtk_hpaned_new();
+	vpaned = gtk_vpaned_new();
+	gtk_window_set_default_size(GTK_WINDOW(host_widgets.window), 1024, 768);
+	gtk_container_add(GTK_CONTAINER(host_widgets.window), vbox);
+	gtk_box_pack_start(GTK_BOX(vbox), hpaned, TRUE, TRUE, 0);
+	gtk_paned_pack1(GTK_PANED(hpaned), host_widgets.sidebar_notebook, FALSE, FALSE);
+	gtk_paned_pack2(GTK_PANED(hpaned), vpaned, TRUE, TRUE);
+	gtk_paned_pack1(GTK_PANED(vpaned), host_widgets.notebook, TRUE, TRUE);
+	gtk_paned_pack2(GTK_PANED(vpaned), host_widgets.message_window_notebook,
+					FALSE, FALSE);
+
+	/* main-notebook.c parks the document notebook in it for a moment */
+	g_object_set_data_full(G_OBJECT(host_widgets.window), "vbox1",
+						   g_object_ref(vbox), (GDestroyNotify) g_object_unref);
+
+	sci = gtk_drawing_area_new();
+	gtk_widget_set_size_request(sci, 640, 480);
+	gtk_notebook_append_page(GTK_NOTEBOOK(host_widgets.notebook), sci,
+							 gtk_label_new("untitled.c"));
+
+	host_editor.document = &host_doc;
+	host_editor.sci = SCINTILLA(sci);
+	host_doc.is_valid = TRUE;
+	host_doc.index = 0;
+	host_doc.file_name = g_strdup("untitled.c");
+	host_doc.editor = &host_editor;
+	text = g_string_new(NULL);
+
+	gtk_widget_show_all(host_widgets.window);
+}
+
+static void create_geany_data(void)
+{
+	host_signals = g_object_new(host_signals_get_type(), NULL);
+	host_keys = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+	host_workspace.global_tags = g_ptr_array_new();
+	host_app.configdir = config_dir;
+	host_app.tm_workspace = &host_workspace;
+
+	host_data.app = &host_app;
+	host_data.main_widgets = &host_widgets;
+	host_data.documents_array = g_ptr_array_new();
+	g_ptr_array_add(host_data.documents_array, &host_doc);
+
+	host_plugin.info = &host_info;
+}
+
+static gpointer lookup_symbol(const gchar *name)
+{
+	gpointer symbol = NULL;
+
+	if (!g_module_symbol(module, name, &symbol) || symbol == NULL)
+	{
+		g_printerr("dhp-host: '%s' isn't in the plugin: %s\n", name, g_module_error());
+		exit(1);
+	}
+	return symbol;
+}
+
+/* Loads the plugin and gives it the host's data, like Geany does */
+static void load_plugin(void)
+{
+	gint api;
+
+	module = g_module_open(plugin_path, G_MODULE_BIND_LOCAL);
+	if (module == NULL)
+	{
+		g_printerr("dhp-host: unable to load '%s': %s\n", plugin_path,
+				   g_module_error());
+		exit(1);
+	}
+
+	plug.version_check = lookup_symbol("plugin_version_check");
+	plug.set_info = lookup_symbol("plugin_set_info");
+	plug.init = lookup_symbol("plugin_init");
+	plug.cleanup = lookup_symbol("plugin_cleanup");
+	plug.dhplug = lookup_symbol("dev_help_plugin");
+	plug.search = lookup_symbol("devhelp_plugin_search");
+	plug.open_uri = lookup_symbol("devhelp_plugin_open_uri");
+	plug.get_webview = lookup_symbol("devhelp_plugin_get_webview");
+	plug.set_in_message_window = lookup_symbol("devhelp_plugin_set_in_message_window");
+	plug.get_n_tabs = lookup_symbol("doc_tabs_get_n_tabs");
+
+	api = plug.version_check(GEANY_ABI_VERSION);
+	if (api < 0 || api > GEANY_API_VERSION)
+	{
+		g_printerr("dhp-host: the plugin wants API %d and ABI %d, this has "
+				   "API %d\n", api, GEANY_ABI_VERSION, GEANY_API_VERSION);
+		exit(1);
+	}
+
+	*(GeanyPlugin **) lookup_symbol("geany_plugin") = &host_plugin;
+	*(GeanyData **) lookup_symbol("geany_data") = &host_data;
+	*(GeanyFunctions **) lookup_symbol("geany_functions") = &host_functions;
+
+	plug.set_info(&host_info);
+	plug.init(&host_data);
+}
+
+
+static gboolean on_wait_timeout(gpointer user_data)
+{
+	*(gboolean *) user_data = TRUE;
+	return FALSE;
+}
+
+/* Runs the main loop until there's nothing left for it to do */
+static void settle(void)
+{
+	while (gtk_events_pending())
+		gtk_main_iteration();
+}
+
+static void run_for(guint ms)
+{
+	gboolean done = FALSE;
+
+	g_timeout_add(ms, on_wait_timeout, &done);
+	while (!done)
+		gtk_main_iteration();
+}
+
+/* Runs the main loop until condition holds, FALSE if it timed out first */
+static gboolean run_until(HostCondition condition, guint timeout_ms)
+{
+	gboolean timed_out = FALSE;
+	guint id;
+
+	id = g_timeout_add(timeout_ms, on_wait_timeout, &timed_out);
+	while (!condition() && !timed_out)
+		gtk_main_iteration();
+	if (!timed_out)
+		g_source_remove(id);
+
+	return condition();
+}
+
+static gboolean books_loaded(void)
+{
+	return (*plug.dhplug)->book_tree != NULL;
+}
+
+static gboolean page_loaded(void)
+{
+	DevhelpPlugin *dhplug = *plug.dhplug;
+	WebKitLoadStatus status;
+
+	/* getting the webview opens a tab, so don't if there's none */
+	if (plug.get_n_tabs(dhplug->doc_tabs) == 0)
+		return TRUE;
+
+	status = webkit_web_view_get_load_status(
+		WEBKIT_WEB_VIEW(plug.get_webview(dhplug)));
+	return status == WEBKIT_LOAD_FINISHED || status == WEBKIT_LOAD_FAILED;
+}
+
+static void notify_editor(guint code, gint modification_type, gint position)
+{
+	SCNotification nt;
+	gboolean handled = FALSE;
+
+	memset(&nt, 0, sizeof(nt));
+	nt.nmhdr.hwndFrom = host_editor.sci;
+	nt.nmhdr.code = code;
+	nt.modificationType = modification_type;
+	nt.position = position;
+
+	g_signal_emit_by_name(host_signals, "editor-notify", &host_editor, &nt,
+						  &handled);
+}
+
+/* One key typed at the cursor, replacing the selection */
+static void type_key(const gchar *key, gsize len)
+{
+	gint start = MIN(anchor, cursor);
+
+	if (anchor != cursor)
+	{
+		g_string_erase(text, start, MAX(anchor, cursor) - start);
+		notify_editor(SCN_MODIFIED, SC_MOD_DELETETEXT, start);
+	}
+	g_string_insert_len(text, start, key, len);
+	cursor = anchor = start + len;
+
+	notify_editor(SCN_MODIFIED, SC_MOD_INSERTTEXT, start);
+	notify_editor(SCN_UPDATEUI, 0, cursor);
+}
+
+static void hover(gint pos)
+{
+	GtkWidget *sci = GTK_WIDGET(host_editor.sci);
+	GtkTooltip *tooltip;
+	gboolean shown = FALSE;
+	gint x, y;
+
+	pos = clamp_position(pos);
+	x = (pos - line_start(pos)) * HOST_CHAR_WIDTH + HOST_CHAR_WIDTH / 2;
+	y = line_from_position(pos) * HOST_LINE_HEIGHT + HOST_LINE_HEIGHT / 2;
+
+	tooltip = g_object_new(GTK_TYPE_TOOLTIP, NULL);
+	g_signal_emit_by_name(sci, "query-tooltip", x, y, FALSE, tooltip, &shown);
+	g_object_unref(tooltip);
+}
+
+/* A path under the data directory or a URI as it is */
+static gchar *link_to_uri(const gchar *link)
+{
+	gchar *path, *uri;
+
+	if (strstr(link, "://") != NULL)
+		return g_strdup(link);
+
+	path = g_build_filename(data_dir != NULL ? data_dir : ".", link, NULL);
+	uri = g_filename_to_uri(path, NULL, NULL);
+	g_free(path);
+
+	return uri;
+}
+
+/*
+ * Does one action of the script.  Those that might start loading a page
+ * set loads, and the ones that aren't reported set untimed.
+ *
+ * @return	FALSE if the action isn't known or its argument is wrong.
+ */
+static gboolean run_action(const gchar *command, const gchar *arg,
+						   gboolean *loads, gboolean *untimed,
+						   gboolean *timed_out)
+{
+	DevhelpPlugin *dhplug = *plug.dhplug;
+
+	if (g_strcmp0(command, "ready") == 0)
+		*timed_out = !run_until(books_loaded, HOST_READY_TIMEOUT_MS);
+	else if (g_strcmp0(command, "wait") == 0 && *arg != '\0')
+	{
+		run_for((guint) atoi(arg));
+		*untimed = TRUE;
+	}
+	else if (g_strcmp0(command, "text") == 0)
+	{
+		gchar *unescaped = g_strcompress(arg);
+
+		g_string_assign(text, unescaped);
+		g_free(unescaped);
+		cursor = anchor = 0;
+		notify_editor(SCN_MODIFIED, SC_MOD_DELETETEXT | SC_MOD_INSERTTEXT, 0);
+		notify_editor(SCN_UPDATEUI, 0, cursor);
+	}
+	else if (g_strcmp0(command, "cursor") == 0 && *arg != '\0')
+	{
+		cursor = anchor = clamp_position(atoi(arg));
+		notify_editor(SCN_UPDATEUI, 0, cursor);
+	}
+	else if (g_strcmp0(command, "select") == 0)
+	{
+		gint start, end;
+
+		if (sscanf(arg, "%d %d", &start, &end) != 2)
+			return FALSE;
+		anchor = clamp_position(start);
+		cursor = clamp_position(end);
+		notify_editor(SCN_UPDATEUI, 0, cursor);
+	}
+	else if (g_strcmp0(command, "type") == 0)
+	{
+		const gchar *key;
+
+		/* the main loop runs between keys, like when they're typed */
+		for (key = arg; *key != '\0'; key = g_utf8_next_char(key))
+		{
+			type_key(key, g_utf8_next_char(key) - key);
+			settle();
+		}
+	}
+	else if (g_strcmp0(command, "key") == 0)
+	{
+		HostKey *host_key = g_hash_table_lookup(host_keys, arg);
+
+		if (host_key == NULL)
+			return FALSE;
+		host_key->callback(host_key->key_id);
+		*loads = TRUE;
+	}
+	else if (g_strcmp0(command, "popup") == 0)
+	{
+		gtk_menu_popup(GTK_MENU(host_widgets.editor_menu), NULL, NULL, NULL,
+					   NULL, 0, GDK_CURRENT_TIME);
+		settle();
+		gtk_menu_popdown(GTK_MENU(host_widgets.editor_menu));
+	}
+	else if (g_strcmp0(command, "menu") == 0)
+	{
+		if (g_strcmp0(arg, "search") == 0)
+			gtk_menu_item_activate(GTK_MENU_ITEM(dhplug->editor_menu_item));
+		else if (g_strcmp0(arg, "open") == 0)
+			gtk_menu_item_activate(GTK_MENU_ITEM(dhplug->editor_open_menu_item));
+		else
+			return FALSE;
+		*loads = TRUE;
+	}
+	else if (g_strcmp0(command, "search") == 0)
+		plug.search(dhplug, arg);
+	else if (g_strcmp0(command, "click") == 0 && *arg != '\0')
+	{
+		gchar *uri = link_to_uri(arg);
+
+		plug.open_uri(dhplug, uri);
+		g_free(uri);
+		*loads = TRUE;
+	}
+	else if (g_strcmp0(command, "hover") == 0 && *arg != '\0')
+		hover(atoi(arg));
+	else if (g_strcmp0(command, "layout") == 0)
+	{
+		if (g_strcmp0(arg, "msgwin") != 0 && g_strcmp0(arg, "main") != 0)
+			return FALSE;
+		plug.set_in_message_window(dhplug, g_strcmp0(arg, "msgwin") == 0);
+	}
+	else
+		return FALSE;
+
+	return TRUE;
+}
+
+static void append_json_string(GString *json, const gchar *str)
+{
+	g_string_append_c(json, '"');
+	for (; *str != '\0'; str++)
+	{
+		if (*str == '"' || *str == '\\')
+			g_string_append_printf(json, "\\%c", *str);
+		else if ((guchar) *str < 0x20)
+			g_string_append_printf(json, "\\u%04x", (guchar) *str);
+		else
+			g_string_append_c(json, *str);
+	}
+	g_string_append_c(json, '"');
+}
+
+static void append_result(GString *json, guint line, const gchar *action,
+						  gint64 us, gboolean timed_out)
+{
+	if (json->str[json->len - 1] != '[')
+		g_string_append_c(json, ',');
+	g_string_append_printf(json, "{\"line\":%u,\"action\":", line);
+	append_json_string(json, action);
+	g_string_append_printf(json, ",\"us\":%" G_GINT64_FORMAT ",\"timed_out\":%s}",
+						   us, timed_out ? "true" : "false");
+}
+
+/* Replays the script, adding the time of each action to json */
+static gboolean replay(gchar **lines, GString *json)
+{
+	guint i;
+
+	for (i = 0; lines[i] != NULL; i++)
+	{
+		gchar *line = g_strstrip(lines[i]);
+		gchar *arg = line + strcspn(line, " \t");
+		gboolean loads = FALSE, untimed = FALSE, timed_out = FALSE;
+		gint64 start;
+
+		if (*line == '\0' || *line == '#')
+			continue;
+
+		if (*arg != '\0')
+			*arg++ = '\0';
+		arg = g_strchug(arg);
+
+		start = g_get_monotonic_time();
+		if (!run_action(line, arg, &loads, &untimed, &timed_out))
+		{
+			g_printerr("%s:%u: can't do '%s %s'\n", script_path, i + 1, line, arg);
+			return FALSE;
+		}
+		settle();
+		if (loads)
+			timed_out = !run_until(page_loaded, HOST_LOAD_TIMEOUT_MS);
+
+		if (!untimed)
+		{
+			gchar *action = *arg != '\0' ? g_strconcat(line, " ", arg, NULL) :
+				g_strdup(line);
+
+			append_result(json, i + 1, action, g_get_monotonic_time() - start,
+						  timed_out);
+			g_free(action);
+		}
+	}
+
+	return TRUE;
+}
+
+/* Largest the resident set got, in KiB */
+static glong get_peak_rss(void)
+{
+	struct rusage usage;
+
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+	return usage.ru_maxrss;
+}
+
+int main(int argc, char **argv)
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	GString *json;
+	gchar *script, **lines, *cwd;
+	gint64 start;
+	gboolean ok;
+
+	context = g_option_context_new("- replay a session with the Devhelp plugin");
+	g_option_context_add_main_entries(context, entries, NULL);
+	if (!g_option_context_parse(context, &argc, &argv, &error))
+	{
+		g_printerr("%s\n", error->message);
+		return 1;
+	}
+	g_option_context_free(context);
+
+	if (plugin_path == NULL || config_dir == NULL || script_path == NULL)
+	{
+		g_printerr("dhp-host: --plugin, --config and --script are required\n");
+		return 1;
+	}
+
+	if (!g_file_get_contents(script_path, &script, NULL, &error))
+	{
+		g_printerr("dhp-host: %s\n", error->message);
+		return 1;
+	}
+	lines = g_strsplit(script, "\n", -1);
+	g_free(script);
+
+	/* only find the generated books, before GLib caches the directories */
+	if (data_dir != NULL)
+	{
+		gchar *none;
+
+		cwd = g_get_current_dir();
+		if (!g_path_is_absolute(data_dir))
+			data_dir = g_build_filename(cwd, data_dir, NULL);
+		g_free(cwd);
+
+		none = g_build_filename(data_dir, "none", NULL);
+		g_setenv("XDG_DATA_HOME", data_dir, TRUE);
+		g_setenv("XDG_DATA_DIRS", none, TRUE);
+		g_free(none);
+	}
+
+	g_thread_init(NULL);
+	gtk_init(&argc, &argv);
+
+	create_main_window();
+	create_geany_data();
+
+	start = g_get_monotonic_time();
+	load_plugin();
+	settle();
+
+	json = g_string_new("{\"actions\":[");
+	append_result(json, 0, "plugin_init", g_get_monotonic_time() - start, FALSE);
+	ok = replay(lines, json);
+	g_strfreev(lines);
+
+	plug.cleanup();
+
+	g_string_append_printf(json, "],\"peak_rss_kb\":%ld}", get_peak_rss());
+	if (ok)
+		printf("%s\n", json->str);
+	g_string_free(json, TRUE);
+
+	return ok ? 0 : 1;
+}
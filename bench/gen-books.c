@@ -0,0 +1,237 @@
+/*
+ * gen-books.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+
+/*
+ * Writes a synthetic Devhelp book for the benchmarks: keywords with names
+ * shaped like a GObject library's, spread over a tree of chapters.  The
+ * same options always give the same book.
+ *
+ * The book goes in OUTPUT/devhelp/books/NAME/ so setting XDG_DATA_HOME to
+ * OUTPUT makes the plugin's code find it like an installed one.  With
+ * --pages the chapter pages are written next to it, each with an anchor
+ * and a short description for every keyword that links to it, so opening
+ * links loads something like a real reference page.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+static const gchar *objects[] = {
+	"widget", "window", "button", "label", "entry", "tree_view", "list_store",
+	"buffer", "iter", "adjustment", "container", "notebook", "action",
+	"settings", "style", "file", "stream", "socket", "variant", "value"
+};
+
+static const gchar *verbs[] = {
+	"get", "set", "new", "free", "ref", "unref", "add", "remove", "insert",
+	"append", "show", "hide", "connect", "find", "lookup", "copy", "load",
+	"save", "begin", "end"
+};
+
+static const gchar *nouns[] = {
+	"", "_name", "_value", "_size", "_model", "_child", "_parent", "_data",
+	"_flags", "_state", "_text", "_markup", "_position", "_selection"
+};
+
+static gint n_keywords = 1000;
+static gint depth = 4;
+static gint fanout = 8;
+static gint seed = 1;
+static gchar *book_name = NULL;
+static gchar *output = NULL;
+static gboolean pages = FALSE;
+
+static GOptionEntry entries[] = {
+	{ "keywords", 'k', 0, G_OPTION_ARG_INT, &n_keywords,
+	  "Number of keywords (default 1000)", "N" },
+	{ "depth", 'd', 0, G_OPTION_ARG_INT, &depth,
+	  "Depth of the chapter tree (default 4)", "D" },
+	{ "fanout", 'f', 0, G_OPTION_ARG_INT, &fanout,
+	  "Sub chapters per chapter (default 8)", "F" },
+	{ "seed", 's', 0, G_OPTION_ARG_INT, &seed,
+	  "Random seed (default 1)", "S" },
+	{ "name", 'n', 0, G_OPTION_ARG_STRING, &book_name,
+	  "Name of the book (default bench-N)", "NAME" },
+	{ "output", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+	  "Directory to write the book under", "DIR" },
+	{ "pages", 'p', 0, G_OPTION_ARG_NONE, &pages,
+	  "Also write the HTML pages the book links to", NULL },
+	{ NULL }
+};
+
+/* Writes the chapters below one of depth level, returns the pages written */
+static guint write_chapters(FILE *fp, guint level, guint *page, gint indent)
+{
+	guint i, n = 0;
+
+	if (level >= (guint) depth)
+		return 0;
+
+	for (i = 0; i < (guint) fanout; i++)
+	{
+		guint this_page = (*page)++;
+
+		fprintf(fp, "%*s<sub name=\"Chapter %u.%u\" link=\"page%u.html\">\n",
+				indent, "", level + 1, i + 1, this_page);
+		n += 1 + write_chapters(fp, level + 1, page, indent + 2);
+		fprintf(fp, "%*s</sub>\n", indent, "");
+	}
+
+	return n;
+}
+
+/* Writes one HTML page, returns FALSE if it couldn't be written */
+static gboolean write_page(const gchar *dir, guint page, const gchar *body)
+{
+	gchar *name, *path, *html;
+	gboolean ok;
+
+	name = g_strdup_printf("page%u.html", page);
+	path = g_build_filename(dir, name, NULL);
+	html = g_strdup_printf("<html>\n<head><title>Page %u</title></head>\n"
+						   "<body>\n<h1>Page %u</h1>\n%s</body>\n</html>\n",
+						   page, page, body);
+	ok = g_file_set_contents(path, html, -1, NULL);
+	if (!ok)
+		g_printerr("gen-books: unable to write '%s'\n", path);
+
+	g_free(html);
+	g_free(path);
+	g_free(name);
+
+	return ok;
+}
+
+int main(int argc, char **argv)
+{
+	GOptionContext *context;
+	GError *error = NULL;
+	GRand *rand;
+	GPtrArray *bodies = NULL;
+	FILE *fp;
+	gchar *dir, *path, *file_name;
+	guint n_pages, page = 0;
+	gint i;
+
+	context = g_option_context_new("- write a synthetic Devhelp book");
+	g_option_context_add_main_entries(context, entries, NULL);
+	if (!g_option_context_parse(context, &argc, &argv, &error))
+	{
+		g_printerr("%s\n", error->message);
+		return 1;
+	}
+	g_option_context_free(context);
+
+	if (output == NULL || n_keywords < 1 || depth < 0 || fanout < 1)
+	{
+		g_printerr("gen-books: --output is required and sizes must be positive\n");
+		return 1;
+	}
+	if (book_name == NULL)
+		book_name = g_strdup_printf("bench-%d", n_keywords);
+
+	dir = g_build_filename(output, "devhelp", "books", book_name, NULL);
+	if (g_mkdir_with_parents(dir, 0755) != 0)
+	{
+		g_printerr("gen-books: unable to create '%s'\n", dir);
+		return 1;
+	}
+
+	file_name = g_strconcat(book_name, ".devhelp2", NULL);
+	path = g_build_filename(dir, file_name, NULL);
+	fp = g_fopen(path, "w");
+	if (fp == NULL)
+	{
+		g_printerr("gen-books: unable to write '%s'\n", path);
+		return 1;
+	}
+
+	fprintf(fp, "<?xml version=\"1.0\" encoding=\"utf-8\" standalone=\"no\"?>\n"
+			"<book xmlns=\"http://www.devhelp.net/book\" title=\"Bench %d\" "
+			"link=\"index.html\" name=\"%s\" version=\"2\" language=\"c\">\n"
+			"  <chapters>\n", n_keywords, book_name);
+	n_pages = write_chapters(fp, 0, &page, 4);
+	fprintf(fp, "  </chapters>\n  <functions>\n");
+
+	/* keywords link to page0 when there are no chapters, so there's at
+	 * least that one */
+	if (pages)
+	{
+		bodies = g_ptr_array_new();
+		for (page = 0; page < MAX(n_pages, 1); page++)
+			g_ptr_array_add(bodies, g_string_new(NULL));
+	}
+
+	/* names repeat across objects and prefixes, like real libraries do */
+	rand = g_rand_new_with_seed(seed);
+	for (i = 0; i < n_keywords; i++)
+	{
+		const gchar *object = objects[g_rand_int_range(rand, 0, G_N_ELEMENTS(objects))];
+		const gchar *verb = verbs[g_rand_int_range(rand, 0, G_N_ELEMENTS(verbs))];
+		const gchar *noun = nouns[g_rand_int_range(rand, 0, G_N_ELEMENTS(nouns))];
+		guint kw_page = n_pages ? (guint) g_rand_int_range(rand, 0, n_pages) : 0;
+
+		fprintf(fp, "    <keyword type=\"function\" name=\"bench%u_%s_%s%s_%d ()\" "
+				"link=\"page%u.html#bench%u-%s-%s-%d\"/>\n",
+				(guint) i % 16, object, verb, noun, i, kw_page,
+				(guint) i % 16, object, verb, i);
+
+		if (bodies != NULL)
+			g_string_append_printf(g_ptr_array_index(bodies, kw_page),
+				"<h2><a name=\"bench%u-%s-%s-%d\"></a>bench%u_%s_%s%s_%d ()</h2>\n"
+				"<p>Does something to a %s, see also the other %s functions.</p>\n",
+				(guint) i % 16, object, verb, i, (guint) i % 16, object, verb,
+				noun, i, object, verb);
+	}
+	g_rand_free(rand);
+
+	fprintf(fp, "  </functions>\n</book>\n");
+	if (fclose(fp) != 0)
+	{
+		g_printerr("gen-books: unable to write '%s'\n", path);
+		return 1;
+	}
+
+	if (bodies != NULL)
+	{
+		for (page = 0; page < bodies->len; page++)
+		{
+			GString *body = g_ptr_array_index(bodies, page);
+
+			if (!write_page(dir, page, body->str))
+				return 1;
+			g_string_free(body, TRUE);
+		}
+		g_ptr_array_free(bodies, TRUE);
+	}
+
+	g_print("%s: %d keywords, %u chapters\n", path, n_keywords, n_pages);
+
+	g_free(path);
+	g_free(file_name);
+	g_free(dir);
+
+	return 0;
+}
@@ -0,0 +1,702 @@
+/*
+ * book-index.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <sys/stat.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "book-index.h"
+
+/* book file names tried in each book directory, in order of preference */
+static const gchar *book_suffixes[] = {
+	".devhelp2", ".devhelp2.gz", ".devhelp", ".devhelp.gz", NULL
+};
+
+/* version 1 books encode the keyword type as a prefix of the name */
+static const struct
+{
+	const gchar *prefix;
+	BookKeywordType type;
+} v1_prefixes[] = {
+	{ "function ",	BOOK_KEYWORD_FUNCTION },
+	{ "struct ",	BOOK_KEYWORD_STRUCT },
+	{ "union ",		BOOK_KEYWORD_STRUCT },
+	{ "enum ",		BOOK_KEYWORD_ENUM },
+	{ "macro ",		BOOK_KEYWORD_MACRO },
+	{ "typedef ",	BOOK_KEYWORD_TYPEDEF },
+	{ "property ",	BOOK_KEYWORD_PROPERTY },
+	{ "signal ",	BOOK_KEYWORD_SIGNAL }
+};
+
+/* state kept while parsing a single book file */
+typedef struct
+{
+	GString *strings;
+	GArray *keywords;
+	GArray *chapters;
+	GArray *open;				/* stack of the <sub>s being parsed */
+	GArray *last;				/* last chapter at each depth so far */
+	gchar *dir;
+	gboolean have_book;
+	guint32 title;
+	guint32 name;
+	guint32 base;
+	guint32 link;
+} ParseState;
+
+/* a book being put together by a documentation provider */
+struct _BookBuilder
+{
+	ParseState state;
+};
+
+static guint32 pool_add(GString *pool, const gchar *str, gssize len)
+{
+	guint32 offset = pool->len;
+
+	if (len < 0)
+		len = strlen(str);
+	g_string_append_len(pool, str, len);
+	g_string_append_c(pool, '\0');
+
+	return offset;
+}
+
+static const gchar *lookup_attribute(const gchar **names, const gchar **values,
+									 const gchar *wanted)
+{
+	gint i;
+
+	for (i = 0; names[i] != NULL; i++)
+	{
+		if (strcmp(names[i], wanted) == 0)
+			return values[i];
+	}
+	return NULL;
+}
+
+/**
+ * Gets the BookKeywordType of a Devhelp keyword type attribute, such as
+ * "function" or "macro".
+ *
+ * @param type	The type or NULL.
+ *
+ * @return	The type, BOOK_KEYWORD_OTHER if it isn't known.
+ */
+BookKeywordType book_keyword_type_from_string(const gchar *type)
+{
+	if (type == NULL)
+		return BOOK_KEYWORD_OTHER;
+	if (strcmp(type, "function") == 0)
+		return BOOK_KEYWORD_FUNCTION;
+	if (strcmp(type, "struct") == 0 || strcmp(type, "union") == 0)
+		return BOOK_KEYWORD_STRUCT;
+	if (strcmp(type, "macro") == 0)
+		return BOOK_KEYWORD_MACRO;
+	if (strcmp(type, "enum") == 0)
+		return BOOK_KEYWORD_ENUM;
+	if (strcmp(type, "typedef") == 0)
+		return BOOK_KEYWORD_TYPEDEF;
+	if (strcmp(type, "property") == 0)
+		return BOOK_KEYWORD_PROPERTY;
+	if (strcmp(type, "signal") == 0)
+		return BOOK_KEYWORD_SIGNAL;
+	return BOOK_KEYWORD_OTHER;
+}
+
+static void add_keyword(ParseState *state, const gchar *name,
+						const gchar *link, BookKeywordType type, gboolean v1)
+{
+	BookKeyword kw;
+	gsize len;
+	guint i;
+
+	if (name == NULL || link == NULL)
+		return;
+
+	if (v1)
+	{
+		for (i = 0; i < G_N_ELEMENTS(v1_prefixes); i++)
+		{
+			if (g_str_has_prefix(name, v1_prefixes[i].prefix))
+			{
+				name += strlen(v1_prefixes[i].prefix);
+				type = v1_prefixes[i].type;
+				break;
+			}
+		}
+	}
+
+	/* "gtk_widget_show ()" -> "gtk_widget_show" */
+	len = strlen(name);
+	if (len > 2 && strcmp(name + len - 2, "()") == 0)
+	{
+		len -= 2;
+		while (len > 0 && name[len - 1] == ' ')
+			len--;
+	}
+	if (len == 0)
+		return;
+
+	kw.name = pool_add(state->strings, name, len);
+	kw.link = pool_add(state->strings, link, -1);
+	kw.type = type;
+	g_array_append_val(state->keywords, kw);
+}
+
+/* Starts a chapter inside whichever one is open */
+static void open_chapter(ParseState *state, const gchar *name, const gchar *link)
+{
+	BookChapter chapter;
+	guint32 index, prev, none = BOOK_CHAPTER_NONE;
+
+	index = state->chapters->len;
+	chapter.name = name ? pool_add(state->strings, name, -1) : 0;
+	chapter.link = link ? pool_add(state->strings, link, -1) : 0;
+	chapter.next = BOOK_CHAPTER_NONE;
+	chapter.parent = BOOK_CHAPTER_NONE;
+	if (state->open->len > 0)
+		chapter.parent = g_array_index(state->open, guint32, state->open->len - 1);
+
+	prev = g_array_index(state->last, guint32, state->open->len);
+	if (prev != BOOK_CHAPTER_NONE)
+		g_array_index(state->chapters, BookChapter, prev).next = index;
+	g_array_index(state->last, guint32, state->open->len) = index;
+
+	g_array_append_val(state->chapters, chapter);
+	g_array_append_val(state->open, index);
+	g_array_append_val(state->last, none);
+}
+
+static void close_chapter(ParseState *state)
+{
+	if (state->open->len == 0)
+		return;
+	g_array_set_size(state->open, state->open->len - 1);
+	g_array_set_size(state->last, state->last->len - 1);
+}
+
+static void parser_start_element(GMarkupParseContext *context,
+								 const gchar *element_name,
+								 const gchar **attribute_names,
+								 const gchar **attribute_values,
+								 gpointer user_data,
+								 GError **error)
+{
+	ParseState *state = user_data;
+	const gchar *name, *link;
+
+	if (strcmp(element_name, "keyword") == 0)
+	{
+		name = lookup_attribute(attribute_names, attribute_values, "name");
+		link = lookup_attribute(attribute_names, attribute_values, "link");
+		add_keyword(state, name, link, book_keyword_type_from_string(
+			lookup_attribute(attribute_names, attribute_values, "type")), FALSE);
+	}
+	else if (strcmp(element_name, "function") == 0)
+	{
+		name = lookup_attribute(attribute_names, attribute_values, "name");
+		link = lookup_attribute(attribute_names, attribute_values, "link");
+		add_keyword(state, name, link, BOOK_KEYWORD_FUNCTION, TRUE);
+	}
+	else if (strcmp(element_name, "sub") == 0)
+	{
+		name = lookup_attribute(attribute_names, attribute_values, "name");
+		link = lookup_attribute(attribute_names, attribute_values, "link");
+		open_chapter(state, name, link);
+	}
+	else if (strcmp(element_name, "book") == 0)
+	{
+		const gchar *title, *base;
+
+		title = lookup_attribute(attribute_names, attribute_values, "title");
+		name = lookup_attribute(attribute_names, attribute_values, "name");
+		base = lookup_attribute(attribute_names, attribute_values, "base");
+
+		if (name == NULL)
+		{
+			g_set_error(error, G_MARKUP_ERROR, G_MARKUP_ERROR_MISSING_ATTRIBUTE,
+						"<book> element has no name");
+			return;
+		}
+
+		link = lookup_attribute(attribute_names, attribute_values, "link");
+
+		state->have_book = TRUE;
+		state->name = pool_add(state->strings, name, -1);
+		state->link = link ? pool_add(state->strings, link, -1) : 0;
+		state->title = pool_add(state->strings, title ? title : name, -1);
+		if (base != NULL && g_path_is_absolute(base))
+			state->base = pool_add(state->strings, base, -1);
+		else
+			state->base = pool_add(state->strings, state->dir, -1);
+	}
+}
+
+static void parser_end_element(GMarkupParseContext *context,
+							   const gchar *element_name,
+							   gpointer user_data,
+							   GError **error)
+{
+	if (strcmp(element_name, "sub") == 0)
+		close_chapter(user_data);
+}
+
+/* Sets up the pools and arrays, offset 0 of the string pool is always "" */
+static void parse_state_init(ParseState *state)
+{
+	guint32 none = BOOK_CHAPTER_NONE;
+
+	memset(state, 0, sizeof(ParseState));
+	state->strings = g_string_sized_new(4096);
+	state->keywords = g_array_new(FALSE, FALSE, sizeof(BookKeyword));
+	state->chapters = g_array_new(FALSE, FALSE, sizeof(BookChapter));
+	state->open = g_array_new(FALSE, FALSE, sizeof(guint32));
+	state->last = g_array_new(FALSE, FALSE, sizeof(guint32));
+	g_array_append_val(state->last, none);
+	pool_add(state->strings, "", 0);
+}
+
+/* Frees what's left of the state, the pools too unless a book took them */
+static void parse_state_clear(ParseState *state)
+{
+	if (state->strings != NULL)
+		g_string_free(state->strings, TRUE);
+	if (state->keywords != NULL)
+		g_array_free(state->keywords, TRUE);
+	if (state->chapters != NULL)
+		g_array_free(state->chapters, TRUE);
+	g_array_free(state->open, TRUE);
+	g_array_free(state->last, TRUE);
+	g_free(state->dir);
+}
+
+/* Hands the pools over to a new BookIndex */
+static BookIndex *parse_state_to_book(ParseState *state, const gchar *path,
+									  gint64 mtime)
+{
+	BookIndex *book = g_new0(BookIndex, 1);
+
+	book->path = g_strdup(path);
+	book->mtime = mtime;
+	book->title = state->title;
+	book->name = state->name;
+	book->base = state->base;
+	book->link = state->link;
+	book->n_keywords = state->keywords->len;
+	book->heap_keywords = (BookKeyword *) g_array_free(state->keywords, FALSE);
+	book->n_chapters = state->chapters->len;
+	book->heap_chapters = (BookChapter *) g_array_free(state->chapters, FALSE);
+	book->strings_len = state->strings->len;
+	book->heap_strings = g_string_free(state->strings, FALSE);
+	book->keywords = book->heap_keywords;
+	book->chapters = book->heap_chapters;
+	book->strings = book->heap_strings;
+
+	state->keywords = NULL;
+	state->chapters = NULL;
+	state->strings = NULL;
+
+	return book;
+}
+
+static GMarkupParser book_parser = {
+	parser_start_element, parser_end_element, NULL, NULL, NULL
+};
+
+/* Reads a whole book file, decompressing it if it's gzipped */
+static gchar *read_book_file(const gchar *path, gsize *length, GError **error)
+{
+	GFile *file;
+	GInputStream *stream, *in;
+	GConverter *converter;
+	GByteArray *buffer;
+	guint8 chunk[16384];
+	gssize n_read;
+
+	if (!g_str_has_suffix(path, ".gz"))
+	{
+		gchar *contents;
+		if (!g_file_get_contents(path, &contents, length, error))
+			return NULL;
+		return contents;
+	}
+
+	file = g_file_new_for_path(path);
+	stream = G_INPUT_STREAM(g_file_read(file, NULL, error));
+	g_object_unref(file);
+	if (stream == NULL)
+		return NULL;
+
+	converter = G_CONVERTER(g_zlib_decompressor_new(G_ZLIB_COMPRESSOR_FORMAT_GZIP));
+	in = g_converter_input_stream_new(stream, converter);
+	g_object_unref(converter);
+	g_object_unref(stream);
+
+	buffer = g_byte_array_new();
+	while ((n_read = g_input_stream_read(in, chunk, sizeof(chunk), NULL, error)) > 0)
+		g_byte_array_append(buffer, chunk, n_read);
+	g_object_unref(in);
+
+	if (n_read < 0)
+	{
+		g_byte_array_free(buffer, TRUE);
+		return NULL;
+	}
+
+	*length = buffer->len;
+	g_byte_array_append(buffer, (const guint8 *) "", 1);
+
+	return (gchar *) g_byte_array_free(buffer, FALSE);
+}
+
+static void find_books_in_dir(const gchar *dir, GHashTable *seen,
+							  GPtrArray *files)
+{
+	GDir *gdir;
+	const gchar *name;
+	guint i;
+
+	gdir = g_dir_open(dir, 0, NULL);
+	if (gdir == NULL)
+		return;
+
+	while ((name = g_dir_read_name(gdir)) != NULL)
+	{
+		/* books are found by name, the first directory wins */
+		if (g_hash_table_lookup(seen, name) != NULL)
+			continue;
+
+		for (i = 0; book_suffixes[i] != NULL; i++)
+		{
+			gchar *file_name = g_strconcat(name, book_suffixes[i], NULL);
+			gchar *path = g_build_filename(dir, name, file_name, NULL);
+			g_free(file_name);
+
+			if (g_file_test(path, G_FILE_TEST_IS_REGULAR))
+			{
+				g_ptr_array_add(files, path);
+				g_hash_table_insert(seen, g_strdup(name), GINT_TO_POINTER(1));
+				break;
+			}
+			g_free(path);
+		}
+	}
+
+	g_dir_close(gdir);
+}
+
+/**
+ * Gets the directories books are installed in, in the user's and the
+ * system's data directories, the same places Devhelp itself looks.  Not
+ * all of them need exist.
+ *
+ * @return	A newly allocated NULL terminated array of directories, in order
+ * 			of preference, free it with g_strfreev().
+ */
+gchar **book_index_get_dirs(void)
+{
+	const gchar * const *system_dirs;
+	GPtrArray *dirs, *data_dirs;
+	guint i;
+
+	dirs = g_ptr_array_new();
+	data_dirs = g_ptr_array_new();
+
+	g_ptr_array_add(data_dirs, (gpointer) g_get_user_data_dir());
+	system_dirs = g_get_system_data_dirs();
+	for (i = 0; system_dirs[i] != NULL; i++)
+		g_ptr_array_add(data_dirs, (gpointer) system_dirs[i]);
+
+	for (i = 0; i < data_dirs->len; i++)
+	{
+		g_ptr_array_add(dirs, g_build_filename(data_dirs->pdata[i],
+											   "devhelp", "books", NULL));
+		g_ptr_array_add(dirs, g_build_filename(data_dirs->pdata[i],
+											   "gtk-doc", "html", NULL));
+	}
+
+	g_ptr_array_free(data_dirs, TRUE);
+	g_ptr_array_add(dirs, NULL);
+
+	return (gchar **) g_ptr_array_free(dirs, FALSE);
+}
+
+/**
+ * Finds all of the Devhelp book files installed in the directories from
+ * book_index_get_dirs().
+ *
+ * @return	A newly allocated NULL terminated array of file names, free it
+ * 			with g_strfreev().
+ */
+gchar **book_index_find_files(void)
+{
+	GHashTable *seen;
+	GPtrArray *files;
+	gchar **dirs;
+	guint i;
+
+	seen = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	files = g_ptr_array_new();
+
+	dirs = book_index_get_dirs();
+	for (i = 0; dirs[i] != NULL; i++)
+		find_books_in_dir(dirs[i], seen, files);
+	g_strfreev(dirs);
+
+	g_hash_table_destroy(seen);
+	g_ptr_array_add(files, NULL);
+
+	return (gchar **) g_ptr_array_free(files, FALSE);
+}
+
+/**
+ * Gets the modification time of a file.
+ *
+ * @param path	The file to check.
+ *
+ * @return	The modification time in seconds or -1 if the file can't be
+ * 			stat'ed.
+ */
+gint64 book_index_file_mtime(const gchar *path)
+{
+	struct stat st;
+
+	if (g_stat(path, &st) != 0)
+		return -1;
+	return (gint64) st.st_mtime;
+}
+
+/**
+ * Parses a Devhelp book file into a new BookIndex.  This function doesn't
+ * touch any global state so it's safe to call from any thread.
+ *
+ * @param path	The .devhelp/.devhelp2 file, optionally gzipped.
+ * @param mtime	The modification time to record for the file.
+ * @param error	Return location for an error or NULL.
+ *
+ * @return	A new BookIndex to be freed with book_index_free() or NULL on
+ * 			error.
+ */
+BookIndex *book_index_parse_file(const gchar *path, gint64 mtime, GError **error)
+{
+	GMarkupParseContext *context;
+	ParseState state;
+	BookIndex *book;
+	gchar *contents;
+	gsize length;
+	gboolean ok;
+
+	contents = read_book_file(path, &length, error);
+	if (contents == NULL)
+		return NULL;
+
+	parse_state_init(&state);
+	state.dir = g_path_get_dirname(path);
+
+	context = g_markup_parse_context_new(&book_parser, 0, &state, NULL);
+	ok = g_markup_parse_context_parse(context, contents, length, error) &&
+		 g_markup_parse_context_end_parse(context, error);
+	g_markup_parse_context_free(context);
+	g_free(contents);
+
+	if (ok && !state.have_book)
+	{
+		g_set_error(error, G_MARKUP_ERROR, G_MARKUP_ERROR_INVALID_CONTENT,
+					"'%s' doesn't contain a <book> element", path);
+		ok = FALSE;
+	}
+
+	book = ok ? parse_state_to_book(&state, path, mtime) : NULL;
+	parse_state_clear(&state);
+
+	return book;
+}
+
+/**
+ * Starts putting together a book that doesn't come from a book file, for
+ * documentation providers other than Devhelp.  Books built this way have
+ * keywords but no chapters.
+ *
+ * @param title	The title shown in the Contents tab.
+ * @param name	The name filetype book sets match against.
+ * @param base	The directory relative links are in.
+ * @param link	The front page, relative to base, or NULL for none.
+ *
+ * @return	A new BookBuilder, turn it into a book with book_builder_finish().
+ */
+BookBuilder *book_builder_new(const gchar *title, const gchar *name,
+							  const gchar *base, const gchar *link)
+{
+	BookBuilder *builder = g_new(BookBuilder, 1);
+	ParseState *state = &builder->state;
+
+	parse_state_init(state);
+	state->have_book = TRUE;
+	state->title = pool_add(state->strings, title, -1);
+	state->name = pool_add(state->strings, name, -1);
+	state->base = pool_add(state->strings, base, -1);
+	state->link = link ? pool_add(state->strings, link, -1) : 0;
+
+	return builder;
+}
+
+/**
+ * Adds a keyword to a book being built.  Trailing "()" are dropped from
+ * the name like they are for Devhelp books.
+ *
+ * @param builder	The book.
+ * @param name		The keyword.
+ * @param link		Its page, relative to the book's base, or a URI.
+ * @param type		What kind of symbol it is.
+ */
+void book_builder_add_keyword(BookBuilder *builder, const gchar *name,
+							  const gchar *link, BookKeywordType type)
+{
+	add_keyword(&builder->state, name, link, type, FALSE);
+}
+
+/**
+ * Turns what was added to a builder into a BookIndex and frees the builder.
+ *
+ * @param builder	The book.
+ * @param path		What the book was made from, it's what the snapshot
+ * 					and the book monitor know the book by.
+ * @param mtime		The modification time of path.
+ *
+ * @return	A new BookIndex to be freed with book_index_free().
+ */
+BookIndex *book_builder_finish(BookBuilder *builder, const gchar *path,
+							   gint64 mtime)
+{
+	BookIndex *book = parse_state_to_book(&builder->state, path, mtime);
+
+	parse_state_clear(&builder->state);
+	g_free(builder);
+
+	return book;
+}
+
+/**
+ * Creates a BookIndex whose data lives inside a memory mapped snapshot.
+ * A reference is taken on mapped, the pointers must point inside of it.
+ *
+ * @return	A new BookIndex to be freed with book_index_free().
+ */
+BookIndex *book_index_new_mapped(GMappedFile *mapped, const gchar *path,
+								 gint64 mtime, guint32 title, guint32 name,
+								 guint32 base, guint32 link,
+								 const BookKeyword *keywords, guint n_keywords,
+								 const BookChapter *chapters, guint n_chapters,
+								 const gchar *strings, gsize strings_len)
+{
+	BookIndex *book = g_new0(BookIndex, 1);
+
+	book->path = g_strdup(path);
+	book->mtime = mtime;
+	book->title = title;
+	book->name = name;
+	book->base = base;
+	book->link = link;
+	book->keywords = keywords;
+	book->n_keywords = n_keywords;
+	book->chapters = chapters;
+	book->n_chapters = n_chapters;
+	book->strings = strings;
+	book->strings_len = strings_len;
+	book->mapped = g_mapped_file_ref(mapped);
+
+	return book;
+}
+
+/**
+ * Frees a BookIndex and drops its reference on any mapped snapshot.
+ */
+void book_index_free(BookIndex *book)
+{
+	if (book == NULL)
+		return;
+
+	if (book->mapped != NULL)
+		g_mapped_file_unref(book->mapped);
+	g_free(book->heap_keywords);
+	g_free(book->heap_chapters);
+	g_free(book->heap_strings);
+	g_free(book->path);
+	g_free(book);
+}
+
+/**
+ * Turns a link from a book (relative to the book's base directory and with
+ * an optional anchor) into a URI that can be loaded in the web view.
+ *
+ * @return	A newly allocated URI or NULL on error.
+ */
+gchar *book_index_link_to_uri(const BookIndex *book, guint32 link)
+{
+	const gchar *rel, *anchor;
+	gchar *file_part, *filename, *uri;
+
+	rel = book_index_str(book, link);
+	if (strstr(rel, "://") != NULL)
+		return g_strdup(rel);
+
+	anchor = strchr(rel, '#');
+	file_part = anchor ? g_strndup(rel, anchor - rel) : g_strdup(rel);
+	filename = g_build_filename(book_index_str(book, book->base), file_part, NULL);
+	uri = g_filename_to_uri(filename, NULL, NULL);
+	g_free(filename);
+	g_free(file_part);
+
+	if (uri != NULL && anchor != NULL)
+	{
+		gchar *tmp = g_strconcat(uri, anchor, NULL);
+		g_free(uri);
+		uri = tmp;
+	}
+
+	return uri;
+}
+
+/**
+ * Gets the URI of a keyword's documentation.
+ *
+ * @return	A newly allocated URI or NULL on error.
+ */
+gchar *book_index_get_uri(const BookIndex *book, guint keyword)
+{
+	g_return_val_if_fail(keyword < book->n_keywords, NULL);
+	return book_index_link_to_uri(book, book->keywords[keyword].link);
+}
+
+/**
+ * Gets the URI of a chapter's page.
+ *
+ * @return	A newly allocated URI or NULL on error.
+ */
+gchar *book_index_get_chapter_uri(const BookIndex *book, guint chapter)
+{
+	g_return_val_if_fail(chapter < book->n_chapters, NULL);
+	return book_index_link_to_uri(book, book->chapters[chapter].link);
+}
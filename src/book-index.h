@@ -0,0 +1,143 @@
+/*
+ * book-index.h - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef BOOK_INDEX_H
+#define BOOK_INDEX_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * A BookIndex holds the keywords and chapters of one Devhelp book file in
+ * a compact, position independent form: flat arrays of BookKeyword and
+ * BookChapter records whose fields are offsets into a single string pool.
+ * The same layout is used whether the book was just parsed (heap storage)
+ * or comes from the on-disk snapshot (memory mapped storage, see
+ * index-snapshot.c), so nothing using a BookIndex needs to care where it
+ * came from.  Books of the other
+ * documentation providers, which have no book file, are put together with
+ * a BookBuilder instead.
+ *
+ * See book-index.c for documentation for these functions
+ */
+
+typedef enum
+{
+	BOOK_KEYWORD_OTHER = 0,
+	BOOK_KEYWORD_FUNCTION,
+	BOOK_KEYWORD_STRUCT,
+	BOOK_KEYWORD_MACRO,
+	BOOK_KEYWORD_ENUM,
+	BOOK_KEYWORD_TYPEDEF,
+	BOOK_KEYWORD_PROPERTY,
+	BOOK_KEYWORD_SIGNAL
+} BookKeywordType;
+
+typedef struct _BookKeyword		BookKeyword;
+typedef struct _BookChapter		BookChapter;
+typedef struct _BookIndex		BookIndex;
+typedef struct _BookBuilder		BookBuilder;
+
+/* Turns a source file (or directory) into a book, see doc-provider.h */
+typedef BookIndex *(*BookParseFunc) (const gchar *path, gint64 mtime,
+									 GError **error);
+
+/* parent/next of a chapter that has none */
+#define BOOK_CHAPTER_NONE	G_MAXUINT32
+
+struct _BookKeyword
+{
+	guint32 name;				/* offset of the keyword name in strings */
+	guint32 link;				/* offset of the link (relative to base) */
+	guint32 type;				/* a BookKeywordType */
+};
+
+/*
+ * Chapters are stored in document order, so a chapter's first child, if it
+ * has any, is the chapter right after it.
+ */
+struct _BookChapter
+{
+	guint32 name;				/* offset of the chapter title in strings */
+	guint32 link;				/* offset of the link (relative to base) */
+	guint32 parent;				/* index of the parent or BOOK_CHAPTER_NONE */
+	guint32 next;				/* index of the next sibling or ditto */
+};
+
+struct _BookIndex
+{
+	gchar *path;				/* the .devhelp/.devhelp2 file, or whatever
+								 * its provider made it from */
+	gint64 mtime;				/* modification time of path when indexed */
+
+	guint32 title;				/* offsets of book attributes in strings */
+	guint32 name;
+	guint32 base;
+	guint32 link;				/* the book's front page */
+
+	const BookKeyword *keywords;
+	guint n_keywords;
+	const BookChapter *chapters;
+	guint n_chapters;
+	const gchar *strings;		/* string pool, NUL separated */
+	gsize strings_len;
+
+	/* storage, either mapped or heap_* are set */
+	GMappedFile *mapped;
+	BookKeyword *heap_keywords;
+	BookChapter *heap_chapters;
+	gchar *heap_strings;
+};
+
+#define book_index_str(book, offset)	((book)->strings + (offset))
+#define book_index_keyword_name(book, i) \
+			book_index_str((book), (book)->keywords[(i)].name)
+#define book_index_chapter_name(book, i) \
+			book_index_str((book), (book)->chapters[(i)].name)
+
+gchar **book_index_get_dirs(void);
+gchar **book_index_find_files(void);
+BookIndex *book_index_parse_file(const gchar *path, gint64 mtime,
+								 GError **error);
+BookIndex *book_index_new_mapped(GMappedFile *mapped, const gchar *path,
+								 gint64 mtime, guint32 title, guint32 name,
+								 guint32 base, guint32 link,
+								 const BookKeyword *keywords, guint n_keywords,
+								 const BookChapter *chapters, guint n_chapters,
+								 const gchar *strings, gsize strings_len);
+void book_index_free(BookIndex *book);
+BookKeywordType book_keyword_type_from_string(const gchar *type);
+gchar *book_index_link_to_uri(const BookIndex *book, guint32 link);
+gchar *book_index_get_uri(const BookIndex *book, guint keyword);
+gchar *book_index_get_chapter_uri(const BookIndex *book, guint chapter);
+gint64 book_index_file_mtime(const gchar *path);
+
+BookBuilder *book_builder_new(const gchar *title, const gchar *name,
+							  const gchar *base, const gchar *link);
+void book_builder_add_keyword(BookBuilder *builder, const gchar *name,
+							  const gchar *link, BookKeywordType type);
+BookIndex *book_builder_finish(BookBuilder *builder, const gchar *path,
+							   gint64 mtime);
+
+G_END_DECLS
+
+#endif
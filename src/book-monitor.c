@@ -0,0 +1,218 @@
+/*
+ * book-monitor.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "book-index.h"
+#include "book-monitor.h"
+#include "doc-provider.h"
+
+/* the callback runs once nothing has changed for this long... */
+#define BOOK_MONITOR_QUIET_MS	1500
+
+/* ...but no later than this after the first change */
+#define BOOK_MONITOR_MAX_WAIT_MS	10000
+
+struct _BookMonitor
+{
+	BookMonitorFunc func;
+	gpointer user_data;
+
+	GHashTable *monitors;		/* directory -> GFileMonitor */
+	guint timeout_id;
+	gint64 first_change;		/* monotonic time of the first change not
+								 * yet reported, in microseconds */
+};
+
+/**
+ * Creates a monitor that isn't watching anything yet.
+ *
+ * @param func		Called on the main loop after books changed.
+ * @param user_data	Passed to func.
+ *
+ * @return	A new BookMonitor, free it with book_monitor_free().
+ */
+BookMonitor *book_monitor_new(BookMonitorFunc func, gpointer user_data)
+{
+	BookMonitor *monitor = g_new0(BookMonitor, 1);
+
+	monitor->func = func;
+	monitor->user_data = user_data;
+	monitor->monitors = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+											  NULL);
+
+	return monitor;
+}
+
+static void monitor_destroy(GFileMonitor *file_monitor, BookMonitor *monitor)
+{
+	g_signal_handlers_disconnect_matched(file_monitor, G_SIGNAL_MATCH_DATA,
+										 0, 0, NULL, NULL, monitor);
+	g_file_monitor_cancel(file_monitor);
+	g_object_unref(file_monitor);
+}
+
+/**
+ * Stops watching and frees the monitor.  A pending callback is dropped.
+ */
+void book_monitor_free(BookMonitor *monitor)
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	if (monitor == NULL)
+		return;
+
+	if (monitor->timeout_id != 0)
+		g_source_remove(monitor->timeout_id);
+
+	g_hash_table_iter_init(&iter, monitor->monitors);
+	while (g_hash_table_iter_next(&iter, NULL, &value))
+		monitor_destroy(value, monitor);
+	g_hash_table_destroy(monitor->monitors);
+
+	g_free(monitor);
+}
+
+static gboolean on_quiet_timeout(gpointer user_data)
+{
+	BookMonitor *monitor = user_data;
+
+	monitor->timeout_id = 0;
+	monitor->first_change = 0;
+	monitor->func(monitor->user_data);
+
+	return FALSE;
+}
+
+static void on_directory_changed(GFileMonitor *file_monitor, GFile *file,
+								 GFile *other_file, GFileMonitorEvent event_type,
+								 gpointer user_data)
+{
+	BookMonitor *monitor = user_data;
+	gint64 now;
+
+	/* CHANGED is always followed by CHANGES_DONE_HINT, wait for that */
+	switch (event_type)
+	{
+		case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+		case G_FILE_MONITOR_EVENT_DELETED:
+		case G_FILE_MONITOR_EVENT_CREATED:
+		case G_FILE_MONITOR_EVENT_MOVED:
+			break;
+		default:
+			return;
+	}
+
+	now = g_get_monotonic_time();
+	if (monitor->first_change == 0)
+		monitor->first_change = now;
+
+	/* keep putting it off while changes keep coming, up to a point */
+	if (monitor->timeout_id != 0)
+	{
+		if (now - monitor->first_change >= BOOK_MONITOR_MAX_WAIT_MS * 1000)
+			return;
+		g_source_remove(monitor->timeout_id);
+	}
+	monitor->timeout_id = g_timeout_add(BOOK_MONITOR_QUIET_MS, on_quiet_timeout,
+										monitor);
+}
+
+static void add_dir(BookMonitor *monitor, GHashTable *wanted, const gchar *dir)
+{
+	GFileMonitor *file_monitor;
+	GFile *file;
+	gpointer key, value;
+
+	if (g_hash_table_lookup(wanted, dir) != NULL)
+		return;
+
+	/* already watched, keep it */
+	if (g_hash_table_lookup_extended(monitor->monitors, dir, &key, &value))
+	{
+		g_hash_table_steal(monitor->monitors, dir);
+		g_hash_table_insert(wanted, key, value);
+		return;
+	}
+
+	/* directories that don't exist yet are watched too, so the first book
+	 * installed in them is noticed */
+	file = g_file_new_for_path(dir);
+	file_monitor = g_file_monitor_directory(file, G_FILE_MONITOR_NONE, NULL, NULL);
+	g_object_unref(file);
+	if (file_monitor == NULL)
+		return;
+
+	g_signal_connect(file_monitor, "changed", G_CALLBACK(on_directory_changed),
+					 monitor);
+	g_hash_table_insert(wanted, g_strdup(dir), file_monitor);
+}
+
+/**
+ * Watches the book directories and the directories of books, replacing
+ * what was watched before.  Directories watched both times keep their
+ * monitor.
+ *
+ * @param monitor	The book monitor.
+ * @param books		Array of BookIndex whose directories to watch.
+ */
+void book_monitor_watch(BookMonitor *monitor, GPtrArray *books)
+{
+	GHashTable *wanted;
+	GHashTableIter iter;
+	gpointer value;
+	gchar **dirs;
+	guint i;
+
+	wanted = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+	/* new books show up as new directories in these */
+	dirs = doc_provider_get_dirs();
+	for (i = 0; dirs[i] != NULL; i++)
+		add_dir(monitor, wanted, dirs[i]);
+	g_strfreev(dirs);
+
+	/* upgrades rewrite the book file inside of its own directory, books
+	 * made from a directory, a man section, change inside of it */
+	for (i = 0; books != NULL && i < books->len; i++)
+	{
+		const BookIndex *book = g_ptr_array_index(books, i);
+		gchar *dir;
+
+		if (g_file_test(book->path, G_FILE_TEST_IS_DIR))
+			dir = g_strdup(book->path);
+		else
+			dir = g_path_get_dirname(book->path);
+
+		add_dir(monitor, wanted, dir);
+		g_free(dir);
+	}
+
+	/* whatever is left isn't wanted anymore */
+	g_hash_table_iter_init(&iter, monitor->monitors);
+	while (g_hash_table_iter_next(&iter, NULL, &value))
+		monitor_destroy(value, monitor);
+	g_hash_table_destroy(monitor->monitors);
+
+	monitor->monitors = wanted;
+}
@@ -0,0 +1,51 @@
+/*
+ * book-monitor.h - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef BOOK_MONITOR_H
+#define BOOK_MONITOR_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Watches the directories books are installed in, of every documentation
+ * provider, and the directory of every book, for books being installed,
+ * upgraded or removed.  A package
+ * manager touches many files at once so changes are coalesced: the
+ * callback runs, on the main loop, once things have been quiet for a
+ * moment, or at the latest a few seconds after the first change.
+ *
+ * See book-monitor.c for documentation for these functions
+ */
+
+typedef struct _BookMonitor		BookMonitor;
+
+typedef void (*BookMonitorFunc) (gpointer user_data);
+
+BookMonitor *book_monitor_new(BookMonitorFunc func, gpointer user_data);
+void book_monitor_free(BookMonitor *monitor);
+
+void book_monitor_watch(BookMonitor *monitor, GPtrArray *books);
+
+G_END_DECLS
+
+#endif
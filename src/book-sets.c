@@ -0,0 +1,345 @@
+/*
+ * book-sets.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <glib.h>
+
+#include "book-index.h"
+#include "search-index.h"
+#include "book-sets.h"
+
+typedef struct
+{
+	gchar **patterns;			/* book names or globs of them */
+	gboolean building;			/* a BuildJob is making its index */
+	gboolean built;				/* index is up to date with the books */
+	SearchIndex *index;			/* NULL if no book matched */
+} Shard;
+
+struct _BookSets
+{
+	GHashTable *filetypes;		/* filetype name -> key of its shard */
+	GHashTable *shards;			/* key -> Shard */
+	GPtrArray *books;			/* every book, the shards point into it */
+	guint generation;			/* bumped when the books change */
+	GSList *jobs;				/* BuildJobs not back yet */
+};
+
+/* A shard's index being built on a thread of its own */
+typedef struct
+{
+	BookSets *sets;				/* NULL once the sets are freed */
+	gchar *key;					/* of the shard */
+	guint generation;			/* of the books it's built from */
+	GPtrArray *all_books;		/* referenced, books points into it */
+	GPtrArray *books;
+	SearchIndex *index;			/* set by the thread */
+} BuildJob;
+
+static void shard_free(Shard *shard)
+{
+	g_strfreev(shard->patterns);
+	search_index_unref(shard->index);
+	g_free(shard);
+}
+
+/**
+ * Creates book sets with no filetype in them.
+ *
+ * @return	A new BookSets, free it with book_sets_free().
+ */
+BookSets *book_sets_new(void)
+{
+	BookSets *sets = g_new0(BookSets, 1);
+
+	sets->filetypes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	sets->shards = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+										 (GDestroyNotify) shard_free);
+
+	return sets;
+}
+
+void book_sets_free(BookSets *sets)
+{
+	GSList *iter;
+
+	if (sets == NULL)
+		return;
+
+	/* builds still running throw their index away when they're done */
+	for (iter = sets->jobs; iter != NULL; iter = iter->next)
+		((BuildJob *) iter->data)->sets = NULL;
+	g_slist_free(sets->jobs);
+
+	/* the shards have to go before the books they point into */
+	g_hash_table_destroy(sets->shards);
+	g_hash_table_destroy(sets->filetypes);
+	if (sets->books != NULL)
+		g_ptr_array_unref(sets->books);
+	g_free(sets);
+}
+
+static gint compare_strings(gconstpointer a, gconstpointer b)
+{
+	return strcmp(*(const gchar * const *) a, *(const gchar * const *) b);
+}
+
+/* The same set in any order is the same shard */
+static gchar *make_key(const gchar * const *books, gchar ***sorted)
+{
+	guint i, n = g_strv_length((gchar **) books);
+
+	*sorted = g_new0(gchar *, n + 1);
+	for (i = 0; i < n; i++)
+		(*sorted)[i] = g_strstrip(g_strdup(books[i]));
+	qsort(*sorted, n, sizeof(gchar *), compare_strings);
+
+	return g_strjoinv(";", *sorted);
+}
+
+/* Drops shards no filetype uses anymore */
+static void drop_unused_shards(BookSets *sets)
+{
+	GHashTableIter iter;
+	gpointer key;
+	GHashTable *used;
+
+	used = g_hash_table_new(g_str_hash, g_str_equal);
+	g_hash_table_iter_init(&iter, sets->filetypes);
+	while (g_hash_table_iter_next(&iter, NULL, &key))
+		g_hash_table_insert(used, key, key);
+
+	g_hash_table_iter_init(&iter, sets->shards);
+	while (g_hash_table_iter_next(&iter, &key, NULL))
+	{
+		if (g_hash_table_lookup(used, key) == NULL)
+			g_hash_table_iter_remove(&iter);
+	}
+	g_hash_table_destroy(used);
+}
+
+/**
+ * Sets the books a filetype's symbols are looked up in.
+ *
+ * @param sets		The book sets.
+ * @param filetype	Name of the Geany filetype, eg. "Python".
+ * @param books		NULL terminated names of the books, as in their
+ * 					.devhelp2 files, or glob patterns like "python*".
+ * 					NULL or empty to look in every book.
+ */
+void book_sets_set_filetype(BookSets *sets, const gchar *filetype,
+							const gchar * const *books)
+{
+	gchar **sorted, *key;
+
+	if (books == NULL || books[0] == NULL)
+	{
+		g_hash_table_remove(sets->filetypes, filetype);
+		drop_unused_shards(sets);
+		return;
+	}
+
+	key = make_key(books, &sorted);
+	if (g_hash_table_lookup(sets->shards, key) == NULL)
+	{
+		Shard *shard = g_new0(Shard, 1);
+
+		shard->patterns = sorted;
+		g_hash_table_insert(sets->shards, g_strdup(key), shard);
+	}
+	else
+		g_strfreev(sorted);
+
+	g_hash_table_insert(sets->filetypes, g_strdup(filetype), key);
+	drop_unused_shards(sets);
+}
+
+/**
+ * Sets the books the shards are made of.  Every shard is dropped and made
+ * again from these the next time it's needed.
+ *
+ * @param sets	The book sets.
+ * @param books	Array of every BookIndex, a reference is kept on it.
+ */
+void book_sets_set_books(BookSets *sets, GPtrArray *books)
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	g_hash_table_iter_init(&iter, sets->shards);
+	while (g_hash_table_iter_next(&iter, NULL, &value))
+	{
+		Shard *shard = value;
+
+		search_index_unref(shard->index);
+		shard->index = NULL;
+		shard->building = FALSE;
+		shard->built = FALSE;
+	}
+	sets->generation++;
+
+	if (books != NULL)
+		g_ptr_array_ref(books);
+	if (sets->books != NULL)
+		g_ptr_array_unref(sets->books);
+	sets->books = books;
+}
+
+static gboolean book_matches(const BookIndex *book, gchar **patterns)
+{
+	const gchar *name = book_index_str(book, book->name);
+	guint i;
+
+	for (i = 0; patterns[i] != NULL; i++)
+	{
+		if (g_pattern_match_simple(patterns[i], name))
+			return TRUE;
+	}
+	return FALSE;
+}
+
+static void build_job_free(BuildJob *job)
+{
+	search_index_unref(job->index);
+	g_ptr_array_unref(job->books);
+	g_ptr_array_unref(job->all_books);
+	g_free(job->key);
+	g_free(job);
+}
+
+/* Hands a built index to its shard, if the shard still wants it */
+static gboolean on_shard_built(gpointer user_data)
+{
+	BuildJob *job = user_data;
+	BookSets *sets = job->sets;
+	Shard *shard;
+
+	if (sets != NULL)
+	{
+		sets->jobs = g_slist_remove(sets->jobs, job);
+
+		shard = g_hash_table_lookup(sets->shards, job->key);
+		if (shard != NULL && !shard->built && job->generation == sets->generation)
+		{
+			shard->index = job->index;
+			job->index = NULL;
+			shard->building = FALSE;
+			shard->built = TRUE;
+		}
+	}
+
+	build_job_free(job);
+	return FALSE;
+}
+
+static gpointer build_thread(gpointer data)
+{
+	BuildJob *job = data;
+
+	job->index = search_index_new(job->books);
+	g_idle_add(on_shard_built, job);
+
+	return NULL;
+}
+
+/*
+ * Starts building a shard's index on a thread, it's used once it's done.
+ * Without threads it's built right away.
+ */
+static void shard_build(BookSets *sets, const gchar *key, Shard *shard)
+{
+	GError *error = NULL;
+	BuildJob *job;
+	guint i;
+
+	/* the books belong to sets->books, this only points at some of them */
+	job = g_new0(BuildJob, 1);
+	job->books = g_ptr_array_new();
+	for (i = 0; i < sets->books->len; i++)
+	{
+		BookIndex *book = g_ptr_array_index(sets->books, i);
+
+		if (book_matches(book, shard->patterns))
+			g_ptr_array_add(job->books, book);
+	}
+
+	if (job->books->len == 0)
+	{
+		g_ptr_array_unref(job->books);
+		g_free(job);
+		shard->built = TRUE;
+		return;
+	}
+
+	job->sets = sets;
+	job->key = g_strdup(key);
+	job->generation = sets->generation;
+	job->all_books = g_ptr_array_ref(sets->books);
+
+	shard->building = TRUE;
+	sets->jobs = g_slist_prepend(sets->jobs, job);
+
+	if (!g_thread_supported() ||
+		g_thread_create(build_thread, job, FALSE, &error) == NULL)
+	{
+		if (error != NULL)
+		{
+			g_warning("Unable to start building the index of '%s': %s",
+					  key, error->message);
+			g_error_free(error);
+		}
+		job->index = search_index_new(job->books);
+		on_shard_built(job);
+	}
+}
+
+/**
+ * Gets the index of the books a filetype's symbols are looked up in.  The
+ * first time since the books changed it starts building it, and until
+ * it's built NULL is returned.
+ *
+ * @param sets		The book sets.
+ * @param filetype	Name of the Geany filetype.
+ *
+ * @return	The shard, owned by sets and only valid until the books or the
+ * 			filetype's set change.  NULL if the filetype has no set, none
+ * 			of its books are installed, the books aren't loaded yet or
+ * 			the shard is still being built, in which case every book
+ * 			should be used.
+ */
+SearchIndex *book_sets_get_index(BookSets *sets, const gchar *filetype)
+{
+	const gchar *key;
+	Shard *shard;
+
+	if (sets->books == NULL || filetype == NULL)
+		return NULL;
+
+	key = g_hash_table_lookup(sets->filetypes, filetype);
+	if (key == NULL)
+		return NULL;
+
+	shard = g_hash_table_lookup(sets->shards, key);
+	if (!shard->built && !shard->building)
+		shard_build(sets, key, shard);
+
+	return shard->index;
+}
@@ -0,0 +1,62 @@
+/*
+ * book-sets.h - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef BOOK_SETS_H
+#define BOOK_SETS_H
+
+#include <glib.h>
+#include "search-index.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Which books document which Geany filetypes, so symbols of a Python file
+ * are only looked up in the Python books.  A book set is a list of book
+ * names, or glob patterns of them, and each distinct set gets a
+ * SearchIndex (a shard) over just the books it matches.  Filetypes with
+ * the same set share the shard.
+ *
+ * Shards are only built the first time a filetype of theirs is looked
+ * up, on a thread of their own so the lookup isn't held up, and dropped
+ * when the books change.  Filetypes without a set, whose set matches none
+ * of the installed books, or whose shard isn't built yet are looked up in
+ * every book as before.
+ *
+ * Only used from the main thread, the builds hand their shards back to it
+ * from an idle callback.
+ *
+ * See book-sets.c for documentation for these functions
+ */
+
+typedef struct _BookSets	BookSets;
+
+BookSets *book_sets_new(void);
+void book_sets_free(BookSets *sets);
+
+void book_sets_set_filetype(BookSets *sets, const gchar *filetype,
+							const gchar * const *books);
+void book_sets_set_books(BookSets *sets, GPtrArray *books);
+
+SearchIndex *book_sets_get_index(BookSets *sets, const gchar *filetype);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,528 @@
+/*
+ * book-tree-model.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <gtk/gtk.h>
+
+#include "book-index.h"
+#include "book-tree-model.h"
+
+/* chapters in all the cached child lists before they're all dropped */
+#define BOOK_TREE_MODEL_MAX_CACHED	(1 << 18)
+
+/* an iter is the row of its book in order and the chapter */
+#define ITER_POS(iter)		GPOINTER_TO_UINT((iter)->user_data)
+#define ITER_CHAPTER(iter)	((guint32) GPOINTER_TO_UINT((iter)->user_data2))
+
+/* The children of a row, in document order so sorted by index */
+typedef struct
+{
+	guint n;
+	guint32 items[1];
+} ChildList;
+
+struct _DevhelpBookTreeModelPrivate
+{
+	gint stamp;
+	GPtrArray *books;
+	guint *order;				/* book numbers, sorted by title */
+	guint n_books;
+
+	GHashTable **children;		/* per row of order, chapter -> ChildList,
+								 * the book's own row is BOOK_CHAPTER_NONE */
+	guint n_cached;				/* chapters in all of the lists */
+};
+
+static void devhelp_book_tree_model_finalize	(GObject *object);
+static void devhelp_book_tree_model_iface_init	(GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(DevhelpBookTreeModel, devhelp_book_tree_model, G_TYPE_OBJECT,
+	G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_MODEL, devhelp_book_tree_model_iface_init))
+
+
+static void devhelp_book_tree_model_class_init(DevhelpBookTreeModelClass *klass)
+{
+	GObjectClass *g_object_class;
+
+	g_object_class = G_OBJECT_CLASS(klass);
+
+	g_object_class->finalize = devhelp_book_tree_model_finalize;
+
+	g_type_class_add_private((gpointer)klass, sizeof(DevhelpBookTreeModelPrivate));
+}
+
+static void devhelp_book_tree_model_init(DevhelpBookTreeModel *self)
+{
+	self->priv = G_TYPE_INSTANCE_GET_PRIVATE(self,
+		DEVHELP_TYPE_BOOK_TREE_MODEL, DevhelpBookTreeModelPrivate);
+
+	self->priv->stamp = g_random_int();
+}
+
+static void drop_all_children(DevhelpBookTreeModelPrivate *priv)
+{
+	guint i;
+
+	for (i = 0; i < priv->n_books; i++)
+	{
+		if (priv->children[i] != NULL)
+		{
+			g_hash_table_destroy(priv->children[i]);
+			priv->children[i] = NULL;
+		}
+	}
+	priv->n_cached = 0;
+}
+
+static void devhelp_book_tree_model_finalize(GObject *object)
+{
+	DevhelpBookTreeModel *self;
+
+	g_return_if_fail(object != NULL);
+	g_return_if_fail(DEVHELP_IS_BOOK_TREE_MODEL(object));
+
+	self = DEVHELP_BOOK_TREE_MODEL(object);
+
+	drop_all_children(self->priv);
+	g_free(self->priv->children);
+	g_free(self->priv->order);
+	if (self->priv->books != NULL)
+		g_ptr_array_unref(self->priv->books);
+
+	G_OBJECT_CLASS(devhelp_book_tree_model_parent_class)->finalize(object);
+}
+
+static gint compare_book_titles(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	GPtrArray *books = user_data;
+	const BookIndex *ba = g_ptr_array_index(books, *(const guint *) a);
+	const BookIndex *bb = g_ptr_array_index(books, *(const guint *) b);
+
+	return g_utf8_collate(book_index_str(ba, ba->title),
+						  book_index_str(bb, bb->title));
+}
+
+/**
+ * Creates a model showing books.  Nothing is copied out of them, only the
+ * books are sorted.
+ *
+ * @param books	Array of BookIndex or NULL, a reference is kept on it.
+ *
+ * @return	A new DevhelpBookTreeModel.
+ */
+DevhelpBookTreeModel *devhelp_book_tree_model_new(GPtrArray *books)
+{
+	DevhelpBookTreeModel *model;
+	DevhelpBookTreeModelPrivate *priv;
+	guint i;
+
+	model = g_object_new(DEVHELP_TYPE_BOOK_TREE_MODEL, NULL);
+	priv = model->priv;
+
+	if (books == NULL)
+		return model;
+
+	priv->books = g_ptr_array_ref(books);
+	priv->n_books = books->len;
+	priv->order = g_new(guint, books->len);
+	for (i = 0; i < books->len; i++)
+		priv->order[i] = i;
+	g_qsort_with_data(priv->order, books->len, sizeof(guint),
+					  compare_book_titles, books);
+	priv->children = g_new0(GHashTable *, books->len);
+
+	return model;
+}
+
+static inline const BookIndex *get_book(DevhelpBookTreeModelPrivate *priv, guint pos)
+{
+	return g_ptr_array_index(priv->books, priv->order[pos]);
+}
+
+static inline void set_iter(DevhelpBookTreeModelPrivate *priv, GtkTreeIter *iter,
+							guint pos, guint32 chapter)
+{
+	iter->stamp = priv->stamp;
+	iter->user_data = GUINT_TO_POINTER(pos);
+	iter->user_data2 = GUINT_TO_POINTER(chapter);
+	iter->user_data3 = NULL;
+}
+
+/* First child of a chapter, or of the book for BOOK_CHAPTER_NONE.  Chapters
+ * are in document order so it's the one right after it, if any. */
+static guint32 first_child(const BookIndex *book, guint32 chapter)
+{
+	guint32 child = (chapter == BOOK_CHAPTER_NONE) ? 0 : chapter + 1;
+
+	if (child >= book->n_chapters || book->chapters[child].parent != chapter)
+		return BOOK_CHAPTER_NONE;
+	return child;
+}
+
+/* The children of a row, made if they weren't yet */
+static ChildList *get_children(DevhelpBookTreeModelPrivate *priv, guint pos,
+							   guint32 chapter)
+{
+	const BookIndex *book = get_book(priv, pos);
+	ChildList *list;
+	guint32 child;
+	guint n = 0;
+
+	if (priv->children[pos] != NULL)
+	{
+		list = g_hash_table_lookup(priv->children[pos], GUINT_TO_POINTER(chapter));
+		if (list != NULL)
+			return list;
+	}
+
+	for (child = first_child(book, chapter); child != BOOK_CHAPTER_NONE;
+		 child = book->chapters[child].next)
+		n++;
+
+	/* they're quick to make again, so start over rather than track use */
+	if (priv->n_cached + n > BOOK_TREE_MODEL_MAX_CACHED)
+		drop_all_children(priv);
+
+	list = g_malloc(G_STRUCT_OFFSET(ChildList, items) + MAX(n, 1) * sizeof(guint32));
+	list->n = 0;
+	for (child = first_child(book, chapter); child != BOOK_CHAPTER_NONE;
+		 child = book->chapters[child].next)
+		list->items[list->n++] = child;
+
+	if (priv->children[pos] == NULL)
+		priv->children[pos] = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+													NULL, g_free);
+	g_hash_table_insert(priv->children[pos], GUINT_TO_POINTER(chapter), list);
+	priv->n_cached += n;
+
+	return list;
+}
+
+/* Position of chapter in its parent's list */
+static gint child_position(const ChildList *list, guint32 chapter)
+{
+	guint lo = 0, hi = list->n;
+
+	while (lo < hi)
+	{
+		guint mid = lo + (hi - lo) / 2;
+
+		if (list->items[mid] < chapter)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return (gint) lo;
+}
+
+/**
+ * Drops the child lists below a row once it's collapsed, they're made
+ * again if it's expanded.  Connect it to the view's "row-collapsed".
+ *
+ * @param model	The book tree model.
+ * @param iter	The row that was collapsed.
+ */
+void devhelp_book_tree_model_collapsed(DevhelpBookTreeModel *model,
+									   GtkTreeIter *iter)
+{
+	DevhelpBookTreeModelPrivate *priv;
+	const BookIndex *book;
+	GHashTableIter table_iter;
+	gpointer key, value;
+	guint pos;
+	guint32 chapter, last, end;
+
+	g_return_if_fail(DEVHELP_IS_BOOK_TREE_MODEL(model));
+	g_return_if_fail(iter->stamp == model->priv->stamp);
+
+	priv = model->priv;
+	pos = ITER_POS(iter);
+	chapter = ITER_CHAPTER(iter);
+
+	if (priv->children[pos] == NULL)
+		return;
+
+	if (chapter == BOOK_CHAPTER_NONE)
+	{
+		g_hash_table_iter_init(&table_iter, priv->children[pos]);
+		while (g_hash_table_iter_next(&table_iter, NULL, &value))
+			priv->n_cached -= ((ChildList *) value)->n;
+		g_hash_table_destroy(priv->children[pos]);
+		priv->children[pos] = NULL;
+		return;
+	}
+
+	/* the row's descendants are the chapters up to the next one that
+	 * isn't below it */
+	book = get_book(priv, pos);
+	last = chapter;
+	while (book->chapters[last].next == BOOK_CHAPTER_NONE &&
+		   book->chapters[last].parent != BOOK_CHAPTER_NONE)
+		last = book->chapters[last].parent;
+	end = book->chapters[last].next;
+	if (end == BOOK_CHAPTER_NONE)
+		end = book->n_chapters;
+
+	g_hash_table_iter_init(&table_iter, priv->children[pos]);
+	while (g_hash_table_iter_next(&table_iter, &key, &value))
+	{
+		guint32 row = (guint32) GPOINTER_TO_UINT(key);
+
+		if (row != BOOK_CHAPTER_NONE && row >= chapter && row < end)
+		{
+			priv->n_cached -= ((ChildList *) value)->n;
+			g_hash_table_iter_remove(&table_iter);
+		}
+	}
+}
+
+
+static GtkTreeModelFlags book_tree_model_get_flags(GtkTreeModel *tree_model)
+{
+	return GTK_TREE_MODEL_ITERS_PERSIST;
+}
+
+static gint book_tree_model_get_n_columns(GtkTreeModel *tree_model)
+{
+	return BOOK_TREE_MODEL_N_COLUMNS;
+}
+
+static GType book_tree_model_get_column_type(GtkTreeModel *tree_model, gint index)
+{
+	switch (index)
+	{
+		case BOOK_TREE_MODEL_COL_TITLE:
+			return G_TYPE_STRING;
+		case BOOK_TREE_MODEL_COL_BOOK:
+		case BOOK_TREE_MODEL_COL_CHAPTER:
+			return G_TYPE_UINT;
+		default:
+			return G_TYPE_INVALID;
+	}
+}
+
+static gboolean book_tree_model_get_iter(GtkTreeModel *tree_model,
+										 GtkTreeIter *iter, GtkTreePath *path)
+{
+	DevhelpBookTreeModelPrivate *priv = DEVHELP_BOOK_TREE_MODEL(tree_model)->priv;
+	gint *indices = gtk_tree_path_get_indices(path);
+	gint depth = gtk_tree_path_get_depth(path), i;
+	guint32 chapter = BOOK_CHAPTER_NONE;
+
+	if (depth < 1 || indices[0] < 0 || (guint) indices[0] >= priv->n_books)
+		return FALSE;
+
+	for (i = 1; i < depth; i++)
+	{
+		ChildList *list = get_children(priv, indices[0], chapter);
+
+		if (indices[i] < 0 || (guint) indices[i] >= list->n)
+			return FALSE;
+		chapter = list->items[indices[i]];
+	}
+
+	set_iter(priv, iter, indices[0], chapter);
+	return TRUE;
+}
+
+static GtkTreePath *book_tree_model_get_path(GtkTreeModel *tree_model,
+											 GtkTreeIter *iter)
+{
+	DevhelpBookTreeModelPrivate *priv = DEVHELP_BOOK_TREE_MODEL(tree_model)->priv;
+	guint pos = ITER_POS(iter);
+	guint32 chapter = ITER_CHAPTER(iter);
+	const BookIndex *book;
+	GtkTreePath *path;
+
+	g_return_val_if_fail(iter->stamp == priv->stamp, NULL);
+
+	book = get_book(priv, pos);
+	path = gtk_tree_path_new();
+	while (chapter != BOOK_CHAPTER_NONE)
+	{
+		guint32 parent = book->chapters[chapter].parent;
+
+		gtk_tree_path_prepend_index(path,
+			child_position(get_children(priv, pos, parent), chapter));
+		chapter = parent;
+	}
+	gtk_tree_path_prepend_index(path, pos);
+
+	return path;
+}
+
+static void book_tree_model_get_value(GtkTreeModel *tree_model, GtkTreeIter *iter,
+									  gint column, GValue *value)
+{
+	DevhelpBookTreeModelPrivate *priv = DEVHELP_BOOK_TREE_MODEL(tree_model)->priv;
+	guint pos = ITER_POS(iter);
+	guint32 chapter = ITER_CHAPTER(iter);
+	const BookIndex *book;
+
+	g_return_if_fail(iter->stamp == priv->stamp);
+
+	book = get_book(priv, pos);
+	g_value_init(value, book_tree_model_get_column_type(tree_model, column));
+
+	switch (column)
+	{
+		/* the model keeps the books alive, no need to copy */
+		case BOOK_TREE_MODEL_COL_TITLE:
+			g_value_set_static_string(value, chapter == BOOK_CHAPTER_NONE ?
+				book_index_str(book, book->title) :
+				book_index_chapter_name(book, chapter));
+			break;
+		case BOOK_TREE_MODEL_COL_BOOK:
+			g_value_set_uint(value, priv->order[pos]);
+			break;
+		case BOOK_TREE_MODEL_COL_CHAPTER:
+			g_value_set_uint(value, chapter);
+			break;
+	}
+}
+
+static gboolean book_tree_model_iter_next(GtkTreeModel *tree_model, GtkTreeIter *iter)
+{
+	DevhelpBookTreeModelPrivate *priv = DEVHELP_BOOK_TREE_MODEL(tree_model)->priv;
+	guint pos = ITER_POS(iter);
+	guint32 chapter = ITER_CHAPTER(iter), next;
+
+	g_return_val_if_fail(iter->stamp == priv->stamp, FALSE);
+
+	if (chapter == BOOK_CHAPTER_NONE)
+	{
+		if (pos + 1 >= priv->n_books)
+			return FALSE;
+		set_iter(priv, iter, pos + 1, BOOK_CHAPTER_NONE);
+		return TRUE;
+	}
+
+	next = get_book(priv, pos)->chapters[chapter].next;
+	if (next == BOOK_CHAPTER_NONE)
+		return FALSE;
+	set_iter(priv, iter, pos, next);
+	return TRUE;
+}
+
+static gboolean book_tree_model_iter_children(GtkTreeModel *tree_model,
+											  GtkTreeIter *iter, GtkTreeIter *parent)
+{
+	DevhelpBookTreeModelPrivate *priv = DEVHELP_BOOK_TREE_MODEL(tree_model)->priv;
+	guint32 child;
+
+	if (parent == NULL)
+	{
+		if (priv->n_books == 0)
+			return FALSE;
+		set_iter(priv, iter, 0, BOOK_CHAPTER_NONE);
+		return TRUE;
+	}
+
+	g_return_val_if_fail(parent->stamp == priv->stamp, FALSE);
+
+	child = first_child(get_book(priv, ITER_POS(parent)), ITER_CHAPTER(parent));
+	if (child == BOOK_CHAPTER_NONE)
+		return FALSE;
+	set_iter(priv, iter, ITER_POS(parent), child);
+	return TRUE;
+}
+
+static gboolean book_tree_model_iter_has_child(GtkTreeModel *tree_model,
+											   GtkTreeIter *iter)
+{
+	DevhelpBookTreeModelPrivate *priv = DEVHELP_BOOK_TREE_MODEL(tree_model)->priv;
+
+	g_return_val_if_fail(iter->stamp == priv->stamp, FALSE);
+
+	return first_child(get_book(priv, ITER_POS(iter)), ITER_CHAPTER(iter)) !=
+		BOOK_CHAPTER_NONE;
+}
+
+static gint book_tree_model_iter_n_children(GtkTreeModel *tree_model,
+											GtkTreeIter *iter)
+{
+	DevhelpBookTreeModelPrivate *priv = DEVHELP_BOOK_TREE_MODEL(tree_model)->priv;
+
+	if (iter == NULL)
+		return priv->n_books;
+
+	g_return_val_if_fail(iter->stamp == priv->stamp, 0);
+
+	return get_children(priv, ITER_POS(iter), ITER_CHAPTER(iter))->n;
+}
+
+static gboolean book_tree_model_iter_nth_child(GtkTreeModel *tree_model,
+											   GtkTreeIter *iter,
+											   GtkTreeIter *parent, gint n)
+{
+	DevhelpBookTreeModelPrivate *priv = DEVHELP_BOOK_TREE_MODEL(tree_model)->priv;
+	ChildList *list;
+
+	if (n < 0)
+		return FALSE;
+
+	if (parent == NULL)
+	{
+		if ((guint) n >= priv->n_books)
+			return FALSE;
+		set_iter(priv, iter, n, BOOK_CHAPTER_NONE);
+		return TRUE;
+	}
+
+	g_return_val_if_fail(parent->stamp == priv->stamp, FALSE);
+
+	list = get_children(priv, ITER_POS(parent), ITER_CHAPTER(parent));
+	if ((guint) n >= list->n)
+		return FALSE;
+	set_iter(priv, iter, ITER_POS(parent), list->items[n]);
+	return TRUE;
+}
+
+static gboolean book_tree_model_iter_parent(GtkTreeModel *tree_model,
+											GtkTreeIter *iter, GtkTreeIter *child)
+{
+	DevhelpBookTreeModelPrivate *priv = DEVHELP_BOOK_TREE_MODEL(tree_model)->priv;
+	guint pos = ITER_POS(child);
+	guint32 chapter = ITER_CHAPTER(child);
+
+	g_return_val_if_fail(child->stamp == priv->stamp, FALSE);
+
+	if (chapter == BOOK_CHAPTER_NONE)
+		return FALSE;
+
+	set_iter(priv, iter, pos, get_book(priv, pos)->chapters[chapter].parent);
+	return TRUE;
+}
+
+static void devhelp_book_tree_model_iface_init(GtkTreeModelIface *iface)
+{
+	iface->get_flags = book_tree_model_get_flags;
+	iface->get_n_columns = book_tree_model_get_n_columns;
+	iface->get_column_type = book_tree_model_get_column_type;
+	iface->get_iter = book_tree_model_get_iter;
+	iface->get_path = book_tree_model_get_path;
+	iface->get_value = book_tree_model_get_value;
+	iface->iter_next = book_tree_model_iter_next;
+	iface->iter_children = book_tree_model_iter_children;
+	iface->iter_has_child = book_tree_model_iter_has_child;
+	iface->iter_n_children = book_tree_model_iter_n_children;
+	iface->iter_nth_child = book_tree_model_iter_nth_child;
+	iface->iter_parent = book_tree_model_iter_parent;
+}
@@ -0,0 +1,83 @@
+/*
+ * book-tree-model.h - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef BOOK_TREE_MODEL_H
+#define BOOK_TREE_MODEL_H
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define DEVHELP_TYPE_BOOK_TREE_MODEL		(devhelp_book_tree_model_get_type())
+#define DEVHELP_BOOK_TREE_MODEL(obj)		(G_TYPE_CHECK_INSTANCE_CAST((obj),\
+			DEVHELP_TYPE_BOOK_TREE_MODEL, DevhelpBookTreeModel))
+#define DEVHELP_BOOK_TREE_MODEL_CLASS(klass)	(G_TYPE_CHECK_CLASS_CAST((klass),\
+			DEVHELP_TYPE_BOOK_TREE_MODEL, DevhelpBookTreeModelClass))
+#define DEVHELP_IS_BOOK_TREE_MODEL(obj)		(G_TYPE_CHECK_INSTANCE_TYPE((obj),\
+			DEVHELP_TYPE_BOOK_TREE_MODEL))
+
+typedef struct _DevhelpBookTreeModel			DevhelpBookTreeModel;
+typedef struct _DevhelpBookTreeModelClass		DevhelpBookTreeModelClass;
+typedef struct _DevhelpBookTreeModelPrivate		DevhelpBookTreeModelPrivate;
+
+/*
+ * A read only tree model of books, sorted by title, and their chapters,
+ * read straight from the chapter arrays of the BookIndex array instead of
+ * being copied into a GtkTreeStore.  An iter is just the row of the book
+ * and the index of the chapter, so walking the tree costs nothing.
+ *
+ * Only finding a row's n-th child or its position among its siblings
+ * needs the list of a row's children, which is made the first time it's
+ * asked for, normally when the row is expanded.  The lists of a row and
+ * everything below it are dropped again when it's collapsed, and all of
+ * them are if they grow past a limit.
+ *
+ * See book-tree-model.c for documentation for these functions
+ */
+struct _DevhelpBookTreeModel
+{
+	GObject parent;
+
+	DevhelpBookTreeModelPrivate *priv;
+};
+
+struct _DevhelpBookTreeModelClass
+{
+	GObjectClass parent_class;
+};
+
+enum
+{
+	BOOK_TREE_MODEL_COL_TITLE,
+	BOOK_TREE_MODEL_COL_BOOK,		/* index into the books array */
+	BOOK_TREE_MODEL_COL_CHAPTER,	/* BOOK_CHAPTER_NONE for the book itself */
+	BOOK_TREE_MODEL_N_COLUMNS
+};
+
+GType devhelp_book_tree_model_get_type(void);
+DevhelpBookTreeModel *devhelp_book_tree_model_new(GPtrArray *books);
+
+void devhelp_book_tree_model_collapsed(DevhelpBookTreeModel *model,
+									   GtkTreeIter *iter);
+
+G_END_DECLS
+
+#endif
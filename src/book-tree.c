@@ -0,0 +1,277 @@
+/*
+ * book-tree.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <gtk/gtk.h>
+
+#include "book-index.h"
+#include "book-tree.h"
+#include "book-tree-model.h"
+
+enum
+{
+	LINK_SELECTED,
+	LAST_SIGNAL
+};
+
+static guint tree_signals[LAST_SIGNAL] = { 0 };
+
+struct _DevhelpBookTreePrivate
+{
+	DevhelpBookTreeModel *model;
+	GPtrArray *books;
+	gboolean restoring;			/* reselecting a row after new books */
+};
+
+static void devhelp_book_tree_finalize	(GObject *object);
+
+G_DEFINE_TYPE(DevhelpBookTree, devhelp_book_tree, GTK_TYPE_TREE_VIEW)
+
+
+static void devhelp_book_tree_class_init(DevhelpBookTreeClass *klass)
+{
+	GObjectClass *g_object_class;
+
+	g_object_class = G_OBJECT_CLASS(klass);
+
+	g_object_class->finalize = devhelp_book_tree_finalize;
+
+	tree_signals[LINK_SELECTED] = g_signal_new("link-selected",
+		G_TYPE_FROM_CLASS(klass),
+		G_SIGNAL_RUN_LAST,
+		G_STRUCT_OFFSET(DevhelpBookTreeClass, link_selected),
+		NULL, NULL,
+		g_cclosure_marshal_VOID__STRING,
+		G_TYPE_NONE, 1, G_TYPE_STRING);
+
+	g_type_class_add_private((gpointer)klass, sizeof(DevhelpBookTreePrivate));
+}
+
+
+static void devhelp_book_tree_finalize(GObject *object)
+{
+	DevhelpBookTree *self;
+
+	g_return_if_fail(object != NULL);
+	g_return_if_fail(DEVHELP_IS_BOOK_TREE(object));
+
+	self = DEVHELP_BOOK_TREE(object);
+
+	g_object_unref(self->priv->model);
+	if (self->priv->books != NULL)
+		g_ptr_array_unref(self->priv->books);
+
+	G_OBJECT_CLASS(devhelp_book_tree_parent_class)->finalize(object);
+}
+
+/* The page of a book or chapter row, which also tells rows apart when the
+ * books are loaded again and their rows are numbered differently */
+static gchar *row_uri(DevhelpBookTree *self, GtkTreeModel *model, GtkTreeIter *iter)
+{
+	const BookIndex *book;
+	guint book_num, chapter;
+
+	gtk_tree_model_get(model, iter, BOOK_TREE_MODEL_COL_BOOK, &book_num,
+					   BOOK_TREE_MODEL_COL_CHAPTER, &chapter, -1);
+	book = g_ptr_array_index(self->priv->books, book_num);
+
+	if (chapter == BOOK_CHAPTER_NONE)
+		return book_index_link_to_uri(book, book->link);
+	return book_index_get_chapter_uri(book, chapter);
+}
+
+static void on_selection_changed(GtkTreeSelection *selection, gpointer user_data)
+{
+	DevhelpBookTree *self = user_data;
+	GtkTreeModel *model;
+	GtkTreeIter iter;
+	gchar *uri;
+
+	if (self->priv->books == NULL || self->priv->restoring ||
+		!gtk_tree_selection_get_selected(selection, &model, &iter))
+		return;
+
+	uri = row_uri(self, model, &iter);
+	if (uri != NULL)
+		g_signal_emit(self, tree_signals[LINK_SELECTED], 0, uri);
+	g_free(uri);
+}
+
+/* The rows below a collapsed row aren't needed until it's expanded again */
+static void on_row_collapsed(GtkTreeView *view, GtkTreeIter *iter,
+							 GtkTreePath *path, gpointer user_data)
+{
+	DevhelpBookTree *self = user_data;
+
+	devhelp_book_tree_model_collapsed(self->priv->model, iter);
+}
+
+static void devhelp_book_tree_init(DevhelpBookTree *self)
+{
+	DevhelpBookTreePrivate *priv;
+	GtkCellRenderer *renderer;
+	GtkTreeViewColumn *column;
+
+	self->priv = G_TYPE_INSTANCE_GET_PRIVATE(self,
+		DEVHELP_TYPE_BOOK_TREE, DevhelpBookTreePrivate);
+	priv = self->priv;
+
+	priv->model = devhelp_book_tree_model_new(NULL);
+	priv->books = NULL;
+
+	gtk_tree_view_set_model(GTK_TREE_VIEW(self), GTK_TREE_MODEL(priv->model));
+	gtk_tree_view_set_headers_visible(GTK_TREE_VIEW(self), FALSE);
+	gtk_tree_view_set_enable_search(GTK_TREE_VIEW(self), FALSE);
+
+	renderer = gtk_cell_renderer_text_new();
+	g_object_set(renderer, "ellipsize", PANGO_ELLIPSIZE_END, NULL);
+	column = gtk_tree_view_column_new_with_attributes(NULL, renderer,
+		"text", BOOK_TREE_MODEL_COL_TITLE, NULL);
+	gtk_tree_view_append_column(GTK_TREE_VIEW(self), column);
+
+	g_signal_connect(gtk_tree_view_get_selection(GTK_TREE_VIEW(self)),
+		"changed", G_CALLBACK(on_selection_changed), self);
+	g_signal_connect(self, "row-collapsed", G_CALLBACK(on_row_collapsed), self);
+}
+
+/**
+ * Creates a new, empty, book tree.  It won't show anything until
+ * devhelp_book_tree_set_books() is called.
+ */
+GtkWidget *devhelp_book_tree_new(void)
+{
+	return g_object_new(DEVHELP_TYPE_BOOK_TREE, NULL);
+}
+
+/* What's expanded and selected, kept by page across new books */
+typedef struct
+{
+	DevhelpBookTree *tree;
+	GHashTable *expanded;		/* uris of the expanded rows */
+	gchar *selected;
+} TreeState;
+
+static void save_expanded_row(GtkTreeView *view, GtkTreePath *path, gpointer data)
+{
+	TreeState *state = data;
+	GtkTreeModel *model = gtk_tree_view_get_model(view);
+	GtkTreeIter iter;
+	gchar *uri;
+
+	if (gtk_tree_model_get_iter(model, &iter, path) &&
+		(uri = row_uri(state->tree, model, &iter)) != NULL)
+		g_hash_table_insert(state->expanded, uri, uri);
+}
+
+/* Expands the rows below parent that were expanded before and selects
+ * the row that was, only rows that can be seen are looked at */
+static void restore_rows(TreeState *state, GtkTreeModel *model, GtkTreeIter *parent)
+{
+	GtkTreeView *view = GTK_TREE_VIEW(state->tree);
+	GtkTreeIter iter;
+	gboolean valid;
+
+	for (valid = gtk_tree_model_iter_children(model, &iter, parent); valid;
+		 valid = gtk_tree_model_iter_next(model, &iter))
+	{
+		gchar *uri = row_uri(state->tree, model, &iter);
+		GtkTreePath *path;
+
+		if (uri == NULL)
+			continue;
+
+		if (state->selected != NULL && strcmp(uri, state->selected) == 0)
+		{
+			gtk_tree_selection_select_iter(gtk_tree_view_get_selection(view), &iter);
+			g_free(state->selected);
+			state->selected = NULL;
+		}
+
+		if (g_hash_table_lookup(state->expanded, uri) != NULL)
+		{
+			path = gtk_tree_model_get_path(model, &iter);
+			gtk_tree_view_expand_row(view, path, FALSE);
+			gtk_tree_path_free(path);
+			restore_rows(state, model, &iter);
+		}
+		g_free(uri);
+	}
+}
+
+/**
+ * Shows books in the tree, replacing whatever it showed before.  The rows
+ * that were expanded or selected still are if their books are in books,
+ * and the tree is scrolled back to where it was.
+ *
+ * @param tree	The book tree.
+ * @param books	Array of BookIndex, a reference is kept on it.
+ */
+void devhelp_book_tree_set_books(DevhelpBookTree *tree, GPtrArray *books)
+{
+	DevhelpBookTreePrivate *priv;
+	DevhelpBookTreeModel *model;
+	TreeState state;
+	GdkRectangle visible;
+
+	g_return_if_fail(DEVHELP_IS_BOOK_TREE(tree));
+
+	priv = tree->priv;
+
+	state.tree = tree;
+	state.expanded = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	state.selected = NULL;
+	if (priv->books != NULL)
+	{
+		GtkTreeModel *old_model;
+		GtkTreeIter iter;
+
+		gtk_tree_view_map_expanded_rows(GTK_TREE_VIEW(tree), save_expanded_row,
+										&state);
+		if (gtk_tree_selection_get_selected(
+				gtk_tree_view_get_selection(GTK_TREE_VIEW(tree)), &old_model, &iter))
+			state.selected = row_uri(tree, old_model, &iter);
+	}
+	gtk_tree_view_get_visible_rect(GTK_TREE_VIEW(tree), &visible);
+
+	if (books != NULL)
+		g_ptr_array_ref(books);
+	if (priv->books != NULL)
+		g_ptr_array_unref(priv->books);
+	priv->books = books;
+
+	/* the model reads the chapters from the books, there's nothing to fill */
+	model = devhelp_book_tree_model_new(books);
+	gtk_tree_view_set_model(GTK_TREE_VIEW(tree), GTK_TREE_MODEL(model));
+	g_object_unref(priv->model);
+	priv->model = model;
+
+	/* putting the selection back doesn't open its page again */
+	if (books != NULL)
+	{
+		priv->restoring = TRUE;
+		restore_rows(&state, GTK_TREE_MODEL(model), NULL);
+		priv->restoring = FALSE;
+		gtk_tree_view_scroll_to_point(GTK_TREE_VIEW(tree), -1, visible.y);
+	}
+
+	g_free(state.selected);
+	g_hash_table_destroy(state.expanded);
+}
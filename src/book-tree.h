@@ -0,0 +1,68 @@
+/*
+ * book-tree.h - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef BOOK_TREE_H
+#define BOOK_TREE_H
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+#define DEVHELP_TYPE_BOOK_TREE			(devhelp_book_tree_get_type())
+#define DEVHELP_BOOK_TREE(obj)			(G_TYPE_CHECK_INSTANCE_CAST((obj),\
+			DEVHELP_TYPE_BOOK_TREE, DevhelpBookTree))
+#define DEVHELP_BOOK_TREE_CLASS(klass)	(G_TYPE_CHECK_CLASS_CAST((klass),\
+			DEVHELP_TYPE_BOOK_TREE, DevhelpBookTreeClass))
+#define DEVHELP_IS_BOOK_TREE(obj)		(G_TYPE_CHECK_INSTANCE_TYPE((obj),\
+			DEVHELP_TYPE_BOOK_TREE))
+
+typedef struct _DevhelpBookTree			DevhelpBookTree;
+typedef struct _DevhelpBookTreeClass	DevhelpBookTreeClass;
+typedef struct _DevhelpBookTreePrivate	DevhelpBookTreePrivate;
+
+/*
+ * The sidebar "Contents" tab: every book, sorted by title, with its
+ * chapters below it, shown through a DevhelpBookTreeModel reading the
+ * BookIndex array directly.  Emits "link-selected" with the URI of the
+ * book or chapter that's selected.
+ */
+struct _DevhelpBookTree
+{
+	GtkTreeView parent;
+
+	DevhelpBookTreePrivate *priv;
+};
+
+struct _DevhelpBookTreeClass
+{
+	GtkTreeViewClass parent_class;
+
+	void (*link_selected) (DevhelpBookTree *tree, const gchar *uri);
+};
+
+GType devhelp_book_tree_get_type(void);
+GtkWidget *devhelp_book_tree_new(void);
+
+void devhelp_book_tree_set_books(DevhelpBookTree *tree, GPtrArray *books);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,106 @@
+/*
+ * cache-util.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "book-index.h"
+#include "cache-util.h"
+
+/**
+ * Appends a string to a string pool.
+ *
+ * @param pool	The pool, offset 0 of which is the empty string.
+ * @param str	The string.
+ * @param len	Its length, or -1 if it's NUL terminated.
+ *
+ * @return	The offset of the string in the pool, 0 if it's empty.
+ */
+guint32 cache_util_pool_add(GString *pool, const gchar *str, gssize len)
+{
+	guint32 offset = pool->len;
+
+	if (len < 0)
+		len = strlen(str);
+	if (len == 0)
+		return 0;
+	g_string_append_len(pool, str, len);
+	g_string_append_c(pool, '\0');
+	return offset;
+}
+
+/**
+ * Gets the file a book's cache is kept in, named after the book's path.
+ *
+ * @param cache_dir	The directory of the cache.
+ * @param book		The book.
+ * @param suffix	Tells the caches of the book apart, eg. ".sum".
+ *
+ * @return	The newly allocated path.
+ */
+gchar *cache_util_book_path(const gchar *cache_dir, const BookIndex *book,
+							const gchar *suffix)
+{
+	gchar *sum = g_compute_checksum_for_string(G_CHECKSUM_MD5, book->path, -1);
+	gchar *name = g_strconcat(sum, suffix, NULL);
+	gchar *path = g_build_filename(cache_dir, name, NULL);
+
+	g_free(name);
+	g_free(sum);
+	return path;
+}
+
+/**
+ * Gets the time a cache made from a book's pages has to be newer than.
+ * Adding or removing pages changes the book's directory rather than the
+ * book file.
+ *
+ * @param book	The book.
+ *
+ * @return	The later of the book file's and its directory's mtime.
+ */
+gint64 cache_util_book_mtime(const BookIndex *book)
+{
+	gint64 dir_mtime = book_index_file_mtime(book_index_str(book, book->base));
+
+	return MAX(book->mtime, dir_mtime);
+}
+
+/**
+ * Writes a cache file, warning if it can't be.
+ *
+ * @param path	The file.
+ * @param data	The contents.
+ * @param size	Their size.
+ * @param what	What the cache is, for the warning.
+ */
+void cache_util_save(const gchar *path, const gchar *data, gsize size,
+					 const gchar *what)
+{
+	GError *error = NULL;
+
+	if (!g_file_set_contents(path, data, size, &error))
+	{
+		g_warning("Unable to save %s '%s': %s", what, path, error->message);
+		g_error_free(error);
+	}
+}
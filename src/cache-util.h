@@ -0,0 +1,50 @@
+/*
+ * cache-util.h - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef CACHE_UTIL_H
+#define CACHE_UTIL_H
+
+#include <glib.h>
+#include "book-index.h"
+
+G_BEGIN_DECLS
+
+/*
+ * What the per book caches of the full text index and the summary store
+ * have in common.  Each book gets a file in the cache's directory named
+ * after its path, holding a header, flat arrays of fixed size records and
+ * a string pool the records point into by offset.  The files are in host
+ * byte order like the keyword snapshot, they never leave the machine they
+ * were written on, and a cache older than its book is made again.
+ *
+ * See cache-util.c for documentation for these functions
+ */
+
+guint32 cache_util_pool_add(GString *pool, const gchar *str, gssize len);
+gchar *cache_util_book_path(const gchar *cache_dir, const BookIndex *book,
+							const gchar *suffix);
+gint64 cache_util_book_mtime(const BookIndex *book);
+void cache_util_save(const gchar *path, const gchar *data, gsize size,
+					 const gchar *what);
+
+G_END_DECLS
+
+#endif
@@ -22,32 +22,135 @@
 #include <gtk/gtk.h>
 #include <geanyplugin.h>
 
-#include <devhelp/dh-base.h>
-#include <devhelp/dh-book-tree.h>
-#include <devhelp/dh-search.h>
-#include <devhelp/dh-link.h>
-
-#ifdef HAVE_BOOK_MANAGER /* for newer api */
-#include <devhelp/dh-book-manager.h>
-#endif
-
 #include <webkit/webkitwebview.h>
 
 #include "plugin.h"
 #include "devhelpplugin.h"
 #include "main-notebook.h"
+#include "book-index.h"
+#include "book-monitor.h"
+#include "book-sets.h"
+#include "book-tree.h"
+#include "index-client.h"
+#include "index-protocol.h"
+#include "doc-provider.h"
+#include "search-index.h"
+#include "search-panel.h"
+#include "symbol-table.h"
+#include "doc-tabs.h"
+#include "fulltext-index.h"
+#include "stats.h"
+#include "summary-store.h"
+#include "tag-util.h"
+
+#define DHPLUG_SNAPSHOT_FILE "keywords.cache"
+#define DHPLUG_FULLTEXT_DIR "fulltext"
+#define DHPLUG_SUMMARY_DIR "summaries"
+
+#define DHPLUG_DEFAULT_PREFETCH_DELAY 500
+
+/* tag manager symbols that are looked up in the symbol table */
+#define DHPLUG_SYMBOL_TAG_TYPES (tm_tag_function_t | tm_tag_prototype_t | \
+	tm_tag_macro_t | tm_tag_macro_with_arg_t | tm_tag_struct_t | \
+	tm_tag_union_t | tm_tag_typedef_t | tm_tag_enum_t | \
+	tm_tag_enumerator_t | tm_tag_class_t)
+
+
+/* Array of BookIndex for every installed book */
+static GPtrArray *book_indexes = NULL;
+
+/* Keyword search index over book_indexes */
+static SearchIndex *search_index = NULL;
+
+/* Full text index over the pages of book_indexes, NULL until it's built */
+static FulltextIndex *fulltext_index = NULL;
+
+/* Signatures and summaries of the keywords, NULL until they're extracted */
+static SummaryStore *summary_store = NULL;
+
+/* 
+ * Handed to the book loading thread.  The plugin pointer is cleared when
+ * the plugin is finalized before loading finishes so the idle callback
+ * knows not to touch it.
+ */
+typedef struct
+{
+	DevhelpPlugin *dhplug;
+	gchar *snapshot_path;
+	GPtrArray *books;			/* the books loaded, or a reload's results,
+								 * NULL if no book changed */
+	SearchIndex *index;
+	gint64 start;				/* see stats_begin() */
+	gboolean index_daemon;		/* use the daemon, which then writes the
+								 * snapshots, see dhp-indexd.c */
+	IndexClient *search_client;	/* the connection to it, NULL if there's none */
+} BookLoader;
 
+/* Same as BookLoader for the full text indexing thread */
+typedef struct
+{
+	DevhelpPlugin *dhplug;
+	GPtrArray *books;			/* what gets indexed, referenced */
+	gchar *cache_dir;
+	GCancellable *cancellable;
+	FulltextIndex *result;
+} FulltextLoader;
 
-/* Devhelp base object */
-static DhBase *dhbase = NULL; 
+/* And for the summary extracting thread */
+typedef struct
+{
+	DevhelpPlugin *dhplug;
+	GPtrArray *books;			/* what gets extracted, referenced */
+	gchar *cache_dir;
+	GCancellable *cancellable;
+	SummaryStore *result;
+} SummaryLoader;
 
 struct _DevhelpPluginPrivate
 {
-	/* add your private declarations here */
-	gint tmp;
+	BookLoader *loader;			/* non-NULL while books are loading */
+	BookMonitor *monitor;		/* watches for books being installed */
+	BookLoader *reloader;		/* non-NULL while books are reloading */
+	gboolean reload_pending;	/* books changed during the reload */
+	gchar *pending_search;		/* search requested before books loaded */
+	gboolean fulltext;			/* index the text of the pages */
+	FulltextLoader *fulltext_loader;	/* non-NULL while that runs */
+	gboolean hover_tooltips;	/* show summaries when hovering over symbols */
+	SummaryLoader *summary_loader;	/* non-NULL while they're extracted */
+	
+	gboolean prefetch;			/* preload docs for the symbol at the cursor */
+	guint prefetch_delay;		/* ms the cursor has to rest before that */
+	guint prefetch_id;			/* source id of the prefetch timer */
+	gchar *prefetch_tag;		/* last tag looked up for prefetching */
+	gchar *prefetch_uri;		/* and its page, NULL if it has none */
+	GtkWidget *prefetch_window;	/* offscreen window holding... */
+	GtkWidget *prefetch_view;	/* ...the webview pages get preloaded into */
+	
+	/* the tag at the cursor, cached until the cursor, the selection or
+	 * the text changes */
+	gboolean tag_valid;
+	GeanyDocument *tag_doc;
+	gint tag_pos;
+	gint tag_sel_start;
+	gint tag_sel_end;
+	gchar *tag;
+	gint tag_matches;			/* keywords named tag, -1 if not counted */
+	gboolean tag_labels_valid;	/* editor menu labels show tag */
+	
+	SymbolTable *symbols;		/* docs of the tag manager's symbols */
+	guint n_global_tags;		/* global tags in the symbol table */
+	BookSets *book_sets;		/* the books of each filetype */
+	
+	gboolean index_daemon;		/* share the daemon's index, see dhp-indexd.c */
+	gboolean index_connected;	/* the search panel searches through it */
+	IndexClient *search_client;	/* until it's handed to the search panel */
 };
 
 static void devhelp_plugin_finalize			(GObject *object);
+static void on_books_changed				(gpointer user_data);
+static void devhelp_plugin_detach_tooltips	(DevhelpPlugin *dhplug);
+static void devhelp_plugin_start_fulltext	(DevhelpPlugin *dhplug);
+static void devhelp_plugin_start_summaries	(DevhelpPlugin *dhplug);
 
 G_DEFINE_TYPE(DevhelpPlugin, devhelp_plugin, G_TYPE_OBJECT)
 
@@ -63,102 +166,1175 @@ static void devhelp_plugin_class_init(DevhelpPluginClass *klass)
 	g_type_class_add_private((gpointer)klass, sizeof(DevhelpPluginPrivate));
 }
 
-
-static void devhelp_plugin_finalize(GObject *object)
+
+static void devhelp_plugin_finalize(GObject *object)
+{
+	DevhelpPlugin *self;
+
+	g_return_if_fail(object != NULL);
+	g_return_if_fail(DEVHELP_IS_PLUGIN(object));
+
+	self = DEVHELP_PLUGIN(object);
+
+	if (self->priv->loader != NULL)
+		self->priv->loader->dhplug = NULL;
+	if (self->priv->reloader != NULL)
+		self->priv->reloader->dhplug = NULL;
+	book_monitor_free(self->priv->monitor);
+	if (self->priv->fulltext_loader != NULL) {
+		self->priv->fulltext_loader->dhplug = NULL;
+		g_cancellable_cancel(self->priv->fulltext_loader->cancellable);
+	}
+	if (self->priv->summary_loader != NULL) {
+		self->priv->summary_loader->dhplug = NULL;
+		g_cancellable_cancel(self->priv->summary_loader->cancellable);
+	}
+	devhelp_plugin_detach_tooltips(self);
+	g_free(self->priv->pending_search);
+	if (self->priv->prefetch_id != 0)
+		g_source_remove(self->priv->prefetch_id);
+	g_free(self->priv->prefetch_tag);
+	g_free(self->priv->prefetch_uri);
+	g_free(self->priv->tag);
+	symbol_table_free(self->priv->symbols);
+	book_sets_free(self->priv->book_sets);
+	index_client_free(self->priv->search_client);
+	if (self->priv->prefetch_window != NULL)
+		gtk_widget_destroy(self->priv->prefetch_window);
+
+	gtk_widget_destroy(self->sb_notebook);
+	
+	doc_tabs_free(self->doc_tabs);
+								
+	if (!self->in_message_window)
+		main_notebook_release();
+   
+	gtk_widget_destroy(self->editor_menu_sep);
+	gtk_widget_destroy(self->editor_menu_item);
+	gtk_widget_destroy(self->editor_open_menu_item);
+   
+	gtk_notebook_set_tab_pos(GTK_NOTEBOOK(
+								geany->main_widgets->sidebar_notebook), 
+								self->orig_sb_tab_pos);
+
+	G_OBJECT_CLASS(devhelp_plugin_parent_class)->finalize(object);
+}
+
+
+static void devhelp_plugin_init(DevhelpPlugin *self)
+{
+	self->priv = G_TYPE_INSTANCE_GET_PRIVATE(self,
+		DEVHELP_TYPE_PLUGIN, DevhelpPluginPrivate);
+	self->priv->loader = NULL;
+	self->priv->monitor = NULL;
+	self->priv->reloader = NULL;
+	self->priv->reload_pending = FALSE;
+	self->priv->pending_search = NULL;
+	self->priv->fulltext = FALSE;
+	self->priv->fulltext_loader = NULL;
+	self->priv->hover_tooltips = FALSE;
+	self->priv->summary_loader = NULL;
+	self->priv->prefetch = FALSE;
+	self->priv->prefetch_delay = DHPLUG_DEFAULT_PREFETCH_DELAY;
+	self->priv->prefetch_id = 0;
+	self->priv->prefetch_tag = NULL;
+	self->priv->prefetch_uri = NULL;
+	self->priv->prefetch_window = NULL;
+	self->priv->prefetch_view = NULL;
+	self->priv->tag_valid = FALSE;
+	self->priv->tag_doc = NULL;
+	self->priv->tag = NULL;
+	self->priv->tag_matches = -1;
+	self->priv->tag_labels_valid = FALSE;
+	self->priv->symbols = symbol_table_new();
+	self->priv->n_global_tags = 0;
+	self->priv->book_sets = book_sets_new();
+	self->priv->index_daemon = FALSE;
+	self->priv->index_connected = FALSE;
+	self->priv->search_client = NULL;
+}
+
+/* 
+ * Gets the tag at the cursor of the current document, only working it out
+ * again if the cursor, selection or document changed since the last call.
+ * The returned string is owned by the plugin.
+ */
+static const gchar *devhelp_plugin_get_cached_tag(DevhelpPlugin *dhplug)
+{
+	DevhelpPluginPrivate *priv = dhplug->priv;
+	GeanyDocument *doc = document_get_current();
+	gint pos, sel_start, sel_end;
+	
+	if (doc == NULL)
+		return NULL;
+	
+	pos = sci_get_current_position(doc->editor->sci);
+	sel_start = sci_get_selection_start(doc->editor->sci);
+	sel_end = sci_get_selection_end(doc->editor->sci);
+	
+	if (priv->tag_valid && priv->tag_doc == doc && priv->tag_pos == pos &&
+		priv->tag_sel_start == sel_start && priv->tag_sel_end == sel_end)
+		return priv->tag;
+	
+	g_free(priv->tag);
+	priv->tag = devhelp_plugin_get_current_tag();
+	priv->tag_doc = doc;
+	priv->tag_pos = pos;
+	priv->tag_sel_start = sel_start;
+	priv->tag_sel_end = sel_end;
+	priv->tag_valid = TRUE;
+	priv->tag_matches = -1;
+	priv->tag_labels_valid = FALSE;
+	
+	return priv->tag;
+}
+
+/* Drops the cached tag, the text it came from changed */
+static void devhelp_plugin_invalidate_tag(DevhelpPlugin *dhplug)
+{
+	dhplug->priv->tag_valid = FALSE;
+}
+
+/* Number of the book of an entry of index in book_indexes */
+static guint32 devhelp_plugin_book_number(SearchIndex *index, guint entry)
+{
+	const BookIndex *book = search_index_entry_book(index, entry);
+	guint i;
+	
+	/* shards only have some of the books */
+	if (index->books == book_indexes)
+		return index->entries[entry].book;
+	for (i = 0; i < book_indexes->len; i++) {
+		if (g_ptr_array_index(book_indexes, i) == book)
+			break;
+	}
+	return i;
+}
+
+/* Appends up to n keywords named like the one at entry as IndexRefs */
+static void append_entry_refs(SearchIndex *index, guint entry, guint n,
+							  GArray *refs)
+{
+	guint i = 0;
+	
+	do {
+		IndexRef ref;
+		ref.book = devhelp_plugin_book_number(index, entry);
+		ref.keyword = index->entries[entry].keyword;
+		g_array_append_val(refs, ref);
+	} while (++i < n && search_index_lookup_next(index, &entry));
+}
+
+/* 
+ * Finds what documents tag in doc.  Filetypes with a book set are looked
+ * up in the shard of their books only, others in every book through the
+ * symbol table.  With the index daemon too this is done on the window's
+ * own index, mapped from the one the daemon saves, since it runs on the
+ * main loop when hovering or opening the editor menu.  The keywords
+ * named exactly tag, or if there are none the first one named like it
+ * ignoring case, are appended to refs as IndexRefs into book_indexes and
+ * n_exact is set to how many are named exactly tag.  Returns FALSE if the
+ * books aren't loaded yet.
+ */
+static gboolean devhelp_plugin_lookup_tag(DevhelpPlugin *dhplug,
+										  GeanyDocument *doc, const gchar *tag,
+										  GArray *refs, guint *n_exact)
+{
+	DevhelpPluginPrivate *priv = dhplug->priv;
+	SearchIndex *index = NULL;
+	SymbolDocs docs;
+	
+	if (doc != NULL && doc->file_type != NULL)
+		index = book_sets_get_index(priv->book_sets, doc->file_type->name);
+	
+	if (index != NULL)
+		symbol_table_resolve(index, tag, &docs);
+	else {
+		index = search_index;
+		if (!symbol_table_lookup(priv->symbols, tag, &docs))
+			return FALSE;
+	}
+	
+	*n_exact = docs.n_exact;
+	if (docs.documented)
+		append_entry_refs(index, docs.entry, MAX(docs.n_exact, 1), refs);
+	return TRUE;
+}
+
+/* Called when the editor menu item is selected */
+static void on_search_help_activate(GtkMenuItem *menuitem, gpointer user_data)
+{
+	DevhelpPlugin *dhplug = user_data;
+	gchar *current_tag = g_strdup(devhelp_plugin_get_cached_tag(dhplug));
+	
+	if (current_tag == NULL)
+		return;
+	
+	devhelp_plugin_search(dhplug, current_tag);
+	
+	/* activate devhelp tabs with search tab active */
+	devhelp_plugin_activate_tabs(dhplug, FALSE);
+	if (dhplug->tabs_toggled)
+		devhelp_plugin_open_prefetched(dhplug, current_tag);
+	
+	g_free(current_tag);
+}
+
+/* Called when the "Open Documentation" editor menu item is selected */
+static void on_open_help_activate(GtkMenuItem *menuitem, gpointer user_data)
+{
+	DevhelpPlugin *dhplug = user_data;
+	gchar *current_tag = g_strdup(devhelp_plugin_get_cached_tag(dhplug));
+	
+	if (current_tag == NULL)
+		return;
+	
+	devhelp_plugin_open_symbol(dhplug, current_tag);
+	
+	g_free(current_tag);
+}
+
+/* 
+ * Called when the editor context menu is shown so that the devhelp
+ * search item can be disabled if there isn't a selected tag.
+ */
+static void on_editor_menu_popup(GtkWidget *widget, gpointer user_data)
+{
+	const gchar *curword;
+	gchar *new_label = NULL;
+	DevhelpPlugin *dhplug = user_data;
+	DevhelpPluginPrivate *priv = dhplug->priv;
+	
+	curword = devhelp_plugin_get_cached_tag(dhplug);
+	if (curword == NULL) {
+		gtk_widget_set_sensitive(dhplug->editor_menu_item, FALSE);
+		gtk_widget_set_sensitive(dhplug->editor_open_menu_item, FALSE);
+		return;
+	}
+	
+	/* a probe of the symbol table, but only once the books are loaded */
+	if (priv->tag_matches < 0) {
+		GArray *refs = g_array_new(FALSE, FALSE, sizeof(IndexRef));
+		guint n_exact;
+		
+		if (devhelp_plugin_lookup_tag(dhplug, priv->tag_doc, curword, refs,
+									  &n_exact)) {
+			priv->tag_matches = n_exact;
+			priv->tag_labels_valid = FALSE;
+		}
+		g_array_free(refs, TRUE);
+	}
+	
+	gtk_widget_set_sensitive(dhplug->editor_menu_item, TRUE);
+	gtk_widget_set_sensitive(dhplug->editor_open_menu_item,
+							 priv->tag_matches != 0);
+	
+	if (priv->tag_labels_valid)
+		return;
+	
+	if (priv->tag_matches < 0)
+		new_label = g_strdup_printf("Search Devhelp for '%s'", curword);
+	else if (priv->tag_matches == 1)
+		new_label = g_strdup_printf("Search Devhelp for '%s' (1 match)", curword);
+	else
+		new_label = g_strdup_printf("Search Devhelp for '%s' (%d matches)",
+									curword, priv->tag_matches);
+	gtk_menu_item_set_label(GTK_MENU_ITEM(dhplug->editor_menu_item), new_label);
+	g_free(new_label);
+	
+	new_label = g_strdup_printf("Open Documentation for '%s'", curword);
+	gtk_menu_item_set_label(GTK_MENU_ITEM(dhplug->editor_open_menu_item),
+							new_label);
+	g_free(new_label);
+	
+	priv->tag_labels_valid = TRUE;
+}
+
+/* 
+ * Called when the book tree or the search panel selects a link.  Holding
+ * Ctrl opens the page in a new tab.
+ */
+static void on_uri_selected(GObject *ignored, const gchar *uri, gpointer user_data)
+{
+	DevhelpPlugin *dhplug = user_data;
+	GdkModifierType state = 0;
+	
+	gtk_get_current_event_state(&state);
+	doc_tabs_open(dhplug->doc_tabs, uri, (state & GDK_CONTROL_MASK) != 0);
+}
+
+/* 
+ * Gets the URI of the first keyword named tag in the books of the current
+ * document or NULL if there isn't one or the books aren't loaded yet.
+ */
+static gchar *lookup_symbol_uri(DevhelpPlugin *dhplug, const gchar *tag)
+{
+	GArray *refs = g_array_new(FALSE, FALSE, sizeof(IndexRef));
+	gchar *uri = NULL;
+	guint n_exact;
+	
+	if (devhelp_plugin_lookup_tag(dhplug, document_get_current(), tag, refs,
+								  &n_exact) && refs->len > 0) {
+		const IndexRef *ref = &g_array_index(refs, IndexRef, 0);
+		uri = book_index_get_uri(g_ptr_array_index(book_indexes, ref->book),
+								 ref->keyword);
+	}
+	
+	g_array_free(refs, TRUE);
+	return uri;
+}
+
+/* Collects the names of the tags worth looking up documentation for */
+static GPtrArray *collect_symbol_names(GPtrArray *tags)
+{
+	GPtrArray *names = g_ptr_array_new();
+	guint i;
+	
+	for (i = 0; tags != NULL && i < tags->len; i++) {
+		const TMTag *tag = g_ptr_array_index(tags, i);
+		if (tag->name != NULL && (tag->type & DHPLUG_SYMBOL_TAG_TYPES))
+			g_ptr_array_add(names, tag->name);
+	}
+	
+	return names;
+}
+
+/* 
+ * Puts the symbols of doc, as the tag manager last parsed them, in the
+ * symbol table.  Each document is a source of its own.
+ */
+static void devhelp_plugin_update_symbols(DevhelpPlugin *dhplug,
+										  GeanyDocument *doc)
+{
+	GPtrArray *names;
+	
+	if (doc->tm_file == NULL) {
+		symbol_table_remove_source(dhplug->priv->symbols, doc->index);
+		return;
+	}
+	
+	names = collect_symbol_names(doc->tm_file->tags_array);
+	symbol_table_set_source(dhplug->priv->symbols, doc->index, names);
+	g_ptr_array_free(names, TRUE);
+}
+
+/* 
+ * Puts the global tags in the symbol table.  Geany loads them for each
+ * filetype as it's first used, so this only does anything if some were
+ * loaded since the last time.
+ */
+static void devhelp_plugin_update_global_symbols(DevhelpPlugin *dhplug)
+{
+	GPtrArray *tags, *names;
+	
+	tags = geany->app->tm_workspace->global_tags;
+	if (tags == NULL || tags->len == dhplug->priv->n_global_tags)
+		return;
+	
+	names = collect_symbol_names(tags);
+	symbol_table_set_source(dhplug->priv->symbols, SYMBOL_TABLE_GLOBAL_SOURCE,
+							names);
+	g_ptr_array_free(names, TRUE);
+	dhplug->priv->n_global_tags = tags->len;
+}
+
+/* Called when a document is opened or saved, its tags were parsed again */
+static void on_document_tags_changed(GObject *object, GeanyDocument *doc,
+									 gpointer user_data)
+{
+	devhelp_plugin_update_symbols(user_data, doc);
+	devhelp_plugin_update_global_symbols(user_data);
+}
+
+/* Same for a change of filetype, which also parses the tags again */
+static void on_document_filetype_set(GObject *object, GeanyDocument *doc,
+									 GeanyFiletype *filetype_old,
+									 gpointer user_data)
+{
+	/* the tag may be documented by other books now */
+	devhelp_plugin_invalidate_tag(user_data);
+	on_document_tags_changed(object, doc, user_data);
+}
+
+static void on_document_close(GObject *object, GeanyDocument *doc,
+							  gpointer user_data)
+{
+	DevhelpPlugin *dhplug = user_data;
+	
+	symbol_table_remove_source(dhplug->priv->symbols, doc->index);
+}
+
+/* Escapes text into markup, NULL is left out */
+static void append_markup(GString *markup, const gchar *format, const gchar *text)
+{
+	gchar *escaped;
+	
+	if (text == NULL)
+		return;
+	
+	escaped = g_markup_printf_escaped(format, text);
+	if (markup->len > 0)
+		g_string_append_c(markup, '\n');
+	g_string_append(markup, escaped);
+	g_free(escaped);
+}
+
+/* 
+ * Shows the signature and summary of the symbol under the mouse.  Only
+ * ever looks things up in memory, the summaries were extracted from the
+ * pages in the background beforehand.
+ */
+static gboolean on_sci_query_tooltip(GtkWidget *widget, gint x, gint y,
+									 gboolean keyboard_mode, GtkTooltip *tooltip,
+									 gpointer user_data)
+{
+	DevhelpPlugin *dhplug = user_data;
+	ScintillaObject *sci = SCINTILLA(widget);
+	const gchar *signature, *summary;
+	GeanyDocument *doc;
+	GArray *refs;
+	IndexRef ref;
+	guint n_exact;
+	GdkRectangle area;
+	GString *markup;
+	gchar *word;
+	gint pos, start, end, line;
+	
+	if (!dhplug->priv->hover_tooltips || summary_store == NULL || keyboard_mode ||
+		summary_store_get_books(summary_store) != book_indexes)
+		return FALSE;
+	
+	doc = document_get_current();
+	if (doc == NULL || doc->editor->sci != sci)
+		return FALSE;
+	
+	pos = scintilla_send_message(sci, SCI_POSITIONFROMPOINTCLOSE, x, y);
+	if (pos < 0)
+		return FALSE;
+	
+	word = editor_get_word_at_pos(doc->editor, pos, GEANY_WORDCHARS);
+	if (word == NULL)
+		return FALSE;
+	refs = g_array_new(FALSE, FALSE, sizeof(IndexRef));
+	if (word[0] == '\0' ||
+		!devhelp_plugin_lookup_tag(dhplug, doc, word, refs, &n_exact) ||
+		refs->len == 0) {
+		g_array_free(refs, TRUE);
+		g_free(word);
+		return FALSE;
+	}
+	ref = g_array_index(refs, IndexRef, 0);
+	g_array_free(refs, TRUE);
+	
+	/* the store numbers books the same way as book_indexes */
+	if (!summary_store_lookup(summary_store, ref.book, ref.keyword,
+							  &signature, &summary)) {
+		g_free(word);
+		return FALSE;
+	}
+	
+	markup = g_string_new(NULL);
+	append_markup(markup, "<tt>%s</tt>", signature != NULL ? signature : word);
+	append_markup(markup, "%s", summary);
+	gtk_tooltip_set_markup(tooltip, markup->str);
+	g_string_free(markup, TRUE);
+	g_free(word);
+	
+	/* the same tooltip stays up while the mouse is over the word */
+	start = scintilla_send_message(sci, SCI_WORDSTARTPOSITION, pos, TRUE);
+	end = scintilla_send_message(sci, SCI_WORDENDPOSITION, pos, TRUE);
+	line = sci_get_line_from_position(sci, pos);
+	area.x = scintilla_send_message(sci, SCI_POINTXFROMPOSITION, 0, start);
+	area.y = scintilla_send_message(sci, SCI_POINTYFROMPOSITION, 0, start);
+	area.width = MAX(scintilla_send_message(sci, SCI_POINTXFROMPOSITION, 0, end) -
+					 area.x, 1);
+	area.height = scintilla_send_message(sci, SCI_TEXTHEIGHT, line, 0);
+	gtk_tooltip_set_tip_area(tooltip, &area);
+	
+	return TRUE;
+}
+
+/* Lets a document's editor show summary tooltips, once */
+static void devhelp_plugin_attach_tooltip(DevhelpPlugin *dhplug,
+										  GeanyDocument *doc)
+{
+	GtkWidget *sci;
+	
+	if (!DOC_VALID(doc))
+		return;
+	
+	sci = GTK_WIDGET(doc->editor->sci);
+	if (g_object_get_data(G_OBJECT(sci), "devhelp-tooltip") == dhplug)
+		return;
+	
+	g_object_set_data(G_OBJECT(sci), "devhelp-tooltip", dhplug);
+	gtk_widget_set_has_tooltip(sci, TRUE);
+	g_signal_connect(sci, "query-tooltip", G_CALLBACK(on_sci_query_tooltip),
+					 dhplug);
+}
+
+static void devhelp_plugin_detach_tooltips(DevhelpPlugin *dhplug)
+{
+	guint i;
+	
+	foreach_document(i) {
+		GtkWidget *sci = GTK_WIDGET(documents[i]->editor->sci);
+		
+		if (g_object_get_data(G_OBJECT(sci), "devhelp-tooltip") != dhplug)
+			continue;
+		g_signal_handlers_disconnect_by_func(sci, on_sci_query_tooltip, dhplug);
+		g_object_set_data(G_OBJECT(sci), "devhelp-tooltip", NULL);
+		gtk_widget_set_has_tooltip(sci, FALSE);
+	}
+}
+
+/* 
+ * Runs once the cursor has rested for prefetch_delay.  Looks up the symbol
+ * under the cursor and loads its page into a hidden webview so WebKit has
+ * it cached by the time it's asked for.
+ */
+static gboolean on_prefetch_timeout(gpointer user_data)
+{
+	DevhelpPlugin *dhplug = user_data;
+	DevhelpPluginPrivate *priv = dhplug->priv;
+	const gchar *tag;
+	
+	priv->prefetch_id = 0;
+	
+	tag = devhelp_plugin_get_cached_tag(dhplug);
+	if (tag == NULL || g_strcmp0(tag, priv->prefetch_tag) == 0)
+		return FALSE;
+	
+	g_free(priv->prefetch_tag);
+	g_free(priv->prefetch_uri);
+	priv->prefetch_tag = g_strdup(tag);
+	priv->prefetch_uri = lookup_symbol_uri(dhplug, tag);
+	
+	/* man pages aren't worth running man for on the off chance */
+	if (priv->prefetch_uri == NULL ||
+		doc_provider_for_uri(priv->prefetch_uri) != NULL)
+		return FALSE;
+	
+	if (priv->prefetch_view == NULL) {
+		priv->prefetch_window = gtk_offscreen_window_new();
+		priv->prefetch_view = webkit_web_view_new();
+		gtk_container_add(GTK_CONTAINER(priv->prefetch_window),
+						  priv->prefetch_view);
+		gtk_widget_show_all(priv->prefetch_window);
+	}
+	
+	/* only ever one preload in flight */
+	webkit_web_view_stop_loading(WEBKIT_WEB_VIEW(priv->prefetch_view));
+	webkit_web_view_load_uri(WEBKIT_WEB_VIEW(priv->prefetch_view),
+							 priv->prefetch_uri);
+	
+	return FALSE;
+}
+
+/* Geany reuses document structs, so a new document can't share a cached tag */
+static void on_document_activate(GObject *object, GeanyDocument *doc,
+								 gpointer user_data)
+{
+	devhelp_plugin_invalidate_tag(user_data);
+	devhelp_plugin_attach_tooltip(user_data, doc);
+}
+
+/* 
+ * Restarts the prefetch timer whenever the cursor moves or the text changes
+ * so moving around quickly never starts a burst of page loads.
+ */
+static gboolean on_editor_notify(GObject *object, GeanyEditor *editor,
+								 SCNotification *nt, gpointer user_data)
+{
+	DevhelpPlugin *dhplug = user_data;
+	DevhelpPluginPrivate *priv = dhplug->priv;
+	
+	if (nt->nmhdr.code == SCN_MODIFIED &&
+		(nt->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT)))
+		devhelp_plugin_invalidate_tag(dhplug);
+	
+	if (!priv->prefetch || nt->nmhdr.code != SCN_UPDATEUI)
+		return FALSE;
+	
+	if (priv->prefetch_id != 0)
+		g_source_remove(priv->prefetch_id);
+	priv->prefetch_id = g_timeout_add(priv->prefetch_delay,
+									  on_prefetch_timeout, dhplug);
+	
+	return FALSE;
+}
+
+/* Placeholder shown in the sidebar tabs while the books are loading */
+static GtkWidget *loading_label_new(void)
+{
+	GtkWidget *label = gtk_label_new(_("Loading documentation..."));
+	gtk_widget_set_sensitive(label, FALSE);
+	return label;
+}
+
+/* Replaces whatever is in container with child */
+static void replace_child(GtkWidget *container, GtkWidget *child)
+{
+	GList *children, *iter;
+	
+	children = gtk_container_get_children(GTK_CONTAINER(container));
+	for (iter = children; iter; iter = g_list_next(iter))
+		gtk_widget_destroy(iter->data);
+	g_list_free(children);
+	
+	gtk_box_pack_start(GTK_BOX(container), child, TRUE, TRUE, 0);
+	gtk_widget_show_all(child);
+}
+
+/* 
+ * Builds the book tree and search widgets from the loaded books and puts
+ * them in place of the "loading" placeholders.  Must be called from the
+ * main thread.
+ */
+static void devhelp_plugin_books_loaded(DevhelpPlugin *dhplug)
+{
+	GtkWidget *book_tree_sw;
+	gint64 start = g_get_monotonic_time();
+	
+	dhplug->book_tree = devhelp_book_tree_new();
+	devhelp_book_tree_set_books(DEVHELP_BOOK_TREE(dhplug->book_tree),
+								book_indexes);
+	dhplug->search = devhelp_search_panel_new();
+	devhelp_search_panel_set_index(DEVHELP_SEARCH_PANEL(dhplug->search),
+								   search_index);
+	symbol_table_set_index(dhplug->priv->symbols, search_index);
+	book_sets_set_books(dhplug->priv->book_sets, book_indexes);
+	
+	/* with the daemon the panel's keyword searches go to it */
+	if (dhplug->priv->search_client != NULL) {
+		devhelp_search_panel_set_client(DEVHELP_SEARCH_PANEL(dhplug->search),
+										dhplug->priv->search_client, book_indexes);
+		dhplug->priv->search_client = NULL;
+	}
+
+	/* sidebar contents/book tree */
+	book_tree_sw = gtk_scrolled_window_new(NULL, NULL);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(book_tree_sw),
+		GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+	gtk_container_set_border_width(GTK_CONTAINER(book_tree_sw), 6);
+	gtk_container_add(GTK_CONTAINER(book_tree_sw), dhplug->book_tree); 
+	replace_child(dhplug->contents_box, book_tree_sw);
+	
+	/* sidebar search */
+	replace_child(dhplug->search_box, dhplug->search);
+	
+	g_signal_connect(
+			dhplug->book_tree, 
+			"link-selected", 
+			G_CALLBACK(on_uri_selected), 
+			dhplug);
+										
+	g_signal_connect(
+			dhplug->search, 
+			"link-selected",
+			G_CALLBACK(on_uri_selected), 
+			dhplug);
+	
+	if (dhplug->priv->pending_search != NULL) {
+		devhelp_search_panel_set_search_string(
+			DEVHELP_SEARCH_PANEL(dhplug->search), dhplug->priv->pending_search);
+		g_free(dhplug->priv->pending_search);
+		dhplug->priv->pending_search = NULL;
+	}
+	
+	g_debug("Devhelp: filled the sidebar in %.1f ms",
+			(g_get_monotonic_time() - start) / 1000.0);
+	
+	if (dhplug->priv->monitor == NULL)
+		dhplug->priv->monitor = book_monitor_new(on_books_changed, dhplug);
+	book_monitor_watch(dhplug->priv->monitor, book_indexes);
+	
+	devhelp_plugin_start_fulltext(dhplug);
+	devhelp_plugin_start_summaries(dhplug);
+}
+
+/* Idle callback run on the main thread once the pages are indexed */
+static gboolean on_fulltext_loaded(gpointer user_data)
+{
+	FulltextLoader *loader = user_data;
+	
+	if (loader->dhplug != NULL) {
+		loader->dhplug->priv->fulltext_loader = NULL;
+		fulltext_index = loader->result;
+		if (loader->dhplug->search != NULL && fulltext_index != NULL)
+			devhelp_search_panel_set_fulltext(
+				DEVHELP_SEARCH_PANEL(loader->dhplug->search), fulltext_index);
+	}
+	else
+		fulltext_index_unref(loader->result);
+	
+	g_ptr_array_unref(loader->books);
+	g_object_unref(loader->cancellable);
+	g_free(loader->cache_dir);
+	g_free(loader);
+	
+	return FALSE;
+}
+
+/* 
+ * Full text indexing thread.  Books are indexed in parallel by
+ * fulltext_index_new(), this only waits for it so the main loop doesn't.
+ */
+static gpointer build_fulltext_thread(gpointer user_data)
+{
+	FulltextLoader *loader = user_data;
+	
+	loader->result = fulltext_index_new(loader->books, loader->cache_dir,
+										loader->cancellable);
+	if (g_cancellable_is_cancelled(loader->cancellable)) {
+		fulltext_index_unref(loader->result);
+		loader->result = NULL;
+	}
+	
+	g_idle_add(on_fulltext_loaded, loader);
+	
+	return NULL;
+}
+
+/* 
+ * Hands the full text index to the search panel, starting to build it in
+ * the background if that hasn't been done yet.  Does nothing until the
+ * books are loaded or if full text search is turned off.
+ */
+static void devhelp_plugin_start_fulltext(DevhelpPlugin *dhplug)
+{
+	DevhelpPluginPrivate *priv = dhplug->priv;
+	FulltextLoader *loader;
+	GError *error = NULL;
+	
+	if (!priv->fulltext || dhplug->search == NULL || priv->fulltext_loader != NULL)
+		return;
+	
+	if (fulltext_index != NULL) {
+		devhelp_search_panel_set_fulltext(DEVHELP_SEARCH_PANEL(dhplug->search),
+										  fulltext_index);
+		return;
+	}
+	
+	/* far too slow to do on the main thread, so no threads means no
+	 * full text search */
+	if (!g_thread_supported())
+		return;
+	
+	loader = g_new0(FulltextLoader, 1);
+	loader->dhplug = dhplug;
+	loader->books = g_ptr_array_ref(book_indexes);
+	loader->cancellable = g_cancellable_new();
+	if (plugin_get_config_dir() != NULL)
+		loader->cache_dir = g_build_filename(plugin_get_config_dir(),
+											 DHPLUG_FULLTEXT_DIR, NULL);
+	
+	if (g_thread_create(build_fulltext_thread, loader, FALSE, &error) == NULL) {
+		g_warning(_("Unable to start full text indexing thread: %s"),
+				  error->message);
+		g_error_free(error);
+		g_ptr_array_unref(loader->books);
+		g_object_unref(loader->cancellable);
+		g_free(loader->cache_dir);
+		g_free(loader);
+		return;
+	}
+	
+	priv->fulltext_loader = loader;
+}
+
+/* Idle callback run on the main thread once the summaries are extracted */
+static gboolean on_summaries_loaded(gpointer user_data)
+{
+	SummaryLoader *loader = user_data;
+	
+	if (loader->dhplug != NULL) {
+		loader->dhplug->priv->summary_loader = NULL;
+		summary_store = loader->result;
+	}
+	else
+		summary_store_unref(loader->result);
+	
+	g_ptr_array_unref(loader->books);
+	g_object_unref(loader->cancellable);
+	g_free(loader->cache_dir);
+	g_free(loader);
+	
+	return FALSE;
+}
+
+/* Summary extracting thread, the books are done on a pool of workers */
+static gpointer build_summaries_thread(gpointer user_data)
+{
+	SummaryLoader *loader = user_data;
+	
+	loader->result = summary_store_new(loader->books, loader->cache_dir,
+									   loader->cancellable);
+	if (g_cancellable_is_cancelled(loader->cancellable)) {
+		summary_store_unref(loader->result);
+		loader->result = NULL;
+	}
+	
+	g_idle_add(on_summaries_loaded, loader);
+	
+	return NULL;
+}
+
+/* 
+ * Starts extracting the keyword summaries for the hover tooltips in the
+ * background if that hasn't been done yet.  Does nothing until the books
+ * are loaded or if the tooltips are turned off.
+ */
+static void devhelp_plugin_start_summaries(DevhelpPlugin *dhplug)
+{
+	DevhelpPluginPrivate *priv = dhplug->priv;
+	SummaryLoader *loader;
+	GError *error = NULL;
+	
+	if (!priv->hover_tooltips || book_indexes == NULL || priv->loader != NULL ||
+		priv->summary_loader != NULL || summary_store != NULL)
+		return;
+	
+	/* reading pages on the main thread is exactly what this avoids */
+	if (!g_thread_supported())
+		return;
+	
+	loader = g_new0(SummaryLoader, 1);
+	loader->dhplug = dhplug;
+	loader->books = g_ptr_array_ref(book_indexes);
+	loader->cancellable = g_cancellable_new();
+	if (plugin_get_config_dir() != NULL)
+		loader->cache_dir = g_build_filename(plugin_get_config_dir(),
+											 DHPLUG_SUMMARY_DIR, NULL);
+	
+	if (g_thread_create(build_summaries_thread, loader, FALSE, &error) == NULL) {
+		g_warning(_("Unable to start summary extracting thread: %s"),
+				  error->message);
+		g_error_free(error);
+		g_ptr_array_unref(loader->books);
+		g_object_unref(loader->cancellable);
+		g_free(loader->cache_dir);
+		g_free(loader);
+		return;
+	}
+	
+	priv->summary_loader = loader;
+}
+
+/* Stops extracting summaries and drops the ones there are */
+static void devhelp_plugin_drop_summaries(DevhelpPlugin *dhplug)
+{
+	DevhelpPluginPrivate *priv = dhplug->priv;
+	
+	if (priv->summary_loader != NULL) {
+		priv->summary_loader->dhplug = NULL;
+		g_cancellable_cancel(priv->summary_loader->cancellable);
+		priv->summary_loader = NULL;
+	}
+	summary_store_unref(summary_store);
+	summary_store = NULL;
+}
+
+/* Idle callback run on the main thread once the loading thread is done */
+static gboolean on_books_loaded(gpointer user_data)
+{
+	BookLoader *loader = user_data;
+	
+	if (loader->dhplug != NULL) {
+		/* only published here, on the main thread that reads them */
+		if (book_indexes == NULL) {
+			book_indexes = loader->books;
+			loader->books = NULL;
+		}
+		/* another window's loader may have put its books in first */
+		if (search_index == NULL && loader->index != NULL) {
+			if (loader->index->books == book_indexes) {
+				search_index = loader->index;
+				loader->index = NULL;
+			}
+			else
+				search_index = search_index_new(book_indexes);
+		}
+		loader->dhplug->priv->loader = NULL;
+		loader->dhplug->priv->index_connected = (loader->search_client != NULL);
+		loader->dhplug->priv->search_client = loader->search_client;
+		devhelp_plugin_books_loaded(loader->dhplug);
+		stats_end(STATS_BOOK_LOAD, loader->start);
+	}
+	else
+		index_client_free(loader->search_client);
+	
+	if (loader->books != NULL)
+		g_ptr_array_unref(loader->books);
+	search_index_unref(loader->index);
+	g_free(loader->snapshot_path);
+	g_free(loader);
+	
+	return FALSE;
+}
+
+/* 
+ * Connects to the index daemon, starting it if no other Geany has.  The
+ * connection is the search panel's, which starts it again if it dies.
+ * Tag lookups run on the main loop so they never go to the daemon, they
+ * use the window's own index.
+ */
+static void devhelp_plugin_connect_daemon(BookLoader *loader)
+{
+	gchar *socket_path = index_protocol_socket_path();
+	gchar *argv[] = { DHPLUG_INDEXD, "--snapshot", loader->snapshot_path, NULL };
+	GError *error = NULL;
+	
+	/* no snapshot means the daemon would parse every book on each start */
+	if (loader->snapshot_path == NULL)
+		argv[1] = NULL;
+	
+	loader->search_client = index_client_connect(socket_path, argv, &error);
+	if (loader->search_client == NULL) {
+		g_warning(_("Unable to use the documentation index daemon, "
+					"searching the books in this window: %s"), error->message);
+		g_error_free(error);
+	}
+	
+	g_free(socket_path);
+}
+
+/* 
+ * Book loading thread.  The books of every documentation provider are
+ * parsed on a pool of worker threads by index_snapshot_load(), this keeps
+ * even the waiting off of the main thread.  Nothing GTK related may
+ * happen in here, and the globals are left alone: what it makes goes in
+ * the loader for on_books_loaded() to publish.
+ */
+static gpointer load_books_thread(gpointer user_data)
 {
-	DevhelpPlugin *self;
-
-	g_return_if_fail(object != NULL);
-	g_return_if_fail(DEVHELP_IS_PLUGIN(object));
-
-	self = DEVHELP_PLUGIN(object);
-
-	gtk_widget_destroy(self->sb_notebook);
+	BookLoader *loader = user_data;
+	gboolean save;
 	
-	gtk_notebook_remove_page(GTK_NOTEBOOK(self->main_notebook),
-								self->webview_tab);
-								
-	if (!self->in_message_window)
-		main_notebook_destroy();
-   
-	gtk_widget_destroy(self->editor_menu_sep);
-	gtk_widget_destroy(self->editor_menu_item);
-   
-	gtk_notebook_set_tab_pos(GTK_NOTEBOOK(
-								geany->main_widgets->sidebar_notebook), 
-								self->orig_sb_tab_pos);
+	if (loader->index_daemon)
+		devhelp_plugin_connect_daemon(loader);
+	
+	/* once there's a daemon it keeps the snapshots and the index up to
+	 * date, the windows only read them */
+	save = (loader->search_client == NULL);
+	if (loader->books == NULL)
+		loader->books = doc_provider_load_books(loader->snapshot_path, save,
+												NULL);
+	if (loader->index == NULL)
+		loader->index = doc_provider_index_books(loader->books,
+												 loader->snapshot_path, save);
+	
+	g_idle_add(on_books_loaded, loader);
+	
+	return NULL;
+}
 
-	G_OBJECT_CLASS(devhelp_plugin_parent_class)->finalize(object);
+/* 
+ * Starts loading the books in the background.  If threads aren't available
+ * the books are loaded synchronously like they used to be.
+ */
+static void devhelp_plugin_load_books(DevhelpPlugin *dhplug)
+{
+	GError *error = NULL;
+	BookLoader *loader;
+	
+	/* every window has a connection of its own to the daemon */
+	if (search_index != NULL && !dhplug->priv->index_daemon) {
+		devhelp_plugin_books_loaded(dhplug);
+		return;
+	}
+	
+	loader = g_new0(BookLoader, 1);
+	loader->dhplug = dhplug;
+	loader->start = stats_begin();
+	loader->index_daemon = dhplug->priv->index_daemon;
+	/* what another window loaded already is reused, not read again */
+	if (book_indexes != NULL)
+		loader->books = g_ptr_array_ref(book_indexes);
+	if (search_index != NULL)
+		loader->index = search_index_ref(search_index);
+	if (plugin_get_config_dir() != NULL)
+		loader->snapshot_path = g_build_filename(plugin_get_config_dir(),
+												 DHPLUG_SNAPSHOT_FILE, NULL);
+	dhplug->priv->loader = loader;
+	
+	/* connecting may wait for the daemon to start, so without threads
+	 * the books are indexed here */
+	if (!g_thread_supported() ||
+		g_thread_create(load_books_thread, loader, FALSE, &error) == NULL)
+	{
+		if (error != NULL) {
+			g_warning(_("Unable to start book loading thread: %s"),
+					  error->message);
+			g_error_free(error);
+		}
+		if (loader->books == NULL)
+			loader->books = doc_provider_load_books(loader->snapshot_path, TRUE,
+													NULL);
+		if (loader->index == NULL)
+			loader->index = doc_provider_index_books(loader->books,
+													 loader->snapshot_path,
+													 TRUE);
+		on_books_loaded(loader);
+	}
 }
 
 
-static void devhelp_plugin_init(DevhelpPlugin *self)
+/* 
+ * Puts reloaded books in place of the old ones everywhere they're used.
+ * Takes over the references to books and index.
+ */
+static void devhelp_plugin_swap_books(DevhelpPlugin *dhplug, GPtrArray *books,
+									  SearchIndex *index)
 {
-	self->priv = G_TYPE_INSTANCE_GET_PRIVATE(self,
-		DEVHELP_TYPE_PLUGIN, DevhelpPluginPrivate);
+	DevhelpPluginPrivate *priv = dhplug->priv;
+	
+	/* anything still using the old ones holds its own reference */
+	if (book_indexes != NULL)
+		g_ptr_array_unref(book_indexes);
+	search_index_unref(search_index);
+	book_indexes = books;
+	search_index = index;
+	
+	devhelp_book_tree_set_books(DEVHELP_BOOK_TREE(dhplug->book_tree),
+								book_indexes);
+	devhelp_search_panel_set_index(DEVHELP_SEARCH_PANEL(dhplug->search),
+								   search_index);
+	symbol_table_set_index(priv->symbols, search_index);
+	book_sets_set_books(priv->book_sets, book_indexes);
+	
+	/* the daemon reloads the books on its own, results from books it hasn't
+	 * caught up with yet are left out until it has */
+	if (priv->index_connected)
+		devhelp_search_panel_set_client(DEVHELP_SEARCH_PANEL(dhplug->search),
+										NULL, book_indexes);
 	
+	/* the tag may have more or fewer matches, or a different page */
+	devhelp_plugin_invalidate_tag(dhplug);
+	g_free(priv->prefetch_tag);
+	g_free(priv->prefetch_uri);
+	priv->prefetch_tag = NULL;
+	priv->prefetch_uri = NULL;
+	
+	/* only the books that changed miss the full text cache */
+	if (priv->fulltext_loader != NULL) {
+		priv->fulltext_loader->dhplug = NULL;
+		g_cancellable_cancel(priv->fulltext_loader->cancellable);
+		priv->fulltext_loader = NULL;
+	}
+	devhelp_search_panel_set_fulltext(DEVHELP_SEARCH_PANEL(dhplug->search), NULL);
+	fulltext_index_unref(fulltext_index);
+	fulltext_index = NULL;
+	devhelp_plugin_start_fulltext(dhplug);
+	
+	/* same for the summaries */
+	devhelp_plugin_drop_summaries(dhplug);
+	devhelp_plugin_start_summaries(dhplug);
+	
+	book_monitor_watch(priv->monitor, book_indexes);
 }
 
-/* Called when the editor menu item is selected */
-static void on_search_help_activate(GtkMenuItem *menuitem, gpointer user_data)
+static void devhelp_plugin_reload_books(DevhelpPlugin *dhplug);
+
+/* Idle callback run on the main thread once the reloading thread is done */
+static gboolean on_books_reloaded(gpointer user_data)
 {
-	DevhelpPlugin *dhplug = user_data;
-	gchar *current_tag = devhelp_plugin_get_current_tag();
+	BookLoader *loader = user_data;
+	DevhelpPlugin *dhplug = loader->dhplug;
 	
-	if (current_tag == NULL)
-		return;
-	
-	dh_search_set_search_string (DH_SEARCH(dhplug->search), current_tag, NULL);
+	if (dhplug != NULL) {
+		dhplug->priv->reloader = NULL;
+		
+		if (loader->books != NULL) {
+			devhelp_plugin_swap_books(dhplug, loader->books, loader->index);
+			loader->books = NULL;
+			loader->index = NULL;
+		}
+		
+		if (dhplug->priv->reload_pending) {
+			dhplug->priv->reload_pending = FALSE;
+			devhelp_plugin_reload_books(dhplug);
+		}
+	}
 	
-	/* activate devhelp tabs with search tab active */
-	devhelp_plugin_activate_tabs(dhplug, FALSE);
+	if (loader->books != NULL)
+		g_ptr_array_unref(loader->books);
+	search_index_unref(loader->index);
+	g_free(loader->snapshot_path);
+	g_free(loader);
 	
-	g_free(current_tag);
+	return FALSE;
 }
 
 /* 
- * Called when the editor context menu is shown so that the devhelp
- * search item can be disabled if there isn't a selected tag.
+ * Book reloading thread.  Unchanged books come from the snapshots so only
+ * the ones that were installed or upgraded get parsed.  The new books and
+ * index are only handed over if something actually changed.
  */
-static void on_editor_menu_popup(GtkWidget *widget, gpointer user_data)
+static gpointer reload_books_thread(gpointer user_data)
 {
-	gchar *curword = NULL;
-	gchar *new_label = NULL;
-	DevhelpPlugin *dhplug = user_data;
+	BookLoader *loader = user_data;
+	gboolean changed = FALSE;
 	
-	curword = devhelp_plugin_get_current_tag();
-	if (curword == NULL)
-		gtk_widget_set_sensitive(dhplug->editor_menu_item, FALSE);
+	/* the daemon writes the snapshots if it's used, see load_books_thread() */
+	loader->books = doc_provider_load_books(loader->snapshot_path,
+											!loader->index_daemon, &changed);
+	if (changed)
+		loader->index = doc_provider_index_books(loader->books,
+												 loader->snapshot_path,
+												 !loader->index_daemon);
 	else {
-		gtk_widget_set_sensitive(dhplug->editor_menu_item, TRUE);
-		new_label = g_strdup_printf("Search Devhelp for '%s'", curword);
-		gtk_menu_item_set_label(GTK_MENU_ITEM(dhplug->editor_menu_item),
-								new_label);
-		g_free(new_label);
+		g_ptr_array_unref(loader->books);
+		loader->books = NULL;
 	}
 	
-	g_free(curword);	
+	g_idle_add(on_books_reloaded, loader);
+	
+	return NULL;
 }
 
-/**
- * on_link_clicked:
- * @param ignored		Not used
- * @param link	  		The devhelp link object describing what was clicked.
- * @param user_data 	The current DevhelpPlugin struct.
- * 
- * Called when a link in either the contents or search areas on the sidebar 
- * have a link clicked on, meaning to load that file into the webview.
+/* 
+ * Loads the books again in the background, if that isn't already
+ * happening, in which case it's done again once that finishes.
  */
-static void on_link_clicked(GObject *ignored, DhLink *link, gpointer user_data)
+static void devhelp_plugin_reload_books(DevhelpPlugin *dhplug)
 {
-	gchar *uri = dh_link_get_uri(link);
-	DevhelpPlugin *plug = user_data;
-	webkit_web_view_open(WEBKIT_WEB_VIEW(plug->webview), uri);
-	g_free(uri);
-	gtk_notebook_set_current_page(GTK_NOTEBOOK(plug->main_notebook), 
-									plug->webview_tab);
+	DevhelpPluginPrivate *priv = dhplug->priv;
+	GError *error = NULL;
+	BookLoader *loader;
+	
+	if (priv->reloader != NULL) {
+		priv->reload_pending = TRUE;
+		return;
+	}
+	
+	/* parsing on the main thread would freeze the UI, wait for a restart */
+	if (!g_thread_supported())
+		return;
+	
+	loader = g_new0(BookLoader, 1);
+	loader->dhplug = dhplug;
+	loader->index_daemon = priv->index_connected;
+	if (plugin_get_config_dir() != NULL)
+		loader->snapshot_path = g_build_filename(plugin_get_config_dir(),
+												 DHPLUG_SNAPSHOT_FILE, NULL);
+	
+	if (g_thread_create(reload_books_thread, loader, FALSE, &error) == NULL) {
+		g_warning(_("Unable to start book loading thread: %s"), error->message);
+		g_error_free(error);
+		g_free(loader->snapshot_path);
+		g_free(loader);
+		return;
+	}
+	
+	priv->reloader = loader;
 }
 
+/* Called by the book monitor once books were installed, upgraded or removed */
+static void on_books_changed(gpointer user_data)
+{
+	devhelp_plugin_reload_books(user_data);
+}
 
 /**
  * devhelp_plugin_new:
@@ -167,14 +1343,21 @@ static void on_link_clicked(GObject *ignored, DhLink *link, gpointer user_data)
  * and must be freed with the devhelp_plugin_destroy() function.  This function
  * gets called from Geany's plugin_init() function.
  * 
+ * With index_daemon set the search panel searches the keywords through the
+ * index daemon, started by the first Geany that needs it.  Tag lookups
+ * still use each window's index, mapped from the one the daemon saves.
+ * It can't be changed later since the books start loading here.
+ * 
  * @return A newly allocated DevhelpPlugin struct or null on error.
  */
-DevhelpPlugin *devhelp_plugin_new(gboolean sb_tabs_bottom, gboolean show_in_msgwin)
+DevhelpPlugin *devhelp_plugin_new(gboolean sb_tabs_bottom, gboolean show_in_msgwin,
+								  gboolean index_daemon)
 {
-	gchar *homepage_uri;
-	GtkWidget *book_tree_sw, *webview_sw, *contents_label;
-	GtkWidget *search_label, *dh_sidebar_label, *doc_label;
+	GtkWidget *contents_label, *search_label, *dh_sidebar_label;
+	gchar *home_uri;
 	DevhelpPlugin *dhplug;
+	gint64 start = stats_begin(), widgets_start, notebook_start;
+	guint i;
 
 	dhplug = g_object_new(DEVHELP_TYPE_PLUGIN, NULL);
 	
@@ -183,80 +1366,51 @@ DevhelpPlugin *devhelp_plugin_new(gboolean sb_tabs_bottom, gboolean show_in_msgw
 		return NULL;
 	}
 	
-#ifdef HAVE_BOOK_MANAGER /* for newer api */
-	DhBookManager *book_manager;
-#else
-	GNode *books;
-	GList *keywords;
-#endif
-	
-	if (dhbase == NULL)
-		dhbase = dh_base_new();	
-		
-#ifdef HAVE_BOOK_MANAGER /* for newer api */
-	book_manager = dh_base_get_book_manager(dhbase);
-	dhplug->book_tree = dh_book_tree_new(book_manager);
-	dhplug->search = dh_search_new(book_manager);
-#else	
-	books = dh_base_get_book_tree(dhbase);
-	keywords = dh_base_get_keywords(dhbase);
-	dhplug->book_tree = dh_book_tree_new(books);
-	dhplug->search = dh_search_new(keywords);
-#endif
-
 	dhplug->in_message_window = show_in_msgwin;
+	dhplug->priv->index_daemon = index_daemon;
 	
 	/* create/grab notebooks */
+	widgets_start = stats_begin();
 	dhplug->sb_notebook = gtk_notebook_new();
 	dhplug->doc_notebook = geany->main_widgets->notebook;
 	
 	if (dhplug->in_message_window)
 		dhplug->main_notebook = geany->main_widgets->message_window_notebook;
-	else
-		dhplug->main_notebook = main_notebook_get();
+	else {
+		notebook_start = stats_begin();
+		dhplug->main_notebook = main_notebook_acquire();
+		stats_end(STATS_MAIN_NOTEBOOK, notebook_start);
+	}
 	
 	/* editor menu items */
 	dhplug->editor_menu_sep = gtk_separator_menu_item_new();
 	dhplug->editor_menu_item = gtk_menu_item_new_with_label(
 									_("Search Documentation for Tag"));
+	dhplug->editor_open_menu_item = gtk_menu_item_new_with_label(
+									_("Open Documentation for Tag"));
 	   
 	/* tab labels */
 	contents_label = gtk_label_new(_("Contents"));
 	search_label = gtk_label_new(_("Search"));
 	dh_sidebar_label = gtk_label_new(_("Devhelp"));
-	doc_label = gtk_label_new(_("Documentation"));	
 	
 	dhplug->orig_sb_tab_pos = gtk_notebook_get_tab_pos(GTK_NOTEBOOK(
 									geany->main_widgets->sidebar_notebook));
 	devhelp_plugin_sidebar_tabs_bottom(dhplug, sb_tabs_bottom);
 
-	/* sidebar contents/book tree */
-	book_tree_sw = gtk_scrolled_window_new(NULL, NULL);
-	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(book_tree_sw),
-		GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
-	gtk_container_set_border_width(GTK_CONTAINER(book_tree_sw), 6);
-	gtk_container_add(GTK_CONTAINER(book_tree_sw), dhplug->book_tree); 
-	gtk_widget_show(dhplug->book_tree);
-	
-	/* sidebar search */
-	gtk_widget_show(dhplug->search);
-	
-	/* webview to display documentation */
-	dhplug->webview = webkit_web_view_new();
-	webview_sw = gtk_scrolled_window_new(NULL, NULL);
-	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(webview_sw),
-		GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
-	/*gtk_container_set_border_width(GTK_CONTAINER(webview_sw), 6);*/
-	gtk_scrolled_window_set_shadow_type(GTK_SCROLLED_WINDOW(webview_sw), 
-		GTK_SHADOW_ETCHED_IN);
-	gtk_container_add(GTK_CONTAINER(webview_sw), dhplug->webview);
-	gtk_widget_show_all(webview_sw);
+	/* sidebar contents/search, filled in once the books are loaded */
+	dhplug->contents_box = gtk_vbox_new(FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(dhplug->contents_box), loading_label_new(),
+		TRUE, TRUE, 0);
+	dhplug->search_box = gtk_vbox_new(FALSE, 0);
+	gtk_box_pack_start(GTK_BOX(dhplug->search_box), loading_label_new(),
+		TRUE, TRUE, 0);
 	
 	/* setup the sidebar notebook */
 	gtk_notebook_append_page(GTK_NOTEBOOK(dhplug->sb_notebook),
-		book_tree_sw, contents_label);
+		dhplug->contents_box, contents_label);
 	gtk_notebook_append_page(GTK_NOTEBOOK(dhplug->sb_notebook),
-		dhplug->search, search_label);
+		dhplug->search_box, search_label);
 	gtk_notebook_set_current_page(GTK_NOTEBOOK(dhplug->sb_notebook), 0);
 		
 	gtk_widget_show_all(dhplug->sb_notebook);
@@ -267,11 +1421,10 @@ DevhelpPlugin *devhelp_plugin_new(gboolean sb_tabs_bottom, gboolean show_in_msgw
 		GTK_NOTEBOOK(geany->main_widgets->sidebar_notebook),
 		dhplug->sb_notebook);
 
-	/* put the webview stuff into the main notebook */
-	gtk_notebook_append_page(GTK_NOTEBOOK(dhplug->main_notebook),
-		webview_sw, doc_label);
-	dhplug->webview_tab = gtk_notebook_page_num(
-							GTK_NOTEBOOK(dhplug->main_notebook), webview_sw);
+	/* documentation tabs go in the main notebook once they're needed */
+	home_uri = g_filename_to_uri(DHPLUG_WEBVIEW_HOME_FILE, NULL, NULL);
+	dhplug->doc_tabs = doc_tabs_new(dhplug->main_notebook, home_uri);
+	g_free(home_uri);
 	
 	/* add menu item to editor popup menu */
 	/* todo: make this an image menu item with devhelp icon */
@@ -279,8 +1432,12 @@ DevhelpPlugin *devhelp_plugin_new(gboolean sb_tabs_bottom, gboolean show_in_msgw
 		dhplug->editor_menu_sep);
 	gtk_menu_shell_append(GTK_MENU_SHELL(geany->main_widgets->editor_menu),
 		dhplug->editor_menu_item);
+	gtk_menu_shell_append(GTK_MENU_SHELL(geany->main_widgets->editor_menu),
+		dhplug->editor_open_menu_item);
 	gtk_widget_show(dhplug->editor_menu_sep);
 	gtk_widget_show(dhplug->editor_menu_item);
+	gtk_widget_show(dhplug->editor_open_menu_item);
+	stats_end(STATS_WIDGETS, widgets_start);
 
 	/* connect signals */
 	g_signal_connect(
@@ -294,18 +1451,32 @@ DevhelpPlugin *devhelp_plugin_new(gboolean sb_tabs_bottom, gboolean show_in_msgw
 			"activate",
 			G_CALLBACK(on_search_help_activate), 
 			dhplug);
-										
+	
 	g_signal_connect(
-			dhplug->book_tree, 
-			"link-selected", 
-			G_CALLBACK(on_link_clicked), 
+			dhplug->editor_open_menu_item, 
+			"activate",
+			G_CALLBACK(on_open_help_activate), 
 			dhplug);
-										
-	g_signal_connect(
-			dhplug->search, 
-			"link-selected",
-			G_CALLBACK(on_link_clicked), 
-			dhplug);	
+	
+	plugin_signal_connect(geany_plugin, NULL, "editor-notify", FALSE,
+			G_CALLBACK(on_editor_notify), dhplug);
+	plugin_signal_connect(geany_plugin, NULL, "document-activate", FALSE,
+			G_CALLBACK(on_document_activate), dhplug);
+	plugin_signal_connect(geany_plugin, NULL, "document-open", FALSE,
+			G_CALLBACK(on_document_tags_changed), dhplug);
+	plugin_signal_connect(geany_plugin, NULL, "document-save", FALSE,
+			G_CALLBACK(on_document_tags_changed), dhplug);
+	plugin_signal_connect(geany_plugin, NULL, "document-filetype-set", FALSE,
+			G_CALLBACK(on_document_filetype_set), dhplug);
+	plugin_signal_connect(geany_plugin, NULL, "document-close", FALSE,
+			G_CALLBACK(on_document_close), dhplug);
+	
+	/* symbols of the documents that are already open */
+	foreach_document(i) {
+		devhelp_plugin_update_symbols(dhplug, documents[i]);
+		devhelp_plugin_attach_tooltip(dhplug, documents[i]);
+	}
+	devhelp_plugin_update_global_symbols(dhplug);
 
 	/* toggle state tracking */
 	dhplug->last_main_tab_id = gtk_notebook_get_current_page(
@@ -314,17 +1485,288 @@ DevhelpPlugin *devhelp_plugin_new(gboolean sb_tabs_bottom, gboolean show_in_msgw
 									geany->main_widgets->sidebar_notebook));
 	dhplug->tabs_toggled = FALSE;
 	
-	/* load the default homepage for the webview */
-	homepage_uri = g_filename_to_uri(DHPLUG_WEBVIEW_HOME_FILE, NULL, NULL);
-	if (homepage_uri) {
-		webkit_web_view_load_uri(WEBKIT_WEB_VIEW(dhplug->webview), 
-								 homepage_uri);
-		g_free(homepage_uri);
-	}
+	devhelp_plugin_load_books(dhplug);
+	
+	stats_end(STATS_PLUGIN_NEW, start);
 	
 	return dhplug;
 }
 
+/**
+ * devhelp_plugin_get_webview:
+ * @param dhplug	The current DevhelpPlugin struct.
+ * 
+ * Gets the webview of the current documentation tab, opening the tab if
+ * there isn't one or bringing it back if it was suspended.
+ * 
+ * @return The WebKitWebView, owned by the plugin.
+ */
+GtkWidget *devhelp_plugin_get_webview(DevhelpPlugin *dhplug)
+{
+	return doc_tabs_get_view(dhplug->doc_tabs);
+}
+
+/**
+ * devhelp_plugin_set_webview_idle_timeout:
+ * @param dhplug	The current DevhelpPlugin struct.
+ * @param seconds	How long the documentation tabs can go unused before their
+ * 					webviews are destroyed to free their memory, 0 to never
+ * 					destroy them.
+ */
+void devhelp_plugin_set_webview_idle_timeout(DevhelpPlugin *dhplug, guint seconds)
+{
+	doc_tabs_set_idle_timeout(dhplug->doc_tabs, seconds);
+}
+
+/**
+ * devhelp_plugin_set_webview_limits:
+ * @param dhplug		The current DevhelpPlugin struct.
+ * @param max_views		How many documentation tabs can have a live webview.
+ * @param max_memory_mb	How many megabytes the webviews can use before the
+ * 						least recently used tab is suspended, 0 for no limit.
+ */
+void devhelp_plugin_set_webview_limits(DevhelpPlugin *dhplug, guint max_views,
+									   guint max_memory_mb)
+{
+	doc_tabs_set_limits(dhplug->doc_tabs, max_views, max_memory_mb);
+}
+
+/**
+ * devhelp_plugin_set_fulltext:
+ * @param dhplug	The current DevhelpPlugin struct.
+ * @param enabled	Whether to index the text of the documentation pages so
+ * 					the Search tab can search it.
+ * 
+ * Indexing happens in the background once the books are loaded, books
+ * indexed before are loaded from the cache in the config directory.
+ */
+void devhelp_plugin_set_fulltext(DevhelpPlugin *dhplug, gboolean enabled)
+{
+	DevhelpPluginPrivate *priv = dhplug->priv;
+	
+	priv->fulltext = enabled;
+	
+	if (enabled) {
+		devhelp_plugin_start_fulltext(dhplug);
+		return;
+	}
+	
+	if (priv->fulltext_loader != NULL) {
+		priv->fulltext_loader->dhplug = NULL;
+		g_cancellable_cancel(priv->fulltext_loader->cancellable);
+		priv->fulltext_loader = NULL;
+	}
+	if (dhplug->search != NULL)
+		devhelp_search_panel_set_fulltext(DEVHELP_SEARCH_PANEL(dhplug->search), NULL);
+	fulltext_index_unref(fulltext_index);
+	fulltext_index = NULL;
+}
+
+/**
+ * devhelp_plugin_set_hover_tooltips:
+ * @param dhplug	The current DevhelpPlugin struct.
+ * @param enabled	Whether hovering over a documented symbol shows its
+ * 					signature and summary.
+ * 
+ * The summaries are extracted from the pages in the background once the
+ * books are loaded and cached in the config directory.
+ */
+void devhelp_plugin_set_hover_tooltips(DevhelpPlugin *dhplug, gboolean enabled)
+{
+	dhplug->priv->hover_tooltips = enabled;
+	
+	if (enabled)
+		devhelp_plugin_start_summaries(dhplug);
+	else
+		devhelp_plugin_drop_summaries(dhplug);
+}
+
+/**
+ * devhelp_plugin_set_filetype_books:
+ * @param dhplug	The current DevhelpPlugin struct.
+ * @param filetype	Name of a Geany filetype, eg. "Python".
+ * @param books		NULL terminated names of the books symbols in documents
+ * 					of that filetype are looked up in, glob patterns work
+ * 					too.  NULL to look in every book.
+ * 
+ * Each distinct set of books gets an index of its own, built the first
+ * time a document of one of its filetypes looks something up.
+ */
+void devhelp_plugin_set_filetype_books(DevhelpPlugin *dhplug,
+									   const gchar *filetype,
+									   const gchar * const *books)
+{
+	DevhelpPluginPrivate *priv = dhplug->priv;
+	
+	book_sets_set_filetype(priv->book_sets, filetype, books);
+	
+	/* the tag may be documented by other books now */
+	devhelp_plugin_invalidate_tag(dhplug);
+	g_free(priv->prefetch_tag);
+	g_free(priv->prefetch_uri);
+	priv->prefetch_tag = NULL;
+	priv->prefetch_uri = NULL;
+}
+
+/**
+ * devhelp_plugin_set_prefetch:
+ * @param dhplug	The current DevhelpPlugin struct.
+ * @param enabled	Whether to preload documentation for the symbol under the
+ * 					cursor.
+ * @param delay		How long in milliseconds the cursor has to rest before
+ * 					that happens.
+ */
+void devhelp_plugin_set_prefetch(DevhelpPlugin *dhplug, gboolean enabled,
+								 guint delay)
+{
+	DevhelpPluginPrivate *priv = dhplug->priv;
+	
+	priv->prefetch = enabled;
+	priv->prefetch_delay = delay > 0 ? delay : DHPLUG_DEFAULT_PREFETCH_DELAY;
+	
+	if (!enabled) {
+		if (priv->prefetch_id != 0) {
+			g_source_remove(priv->prefetch_id);
+			priv->prefetch_id = 0;
+		}
+		if (priv->prefetch_window != NULL) {
+			gtk_widget_destroy(priv->prefetch_window);
+			priv->prefetch_window = NULL;
+			priv->prefetch_view = NULL;
+		}
+	}
+}
+
+/**
+ * devhelp_plugin_open_prefetched:
+ * @param dhplug	The current DevhelpPlugin struct.
+ * @param tag		The symbol the user asked for.
+ * 
+ * Shows the page that was preloaded for tag, if it was.
+ * 
+ * @return TRUE if tag had been prefetched and its page is now shown.
+ */
+gboolean devhelp_plugin_open_prefetched(DevhelpPlugin *dhplug, const gchar *tag)
+{
+	DevhelpPluginPrivate *priv = dhplug->priv;
+	
+	if (priv->prefetch_uri == NULL || g_strcmp0(tag, priv->prefetch_tag) != 0)
+		return FALSE;
+	
+	devhelp_plugin_open_uri(dhplug, priv->prefetch_uri);
+	
+	return TRUE;
+}
+
+/* Opens the page of the keyword a chooser menu item stands for */
+static void on_symbol_chooser_activate(GtkMenuItem *item, gpointer user_data)
+{
+	const gchar *uri = g_object_get_data(G_OBJECT(item), "uri");
+	
+	if (uri != NULL)
+		devhelp_plugin_open_uri(user_data, uri);
+}
+
+/* Pops up a menu listing each book that documents one of refs */
+static void show_symbol_chooser(DevhelpPlugin *dhplug, GArray *refs)
+{
+	GtkWidget *menu = gtk_menu_new();
+	guint i;
+	
+	for (i = 0; i < refs->len; i++) {
+		const IndexRef *ref = &g_array_index(refs, IndexRef, i);
+		const BookIndex *book = g_ptr_array_index(book_indexes, ref->book);
+		gchar *label = g_strdup_printf("%s (%s)",
+							book_index_keyword_name(book, ref->keyword),
+							book_index_str(book, book->title));
+		GtkWidget *item = gtk_menu_item_new_with_label(label);
+		
+		g_free(label);
+		g_object_set_data_full(G_OBJECT(item), "uri",
+							   book_index_get_uri(book, ref->keyword),
+							   g_free);
+		g_signal_connect(item, "activate",
+						 G_CALLBACK(on_symbol_chooser_activate), dhplug);
+		gtk_menu_shell_append(GTK_MENU_SHELL(menu), item);
+	}
+	
+	g_signal_connect(menu, "selection-done", G_CALLBACK(gtk_widget_destroy), NULL);
+	gtk_widget_show_all(menu);
+	gtk_menu_popup(GTK_MENU(menu), NULL, NULL, NULL, NULL, 0,
+				   gtk_get_current_event_time());
+}
+
+/**
+ * devhelp_plugin_open_symbol:
+ * @param dhplug	The current DevhelpPlugin struct.
+ * @param tag		The symbol to show documentation for.
+ * 
+ * Jumps straight to the documentation of tag.  The keyword is found with a
+ * single probe of the symbol table (or the index daemon), or of the books
+ * of the current document's filetype if it has a book set; if more than
+ * one book documents it a menu lets the user pick.  If nothing documents it
+ * (or the books aren't loaded yet) this falls back to searching for it in
+ * the Search tab.
+ */
+void devhelp_plugin_open_symbol(DevhelpPlugin *dhplug, const gchar *tag)
+{
+	GArray *refs = g_array_new(FALSE, FALSE, sizeof(IndexRef));
+	guint n_exact;
+	
+	if (!devhelp_plugin_lookup_tag(dhplug, document_get_current(), tag, refs,
+								   &n_exact) || refs->len == 0) {
+		devhelp_plugin_search(dhplug, tag);
+		if (!dhplug->tabs_toggled)
+			devhelp_plugin_activate_tabs(dhplug, FALSE);
+	}
+	else if (n_exact > 1)
+		show_symbol_chooser(dhplug, refs);
+	else {
+		const IndexRef *ref = &g_array_index(refs, IndexRef, 0);
+		gchar *uri = book_index_get_uri(g_ptr_array_index(book_indexes,
+														  ref->book),
+										ref->keyword);
+		if (uri != NULL)
+			devhelp_plugin_open_uri(dhplug, uri);
+		g_free(uri);
+	}
+	
+	g_array_free(refs, TRUE);
+}
+
+/**
+ * devhelp_plugin_search:
+ * @param dhplug	The current DevhelpPlugin struct.
+ * @param text		The text to put in the search tab.
+ * 
+ * Sets the search string of the sidebar search tab.  If the books are still
+ * loading the search is remembered and run once they are ready.
+ */
+void devhelp_plugin_search(DevhelpPlugin *dhplug, const gchar *text)
+{
+	if (dhplug->search == NULL) {
+		g_free(dhplug->priv->pending_search);
+		dhplug->priv->pending_search = g_strdup(text);
+		return;
+	}
+	
+	devhelp_search_panel_set_search_string(DEVHELP_SEARCH_PANEL(dhplug->search),
+										   text);
+}
+
+/**
+ * devhelp_plugin_open_uri:
+ * @param dhplug	The current DevhelpPlugin struct.
+ * @param uri		The documentation page to show.
+ * 
+ * Shows uri in the current documentation tab, or the tab already showing
+ * it, and switches to that tab.
+ */
+void devhelp_plugin_open_uri(DevhelpPlugin *dhplug, const gchar *uri)
+{
+	doc_tabs_open(dhplug->doc_tabs, uri, FALSE);
+}
+
 /** 
  * devhelp_plugin_clean_word:
  * @param	str	String to clean
@@ -338,13 +1780,15 @@ DevhelpPlugin *devhelp_plugin_new(gboolean sb_tabs_bottom, gboolean show_in_msgw
  */
 gchar *devhelp_plugin_clean_word(gchar *str)
 {
-	return g_strstrip(g_strcanon(str, GEANY_WORDCHARS, ' '));
+	return tag_util_clean(str, GEANY_WORDCHARS);
 }
 
 /**
  * devhelp_plugin_get_current_tag:
  * 
  * Gets either the current selection or the word at the current selection.
+ * Selections longer than TAG_UTIL_MAX_LENGTH can't be a tag and are
+ * ignored without copying them.
  * 
  * @return Newly allocated string with current tag or NULL no tag.
  */
@@ -354,21 +1798,22 @@ gchar *devhelp_plugin_get_current_tag(void)
 	gchar *tag = NULL;
 	GeanyDocument *doc = document_get_current();
 	
-	if (sci_has_selection(doc->editor->sci))
-		return devhelp_plugin_clean_word(sci_get_selection_contents(doc->editor->sci));
-	
-	pos = sci_get_current_position(doc->editor->sci);
-	tag = editor_get_word_at_pos(doc->editor, pos, GEANY_WORDCHARS);
-	
-	if (tag == NULL) 
+	if (doc == NULL)
 		return NULL;
 	
-	if (tag[0] == '\0') {
-		g_free(tag);
-		return NULL;
+	if (sci_has_selection(doc->editor->sci)) {
+		gint length = sci_get_selection_end(doc->editor->sci) -
+					  sci_get_selection_start(doc->editor->sci);
+		if (length > TAG_UTIL_MAX_LENGTH)
+			return NULL;
+		return tag_util_take(sci_get_selection_contents(doc->editor->sci),
+							 GEANY_WORDCHARS);
 	}
 	
-	return devhelp_plugin_clean_word(tag);
+	pos = sci_get_current_position(doc->editor->sci);
+	tag = editor_get_word_at_pos(doc->editor, pos, GEANY_WORDCHARS);
+	
+	return tag_util_take(tag, GEANY_WORDCHARS);
 }
 
 
@@ -395,8 +1840,7 @@ void devhelp_plugin_activate_tabs(DevhelpPlugin *dhplug, gboolean contents)
 		gtk_notebook_set_current_page(GTK_NOTEBOOK(
 										geany->main_widgets->sidebar_notebook), 
 			dhplug->sb_notebook_tab);
-		gtk_notebook_set_current_page(
-			GTK_NOTEBOOK(dhplug->main_notebook), dhplug->webview_tab);
+		doc_tabs_present(dhplug->doc_tabs);
 		if (contents)
 			gtk_notebook_set_current_page(GTK_NOTEBOOK(dhplug->sb_notebook), 0);
 		else
@@ -413,6 +1857,50 @@ void devhelp_plugin_activate_tabs(DevhelpPlugin *dhplug, gboolean contents)
 	}
 }
 
+/**
+ * devhelp_plugin_set_in_message_window:
+ * @param dhplug	The current DevhelpPlugin struct.
+ * @param in_msgwin	Whether the documentation goes in the message window.
+ * 
+ * Moves the documentation tabs between the main notebook and the message
+ * window.  The webviews are moved as they are, so their pages, history
+ * and scroll positions are kept.  The main notebook is released once
+ * nothing is left in it, and only removed if no other plugin uses it.
+ */
+void devhelp_plugin_set_in_message_window(DevhelpPlugin *dhplug,
+										  gboolean in_msgwin)
+{
+	GtkWidget *notebook;
+	
+	g_return_if_fail(dhplug != NULL);
+	
+	if (dhplug->in_message_window == in_msgwin)
+		return;
+	
+	if (in_msgwin)
+		notebook = geany->main_widgets->message_window_notebook;
+	else
+	{
+		gint64 notebook_start = stats_begin();
+		
+		notebook = main_notebook_acquire();
+		stats_end(STATS_MAIN_NOTEBOOK, notebook_start);
+		if (notebook == NULL)
+			return;
+	}
+	
+	doc_tabs_move(dhplug->doc_tabs, notebook);
+	
+	if (in_msgwin)
+		main_notebook_release();
+	
+	dhplug->main_notebook = notebook;
+	dhplug->in_message_window = in_msgwin;
+	
+	/* the tab to toggle back to was in the other notebook */
+	dhplug->tabs_toggled = FALSE;
+}
+
 /**
  * devhelp_plugin_sidebar_tabs_bottom:
  * @param dhplug	The current DevhelpPlugin struct.
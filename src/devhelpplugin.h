@@ -53,16 +53,20 @@ struct _DevhelpPlugin
 {
 	GObject parent;
 
-	GtkWidget *book_tree;			/// "Contents" in the sidebar
-	GtkWidget *search;				/// "Search" in the sidebar
+	GtkWidget *book_tree;			/// "Contents" in the sidebar, NULL until
+									/// the books are loaded
+	GtkWidget *search;				/// "Search" in the sidebar, NULL until
+									/// the books are loaded
+	GtkWidget *contents_box;		/// Sidebar page that holds book_tree
+	GtkWidget *search_box;			/// Sidebar page that holds search
 	GtkWidget *sb_notebook;			/// Notebook that holds contents/search
 	gint sb_notebook_tab;			/// Index of tab where devhelp sidebar is
-	GtkWidget *webview;				/// Webkit that shows documentation
-	gint webview_tab;				/// Index of tab that contains the webview
+	struct _DocTabs *doc_tabs;		/// Documentation tabs in main_notebook
 	GtkWidget *main_notebook;		/// Notebook that holds Geany doc notebook and
 									/// and webkit view
 	GtkWidget *doc_notebook;		/// Geany's document notebook  
 	GtkWidget *editor_menu_item;	/// Item in the editor's context menu 
+	GtkWidget *editor_open_menu_item;	/// "Open Documentation" item
 	GtkWidget *editor_menu_sep;		/// Separator item above menu item
 	gboolean *webview_active;		/// Tracks whether webview stuff is shown
 	
@@ -86,12 +90,30 @@ struct _DevhelpPluginClass
 
 
 GType devhelp_plugin_get_type (void);
-DevhelpPlugin* devhelp_plugin_new (gboolean sb_tabs_bottom, gboolean show_in_msgwin);
+DevhelpPlugin* devhelp_plugin_new (gboolean sb_tabs_bottom, gboolean show_in_msgwin,
+								   gboolean index_daemon);
 
 gchar *devhelp_plugin_clean_word(gchar *str);
 gchar *devhelp_plugin_get_current_tag(void);
+void devhelp_plugin_search(DevhelpPlugin *dhplug, const gchar *text);
+void devhelp_plugin_open_uri(DevhelpPlugin *dhplug, const gchar *uri);
+void devhelp_plugin_set_fulltext(DevhelpPlugin *dhplug, gboolean enabled);
+void devhelp_plugin_set_hover_tooltips(DevhelpPlugin *dhplug, gboolean enabled);
+void devhelp_plugin_set_filetype_books(DevhelpPlugin *dhplug,
+									   const gchar *filetype,
+									   const gchar * const *books);
+void devhelp_plugin_set_prefetch(DevhelpPlugin *dhplug, gboolean enabled,
+								 guint delay);
+gboolean devhelp_plugin_open_prefetched(DevhelpPlugin *dhplug, const gchar *tag);
+void devhelp_plugin_open_symbol(DevhelpPlugin *dhplug, const gchar *tag);
+GtkWidget *devhelp_plugin_get_webview(DevhelpPlugin *dhplug);
+void devhelp_plugin_set_webview_idle_timeout(DevhelpPlugin *dhplug, guint seconds);
+void devhelp_plugin_set_webview_limits(DevhelpPlugin *dhplug, guint max_views,
+									   guint max_memory_mb);
 void devhelp_plugin_activate_tabs(DevhelpPlugin *dhplug, gboolean contents);
 void devhelp_plugin_sidebar_tabs_bottom(DevhelpPlugin *dhplug, gboolean bottom);
+void devhelp_plugin_set_in_message_window(DevhelpPlugin *dhplug,
+										  gboolean in_msgwin);
 
 G_END_DECLS
 
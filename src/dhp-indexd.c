@@ -0,0 +1,540 @@
+/*
+ * dhp-indexd.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+
+/*
+ * The index daemon.  With "index_daemon" on, the first Geany of a user
+ * starts this and every Geany of that user asks it for keyword searches
+ * over a Unix socket, see index-protocol.h.  The books, and the SearchIndex
+ * this saves next to them, are still mapped by each Geany for its symbol
+ * lookups, which run on its main loop; the page cache already shares them.
+ *
+ * It watches the books like the plugin does and loads them again when
+ * they change.  Once no Geany has been connected for --idle-timeout
+ * seconds it exits, the next Geany starts it again.
+ */
+
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
+
+#include "book-index.h"
+#include "book-monitor.h"
+#include "doc-provider.h"
+#include "fuzzy-match.h"
+#include "index-protocol.h"
+#include "search-index.h"
+#include "symbol-table.h"
+
+/* a page is 200 results, nobody asks for this many at once */
+#define INDEXD_MAX_RESULTS		10000
+
+#define INDEXD_IDLE_CHECK_S		30
+
+/* what lookups made before the books are loaded are told */
+#define INDEXD_NOT_READY		"The books are still being loaded"
+
+static gchar *socket_path = NULL;
+static gchar *snapshot_path = NULL;
+static gint idle_timeout = 600;
+
+static GOptionEntry entries[] = {
+	{ "socket", 's', 0, G_OPTION_ARG_FILENAME, &socket_path,
+	  "Socket to listen on (default in the user's runtime directory)", "PATH" },
+	{ "snapshot", 'n', 0, G_OPTION_ARG_FILENAME, &snapshot_path,
+	  "Keyword snapshot to load the books from and keep up to date", "PATH" },
+	{ "idle-timeout", 't', 0, G_OPTION_ARG_INT, &idle_timeout,
+	  "Seconds without a client before exiting (default 600, 0 = never)", "S" },
+	{ NULL }
+};
+
+/* The index every connection searches, swapped when the books change */
+static GStaticMutex index_lock = G_STATIC_MUTEX_INIT;
+static GCond *index_cond = NULL;		/* signalled when it's first set */
+static SearchIndex *current_index = NULL;
+static guint32 generation = 0;			/* bumped with every index */
+
+static volatile gint n_clients = 0;
+static gint64 last_active = 0;			/* monotonic, under index_lock */
+
+static GMainLoop *loop = NULL;
+static BookMonitor *monitor = NULL;
+static gboolean loading = FALSE;		/* a loading thread is running */
+static gboolean load_pending = FALSE;	/* books changed while it was */
+
+/*
+ * Gets the current index, waiting for the first one to be loaded if wait
+ * is set, or NULL if it isn't loaded yet and wait isn't
+ */
+static SearchIndex *get_index(gboolean wait, guint32 *out_generation)
+{
+	SearchIndex *current = NULL;
+
+	g_static_mutex_lock(&index_lock);
+	while (wait && current_index == NULL)
+		g_cond_wait(index_cond, g_static_mutex_get_mutex(&index_lock));
+	if (current_index != NULL)
+		current = search_index_ref(current_index);
+	*out_generation = generation;
+	g_static_mutex_unlock(&index_lock);
+
+	return current;
+}
+
+static void send_books(GOutputStream *output, GByteArray *out,
+					   SearchIndex *current, guint32 current_generation,
+					   GError **error)
+{
+	guint i;
+
+	index_msg_init(out, INDEX_MSG_BOOKS);
+	index_msg_put_u32(out, current_generation);
+	index_msg_put_u32(out, current->books->len);
+	for (i = 0; i < current->books->len; i++)
+	{
+		const BookIndex *book = g_ptr_array_index(current->books, i);
+
+		index_msg_put_i64(out, book->mtime);
+		index_msg_put_str(out, book->path);
+	}
+	index_msg_send(output, out, NULL, error);
+}
+
+/* Sends the keywords of entries, a batch per message */
+static gboolean send_entries(GOutputStream *output, GByteArray *out,
+							 SearchIndex *current, const guint *entries,
+							 guint n_entries, GError **error)
+{
+	guint i, j;
+
+	for (i = 0; i < n_entries; i += INDEX_PROTOCOL_BATCH)
+	{
+		guint n = MIN(n_entries - i, INDEX_PROTOCOL_BATCH);
+
+		index_msg_init(out, INDEX_MSG_RESULTS);
+		index_msg_put_u32(out, n);
+		for (j = i; j < i + n; j++)
+		{
+			const SearchIndexEntry *entry = &current->entries[entries[j]];
+
+			index_msg_put_u32(out, entry->book);
+			index_msg_put_u32(out, entry->keyword);
+		}
+		if (!index_msg_send(output, out, NULL, error))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static gboolean send_end(GOutputStream *output, GByteArray *out,
+						 gboolean has_more, const IndexResume *resume,
+						 guint n_exact, GError **error)
+{
+	index_msg_init(out, INDEX_MSG_END);
+	index_msg_put_u8(out, has_more);
+	index_msg_put_u32(out, resume->next_entry);
+	index_msg_put_u32(out, resume->last_entry);
+	index_msg_put_u32(out, (guint32) resume->last_score);
+	index_msg_put_u32(out, n_exact);
+	return index_msg_send(output, out, NULL, error);
+}
+
+static gboolean send_error(GOutputStream *output, GByteArray *out,
+						   const gchar *message, GError **error)
+{
+	index_msg_init(out, INDEX_MSG_ERROR);
+	index_msg_put_str(out, message);
+	return index_msg_send(output, out, NULL, error);
+}
+
+/* Runs a page of a search the same way the Search tab does locally */
+static gboolean run_search(GOutputStream *output, GByteArray *out,
+						   SearchIndex *current, IndexMsg *msg, GError **error)
+{
+	IndexResume resume;
+	guint8 mode, resuming;
+	guint32 max, score;
+	gboolean has_more = FALSE, ok;
+	guint *entries, n_entries = 0, i, start, end;
+	gchar *query;
+
+	if (!index_msg_get_u8(msg, &mode) || !index_msg_get_u32(msg, &max) ||
+		!index_msg_get_u8(msg, &resuming) ||
+		!index_msg_get_u32(msg, &resume.next_entry) ||
+		!index_msg_get_u32(msg, &resume.last_entry) ||
+		!index_msg_get_u32(msg, &score) || !index_msg_get_str(msg, &query))
+	{
+		send_error(output, out, "Malformed search", NULL);
+		return FALSE;
+	}
+	resume.last_score = (gint32) score;
+	max = CLAMP(max, 1, INDEXD_MAX_RESULTS);
+	entries = g_new(guint, max);
+
+	if (mode == INDEX_SEARCH_FUZZY)
+	{
+		FuzzyMatch *matches = g_new(FuzzyMatch, max);
+		FuzzyMatch after;
+
+		after.entry = resume.last_entry;
+		after.score = resume.last_score;
+		n_entries = fuzzy_index_search(search_index_get_fuzzy(current), query,
+									   matches, max, resuming ? &after : NULL,
+									   NULL);
+		for (i = 0; i < n_entries; i++)
+			entries[i] = matches[i].entry;
+		if (n_entries > 0)
+		{
+			resume.last_entry = matches[n_entries - 1].entry;
+			resume.last_score = matches[n_entries - 1].score;
+		}
+		has_more = (n_entries == max);
+		g_free(matches);
+	}
+	else if (search_index_prefix_range(current, query, &start, &end))
+	{
+		if (resuming)
+			start = MAX(start, resume.next_entry);
+		for (i = start; i < end && n_entries < max; i++)
+			entries[n_entries++] = i;
+		resume.next_entry = i;
+		has_more = (i < end);
+	}
+
+	ok = send_entries(output, out, current, entries, n_entries, error) &&
+		send_end(output, out, has_more, &resume, 0, error);
+
+	g_free(entries);
+	g_free(query);
+	return ok;
+}
+
+/* Resolves a symbol the same way the plugin's symbol table does */
+static gboolean run_lookup(GOutputStream *output, GByteArray *out,
+						   SearchIndex *current, IndexMsg *msg, GError **error)
+{
+	IndexResume resume = { 0, 0, 0 };
+	SymbolDocs docs;
+	GArray *entries;
+	gchar *name;
+	guint entry;
+	gboolean ok;
+
+	if (!index_msg_get_str(msg, &name))
+	{
+		send_error(output, out, "Malformed lookup", NULL);
+		return FALSE;
+	}
+
+	entries = g_array_new(FALSE, FALSE, sizeof(guint));
+	symbol_table_resolve(current, name, &docs);
+	if (docs.documented)
+	{
+		entry = docs.entry;
+		g_array_append_val(entries, entry);
+		while (entries->len < docs.n_exact &&
+			   search_index_lookup_next(current, &entry))
+			g_array_append_val(entries, entry);
+	}
+
+	ok = send_entries(output, out, current, (const guint *) entries->data,
+					  entries->len, error) &&
+		send_end(output, out, FALSE, &resume, docs.n_exact, error);
+
+	g_array_free(entries, TRUE);
+	g_free(name);
+	return ok;
+}
+
+/* Answers one request, FALSE if the connection should be closed */
+static gboolean handle_request(GOutputStream *output, GByteArray *out,
+							   IndexMsg *msg, GError **error)
+{
+	SearchIndex *current;
+	guint32 client_generation, current_generation;
+	gboolean ok;
+
+	if (msg->type != INDEX_MSG_SEARCH && msg->type != INDEX_MSG_LOOKUP)
+	{
+		send_error(output, out, "Unknown request", NULL);
+		return FALSE;
+	}
+	if (!index_msg_get_u32(msg, &client_generation))
+	{
+		send_error(output, out, "Malformed request", NULL);
+		return FALSE;
+	}
+
+	/* lookups are made while Geany waits, searches on a thread of its own
+	 * can wait for the books to be loaded */
+	current = get_index(msg->type == INDEX_MSG_SEARCH, &current_generation);
+	if (current == NULL)
+		return send_error(output, out, INDEXD_NOT_READY, error);
+
+	if (client_generation != current_generation)
+		send_books(output, out, current, current_generation, NULL);
+
+	if (msg->type == INDEX_MSG_SEARCH)
+		ok = run_search(output, out, current, msg, error);
+	else
+		ok = run_lookup(output, out, current, msg, error);
+
+	search_index_unref(current);
+	return ok;
+}
+
+/* Serves one Geany, on a thread of the service's own */
+static gboolean on_run(GThreadedSocketService *service,
+					   GSocketConnection *connection, GObject *source_object,
+					   gpointer user_data)
+{
+	GInputStream *input;
+	GOutputStream *output;
+	GByteArray *out;
+	IndexMsg msg = { 0, NULL, 0 };
+	GError *error = NULL;
+
+	g_atomic_int_inc(&n_clients);
+
+	input = g_buffered_input_stream_new(
+		g_io_stream_get_input_stream(G_IO_STREAM(connection)));
+	output = g_io_stream_get_output_stream(G_IO_STREAM(connection));
+	out = g_byte_array_new();
+
+	while (index_msg_receive(input, &msg, NULL, &error) &&
+		   handle_request(output, out, &msg, &error))
+		;
+
+	/* Geany going away is how connections normally end */
+	if (error != NULL && !g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CLOSED))
+		g_debug("dhp-indexd: dropped a client: %s", error->message);
+	if (error != NULL)
+		g_error_free(error);
+
+	index_msg_clear(&msg);
+	g_byte_array_unref(out);
+	g_object_unref(input);
+
+	g_static_mutex_lock(&index_lock);
+	last_active = g_get_monotonic_time();
+	g_static_mutex_unlock(&index_lock);
+	g_atomic_int_add(&n_clients, -1);
+
+	return TRUE;
+}
+
+static void start_loading(void);
+
+/* Idle callback run on the main loop once the loading thread is done */
+static gboolean on_loaded(gpointer user_data)
+{
+	loading = FALSE;
+
+	g_static_mutex_lock(&index_lock);
+	book_monitor_watch(monitor, current_index->books);
+	g_static_mutex_unlock(&index_lock);
+
+	if (load_pending)
+	{
+		load_pending = FALSE;
+		start_loading();
+	}
+
+	return FALSE;
+}
+
+/* Loads the books of every provider, from the snapshots where they haven't
+ * changed, and puts an index of them in place of the old one */
+static gpointer load_thread(gpointer user_data)
+{
+	SearchIndex *new_index, *old_index;
+	GPtrArray *books;
+
+	books = doc_provider_load_books(snapshot_path, TRUE, NULL);
+	new_index = doc_provider_index_books(books, snapshot_path, TRUE);
+	g_ptr_array_unref(books);
+
+	/* connections still searching the old one hold their own reference */
+	g_static_mutex_lock(&index_lock);
+	old_index = current_index;
+	current_index = new_index;
+	generation++;
+	g_cond_broadcast(index_cond);
+	g_static_mutex_unlock(&index_lock);
+	search_index_unref(old_index);
+
+	g_idle_add(on_loaded, NULL);
+
+	return NULL;
+}
+
+static void start_loading(void)
+{
+	GError *error = NULL;
+
+	if (loading)
+	{
+		load_pending = TRUE;
+		return;
+	}
+
+	if (g_thread_create(load_thread, NULL, FALSE, &error) == NULL)
+	{
+		g_warning("Unable to start book loading thread: %s", error->message);
+		g_error_free(error);
+		return;
+	}
+	loading = TRUE;
+}
+
+static void on_books_changed(gpointer user_data)
+{
+	start_loading();
+}
+
+static gboolean on_idle_check(gpointer user_data)
+{
+	gint64 idle;
+
+	if (g_atomic_int_get(&n_clients) > 0)
+		return TRUE;
+
+	g_static_mutex_lock(&index_lock);
+	idle = g_get_monotonic_time() - last_active;
+	g_static_mutex_unlock(&index_lock);
+
+	if (idle >= (gint64) idle_timeout * G_USEC_PER_SEC)
+		g_main_loop_quit(loop);
+
+	return TRUE;
+}
+
+/* Whether another daemon is answering on the socket */
+static gboolean socket_is_served(void)
+{
+	GSocketClient *client = g_socket_client_new();
+	GSocketAddress *address = g_unix_socket_address_new(socket_path);
+	GSocketConnection *connection;
+
+	connection = g_socket_client_connect(client, G_SOCKET_CONNECTABLE(address),
+										 NULL, NULL);
+	g_object_unref(address);
+	g_object_unref(client);
+
+	if (connection == NULL)
+		return FALSE;
+	g_object_unref(connection);
+	return TRUE;
+}
+
+static gboolean listen_on_socket(GSocketService *service, GError **error)
+{
+	GSocketAddress *address;
+	gboolean ok;
+
+	address = g_unix_socket_address_new(socket_path);
+	ok = g_socket_listener_add_address(G_SOCKET_LISTENER(service), address,
+		G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_DEFAULT, NULL, NULL, error);
+	g_object_unref(address);
+
+	return ok;
+}
+
+int main(int argc, char **argv)
+{
+	GOptionContext *context;
+	GSocketService *service;
+	GError *error = NULL;
+	gchar *dir;
+
+	context = g_option_context_new("- share one Devhelp keyword index between Geanys");
+	g_option_context_add_main_entries(context, entries, NULL);
+	if (!g_option_context_parse(context, &argc, &argv, &error))
+	{
+		g_printerr("%s\n", error->message);
+		return 1;
+	}
+	g_option_context_free(context);
+
+	g_thread_init(NULL);
+	g_type_init();
+
+	/* outlive the Geany, and its terminal, that started it */
+	setsid();
+
+	if (socket_path == NULL)
+		socket_path = index_protocol_socket_path();
+	dir = g_path_get_dirname(socket_path);
+	g_mkdir_with_parents(dir, 0700);
+	g_free(dir);
+
+	service = g_threaded_socket_service_new(-1);
+	if (!listen_on_socket(service, &error))
+	{
+		/* lost the race to another Geany's daemon, or one died and left
+		 * its socket behind */
+		if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_ADDRESS_IN_USE) ||
+			socket_is_served())
+		{
+			g_debug("dhp-indexd: not listening on '%s': %s", socket_path,
+					error->message);
+			g_error_free(error);
+			g_object_unref(service);
+			return 0;
+		}
+		g_clear_error(&error);
+		g_unlink(socket_path);
+		if (!listen_on_socket(service, &error))
+		{
+			g_printerr("dhp-indexd: unable to listen on '%s': %s\n",
+					   socket_path, error->message);
+			g_error_free(error);
+			g_object_unref(service);
+			return 1;
+		}
+	}
+
+	index_cond = g_cond_new();
+	last_active = g_get_monotonic_time();
+	loop = g_main_loop_new(NULL, FALSE);
+	monitor = book_monitor_new(on_books_changed, NULL);
+
+	/* clients can connect right away, their requests wait for the books */
+	g_signal_connect(service, "run", G_CALLBACK(on_run), NULL);
+	g_socket_service_start(service);
+	start_loading();
+
+	if (idle_timeout > 0)
+		g_timeout_add_seconds(INDEXD_IDLE_CHECK_S, on_idle_check, NULL);
+
+	g_main_loop_run(loop);
+
+	/* nothing new gets through, connections still open just stop being
+	 * answered when the process exits */
+	g_socket_service_stop(service);
+	g_unlink(socket_path);
+
+	return 0;
+}
@@ -0,0 +1,313 @@
+/*
+ * doc-provider.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "book-index.h"
+#include "doc-provider.h"
+#include "index-snapshot.h"
+#include "search-index.h"
+
+/* rendered pages kept, so tabs resumed or reopened don't render again */
+#define DOC_PROVIDER_CACHE_PAGES	16
+
+/* the books libdevhelp knows about, see book-index.c */
+static const DocProvider devhelp_provider = {
+	"devhelp",
+	book_index_get_dirs,
+	book_index_find_files,
+	book_index_parse_file,
+	NULL,
+	NULL
+};
+
+/* uri -> HTML of the last pages rendered, under cache_lock */
+static GStaticMutex cache_lock = G_STATIC_MUTEX_INIT;
+static GHashTable *page_cache = NULL;
+static GQueue cache_order = G_QUEUE_INIT;	/* the uris, newest first */
+
+/* in the order their books come in the array of books */
+static const DocProvider * const providers[] = {
+	&devhelp_provider,
+	&man_provider,
+	&html_provider,
+	NULL
+};
+
+/**
+ * Gets every documentation provider.
+ *
+ * @return	A NULL terminated array owned by the plugin.
+ */
+const DocProvider * const *doc_provider_get_all(void)
+{
+	return providers;
+}
+
+/**
+ * Gets the directories the sources of every provider are found in, for
+ * the book monitor to watch.  Not all of them need exist.
+ *
+ * @return	A newly allocated NULL terminated array of directories, free it
+ * 			with g_strfreev().
+ */
+gchar **doc_provider_get_dirs(void)
+{
+	GPtrArray *dirs = g_ptr_array_new();
+	guint i, j;
+
+	for (i = 0; providers[i] != NULL; i++)
+	{
+		gchar **provider_dirs = providers[i]->get_dirs();
+
+		/* the strings move over, only the array is freed */
+		for (j = 0; provider_dirs[j] != NULL; j++)
+			g_ptr_array_add(dirs, provider_dirs[j]);
+		g_free(provider_dirs);
+	}
+	g_ptr_array_add(dirs, NULL);
+
+	return (gchar **) g_ptr_array_free(dirs, FALSE);
+}
+
+/* The Devhelp snapshot keeps its name, the others are named after it */
+static gchar *provider_snapshot_path(const gchar *snapshot_path,
+									 const DocProvider *provider)
+{
+	if (snapshot_path == NULL)
+		return NULL;
+	if (provider == &devhelp_provider)
+		return g_strdup(snapshot_path);
+	return g_strdup_printf("%s.%s", snapshot_path, provider->name);
+}
+
+/**
+ * Loads the books of every provider, each from its own snapshot where its
+ * sources haven't changed, and writes the snapshots that are out of date
+ * back out.  Only touches files so it can be run from any thread.
+ *
+ * @param snapshot_path	The Devhelp snapshot, the other providers' are
+ * 						named after it.  NULL to parse everything.
+ * @param save			Whether to write out of date snapshots, FALSE when
+ * 						the index daemon keeps them up to date.
+ * @param out_changed	Set to whether any source changed since the
+ * 						snapshots were written, can be NULL.
+ *
+ * @return	A new array of BookIndex, the Devhelp books first.
+ */
+GPtrArray *doc_provider_load_books(const gchar *snapshot_path, gboolean save,
+								   gboolean *out_changed)
+{
+	GPtrArray *books;
+	gboolean changed = FALSE;
+	guint i, j;
+
+	books = g_ptr_array_new_with_free_func((GDestroyNotify) book_index_free);
+
+	for (i = 0; providers[i] != NULL; i++)
+	{
+		const DocProvider *provider = providers[i];
+		gchar *path = provider_snapshot_path(snapshot_path, provider);
+		gchar **files = provider->find_files();
+		GPtrArray *part;
+		gboolean dirty = FALSE;
+
+		part = index_snapshot_load(path, files, provider->parse_file, &dirty);
+		g_strfreev(files);
+
+		if (dirty && save && path != NULL)
+		{
+			GError *error = NULL;
+			if (!index_snapshot_save(path, part, &error))
+			{
+				g_warning("Unable to save keyword snapshot '%s': %s", path,
+						  error->message);
+				g_error_free(error);
+			}
+		}
+		changed = changed || dirty;
+
+		/* the books move over, the part array gives them up */
+		g_ptr_array_set_free_func(part, NULL);
+		for (j = 0; j < part->len; j++)
+			g_ptr_array_add(books, g_ptr_array_index(part, j));
+		g_ptr_array_unref(part);
+		g_free(path);
+	}
+
+	if (out_changed != NULL)
+		*out_changed = changed;
+
+	return books;
+}
+
+/**
+ * Gets the search index of books, mapped from the one saved next to the
+ * snapshots if it was built from the same books, or built and saved there
+ * for the next start.  Only touches files so it can be run from any thread.
+ *
+ * @param books			Books from doc_provider_load_books().
+ * @param snapshot_path	The Devhelp snapshot, the index is named after it.
+ * 						NULL to always build it.
+ * @param save			Whether to save an index that had to be built, like
+ * 						for doc_provider_load_books().
+ *
+ * @return	A new SearchIndex, release it with search_index_unref().
+ */
+SearchIndex *doc_provider_index_books(GPtrArray *books,
+									  const gchar *snapshot_path, gboolean save)
+{
+	SearchIndex *index = NULL;
+	gchar *path = NULL;
+
+	if (snapshot_path != NULL)
+	{
+		path = g_strdup_printf("%s.search", snapshot_path);
+		index = search_index_load(path, books);
+	}
+
+	if (index == NULL)
+	{
+		GError *error = NULL;
+
+		index = search_index_new(books);
+		if (save && path != NULL && !search_index_save(index, path, &error))
+		{
+			g_warning("Unable to save search index '%s': %s", path,
+					  error->message);
+			g_error_free(error);
+		}
+	}
+
+	g_free(path);
+
+	return index;
+}
+
+/**
+ * Finds the provider that renders the page of a URI itself.
+ *
+ * @param uri	A link from a book.
+ *
+ * @return	The provider or NULL if the web view can load the URI.
+ */
+const DocProvider *doc_provider_for_uri(const gchar *uri)
+{
+	guint i;
+
+	for (i = 0; uri != NULL && providers[i] != NULL; i++)
+	{
+		const gchar *scheme = providers[i]->scheme;
+		gsize len;
+
+		if (scheme == NULL)
+			continue;
+		len = strlen(scheme);
+		if (strncmp(uri, scheme, len) == 0 && uri[len] == ':')
+			return providers[i];
+	}
+	return NULL;
+}
+
+/**
+ * Gets a page doc_provider_render_page() rendered recently, without
+ * rendering it again.
+ *
+ * @param uri	The page's URI.
+ *
+ * @return	A newly allocated copy of the page or NULL if it isn't cached.
+ */
+gchar *doc_provider_get_cached_page(const gchar *uri)
+{
+	gchar *html = NULL;
+	GList *link;
+
+	g_static_mutex_lock(&cache_lock);
+	if (page_cache != NULL)
+		html = g_strdup(g_hash_table_lookup(page_cache, uri));
+	if (html != NULL)
+	{
+		/* move it to the front so it's the last to go */
+		link = g_queue_find_custom(&cache_order, uri, (GCompareFunc) strcmp);
+		g_queue_unlink(&cache_order, link);
+		g_queue_push_head_link(&cache_order, link);
+	}
+	g_static_mutex_unlock(&cache_lock);
+
+	return html;
+}
+
+static void cache_page(const gchar *uri, const gchar *html)
+{
+	gchar *key;
+
+	g_static_mutex_lock(&cache_lock);
+	if (page_cache == NULL)
+		page_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+	/* two threads may have rendered the same page */
+	if (g_hash_table_lookup(page_cache, uri) == NULL)
+	{
+		key = g_strdup(uri);
+		g_hash_table_insert(page_cache, key, g_strdup(html));
+		g_queue_push_head(&cache_order, key);
+
+		if (cache_order.length > DOC_PROVIDER_CACHE_PAGES)
+			g_hash_table_remove(page_cache, g_queue_pop_tail(&cache_order));
+	}
+	g_static_mutex_unlock(&cache_lock);
+}
+
+/**
+ * Turns the page of a URI some provider renders itself into HTML, or gets
+ * it from the pages rendered last.  Rendering may take a while, so this
+ * is best called from a thread other than the main one; it may be called
+ * from any.
+ *
+ * @param uri	A URI doc_provider_for_uri() found a provider for.
+ * @param error	Return location for a GError or NULL.
+ *
+ * @return	The newly allocated page or NULL on error.
+ */
+gchar *doc_provider_render_page(const gchar *uri, GError **error)
+{
+	const DocProvider *provider = doc_provider_for_uri(uri);
+	gchar *html;
+
+	if (provider == NULL)
+	{
+		g_set_error(error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+					"No documentation provider renders '%s'", uri);
+		return NULL;
+	}
+
+	html = doc_provider_get_cached_page(uri);
+	if (html == NULL)
+	{
+		html = provider->render_page(uri, error);
+		if (html != NULL)
+			cache_page(uri, html);
+	}
+	return html;
+}
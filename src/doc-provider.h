@@ -0,0 +1,84 @@
+/*
+ * doc-provider.h - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef DOC_PROVIDER_H
+#define DOC_PROVIDER_H
+
+#include <glib.h>
+#include "book-index.h"
+#include "search-index.h"
+
+G_BEGIN_DECLS
+
+/*
+ * A documentation provider finds the sources of one kind of documentation
+ * and turns each of them into a BookIndex: Devhelp book files, sections
+ * of the manual pages, directories of HTML with a keyword file.  The books
+ * of every provider end up in the one array of books, so the search index,
+ * the symbol table and everything else built from the books look through
+ * all of them at once without knowing where they came from.
+ *
+ * Each provider has a snapshot of its own next to the Devhelp one, so
+ * installing a man page doesn't make the Devhelp books stale or the other
+ * way around.  The sources are parsed on the loading thread's work pool.
+ * The search index over all of the books is saved next to them as well.
+ * With the index daemon on only the daemon writes these files, the Geany
+ * windows just read them.
+ *
+ * See doc-provider.c for documentation for these functions
+ */
+
+typedef struct _DocProvider		DocProvider;
+
+struct _DocProvider
+{
+	const gchar *name;			/* names its snapshot, "devhelp" has none */
+
+	/* directories its sources are in, watched for new ones */
+	gchar **(*get_dirs) (void);
+	/* its sources, each one becomes a book */
+	gchar **(*find_files) (void);
+	/* parses one source, from any thread */
+	BookParseFunc parse_file;
+
+	/* links of this URI scheme are turned into HTML by render_page(),
+	 * from any thread, rather than loaded by the web view */
+	const gchar *scheme;
+	gchar *(*render_page) (const gchar *uri, GError **error);
+};
+
+extern const DocProvider man_provider;
+extern const DocProvider html_provider;
+
+const DocProvider * const *doc_provider_get_all(void);
+gchar **doc_provider_get_dirs(void);
+GPtrArray *doc_provider_load_books(const gchar *snapshot_path, gboolean save,
+								   gboolean *out_changed);
+SearchIndex *doc_provider_index_books(GPtrArray *books,
+									  const gchar *snapshot_path, gboolean save);
+
+const DocProvider *doc_provider_for_uri(const gchar *uri);
+gchar *doc_provider_get_cached_page(const gchar *uri);
+gchar *doc_provider_render_page(const gchar *uri, GError **error);
+
+G_END_DECLS
+
+#endif
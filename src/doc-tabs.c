@@ -0,0 +1,781 @@
+/*
+ * doc-tabs.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <gtk/gtk.h>
+#include <geanyplugin.h>
+#include <webkit/webkit.h>
+
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#endif
+
+#include "doc-provider.h"
+#include "doc-tabs.h"
+#include "stats.h"
+
+#define DOC_TABS_DEFAULT_MAX_VIEWS	4
+#define DOC_TABS_TITLE_CHARS		24
+
+typedef struct _DocTab		DocTab;
+
+struct _DocTab
+{
+	DocTabs *tabs;
+	GtkWidget *page;			/* scrolled window in the notebook */
+	GtkWidget *label;
+	GtkWidget *view;			/* NULL while suspended */
+	gchar *uri;					/* page to show when the view is created */
+	gdouble scroll_x;			/* where a suspended tab was scrolled to */
+	gdouble scroll_y;
+	gboolean restore_scroll;	/* set the scroll position once loaded */
+	gint64 load_start;			/* see stats_begin(), 0 if not timed */
+	StatsOperation load_op;
+};
+
+struct _DocTabs
+{
+	GtkNotebook *notebook;
+	gchar *home_uri;
+	GList *tabs;				/* every DocTab, in no particular order */
+	GQueue live;				/* tabs with a view, most recently used first */
+	DocTab *current;			/* last documentation tab shown */
+
+	guint max_views;			/* live views allowed at once */
+	gsize max_memory_kb;		/* growth allowed over baseline_kb, 0 for any */
+	gsize baseline_kb;			/* resident size when there were no views */
+
+	guint idle_timeout;			/* seconds, 0 to never suspend when unused */
+	guint idle_id;
+	guint restore_id;			/* puts scroll positions back after a move */
+	guint open_id;				/* opens a link clicked in a view */
+	gchar *open_uri;
+	gboolean open_new_tab;
+	gulong switch_page_id;
+};
+
+static void doc_tab_resume(DocTab *tab);
+
+/* Resident size of the process in KiB, 0 where it can't be found out */
+static gsize resident_kb(void)
+{
+	gsize kb = 0;
+#if defined(G_OS_UNIX) && defined(_SC_PAGESIZE)
+	gchar *contents;
+	gulong size, resident;
+
+	if (g_file_get_contents("/proc/self/statm", &contents, NULL, NULL))
+	{
+		if (sscanf(contents, "%lu %lu", &size, &resident) == 2)
+			kb = resident * (sysconf(_SC_PAGESIZE) / 1024);
+		g_free(contents);
+	}
+#endif
+	return kb;
+}
+
+static DocTab *tab_for_page(GtkWidget *page)
+{
+	return (page != NULL) ? g_object_get_data(G_OBJECT(page), "doc-tab") : NULL;
+}
+
+static void doc_tab_save_scroll(DocTab *tab)
+{
+	GtkScrolledWindow *sw = GTK_SCROLLED_WINDOW(tab->page);
+
+	tab->scroll_x = gtk_adjustment_get_value(gtk_scrolled_window_get_hadjustment(sw));
+	tab->scroll_y = gtk_adjustment_get_value(gtk_scrolled_window_get_vadjustment(sw));
+}
+
+static void doc_tab_restore_scroll(DocTab *tab)
+{
+	GtkScrolledWindow *sw = GTK_SCROLLED_WINDOW(tab->page);
+
+	gtk_adjustment_set_value(gtk_scrolled_window_get_hadjustment(sw), tab->scroll_x);
+	gtk_adjustment_set_value(gtk_scrolled_window_get_vadjustment(sw), tab->scroll_y);
+}
+
+/* Drops a tab's webview, keeping what's needed to bring it back */
+static void doc_tab_suspend(DocTab *tab)
+{
+	const gchar *uri;
+
+	if (tab->view == NULL)
+		return;
+
+	uri = webkit_web_view_get_uri(WEBKIT_WEB_VIEW(tab->view));
+	if (uri != NULL)
+	{
+		g_free(tab->uri);
+		tab->uri = g_strdup(uri);
+	}
+	doc_tab_save_scroll(tab);
+	tab->restore_scroll = TRUE;
+
+	g_queue_remove(&tab->tabs->live, tab);
+	gtk_widget_destroy(tab->view);
+	tab->view = NULL;
+}
+
+/*
+ * Suspends least recently used tabs, other than keep, until the views are
+ * within the limits.  Memory freed by WebKit doesn't show up in the
+ * resident size straight away so at most one tab is suspended for it.
+ */
+static void doc_tabs_enforce_limits(DocTabs *tabs, DocTab *keep)
+{
+	while (g_queue_get_length(&tabs->live) > tabs->max_views)
+	{
+		DocTab *oldest = g_queue_peek_tail(&tabs->live);
+		if (oldest == keep)
+			break;
+		doc_tab_suspend(oldest);
+	}
+
+	if (tabs->max_memory_kb > 0 && g_queue_get_length(&tabs->live) > 1)
+	{
+		gsize kb = resident_kb();
+		DocTab *oldest = g_queue_peek_tail(&tabs->live);
+
+		if (kb > tabs->baseline_kb + tabs->max_memory_kb && oldest != keep)
+			doc_tab_suspend(oldest);
+	}
+}
+
+/* Moves a live tab to the front of the LRU list */
+static void doc_tab_touch(DocTab *tab)
+{
+	GList *link = g_queue_find(&tab->tabs->live, tab);
+
+	if (link != NULL && link != tab->tabs->live.head)
+	{
+		g_queue_unlink(&tab->tabs->live, link);
+		g_queue_push_head_link(&tab->tabs->live, link);
+	}
+}
+
+static void doc_tab_set_title(DocTab *tab, const gchar *title)
+{
+	gtk_label_set_text(GTK_LABEL(tab->label),
+					   (title != NULL && *title != '\0') ? title : _("Documentation"));
+	gtk_widget_set_tooltip_text(tab->label, tab->uri);
+}
+
+static void on_view_title_changed(GObject *view, GParamSpec *pspec, gpointer user_data)
+{
+	doc_tab_set_title(user_data, webkit_web_view_get_title(WEBKIT_WEB_VIEW(view)));
+}
+
+/* Puts a resumed tab back where it was scrolled to once its page is laid out */
+static void on_view_load_status_changed(GObject *view, GParamSpec *pspec,
+										gpointer user_data)
+{
+	DocTab *tab = user_data;
+	WebKitLoadStatus status = webkit_web_view_get_load_status(WEBKIT_WEB_VIEW(view));
+	const gchar *uri;
+
+	if (status == WEBKIT_LOAD_FAILED)
+		tab->load_start = 0;
+	if (status != WEBKIT_LOAD_FINISHED)
+		return;
+
+	stats_end(tab->load_op, tab->load_start);
+	tab->load_start = 0;
+
+	uri = webkit_web_view_get_uri(WEBKIT_WEB_VIEW(view));
+	if (uri != NULL && g_strcmp0(uri, tab->uri) != 0)
+	{
+		g_free(tab->uri);
+		tab->uri = g_strdup(uri);
+	}
+
+	if (!tab->restore_scroll)
+		return;
+	tab->restore_scroll = FALSE;
+
+	doc_tab_restore_scroll(tab);
+}
+
+/* Opens the link clicked last, once the view that emitted it is done */
+static gboolean on_open_link_idle(gpointer user_data)
+{
+	DocTabs *tabs = user_data;
+	gchar *uri = tabs->open_uri;
+
+	tabs->open_id = 0;
+	tabs->open_uri = NULL;
+	doc_tabs_open(tabs, uri, tabs->open_new_tab);
+	g_free(uri);
+
+	return FALSE;
+}
+
+/*
+ * Ctrl+click and middle click open links in a new tab, links to pages a
+ * documentation provider renders itself go through the tabs as well.
+ * Opening a tab can suspend others, the emitting view among them, so it
+ * waits until the signal has returned.
+ */
+static gboolean on_view_navigation_requested(WebKitWebView *view,
+											 WebKitWebFrame *frame,
+											 WebKitNetworkRequest *request,
+											 WebKitWebNavigationAction *action,
+											 WebKitWebPolicyDecision *decision,
+											 gpointer user_data)
+{
+	DocTab *tab = user_data;
+	const gchar *uri = webkit_network_request_get_uri(request);
+	gboolean new_tab;
+
+	if (webkit_web_navigation_action_get_reason(action) !=
+			WEBKIT_WEB_NAVIGATION_REASON_LINK_CLICKED)
+		return FALSE;
+
+	new_tab = (webkit_web_navigation_action_get_button(action) == 2 ||
+			   (webkit_web_navigation_action_get_modifier_state(action) &
+				GDK_CONTROL_MASK));
+
+	/* WebKit can't load the pages providers render themselves */
+	if (!new_tab && doc_provider_for_uri(uri) == NULL)
+		return FALSE;
+
+	webkit_web_policy_decision_ignore(decision);
+
+	g_free(tab->tabs->open_uri);
+	tab->tabs->open_uri = g_strdup(uri);
+	tab->tabs->open_new_tab = new_tab;
+	if (tab->tabs->open_id == 0)
+		tab->tabs->open_id = g_idle_add(on_open_link_idle, tab->tabs);
+
+	return TRUE;
+}
+
+/* A page a documentation provider renders, on its own thread */
+typedef struct
+{
+	GtkWidget *view;			/* referenced until the page is shown */
+	gchar *uri;
+	gchar *html;
+} RenderJob;
+
+static void view_load_html(GtkWidget *view, const gchar *html, const gchar *uri)
+{
+	webkit_web_view_load_string(WEBKIT_WEB_VIEW(view), html, "text/html",
+								"UTF-8", uri);
+}
+
+/* Renders the page, or a page saying why it can't be */
+static gchar *render_page(const gchar *uri)
+{
+	GError *error = NULL;
+	gchar *html = doc_provider_render_page(uri, &error);
+
+	if (html == NULL)
+	{
+		html = g_markup_printf_escaped("<html><body><p>%s</p></body></html>",
+									   error->message);
+		g_error_free(error);
+	}
+	return html;
+}
+
+/* Shows the rendered page, unless the view went away or moved on meanwhile */
+static gboolean on_page_rendered(gpointer user_data)
+{
+	RenderJob *job = user_data;
+
+	if (gtk_widget_get_parent(job->view) != NULL &&
+		g_strcmp0(g_object_get_data(G_OBJECT(job->view), "render-uri"),
+				  job->uri) == 0)
+	{
+		g_object_set_data(G_OBJECT(job->view), "render-uri", NULL);
+		view_load_html(job->view, job->html, job->uri);
+	}
+
+	g_object_unref(job->view);
+	g_free(job->uri);
+	g_free(job->html);
+	g_free(job);
+
+	return FALSE;
+}
+
+static gpointer render_thread(gpointer data)
+{
+	RenderJob *job = data;
+
+	job->html = render_page(job->uri);
+	g_idle_add(on_page_rendered, job);
+
+	return NULL;
+}
+
+/*
+ * Loads a page, or for a page a documentation provider renders, its HTML.
+ * Rendering runs man and the like, so unless the page was rendered lately
+ * it's done on a thread and the view loads it when it's ready.
+ */
+static void view_load_uri(GtkWidget *view, const gchar *uri)
+{
+	RenderJob *job;
+	GError *error = NULL;
+	gchar *html;
+
+	if (doc_provider_for_uri(uri) == NULL)
+	{
+		g_object_set_data(G_OBJECT(view), "render-uri", NULL);
+		webkit_web_view_load_uri(WEBKIT_WEB_VIEW(view), uri);
+		return;
+	}
+
+	html = doc_provider_get_cached_page(uri);
+	if (html == NULL && !g_thread_supported())
+		html = render_page(uri);
+	if (html != NULL)
+	{
+		g_object_set_data(G_OBJECT(view), "render-uri", NULL);
+		view_load_html(view, html, uri);
+		g_free(html);
+		return;
+	}
+
+	/* the last page asked for is the one shown */
+	g_object_set_data_full(G_OBJECT(view), "render-uri", g_strdup(uri), g_free);
+
+	job = g_new0(RenderJob, 1);
+	job->view = g_object_ref(view);
+	job->uri = g_strdup(uri);
+
+	if (g_thread_create(render_thread, job, FALSE, &error) == NULL)
+	{
+		g_warning("Unable to start rendering '%s': %s", uri, error->message);
+		g_error_free(error);
+		job->html = render_page(uri);
+		on_page_rendered(job);
+	}
+}
+
+/* Gives a suspended (or new) tab a webview showing its page */
+static void doc_tab_resume(DocTab *tab)
+{
+	DocTabs *tabs = tab->tabs;
+
+	if (tab->view != NULL)
+	{
+		doc_tab_touch(tab);
+		return;
+	}
+
+	if (g_queue_is_empty(&tabs->live))
+		tabs->baseline_kb = resident_kb();
+
+	tab->view = webkit_web_view_new();
+	g_signal_connect(tab->view, "notify::title",
+					 G_CALLBACK(on_view_title_changed), tab);
+	g_signal_connect(tab->view, "notify::load-status",
+					 G_CALLBACK(on_view_load_status_changed), tab);
+	g_signal_connect(tab->view, "navigation-policy-decision-requested",
+					 G_CALLBACK(on_view_navigation_requested), tab);
+	gtk_container_add(GTK_CONTAINER(tab->page), tab->view);
+	gtk_widget_show(tab->view);
+
+	g_queue_push_head(&tabs->live, tab);
+
+	if (tab->load_start == 0)
+	{
+		tab->load_start = stats_begin();
+		tab->load_op = (tab->uri != NULL) ? STATS_PAGE_LOAD : STATS_HOME_LOAD;
+	}
+	view_load_uri(tab->view, tab->uri != NULL ? tab->uri : tabs->home_uri);
+
+	doc_tabs_enforce_limits(tabs, tab);
+}
+
+static void doc_tab_free(DocTab *tab)
+{
+	g_queue_remove(&tab->tabs->live, tab);
+	g_free(tab->uri);
+	g_free(tab);
+}
+
+static void doc_tab_close(DocTab *tab)
+{
+	DocTabs *tabs = tab->tabs;
+	gint page_num = gtk_notebook_page_num(tabs->notebook, tab->page);
+
+	tabs->tabs = g_list_remove(tabs->tabs, tab);
+	if (tabs->current == tab)
+		tabs->current = (tabs->tabs != NULL) ? tabs->tabs->data : NULL;
+
+	if (page_num >= 0)
+		gtk_notebook_remove_page(tabs->notebook, page_num);
+	doc_tab_free(tab);
+}
+
+static void on_close_clicked(GtkButton *button, gpointer user_data)
+{
+	doc_tab_close(user_data);
+}
+
+/* Adds a new, suspended, tab after the current documentation tab */
+static DocTab *doc_tab_new(DocTabs *tabs, const gchar *uri)
+{
+	DocTab *tab;
+	GtkWidget *hbox, *button, *image;
+	gint pos = -1;
+
+	tab = g_new0(DocTab, 1);
+	tab->tabs = tabs;
+	tab->uri = g_strdup(uri);
+
+	tab->page = gtk_scrolled_window_new(NULL, NULL);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(tab->page),
+		GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+	gtk_scrolled_window_set_shadow_type(GTK_SCROLLED_WINDOW(tab->page),
+		GTK_SHADOW_ETCHED_IN);
+	g_object_set_data(G_OBJECT(tab->page), "doc-tab", tab);
+	gtk_widget_show(tab->page);
+
+	hbox = gtk_hbox_new(FALSE, 2);
+	tab->label = gtk_label_new(_("Documentation"));
+	gtk_label_set_ellipsize(GTK_LABEL(tab->label), PANGO_ELLIPSIZE_END);
+	gtk_label_set_max_width_chars(GTK_LABEL(tab->label), DOC_TABS_TITLE_CHARS);
+	button = gtk_button_new();
+	gtk_button_set_relief(GTK_BUTTON(button), GTK_RELIEF_NONE);
+	gtk_button_set_focus_on_click(GTK_BUTTON(button), FALSE);
+	image = gtk_image_new_from_stock(GTK_STOCK_CLOSE, GTK_ICON_SIZE_MENU);
+	gtk_container_add(GTK_CONTAINER(button), image);
+	g_signal_connect(button, "clicked", G_CALLBACK(on_close_clicked), tab);
+	gtk_box_pack_start(GTK_BOX(hbox), tab->label, TRUE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(hbox), button, FALSE, FALSE, 0);
+	gtk_widget_show_all(hbox);
+
+	if (tabs->current != NULL)
+		pos = gtk_notebook_page_num(tabs->notebook, tabs->current->page) + 1;
+	gtk_notebook_insert_page(tabs->notebook, tab->page, hbox, pos);
+	gtk_notebook_set_tab_reorderable(tabs->notebook, tab->page, TRUE);
+
+	tabs->tabs = g_list_prepend(tabs->tabs, tab);
+
+	return tab;
+}
+
+/* Times out when no documentation tab has been shown for a while */
+static gboolean on_idle_timeout(gpointer user_data)
+{
+	DocTabs *tabs = user_data;
+
+	tabs->idle_id = 0;
+
+	if (!doc_tabs_is_showing(tabs))
+	{
+		while (!g_queue_is_empty(&tabs->live))
+			doc_tab_suspend(g_queue_peek_head(&tabs->live));
+	}
+
+	return FALSE;
+}
+
+/*
+ * Resumes a documentation tab when it's selected and arms the idle timer
+ * when something else is.
+ */
+static void on_switch_page(GtkNotebook *notebook, gpointer page,
+						   guint page_num, gpointer user_data)
+{
+	DocTabs *tabs = user_data;
+	DocTab *tab = tab_for_page(gtk_notebook_get_nth_page(notebook, page_num));
+
+	if (tabs->idle_id != 0)
+	{
+		g_source_remove(tabs->idle_id);
+		tabs->idle_id = 0;
+	}
+
+	if (tab != NULL)
+	{
+		tabs->current = tab;
+		doc_tab_resume(tab);
+	}
+	else if (tabs->idle_timeout > 0 && !g_queue_is_empty(&tabs->live))
+		tabs->idle_id = g_timeout_add_seconds(tabs->idle_timeout,
+											  on_idle_timeout, tabs);
+}
+
+/**
+ * Creates the documentation tabs for notebook.  No tab is added until one
+ * is needed.
+ *
+ * @param notebook	The notebook to put tabs in.
+ * @param home_uri	Page a tab shows when opened without one.
+ *
+ * @return	The new DocTabs, free it with doc_tabs_free().
+ */
+DocTabs *doc_tabs_new(GtkWidget *notebook, const gchar *home_uri)
+{
+	DocTabs *tabs = g_new0(DocTabs, 1);
+
+	tabs->notebook = GTK_NOTEBOOK(notebook);
+	tabs->home_uri = g_strdup(home_uri);
+	g_queue_init(&tabs->live);
+	tabs->max_views = DOC_TABS_DEFAULT_MAX_VIEWS;
+
+	tabs->switch_page_id = g_signal_connect(notebook, "switch-page",
+		G_CALLBACK(on_switch_page), tabs);
+
+	return tabs;
+}
+
+/* Removes every documentation tab and frees tabs */
+void doc_tabs_free(DocTabs *tabs)
+{
+	if (tabs == NULL)
+		return;
+
+	if (tabs->idle_id != 0)
+		g_source_remove(tabs->idle_id);
+	if (tabs->restore_id != 0)
+		g_source_remove(tabs->restore_id);
+	if (tabs->open_id != 0)
+		g_source_remove(tabs->open_id);
+	g_free(tabs->open_uri);
+	g_signal_handler_disconnect(tabs->notebook, tabs->switch_page_id);
+
+	while (tabs->tabs != NULL)
+		doc_tab_close(tabs->tabs->data);
+
+	g_free(tabs->home_uri);
+	g_free(tabs);
+}
+
+/* Runs once the moved tabs have been given their size in the new notebook,
+ * before that the scroll positions would be clamped to nothing */
+static gboolean on_restore_scroll_idle(gpointer user_data)
+{
+	DocTabs *tabs = user_data;
+	GList *iter;
+
+	tabs->restore_id = 0;
+
+	/* tabs still loading put themselves back once they're done */
+	for (iter = tabs->tabs; iter != NULL; iter = iter->next)
+	{
+		DocTab *tab = iter->data;
+
+		if (tab->view != NULL && !tab->restore_scroll)
+			doc_tab_restore_scroll(tab);
+	}
+
+	return FALSE;
+}
+
+/**
+ * Moves every documentation tab to another notebook, keeping their order.
+ * The webviews go along with their pages, so nothing is loaded again and
+ * history and scroll positions are kept.  If a documentation tab was
+ * showing the current one is shown in the new notebook.
+ *
+ * @param tabs		The documentation tabs.
+ * @param notebook	The notebook to move them to.
+ */
+void doc_tabs_move(DocTabs *tabs, GtkWidget *notebook)
+{
+	GtkNotebook *old = tabs->notebook;
+	gboolean showing;
+	gint i = 0;
+
+	if (GTK_NOTEBOOK(notebook) == old)
+		return;
+
+	showing = doc_tabs_is_showing(tabs);
+	g_signal_handler_disconnect(old, tabs->switch_page_id);
+
+	while (i < gtk_notebook_get_n_pages(old))
+	{
+		GtkWidget *page = gtk_notebook_get_nth_page(old, i);
+		DocTab *tab = tab_for_page(page);
+		GtkWidget *label;
+
+		if (tab == NULL)
+		{
+			i++;
+			continue;
+		}
+
+		if (tab->view != NULL && !tab->restore_scroll)
+			doc_tab_save_scroll(tab);
+
+		/* the notebook drops its references when the page is removed */
+		label = g_object_ref(gtk_notebook_get_tab_label(old, page));
+		g_object_ref(page);
+		gtk_notebook_remove_page(old, i);
+		gtk_notebook_append_page(GTK_NOTEBOOK(notebook), page, label);
+		gtk_notebook_set_tab_reorderable(GTK_NOTEBOOK(notebook), page, TRUE);
+		g_object_unref(page);
+		g_object_unref(label);
+	}
+
+	tabs->notebook = GTK_NOTEBOOK(notebook);
+	tabs->switch_page_id = g_signal_connect(notebook, "switch-page",
+		G_CALLBACK(on_switch_page), tabs);
+
+	if (showing && tabs->current != NULL)
+		gtk_notebook_set_current_page(tabs->notebook,
+			gtk_notebook_page_num(tabs->notebook, tabs->current->page));
+
+	if (tabs->restore_id == 0)
+		tabs->restore_id = g_idle_add(on_restore_scroll_idle, tabs);
+}
+
+/**
+ * Sets how many webviews can be alive at once and how much they can grow
+ * the process by before least recently used tabs are suspended.
+ *
+ * @param max_views		Live webviews allowed, at least 1.
+ * @param max_memory_mb	Megabytes of growth allowed, 0 for no limit.
+ */
+void doc_tabs_set_limits(DocTabs *tabs, guint max_views, guint max_memory_mb)
+{
+	tabs->max_views = MAX(max_views, 1);
+	tabs->max_memory_kb = (gsize) max_memory_mb * 1024;
+
+	doc_tabs_enforce_limits(tabs, tabs->current);
+}
+
+/**
+ * Sets how long the documentation can go unshown before every tab is
+ * suspended, 0 to never do that.
+ */
+void doc_tabs_set_idle_timeout(DocTabs *tabs, guint seconds)
+{
+	tabs->idle_timeout = seconds;
+
+	if (seconds == 0 && tabs->idle_id != 0)
+	{
+		g_source_remove(tabs->idle_id);
+		tabs->idle_id = 0;
+	}
+}
+
+/* The tab already showing uri, if any */
+static DocTab *find_tab(DocTabs *tabs, const gchar *uri)
+{
+	GList *iter;
+
+	for (iter = tabs->tabs; iter != NULL; iter = iter->next)
+	{
+		DocTab *tab = iter->data;
+		const gchar *tab_uri = tab->uri;
+
+		if (tab->view != NULL)
+			tab_uri = webkit_web_view_get_uri(WEBKIT_WEB_VIEW(tab->view));
+		if (g_strcmp0(tab_uri, uri) == 0)
+			return tab;
+	}
+	return NULL;
+}
+
+/**
+ * Shows uri and switches to its tab.  A tab already showing uri is
+ * reused, otherwise it's loaded into the current documentation tab.
+ *
+ * @param tabs		The documentation tabs.
+ * @param uri		Page to show.
+ * @param new_tab	Always open a new tab.
+ */
+void doc_tabs_open(DocTabs *tabs, const gchar *uri, gboolean new_tab)
+{
+	DocTab *tab = new_tab ? NULL : find_tab(tabs, uri);
+	gint64 start = stats_begin();
+
+	if (tab == NULL)
+	{
+		if (new_tab || tabs->current == NULL)
+		{
+			tab = doc_tab_new(tabs, uri);
+			tab->load_start = start;
+			tab->load_op = STATS_PAGE_LOAD;
+		}
+		else
+		{
+			tab = tabs->current;
+			g_free(tab->uri);
+			tab->uri = g_strdup(uri);
+			tab->restore_scroll = FALSE;
+			tab->load_start = start;
+			tab->load_op = STATS_PAGE_LOAD;
+			if (tab->view != NULL)
+				view_load_uri(tab->view, uri);
+		}
+	}
+
+	tabs->current = tab;
+	doc_tab_resume(tab);
+	gtk_notebook_set_current_page(tabs->notebook,
+		gtk_notebook_page_num(tabs->notebook, tab->page));
+}
+
+/* Switches to the current documentation tab, opening one if there's none */
+void doc_tabs_present(DocTabs *tabs)
+{
+	if (tabs->current == NULL)
+		tabs->current = doc_tab_new(tabs, NULL);
+
+	doc_tab_resume(tabs->current);
+	gtk_notebook_set_current_page(tabs->notebook,
+		gtk_notebook_page_num(tabs->notebook, tabs->current->page));
+}
+
+/**
+ * Gets the webview of the current documentation tab, opening the tab or
+ * bringing it back from suspension if needed.
+ *
+ * @return	The WebKitWebView, owned by the tab.
+ */
+GtkWidget *doc_tabs_get_view(DocTabs *tabs)
+{
+	if (tabs->current == NULL)
+		tabs->current = doc_tab_new(tabs, NULL);
+
+	doc_tab_resume(tabs->current);
+
+	return tabs->current->view;
+}
+
+/* Whether the notebook is showing a documentation tab */
+gboolean doc_tabs_is_showing(DocTabs *tabs)
+{
+	gint page = gtk_notebook_get_current_page(tabs->notebook);
+
+	return tab_for_page(gtk_notebook_get_nth_page(tabs->notebook, page)) != NULL;
+}
+
+guint doc_tabs_get_n_tabs(DocTabs *tabs)
+{
+	return g_list_length(tabs->tabs);
+}
+
+guint doc_tabs_get_n_views(DocTabs *tabs)
+{
+	return g_queue_get_length(&tabs->live);
+}
@@ -0,0 +1,61 @@
+/*
+ * doc-tabs.h - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef DOC_TABS_H
+#define DOC_TABS_H
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/*
+ * The documentation tabs in the main notebook (or message window).  Any
+ * number of tabs can be open but only a few of them have a live webview,
+ * kept in a least recently used list.  When there are more than the
+ * allowed number of views, or they've grown the process by more than the
+ * allowed memory, the least recently used tab is suspended: its webview
+ * is destroyed and only its URI, title and scroll position are kept.  A
+ * suspended tab gets a new webview when it's selected again.
+ *
+ * Ctrl+click or middle click on a link opens it in a new tab.
+ *
+ * See doc-tabs.c for documentation for these functions
+ */
+
+typedef struct _DocTabs		DocTabs;
+
+DocTabs *doc_tabs_new(GtkWidget *notebook, const gchar *home_uri);
+void doc_tabs_free(DocTabs *tabs);
+void doc_tabs_move(DocTabs *tabs, GtkWidget *notebook);
+
+void doc_tabs_set_limits(DocTabs *tabs, guint max_views, guint max_memory_mb);
+void doc_tabs_set_idle_timeout(DocTabs *tabs, guint seconds);
+
+void doc_tabs_open(DocTabs *tabs, const gchar *uri, gboolean new_tab);
+void doc_tabs_present(DocTabs *tabs);
+GtkWidget *doc_tabs_get_view(DocTabs *tabs);
+gboolean doc_tabs_is_showing(DocTabs *tabs);
+guint doc_tabs_get_n_tabs(DocTabs *tabs);
+guint doc_tabs_get_n_views(DocTabs *tabs);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,1035 @@
+/*
+ * fulltext-index.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "book-index.h"
+#include "cache-util.h"
+#include "fulltext-index.h"
+#include "html-util.h"
+#include "work-pool.h"
+
+/*
+ * Cache file layout, see cache-util.h:
+ *
+ *   FtHeader
+ *   FtDoc[n_docs]
+ *   FtTerm[n_terms]			sorted on the term text
+ *   postings					varint (doc delta, tf) pairs
+ *   string pool				NUL separated, offset 0 is ""
+ */
+#define FULLTEXT_MAGIC		"GDHFTIDX"
+#define FULLTEXT_VERSION	1
+
+#define MAX_TOKEN_LEN		64
+#define MAX_QUERY_TERMS		16
+
+#define BM25_K1				1.2
+#define BM25_B				0.75
+
+typedef struct
+{
+	gchar magic[8];
+	guint32 version;
+	guint32 n_docs;
+	guint32 n_terms;
+	guint32 strings_len;
+	gint64 mtime;				/* of the book when it was indexed */
+	guint64 postings_len;
+	guint64 total_length;		/* tokens in all documents */
+} FtHeader;
+
+typedef struct
+{
+	guint32 page;				/* offsets in the string pool */
+	guint32 anchor;
+	guint32 title;
+	guint32 length;				/* tokens in the document */
+} FtDoc;
+
+typedef struct
+{
+	guint32 text;				/* offset in the string pool */
+	guint32 df;					/* documents containing the term */
+	guint64 postings;			/* offset in the postings */
+} FtTerm;
+
+/* One book's index, mapped from the cache or freshly built */
+typedef struct
+{
+	GMappedFile *mapped;
+	gchar *data;				/* when built rather than mapped */
+	const FtHeader *header;
+	const FtDoc *docs;
+	const FtTerm *terms;
+	const guint8 *postings;
+	const gchar *strings;
+} FtBook;
+
+struct _FulltextIndex
+{
+	volatile gint ref_count;
+	GPtrArray *books;			/* array of BookIndex, referenced */
+	FtBook *ft_books;			/* one for each of books */
+	guint64 n_docs;
+	gdouble avg_length;
+};
+
+/* A damaged offset reads as "", the pool ends in a NUL so the rest can't
+ * run past it */
+#define ft_str(ftb, off) \
+	((off) < (ftb)->header->strings_len ? (ftb)->strings + (off) : "")
+
+typedef void (*TokenFunc) (const gchar *token, gsize len, gpointer user_data);
+
+static inline gboolean is_token_char(guchar c)
+{
+	return g_ascii_isalnum(c) || c == '_' || c >= 0x80;
+}
+
+/*
+ * Splits text into lower cased, NUL terminated, words.  A '.' between two
+ * digits is kept so version numbers like "2.18" are a single word.  One
+ * letter words are dropped, single digits aren't.
+ */
+static void tokenize(const gchar *text, gsize len, TokenFunc func, gpointer user_data)
+{
+	gchar token[MAX_TOKEN_LEN + 1];
+	gsize i = 0;
+
+	while (i < len)
+	{
+		gsize n = 0;
+
+		while (i < len && !is_token_char(text[i]))
+			i++;
+		if (i == len)
+			break;
+
+		while (i < len && (is_token_char(text[i]) ||
+			   (text[i] == '.' && i > 0 && g_ascii_isdigit(text[i - 1]) &&
+				i + 1 < len && g_ascii_isdigit(text[i + 1]))))
+		{
+			if (n < MAX_TOKEN_LEN)
+				token[n++] = g_ascii_tolower(text[i]);
+			i++;
+		}
+
+		token[n] = '\0';
+		if (n > 1 || g_ascii_isdigit(token[0]))
+			func(token, n, user_data);
+	}
+}
+
+static inline guint8 *write_varint(guint8 *p, guint32 value)
+{
+	while (value >= 0x80)
+	{
+		*p++ = (guint8) (value | 0x80);
+		value >>= 7;
+	}
+	*p++ = (guint8) value;
+	return p;
+}
+
+/* Stops at end and at values too big for 32 bits, returning NULL */
+static inline const guint8 *read_varint(const guint8 *p, const guint8 *end,
+										guint32 *value)
+{
+	guint32 v = 0;
+	guint shift;
+
+	for (shift = 0; p < end && shift < 35; shift += 7)
+	{
+		v |= (guint32) (*p & 0x7f) << shift;
+		if (!(*p++ & 0x80))
+		{
+			*value = v;
+			return p;
+		}
+	}
+	return NULL;
+}
+
+/* Building a book's index */
+
+typedef struct
+{
+	GString *strings;
+	GArray *docs;				/* FtDoc */
+	GHashTable *terms;			/* term -> GArray of guint32 doc, tf pairs */
+	GHashTable *doc_terms;		/* term -> DocTerm for the current document */
+	guint64 total_length;
+
+	/* the current document */
+	guint32 page;
+	guint32 anchor;
+	guint32 title;
+	guint32 length;
+	gboolean in_heading;
+	GString *heading;
+} FtBuilder;
+
+/* A term of the document being indexed, the key is its text */
+typedef struct
+{
+	guint32 count;
+	gchar text[1];
+} DocTerm;
+
+static void on_doc_token(const gchar *token, gsize len, gpointer user_data)
+{
+	FtBuilder *b = user_data;
+	DocTerm *term = g_hash_table_lookup(b->doc_terms, token);
+
+	/* no allocation for words the document already had */
+	if (term == NULL)
+	{
+		term = g_malloc(sizeof(DocTerm) + len);
+		term->count = 0;
+		memcpy(term->text, token, len + 1);
+		g_hash_table_insert(b->doc_terms, term->text, term);
+	}
+	term->count++;
+	b->length++;
+}
+
+/* Adds the current document's terms to the postings, empty ones are dropped */
+static void builder_finish_doc(FtBuilder *b)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+	FtDoc doc;
+	guint32 doc_num = b->docs->len;
+
+	if (b->length == 0)
+		return;
+
+	g_hash_table_iter_init(&iter, b->doc_terms);
+	while (g_hash_table_iter_next(&iter, &key, &value))
+	{
+		GArray *postings = g_hash_table_lookup(b->terms, key);
+		guint32 tf = ((DocTerm *) value)->count;
+
+		if (postings == NULL)
+		{
+			postings = g_array_new(FALSE, FALSE, sizeof(guint32));
+			g_hash_table_insert(b->terms, g_strdup(key), postings);
+		}
+		g_array_append_val(postings, doc_num);
+		g_array_append_val(postings, tf);
+	}
+	g_hash_table_remove_all(b->doc_terms);
+
+	doc.page = b->page;
+	doc.anchor = b->anchor;
+	doc.title = b->title;
+	doc.length = b->length;
+	g_array_append_val(b->docs, doc);
+	b->total_length += b->length;
+
+	b->length = 0;
+	b->title = 0;
+}
+
+/* An anchor starts a new section, or renames one that has no text yet */
+static void builder_anchor(FtBuilder *b, const gchar *name, gsize len)
+{
+	builder_finish_doc(b);
+	b->anchor = cache_util_pool_add(b->strings, name, len);
+}
+
+/* Collapses the whitespace of a heading and puts it in the string pool */
+static guint32 pool_add_heading(GString *pool, GString *heading)
+{
+	gchar **words = g_strsplit_set(heading->str, " \t\r\n", -1);
+	GString *text = g_string_sized_new(heading->len);
+	guint32 offset;
+	gchar **w;
+
+	for (w = words; *w != NULL; w++)
+	{
+		if (**w == '\0')
+			continue;
+		if (text->len > 0)
+			g_string_append_c(text, ' ');
+		g_string_append(text, *w);
+	}
+	offset = cache_util_pool_add(pool, text->str, text->len);
+
+	g_string_free(text, TRUE);
+	g_strfreev(words);
+
+	return offset;
+}
+
+/* Appends text outside of tags, skipping entities, to the document */
+static void builder_text(FtBuilder *b, const gchar *text, gsize len)
+{
+	gsize i = 0;
+
+	while (i < len)
+	{
+		const gchar *amp = memchr(text + i, '&', len - i);
+		gsize chunk = (amp != NULL) ? (gsize) (amp - (text + i)) : len - i;
+
+		tokenize(text + i, chunk, on_doc_token, b);
+		if (b->in_heading)
+			g_string_append_len(b->heading, text + i, chunk);
+		i += chunk;
+
+		if (amp != NULL)
+		{
+			const gchar *semi = memchr(amp, ';', MIN(len - i, 10));
+			i = (semi != NULL) ? (gsize) (semi - text) + 1 : i + 1;
+			if (b->in_heading)
+				g_string_append_c(b->heading, ' ');
+		}
+	}
+}
+
+/* Indexes one HTML page, one document per anchored section */
+static void builder_add_page(FtBuilder *b, const gchar *page,
+							 const gchar *html, gsize len)
+{
+	gsize i = 0;
+	guint32 page_title = 0;
+
+	b->page = cache_util_pool_add(b->strings, page, -1);
+	b->anchor = 0;
+	b->title = 0;
+	b->length = 0;
+	b->in_heading = FALSE;
+
+	while (i < len)
+	{
+		const gchar *lt = memchr(html + i, '<', len - i);
+		const gchar *tag, *gt, *value;
+		gsize tag_len, value_len;
+
+		if (lt == NULL)
+		{
+			builder_text(b, html + i, len - i);
+			break;
+		}
+		builder_text(b, html + i, lt - (html + i));
+
+		tag = lt + 1;
+		gt = memchr(tag, '>', len - (tag - html));
+		if (gt == NULL)
+			break;
+		tag_len = gt - tag;
+		i = (gt - html) + 1;
+
+		if (html_tag_is(tag, tag_len, "script") || html_tag_is(tag, tag_len, "style"))
+		{
+			const gchar *close = g_strstr_len(html + i, len - i,
+				html_tag_is(tag, tag_len, "script") ? "</script" : "</style");
+			i = (close != NULL) ? (gsize) (close - html) : len;
+		}
+		else if (html_tag_is(tag, tag_len, "title") && page_title == 0)
+		{
+			const gchar *close = g_strstr_len(html + i, len - i, "</title");
+			GString *title;
+
+			if (close == NULL)
+				continue;
+			title = g_string_new_len(html + i, close - (html + i));
+			page_title = pool_add_heading(b->strings, title);
+			g_string_free(title, TRUE);
+			if (b->title == 0)
+				b->title = page_title;
+			i = close - html;
+		}
+		else if (tag[0] == 'h' && tag_len >= 2 && tag[1] >= '1' && tag[1] <= '4' &&
+				 (tag_len == 2 || g_ascii_isspace(tag[2])))
+		{
+			b->in_heading = TRUE;
+			g_string_truncate(b->heading, 0);
+		}
+		else if (tag[0] == '/' && tag[1] == 'h' && tag_len >= 3 &&
+				 tag[2] >= '1' && tag[2] <= '4' && b->in_heading)
+		{
+			b->in_heading = FALSE;
+			if (b->title == 0 || b->title == page_title)
+				b->title = pool_add_heading(b->strings, b->heading);
+		}
+
+		if ((value = html_tag_anchor(tag, tag_len, &value_len)) != NULL)
+			builder_anchor(b, value, value_len);
+	}
+
+	builder_finish_doc(b);
+}
+
+static gint compare_term_keys(gconstpointer a, gconstpointer b)
+{
+	return strcmp(*(const gchar * const *) a, *(const gchar * const *) b);
+}
+
+/* Lays the builder's contents out as a cache blob */
+static gchar *builder_serialize(FtBuilder *b, gint64 mtime, gsize *out_size)
+{
+	GPtrArray *keys;
+	GByteArray *postings;
+	GHashTableIter iter;
+	gpointer key, value;
+	FtHeader *header;
+	FtTerm *terms;
+	gchar *data;
+	gsize size, terms_off, postings_off, strings_off;
+	guint i;
+
+	keys = g_ptr_array_sized_new(g_hash_table_size(b->terms));
+	g_hash_table_iter_init(&iter, b->terms);
+	while (g_hash_table_iter_next(&iter, &key, &value))
+		g_ptr_array_add(keys, key);
+	qsort(keys->pdata, keys->len, sizeof(gpointer), compare_term_keys);
+
+	terms = g_new(FtTerm, keys->len);
+	postings = g_byte_array_new();
+	for (i = 0; i < keys->len; i++)
+	{
+		GArray *list = g_hash_table_lookup(b->terms, keys->pdata[i]);
+		guint32 prev = 0;
+		guint j;
+
+		terms[i].text = cache_util_pool_add(b->strings, keys->pdata[i], -1);
+		terms[i].df = list->len / 2;
+		terms[i].postings = postings->len;
+
+		for (j = 0; j < list->len; j += 2)
+		{
+			guint8 buf[10], *p = buf;
+			guint32 doc = g_array_index(list, guint32, j);
+
+			p = write_varint(p, doc - prev);
+			p = write_varint(p, g_array_index(list, guint32, j + 1));
+			g_byte_array_append(postings, buf, p - buf);
+			prev = doc;
+		}
+	}
+
+	terms_off = sizeof(FtHeader) + b->docs->len * sizeof(FtDoc);
+	postings_off = terms_off + keys->len * sizeof(FtTerm);
+	strings_off = postings_off + postings->len;
+	size = strings_off + b->strings->len;
+
+	data = g_malloc(size);
+	header = (FtHeader *) data;
+	memcpy(header->magic, FULLTEXT_MAGIC, sizeof(header->magic));
+	header->version = FULLTEXT_VERSION;
+	header->n_docs = b->docs->len;
+	header->n_terms = keys->len;
+	header->strings_len = b->strings->len;
+	header->mtime = mtime;
+	header->postings_len = postings->len;
+	header->total_length = b->total_length;
+	memcpy(data + sizeof(FtHeader), b->docs->data, b->docs->len * sizeof(FtDoc));
+	memcpy(data + terms_off, terms, keys->len * sizeof(FtTerm));
+	memcpy(data + postings_off, postings->data, postings->len);
+	memcpy(data + strings_off, b->strings->str, b->strings->len);
+
+	g_byte_array_free(postings, TRUE);
+	g_free(terms);
+	g_ptr_array_free(keys, TRUE);
+
+	*out_size = size;
+	return data;
+}
+
+static void free_postings(gpointer data)
+{
+	g_array_free(data, TRUE);
+}
+
+static gint compare_names(gconstpointer a, gconstpointer b)
+{
+	return strcmp(*(const gchar * const *) a, *(const gchar * const *) b);
+}
+
+/* Indexes every HTML page in a book's directory */
+static gchar *build_book(const BookIndex *book, gint64 mtime,
+						 GCancellable *cancellable, gsize *out_size)
+{
+	const gchar *base = book_index_str(book, book->base);
+	FtBuilder b;
+	GPtrArray *pages;
+	GDir *dir;
+	const gchar *name;
+	gchar *data;
+	guint i;
+
+	dir = g_dir_open(base, 0, NULL);
+	if (dir == NULL)
+		return NULL;
+	pages = g_ptr_array_new_with_free_func(g_free);
+	while ((name = g_dir_read_name(dir)) != NULL)
+	{
+		if (g_str_has_suffix(name, ".html") || g_str_has_suffix(name, ".htm"))
+			g_ptr_array_add(pages, g_strdup(name));
+	}
+	g_dir_close(dir);
+	qsort(pages->pdata, pages->len, sizeof(gpointer), compare_names);
+
+	memset(&b, 0, sizeof(b));
+	b.strings = g_string_new_len("", 1);
+	b.docs = g_array_new(FALSE, FALSE, sizeof(FtDoc));
+	b.terms = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free_postings);
+	b.doc_terms = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, g_free);
+	b.heading = g_string_new(NULL);
+
+	for (i = 0; i < pages->len; i++)
+	{
+		gchar *path = g_build_filename(base, pages->pdata[i], NULL);
+		GMappedFile *mapped = g_mapped_file_new(path, FALSE, NULL);
+
+		if (mapped != NULL)
+		{
+			builder_add_page(&b, pages->pdata[i], g_mapped_file_get_contents(mapped),
+							 g_mapped_file_get_length(mapped));
+			g_mapped_file_unref(mapped);
+		}
+		g_free(path);
+
+		if (g_cancellable_is_cancelled(cancellable))
+			break;
+	}
+
+	data = g_cancellable_is_cancelled(cancellable) ? NULL :
+		builder_serialize(&b, mtime, out_size);
+
+	g_string_free(b.heading, TRUE);
+	g_hash_table_destroy(b.doc_terms);
+	g_hash_table_destroy(b.terms);
+	g_array_free(b.docs, TRUE);
+	g_string_free(b.strings, TRUE);
+	g_ptr_array_free(pages, TRUE);
+
+	return data;
+}
+
+/*
+ * Points ftb's arrays into data once the header matches the book and the
+ * sizes in it add up to size.  Nothing past the header is read here, so a
+ * mapped cache is only paged in as it's searched: the offsets in terms and
+ * documents are checked when they're used, a damaged cache gives wrong
+ * results rather than reading out of bounds.
+ */
+static gboolean ft_book_attach(FtBook *ftb, const gchar *data, gsize size,
+							   gint64 mtime)
+{
+	const FtHeader *header = (const FtHeader *) data;
+	guint64 need;
+
+	if (size < sizeof(FtHeader) ||
+		memcmp(header->magic, FULLTEXT_MAGIC, sizeof(header->magic)) != 0 ||
+		header->version != FULLTEXT_VERSION || header->mtime != mtime ||
+		header->strings_len == 0)
+		return FALSE;
+
+	need = sizeof(FtHeader) + (guint64) header->n_docs * sizeof(FtDoc) +
+		(guint64) header->n_terms * sizeof(FtTerm) + header->postings_len +
+		header->strings_len;
+	if (need != size || data[size - 1] != '\0')
+		return FALSE;
+
+	ftb->header = header;
+	ftb->docs = (const FtDoc *) (data + sizeof(FtHeader));
+	ftb->terms = (const FtTerm *) (ftb->docs + header->n_docs);
+	ftb->postings = (const guint8 *) (ftb->terms + header->n_terms);
+	ftb->strings = (const gchar *) ftb->postings + header->postings_len;
+
+	return TRUE;
+}
+
+/* Shared by the worker threads indexing books */
+typedef struct
+{
+	FulltextIndex *ft;
+	gchar *cache_dir;
+	GCancellable *cancellable;
+} BuildContext;
+
+/* Loads one book's index from the cache or builds it, on a worker thread */
+static void load_book(gpointer item, gpointer user_data)
+{
+	BuildContext *ctx = user_data;
+	guint i = GPOINTER_TO_UINT(item) - 1;
+	const BookIndex *book = g_ptr_array_index(ctx->ft->books, i);
+	FtBook *ftb = &ctx->ft->ft_books[i];
+	gchar *path = NULL, *built;
+	gint64 mtime;
+	gsize size;
+
+	if (g_cancellable_is_cancelled(ctx->cancellable))
+		return;
+
+	mtime = cache_util_book_mtime(book);
+
+	if (ctx->cache_dir != NULL)
+	{
+		path = cache_util_book_path(ctx->cache_dir, book, ".ftidx");
+		ftb->mapped = g_mapped_file_new(path, FALSE, NULL);
+		if (ftb->mapped != NULL)
+		{
+			if (ft_book_attach(ftb, g_mapped_file_get_contents(ftb->mapped),
+							   g_mapped_file_get_length(ftb->mapped), mtime))
+			{
+				g_free(path);
+				return;
+			}
+			g_mapped_file_unref(ftb->mapped);
+			ftb->mapped = NULL;
+		}
+	}
+
+	built = build_book(book, mtime, ctx->cancellable, &size);
+	if (built != NULL && ft_book_attach(ftb, built, size, mtime))
+	{
+		ftb->data = built;
+		if (path != NULL)
+			cache_util_save(path, built, size, "full text index");
+	}
+	else
+		g_free(built);
+
+	g_free(path);
+}
+
+/**
+ * Loads the full text index of every book, building the ones that aren't
+ * in cache_dir or have changed.  Books are done in parallel on a WorkPool
+ * and this returns once they're all done, so call it from a thread of its
+ * own.
+ *
+ * @param books			Array of BookIndex, a reference is kept on it.
+ * @param cache_dir		Directory to keep the per book indexes in, or NULL
+ * 						to always build them.
+ * @param cancellable	Stops the building early, books not done yet are
+ * 						left empty.  Can be NULL.
+ *
+ * @return	A new FulltextIndex, release it with fulltext_index_unref().
+ */
+FulltextIndex *fulltext_index_new(GPtrArray *books, const gchar *cache_dir,
+								  GCancellable *cancellable)
+{
+	FulltextIndex *ft;
+	BuildContext ctx;
+	WorkPool *pool;
+	guint64 total_length = 0;
+	gint64 start = g_get_monotonic_time();
+	guint i;
+
+	ft = g_new0(FulltextIndex, 1);
+	ft->ref_count = 1;
+	ft->books = g_ptr_array_ref(books);
+	ft->ft_books = g_new0(FtBook, books->len);
+
+	ctx.ft = ft;
+	ctx.cache_dir = (cache_dir != NULL &&
+		g_mkdir_with_parents(cache_dir, 0700) == 0) ? g_strdup(cache_dir) : NULL;
+	ctx.cancellable = cancellable;
+
+	pool = work_pool_new(0, load_book, &ctx);
+	for (i = 0; i < books->len; i++)
+		work_pool_push(pool, GUINT_TO_POINTER(i + 1));
+	work_pool_run(pool);
+
+	for (i = 0; i < books->len; i++)
+	{
+		const FtHeader *header = ft->ft_books[i].header;
+		if (header != NULL)
+		{
+			ft->n_docs += header->n_docs;
+			total_length += header->total_length;
+		}
+	}
+	ft->avg_length = ft->n_docs ? (gdouble) total_length / ft->n_docs : 1.0;
+
+	g_debug("Devhelp full text index: %" G_GUINT64_FORMAT " sections of %u books "
+			"in %" G_GINT64_FORMAT " ms on %u threads", ft->n_docs, books->len,
+			(g_get_monotonic_time() - start) / 1000,
+			work_pool_get_n_threads(pool));
+
+	work_pool_free(pool);
+	g_free(ctx.cache_dir);
+
+	return ft;
+}
+
+FulltextIndex *fulltext_index_ref(FulltextIndex *ft)
+{
+	g_atomic_int_inc(&ft->ref_count);
+	return ft;
+}
+
+void fulltext_index_unref(FulltextIndex *ft)
+{
+	guint i;
+
+	if (ft == NULL || !g_atomic_int_dec_and_test(&ft->ref_count))
+		return;
+
+	for (i = 0; i < ft->books->len; i++)
+	{
+		if (ft->ft_books[i].mapped != NULL)
+			g_mapped_file_unref(ft->ft_books[i].mapped);
+		g_free(ft->ft_books[i].data);
+	}
+	g_free(ft->ft_books);
+	g_ptr_array_unref(ft->books);
+	g_free(ft);
+}
+
+/* Searching */
+
+/* Binary search for a term, a damaged one is left out rather than trusted */
+static const FtTerm *ft_book_find_term(const FtBook *ftb, const gchar *text)
+{
+	guint lo = 0, hi = ftb->header->n_terms;
+
+	while (lo < hi)
+	{
+		guint mid = lo + (hi - lo) / 2;
+		const FtTerm *term = &ftb->terms[mid];
+		gint cmp = strcmp(ft_str(ftb, term->text), text);
+
+		if (cmp == 0)
+		{
+			if (term->df == 0 || term->df > ftb->header->n_docs ||
+				term->postings >= ftb->header->postings_len)
+				return NULL;
+			return term;
+		}
+		if (cmp < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return NULL;
+}
+
+static void on_query_token(const gchar *token, gsize len, gpointer user_data)
+{
+	GPtrArray *terms = user_data;
+	guint i;
+
+	if (terms->len == MAX_QUERY_TERMS)
+		return;
+	for (i = 0; i < terms->len; i++)
+	{
+		if (strlen(terms->pdata[i]) == len && memcmp(terms->pdata[i], token, len) == 0)
+			return;
+	}
+	g_ptr_array_add(terms, g_strndup(token, len));
+}
+
+static inline gfloat bm25(gdouble idf, guint32 tf, guint32 length, gdouble avg_length)
+{
+	return (gfloat) (idf * tf * (BM25_K1 + 1) /
+		(tf + BM25_K1 * (1 - BM25_B + BM25_B * length / avg_length)));
+}
+
+static gint compare_hits(gconstpointer a, gconstpointer b)
+{
+	const FulltextHit *ha = a, *hb = b;
+
+	if (ha->score != hb->score)
+		return (ha->score > hb->score) ? -1 : 1;
+	if (ha->book != hb->book)
+		return (ha->book < hb->book) ? -1 : 1;
+	return (ha->doc < hb->doc) ? -1 : (ha->doc > hb->doc);
+}
+
+/* Heap in compare_hits() order so the worst of the kept hits is at the top,
+ * ties broken like the final sort so resumed searches skip nothing */
+static void heap_push(FulltextHit *heap, guint *n, guint max, const FulltextHit *hit)
+{
+	guint i;
+
+	if (*n == max)
+	{
+		if (compare_hits(hit, &heap[0]) >= 0)
+			return;
+		i = 0;
+		heap[0] = *hit;
+		for (;;)
+		{
+			guint worst = i, l = 2 * i + 1, r = 2 * i + 2;
+			FulltextHit tmp;
+
+			if (l < *n && compare_hits(&heap[l], &heap[worst]) > 0)
+				worst = l;
+			if (r < *n && compare_hits(&heap[r], &heap[worst]) > 0)
+				worst = r;
+			if (worst == i)
+				return;
+			tmp = heap[i];
+			heap[i] = heap[worst];
+			heap[worst] = tmp;
+			i = worst;
+		}
+	}
+
+	i = (*n)++;
+	heap[i] = *hit;
+	while (i > 0 && compare_hits(&heap[(i - 1) / 2], &heap[i]) < 0)
+	{
+		FulltextHit tmp = heap[i];
+		heap[i] = heap[(i - 1) / 2];
+		heap[(i - 1) / 2] = tmp;
+		i = (i - 1) / 2;
+	}
+}
+
+/*
+ * Reads the next (doc, tf) pair of a term's postings, adding the delta to
+ * doc.  Returns NULL if the postings are damaged: past the end, or a
+ * document that isn't in the book.
+ */
+static inline const guint8 *read_posting(const FtBook *ftb, const guint8 *p,
+										 guint32 *doc, guint32 *tf)
+{
+	const guint8 *end = ftb->postings + ftb->header->postings_len;
+	guint32 delta;
+
+	if ((p = read_varint(p, end, &delta)) == NULL ||
+		(p = read_varint(p, end, tf)) == NULL ||
+		delta >= ftb->header->n_docs - *doc)
+		return NULL;
+	*doc += delta;
+	return p;
+}
+
+/*
+ * Scores the documents of one book containing every term.  The rarest
+ * term's postings give the candidates, the others are merged into them.
+ * A term whose postings turn out damaged ends the book with no hits.
+ */
+static guint search_book(FulltextIndex *ft, guint book_num, const FtTerm **found,
+						 const gdouble *idf, guint n_terms, GArray *docs,
+						 GArray *scores)
+{
+	const FtBook *ftb = &ft->ft_books[book_num];
+	guint t, i, n;
+	const guint8 *p;
+	guint32 doc = 0;
+
+	g_array_set_size(docs, found[0]->df);
+	g_array_set_size(scores, found[0]->df);
+	p = ftb->postings + found[0]->postings;
+	for (i = 0; i < found[0]->df; i++)
+	{
+		guint32 tf;
+
+		if ((p = read_posting(ftb, p, &doc, &tf)) == NULL)
+			return 0;
+		g_array_index(docs, guint32, i) = doc;
+		g_array_index(scores, gfloat, i) = bm25(idf[0], tf, ftb->docs[doc].length,
+												ft->avg_length);
+	}
+	n = found[0]->df;
+
+	for (t = 1; t < n_terms && n > 0; t++)
+	{
+		guint j, kept = 0;
+
+		p = ftb->postings + found[t]->postings;
+		doc = 0;
+		i = 0;
+		for (j = 0; j < found[t]->df && i < n; j++)
+		{
+			guint32 tf;
+
+			if ((p = read_posting(ftb, p, &doc, &tf)) == NULL)
+				return 0;
+
+			while (i < n && g_array_index(docs, guint32, i) < doc)
+				i++;
+			if (i < n && g_array_index(docs, guint32, i) == doc)
+			{
+				g_array_index(docs, guint32, kept) = doc;
+				g_array_index(scores, gfloat, kept) = g_array_index(scores, gfloat, i) +
+					bm25(idf[t], tf, ftb->docs[doc].length, ft->avg_length);
+				kept++;
+				i++;
+			}
+		}
+		n = kept;
+	}
+
+	return n;
+}
+
+/**
+ * Finds the documents containing every word of query and ranks them.
+ *
+ * @param ft			The index to search.
+ * @param query			Words to look for, split the same way as the pages.
+ * @param hits			Array of at least max_hits to store results in.
+ * @param max_hits		The most results to return.
+ * @param after			Only hits ranked below this one are returned, to get
+ * 						the ones after a previous search's last hit.  NULL
+ * 						for the best ones.
+ * @param cancellable	Checked between books, can be NULL.
+ *
+ * @return	The number of results stored in hits, best first.
+ */
+guint fulltext_index_search(FulltextIndex *ft, const gchar *query,
+							FulltextHit *hits, guint max_hits,
+							const FulltextHit *after, GCancellable *cancellable)
+{
+	GPtrArray *terms;
+	const FtTerm **found;
+	guint64 df[MAX_QUERY_TERMS];
+	gdouble idf[MAX_QUERY_TERMS];
+	GArray *docs, *scores;
+	guint b, t, n_hits = 0;
+
+	if (max_hits == 0)
+		return 0;
+
+	terms = g_ptr_array_new_with_free_func(g_free);
+	tokenize(query, strlen(query), on_query_token, terms);
+	if (terms->len == 0)
+	{
+		g_ptr_array_free(terms, TRUE);
+		return 0;
+	}
+
+	/* look every term up in every book first, idf is over all of them */
+	found = g_new0(const FtTerm *, ft->books->len * terms->len);
+	memset(df, 0, sizeof(df));
+	for (b = 0; b < ft->books->len; b++)
+	{
+		const FtBook *ftb = &ft->ft_books[b];
+
+		if (ftb->header == NULL)
+			continue;
+		for (t = 0; t < terms->len; t++)
+		{
+			const FtTerm *term = ft_book_find_term(ftb, terms->pdata[t]);
+			if (term == NULL)
+				break;
+			found[b * terms->len + t] = term;
+			df[t] += term->df;
+		}
+		if (t < terms->len)
+			found[b * terms->len] = NULL;
+	}
+	for (t = 0; t < terms->len; t++)
+		idf[t] = log(1.0 + (ft->n_docs - df[t] + 0.5) / (df[t] + 0.5));
+
+	docs = g_array_new(FALSE, FALSE, sizeof(guint32));
+	scores = g_array_new(FALSE, FALSE, sizeof(gfloat));
+	for (b = 0; b < ft->books->len; b++)
+	{
+		const FtTerm *book_found[MAX_QUERY_TERMS];
+		gdouble book_idf[MAX_QUERY_TERMS];
+		guint i, n;
+
+		if (found[b * terms->len] == NULL)
+			continue;
+		if (g_cancellable_is_cancelled(cancellable))
+			break;
+
+		/* rarest term first, it has the fewest candidates */
+		for (t = 0; t < terms->len; t++)
+		{
+			const FtTerm *term = found[b * terms->len + t];
+			for (i = t; i > 0 && book_found[i - 1]->df > term->df; i--)
+			{
+				book_found[i] = book_found[i - 1];
+				book_idf[i] = book_idf[i - 1];
+			}
+			book_found[i] = term;
+			book_idf[i] = idf[t];
+		}
+
+		n = search_book(ft, b, book_found, book_idf, terms->len, docs, scores);
+		for (i = 0; i < n; i++)
+		{
+			FulltextHit hit;
+
+			hit.book = b;
+			hit.doc = g_array_index(docs, guint32, i);
+			hit.score = g_array_index(scores, gfloat, i);
+			if (after != NULL && compare_hits(&hit, after) <= 0)
+				continue;
+			heap_push(hits, &n_hits, max_hits, &hit);
+		}
+	}
+
+	g_array_free(scores, TRUE);
+	g_array_free(docs, TRUE);
+	g_free(found);
+	g_ptr_array_free(terms, TRUE);
+
+	qsort(hits, n_hits, sizeof(FulltextHit), compare_hits);
+
+	return n_hits;
+}
+
+const BookIndex *fulltext_index_hit_book(FulltextIndex *ft, const FulltextHit *hit)
+{
+	return g_ptr_array_index(ft->books, hit->book);
+}
+
+/* Heading of the section, or its anchor or page name if it has none */
+const gchar *fulltext_index_hit_title(FulltextIndex *ft, const FulltextHit *hit)
+{
+	const FtBook *ftb = &ft->ft_books[hit->book];
+	const FtDoc *doc = &ftb->docs[hit->doc];
+
+	if (doc->title != 0)
+		return ft_str(ftb, doc->title);
+	return ft_str(ftb, doc->anchor != 0 ? doc->anchor : doc->page);
+}
+
+/* Newly allocated URI of the section */
+gchar *fulltext_index_hit_uri(FulltextIndex *ft, const FulltextHit *hit)
+{
+	const BookIndex *book = fulltext_index_hit_book(ft, hit);
+	const FtBook *ftb = &ft->ft_books[hit->book];
+	const FtDoc *doc = &ftb->docs[hit->doc];
+	gchar *filename, *uri;
+
+	filename = g_build_filename(book_index_str(book, book->base),
+								ft_str(ftb, doc->page), NULL);
+	uri = g_filename_to_uri(filename, NULL, NULL);
+	g_free(filename);
+
+	if (uri != NULL && doc->anchor != 0)
+	{
+		gchar *full = g_strconcat(uri, "#", ft_str(ftb, doc->anchor), NULL);
+		g_free(uri);
+		uri = full;
+	}
+
+	return uri;
+}
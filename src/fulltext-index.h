@@ -0,0 +1,76 @@
+/*
+ * fulltext-index.h - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef FULLTEXT_INDEX_H
+#define FULLTEXT_INDEX_H
+
+#include <glib.h>
+#include <gio/gio.h>
+#include "book-index.h"
+
+G_BEGIN_DECLS
+
+/*
+ * An inverted index over the text of every HTML page of every book.  Each
+ * page is split into sections at its anchors and each section is a
+ * document, so hits can point right at the part of a page that matched.
+ *
+ * Every book has its own index: documents, a sorted term table and
+ * postings lists of (document delta, term frequency) pairs stored as
+ * varints.  A book's index is written to the cache directory as one blob
+ * and memory mapped the next time, it's only rebuilt when the book or its
+ * directory changes.  Books are indexed on a pool of worker threads.
+ *
+ * Queries match documents containing every word of the query and rank them
+ * with BM25.
+ *
+ * Like SearchIndex, a FulltextIndex is immutable once built and reference
+ * counted so it can be searched from any thread.
+ *
+ * See fulltext-index.c for documentation for these functions
+ */
+
+typedef struct _FulltextIndex	FulltextIndex;
+typedef struct _FulltextHit		FulltextHit;
+
+struct _FulltextHit
+{
+	guint32 book;				/* index into the books */
+	guint32 doc;				/* document of the book */
+	gfloat score;				/* higher is better */
+};
+
+FulltextIndex *fulltext_index_new(GPtrArray *books, const gchar *cache_dir,
+								  GCancellable *cancellable);
+FulltextIndex *fulltext_index_ref(FulltextIndex *ft);
+void fulltext_index_unref(FulltextIndex *ft);
+
+guint fulltext_index_search(FulltextIndex *ft, const gchar *query,
+							FulltextHit *hits, guint max_hits,
+							const FulltextHit *after, GCancellable *cancellable);
+
+const BookIndex *fulltext_index_hit_book(FulltextIndex *ft, const FulltextHit *hit);
+const gchar *fulltext_index_hit_title(FulltextIndex *ft, const FulltextHit *hit);
+gchar *fulltext_index_hit_uri(FulltextIndex *ft, const FulltextHit *hit);
+
+G_END_DECLS
+
+#endif
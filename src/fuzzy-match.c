@@ -0,0 +1,344 @@
+/*
+ * fuzzy-match.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "search-index.h"
+#include "fuzzy-match.h"
+
+#define FLAG_BOUNDARY		0x01
+
+#define SCORE_MATCH			16
+#define BONUS_BOUNDARY		10
+#define BONUS_CONSECUTIVE	8
+#define BONUS_PREFIX		12
+#define MAX_GAP_PENALTY		6
+
+#if defined(__GNUC__)
+#define lowest_bit(x)	((guint) __builtin_ctzll(x))
+#else
+static guint lowest_bit(guint64 x)
+{
+	guint n = 0;
+	while ((x & 1) == 0)
+	{
+		x >>= 1;
+		n++;
+	}
+	return n;
+}
+#endif
+
+struct _FuzzyIndex
+{
+	guint n_keywords;
+	gchar *chars;				/* lower cased names, NUL separated */
+	guint8 *flags;				/* FLAG_* for each byte of chars */
+	guint32 *offsets;			/* start of each name in chars */
+	guint16 *lengths;			/* length of each name, clamped */
+	guint64 *masks;				/* characters present in each name */
+};
+
+/* Bit of the character mask for c, lower case a-z, 0-9 and _ get their own */
+static inline guint64 char_bit(guchar c)
+{
+	if (c >= 'a' && c <= 'z')
+		return G_GUINT64_CONSTANT(1) << (c - 'a');
+	if (c >= '0' && c <= '9')
+		return G_GUINT64_CONSTANT(1) << (26 + c - '0');
+	if (c == '_')
+		return G_GUINT64_CONSTANT(1) << 36;
+	return G_GUINT64_CONSTANT(1) << (37 + c % 27);
+}
+
+static gboolean is_separator(gchar c)
+{
+	return c == '_' || c == '-' || c == '.' || c == ':' || c == ' ';
+}
+
+/**
+ * Builds the packed keyword buffers for index.  Like search_index_new()
+ * this only reads its input so it can be run on any thread.
+ *
+ * @return	A new FuzzyIndex, free it with fuzzy_index_free().
+ */
+FuzzyIndex *fuzzy_index_new(SearchIndex *index)
+{
+	FuzzyIndex *fuzzy;
+	GString *chars;
+	GByteArray *flags;
+	guint i;
+
+	fuzzy = g_new0(FuzzyIndex, 1);
+	fuzzy->n_keywords = index->n_entries;
+	fuzzy->offsets = g_new(guint32, index->n_entries);
+	fuzzy->lengths = g_new(guint16, index->n_entries);
+	fuzzy->masks = g_new(guint64, index->n_entries);
+
+	chars = g_string_sized_new(index->n_entries * 24);
+	flags = g_byte_array_sized_new(index->n_entries * 24);
+
+	for (i = 0; i < index->n_entries; i++)
+	{
+		const gchar *name = search_index_entry_name(index, i);
+		guint64 mask = 0;
+		gsize j, len = strlen(name);
+
+		fuzzy->offsets[i] = chars->len;
+		fuzzy->lengths[i] = MIN(len, G_MAXUINT16);
+
+		for (j = 0; j < len; j++)
+		{
+			guint8 flag = 0;
+			gchar c = g_ascii_tolower(name[j]);
+
+			if (j == 0 || is_separator(name[j - 1]) ||
+				(g_ascii_isupper(name[j]) && g_ascii_islower(name[j - 1])) ||
+				(g_ascii_isdigit(name[j]) && g_ascii_isalpha(name[j - 1])))
+				flag |= FLAG_BOUNDARY;
+
+			g_string_append_c(chars, c);
+			g_byte_array_append(flags, &flag, 1);
+			mask |= char_bit(c);
+		}
+		g_string_append_c(chars, '\0');
+		g_byte_array_append(flags, (const guint8 *) "", 1);
+
+		fuzzy->masks[i] = mask;
+	}
+
+	fuzzy->chars = g_string_free(chars, FALSE);
+	fuzzy->flags = g_byte_array_free(flags, FALSE);
+
+	return fuzzy;
+}
+
+void fuzzy_index_free(FuzzyIndex *fuzzy)
+{
+	if (fuzzy == NULL)
+		return;
+
+	g_free(fuzzy->chars);
+	g_free(fuzzy->flags);
+	g_free(fuzzy->offsets);
+	g_free(fuzzy->lengths);
+	g_free(fuzzy->masks);
+	g_free(fuzzy);
+}
+
+/*
+ * Scores one keyword against the (lower case) query.  The first match of
+ * the whole query is found going forward, then tightened going backward so
+ * "show" in "gtk_widget_show" doesn't start at the "s" of nothing earlier,
+ * and the characters in that window are scored.
+ */
+static gint score_keyword(const gchar *name, const guint8 *flags, guint len,
+						  const gchar *query, guint query_len)
+{
+	guint i, qi, start, end;
+	gint score = 0, prev = -1;
+
+	for (i = 0, qi = 0; i < len && qi < query_len; i++)
+	{
+		if (name[i] == query[qi])
+			qi++;
+	}
+	if (qi < query_len)
+		return G_MININT;
+	end = i;
+
+	for (i = end, qi = query_len; i-- > 0; )
+	{
+		if (name[i] == query[qi - 1] && --qi == 0)
+			break;
+	}
+	start = i;
+
+	for (i = start, qi = 0; i < end && qi < query_len; i++)
+	{
+		gint s;
+
+		if (name[i] != query[qi])
+			continue;
+
+		s = SCORE_MATCH;
+		if (flags[i] & FLAG_BOUNDARY)
+			s += (qi == 0) ? 2 * BONUS_BOUNDARY : BONUS_BOUNDARY;
+		if (prev >= 0 && (guint) prev == i - 1)
+			s += BONUS_CONSECUTIVE;
+		else if (prev >= 0)
+			s -= MIN(i - prev - 1, MAX_GAP_PENALTY);
+
+		score += s;
+		prev = i;
+		qi++;
+	}
+
+	if (start == 0)
+		score += BONUS_PREFIX;
+
+	/* the shorter of two otherwise equal names is the better match */
+	return score - (gint) ((len - query_len) / 4);
+}
+
+static gint compare_matches(gconstpointer a, gconstpointer b)
+{
+	const FuzzyMatch *ma = a, *mb = b;
+
+	if (ma->score != mb->score)
+		return (ma->score > mb->score) ? -1 : 1;
+	return (ma->entry < mb->entry) ? -1 : (ma->entry > mb->entry);
+}
+
+/* Heap in compare_matches() order so the worst of the kept matches is at
+ * the top.  Ties have to be broken the same way as the final sort or a
+ * search resumed after its last match could skip some. */
+static void heap_sift_down(FuzzyMatch *heap, guint n, guint i)
+{
+	for (;;)
+	{
+		guint worst = i, l = 2 * i + 1, r = 2 * i + 2;
+		FuzzyMatch tmp;
+
+		if (l < n && compare_matches(&heap[l], &heap[worst]) > 0)
+			worst = l;
+		if (r < n && compare_matches(&heap[r], &heap[worst]) > 0)
+			worst = r;
+		if (worst == i)
+			return;
+		tmp = heap[i];
+		heap[i] = heap[worst];
+		heap[worst] = tmp;
+		i = worst;
+	}
+}
+
+static void heap_push(FuzzyMatch *heap, guint *n, guint max, guint entry, gint score)
+{
+	FuzzyMatch match;
+	guint i;
+
+	match.entry = entry;
+	match.score = score;
+
+	if (*n == max)
+	{
+		if (compare_matches(&match, &heap[0]) >= 0)
+			return;
+		heap[0] = match;
+		heap_sift_down(heap, *n, 0);
+		return;
+	}
+
+	i = (*n)++;
+	heap[i] = match;
+	while (i > 0 && compare_matches(&heap[(i - 1) / 2], &heap[i]) < 0)
+	{
+		FuzzyMatch tmp = heap[i];
+		heap[i] = heap[(i - 1) / 2];
+		heap[(i - 1) / 2] = tmp;
+		i = (i - 1) / 2;
+	}
+}
+
+/**
+ * Finds the keywords containing all of the characters of query in order,
+ * ignoring case, and ranks them.
+ *
+ * @param fuzzy			The index to search.
+ * @param query			The text to match.
+ * @param matches		Array of at least max_matches to store results in.
+ * @param max_matches	The most results to return.
+ * @param after			Only matches ranked below this one are returned, to
+ * 						get the ones after a previous search's last
+ * 						match.  NULL for the best ones.
+ * @param cancellable	Checked every few thousand keywords to stop early,
+ * 						can be NULL.
+ *
+ * @return	The number of results stored in matches, best first.  If the
+ * 			search was cancelled they are only the best of the keywords
+ * 			checked so far.
+ */
+guint fuzzy_index_search(FuzzyIndex *fuzzy, const gchar *query,
+						 FuzzyMatch *matches, guint max_matches,
+						 const FuzzyMatch *after, GCancellable *cancellable)
+{
+	gchar *lower;
+	guint64 query_mask = 0;
+	guint query_len, base, n_matches = 0;
+
+	if (max_matches == 0)
+		return 0;
+
+	lower = g_ascii_strdown(query, -1);
+	query_len = strlen(lower);
+	if (query_len == 0)
+	{
+		g_free(lower);
+		return 0;
+	}
+	for (base = 0; base < query_len; base++)
+		query_mask |= char_bit(lower[base]);
+
+	for (base = 0; base < fuzzy->n_keywords; base += 64)
+	{
+		const guint64 *masks = fuzzy->masks + base;
+		const guint16 *lengths = fuzzy->lengths + base;
+		guint j, count = MIN(64, fuzzy->n_keywords - base);
+		guint64 hits = 0;
+
+		if ((base & 0x3fff) == 0 && g_cancellable_is_cancelled(cancellable))
+			break;
+
+		/* branch free so the compiler can vectorize it */
+		for (j = 0; j < count; j++)
+			hits |= (guint64) (((masks[j] & query_mask) == query_mask) &
+							   (lengths[j] >= query_len)) << j;
+
+		while (hits != 0)
+		{
+			guint i = base + lowest_bit(hits);
+			gint score;
+
+			hits &= hits - 1;
+			score = score_keyword(fuzzy->chars + fuzzy->offsets[i],
+								  fuzzy->flags + fuzzy->offsets[i],
+								  fuzzy->lengths[i], lower, query_len);
+			if (score == G_MININT)
+				continue;
+			/* same order as compare_matches(), ties go by entry */
+			if (after != NULL && (score > after->score ||
+								  (score == after->score && i <= after->entry)))
+				continue;
+			heap_push(matches, &n_matches, max_matches, i, score);
+		}
+	}
+
+	g_free(lower);
+
+	qsort(matches, n_matches, sizeof(FuzzyMatch), compare_matches);
+
+	return n_matches;
+}
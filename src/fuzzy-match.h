@@ -0,0 +1,63 @@
+/*
+ * fuzzy-match.h - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef FUZZY_MATCH_H
+#define FUZZY_MATCH_H
+
+#include <glib.h>
+#include <gio/gio.h>
+#include "search-index.h"
+
+G_BEGIN_DECLS
+
+/*
+ * Fuzzy (subsequence) matching over every keyword of a SearchIndex, so
+ * "widshow" finds "gtk_widget_show".  The keywords are packed lower case
+ * into one buffer along with a byte of word boundary flags per character
+ * and a 64 bit "which characters does it contain" mask per keyword.  A
+ * query first runs a branch free pass over the masks, a block of 64
+ * keywords at a time, and only the keywords that contain every character
+ * of the query get scored.
+ *
+ * Results are entry numbers of the SearchIndex the FuzzyIndex was built
+ * from.
+ *
+ * See fuzzy-match.c for documentation for these functions
+ */
+
+typedef struct _FuzzyIndex		FuzzyIndex;
+typedef struct _FuzzyMatch		FuzzyMatch;
+
+struct _FuzzyMatch
+{
+	guint entry;				/* entry number in the SearchIndex */
+	gint score;					/* higher is better */
+};
+
+FuzzyIndex *fuzzy_index_new(SearchIndex *index);
+void fuzzy_index_free(FuzzyIndex *fuzzy);
+guint fuzzy_index_search(FuzzyIndex *fuzzy, const gchar *query,
+						 FuzzyMatch *matches, guint max_matches,
+						 const FuzzyMatch *after, GCancellable *cancellable);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,192 @@
+/*
+ * html-provider.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/*
+ * Local trees of HTML documentation, API dumps, pydoc -w output and the
+ * like, that come with a keyword file instead of a Devhelp book.  Each
+ * directory in geany-devhelp/html of the user's or the system's data
+ * directories that has a file called "keywords" is a book, the first one
+ * of a name wins like it does for Devhelp books.  The keyword file has a
+ * keyword per line:
+ *
+ *   name<TAB>link[<TAB>type]
+ *
+ * where link is relative to the directory (or a URI) and type is a Devhelp
+ * keyword type such as "function" or "struct".  Blank lines and lines
+ * starting with '#' are skipped, and "@title <title>", "@name <name>" and
+ * "@index <link>" lines set the book's title, the name filetype book sets
+ * match against and its front page.  They default to the directory's name
+ * and index.html.
+ */
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "book-index.h"
+#include "doc-provider.h"
+
+#define HTML_KEYWORD_FILE	"keywords"
+#define HTML_INDEX_PAGE		"index.html"
+
+/* The html directories of the user's and the system's data directories */
+static gchar **html_get_dirs(void)
+{
+	const gchar * const *system_dirs;
+	GPtrArray *dirs = g_ptr_array_new();
+	guint i;
+
+	g_ptr_array_add(dirs, g_build_filename(g_get_user_data_dir(),
+										   "geany-devhelp", "html", NULL));
+	system_dirs = g_get_system_data_dirs();
+	for (i = 0; system_dirs[i] != NULL; i++)
+		g_ptr_array_add(dirs, g_build_filename(system_dirs[i], "geany-devhelp",
+											   "html", NULL));
+	g_ptr_array_add(dirs, NULL);
+
+	return (gchar **) g_ptr_array_free(dirs, FALSE);
+}
+
+/* The keyword files of the trees in the html directories */
+static gchar **html_find_files(void)
+{
+	GHashTable *seen;
+	GPtrArray *files;
+	gchar **dirs;
+	guint i;
+
+	seen = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	files = g_ptr_array_new();
+
+	dirs = html_get_dirs();
+	for (i = 0; dirs[i] != NULL; i++)
+	{
+		GDir *gdir = g_dir_open(dirs[i], 0, NULL);
+		const gchar *name;
+
+		if (gdir == NULL)
+			continue;
+
+		while ((name = g_dir_read_name(gdir)) != NULL)
+		{
+			gchar *path;
+
+			if (g_hash_table_lookup(seen, name) != NULL)
+				continue;
+
+			path = g_build_filename(dirs[i], name, HTML_KEYWORD_FILE, NULL);
+			if (g_file_test(path, G_FILE_TEST_IS_REGULAR))
+			{
+				g_ptr_array_add(files, path);
+				g_hash_table_insert(seen, g_strdup(name), GINT_TO_POINTER(1));
+			}
+			else
+				g_free(path);
+		}
+		g_dir_close(gdir);
+	}
+
+	g_strfreev(dirs);
+	g_hash_table_destroy(seen);
+	g_ptr_array_add(files, NULL);
+
+	return (gchar **) g_ptr_array_free(files, FALSE);
+}
+
+/* Gets the value of an "@directive value" line or NULL if it isn't one */
+static const gchar *directive_value(const gchar *line, const gchar *directive)
+{
+	gsize len = strlen(directive);
+
+	if (line[0] != '@' || strncmp(line + 1, directive, len) != 0 ||
+		!g_ascii_isspace(line[len + 1]))
+		return NULL;
+	return g_strstrip((gchar *) line + len + 1);
+}
+
+/* Makes a book of a tree from its keyword file */
+static BookIndex *html_parse_file(const gchar *path, gint64 mtime,
+								  GError **error)
+{
+	BookBuilder *builder;
+	gchar *contents, **lines, *dir, *dir_name, *index_path;
+	const gchar *title = NULL, *name = NULL, *link = NULL, *value;
+	guint i;
+
+	if (!g_file_get_contents(path, &contents, NULL, error))
+		return NULL;
+
+	lines = g_strsplit(contents, "\n", -1);
+	g_free(contents);
+
+	/* the book's attributes may be anywhere, but are needed first */
+	for (i = 0; lines[i] != NULL; i++)
+	{
+		g_strchomp(lines[i]);
+		if ((value = directive_value(lines[i], "title")) != NULL)
+			title = value;
+		else if ((value = directive_value(lines[i], "name")) != NULL)
+			name = value;
+		else if ((value = directive_value(lines[i], "index")) != NULL)
+			link = value;
+	}
+
+	dir = g_path_get_dirname(path);
+	dir_name = g_path_get_basename(dir);
+	if (link == NULL)
+	{
+		index_path = g_build_filename(dir, HTML_INDEX_PAGE, NULL);
+		if (g_file_test(index_path, G_FILE_TEST_IS_REGULAR))
+			link = HTML_INDEX_PAGE;
+		g_free(index_path);
+	}
+
+	builder = book_builder_new(title ? title : dir_name, name ? name : dir_name,
+							   dir, link);
+	g_free(dir_name);
+	g_free(dir);
+
+	for (i = 0; lines[i] != NULL; i++)
+	{
+		gchar **fields;
+
+		if (lines[i][0] == '\0' || lines[i][0] == '#' || lines[i][0] == '@')
+			continue;
+
+		fields = g_strsplit(lines[i], "\t", 3);
+		if (fields[0] != NULL && fields[1] != NULL)
+			book_builder_add_keyword(builder, fields[0], fields[1],
+									 book_keyword_type_from_string(fields[2]));
+		g_strfreev(fields);
+	}
+	g_strfreev(lines);
+
+	return book_builder_finish(builder, path, mtime);
+}
+
+const DocProvider html_provider = {
+	"html",
+	html_get_dirs,
+	html_find_files,
+	html_parse_file,
+	NULL,
+	NULL
+};
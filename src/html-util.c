@@ -0,0 +1,197 @@
+/*
+ * html-util.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+
+#include <glib.h>
+
+#include "html-util.h"
+
+/* the entities that turn up in API documentation */
+static const struct
+{
+	const gchar *name;
+	const gchar *text;
+} entities[] = {
+	{ "lt", "<" },
+	{ "gt", ">" },
+	{ "amp", "&" },
+	{ "quot", "\"" },
+	{ "apos", "'" },
+	{ "nbsp", " " },
+	{ "mdash", "\342\200\224" },
+	{ "ndash", "\342\200\223" },
+	{ "hellip", "\342\200\246" }
+};
+
+/* Whether the tag is a name tag, or its closing tag if name starts with / */
+gboolean html_tag_is(const gchar *tag, gsize tag_len, const gchar *name)
+{
+	gsize len = strlen(name);
+
+	return tag_len >= len && g_ascii_strncasecmp(tag, name, len) == 0 &&
+		(tag_len == len || !g_ascii_isalnum(tag[len]));
+}
+
+/**
+ * Finds the value of an attribute of a tag.  Only quoted values are found.
+ *
+ * @param tag		The tag text.
+ * @param tag_len	Its length.
+ * @param name		The attribute, in lower case.
+ * @param value_len	Return location for the length of the value.
+ *
+ * @return	The start of the value inside of tag, or NULL.
+ */
+const gchar *html_tag_attribute(const gchar *tag, gsize tag_len,
+								const gchar *name, gsize *value_len)
+{
+	gsize name_len = strlen(name), i;
+
+	for (i = 1; i + name_len + 2 < tag_len; i++)
+	{
+		const gchar *end;
+		gchar quote;
+
+		if (!g_ascii_isspace(tag[i - 1]) ||
+			g_ascii_strncasecmp(tag + i, name, name_len) != 0 ||
+			tag[i + name_len] != '=')
+			continue;
+
+		quote = tag[i + name_len + 1];
+		if (quote != '"' && quote != '\'')
+			continue;
+		end = memchr(tag + i + name_len + 2, quote, tag_len - (i + name_len + 2));
+		if (end == NULL)
+			return NULL;
+		*value_len = end - (tag + i + name_len + 2);
+		return tag + i + name_len + 2;
+	}
+	return NULL;
+}
+
+/**
+ * Gets the name of the anchor a tag defines, which is what a link's
+ * "#anchor" points to: the name of an <a>, or the id of an <a>, <div>,
+ * <section> or heading.
+ *
+ * @return	The start of the name inside of tag, or NULL if the tag isn't an
+ * 			anchor.
+ */
+const gchar *html_tag_anchor(const gchar *tag, gsize tag_len, gsize *name_len)
+{
+	const gchar *value;
+
+	if (html_tag_is(tag, tag_len, "a") &&
+		(value = html_tag_attribute(tag, tag_len, "name", name_len)) != NULL)
+		return value;
+
+	if (html_tag_is(tag, tag_len, "a") || html_tag_is(tag, tag_len, "div") ||
+		html_tag_is(tag, tag_len, "section") ||
+		(tag[0] == 'h' && tag_len >= 2 && g_ascii_isdigit(tag[1])))
+		return html_tag_attribute(tag, tag_len, "id", name_len);
+
+	return NULL;
+}
+
+static void append_space(GString *out)
+{
+	if (out->len > 0 && out->str[out->len - 1] != ' ')
+		g_string_append_c(out, ' ');
+}
+
+/* Appends the text of an entity starting at the '&', returns its length */
+static gsize append_entity(GString *out, const gchar *amp, gsize len)
+{
+	const gchar *semi = memchr(amp, ';', MIN(len, 10));
+	gsize name_len, i;
+
+	if (semi == NULL)
+	{
+		g_string_append_c(out, '&');
+		return 1;
+	}
+
+	name_len = semi - amp - 1;
+	if (name_len > 1 && amp[1] == '#')
+	{
+		gunichar c = (amp[2] == 'x' || amp[2] == 'X') ?
+			strtoul(amp + 3, NULL, 16) : strtoul(amp + 2, NULL, 10);
+		if (c == 0xa0 || g_unichar_isspace(c))
+			append_space(out);
+		else if (g_unichar_validate(c) && c != 0)
+			g_string_append_unichar(out, c);
+		return name_len + 2;
+	}
+
+	for (i = 0; i < G_N_ELEMENTS(entities); i++)
+	{
+		if (strlen(entities[i].name) == name_len &&
+			strncmp(amp + 1, entities[i].name, name_len) == 0)
+		{
+			if (entities[i].text[0] == ' ')
+				append_space(out);
+			else
+				g_string_append(out, entities[i].text);
+			break;
+		}
+	}
+	return name_len + 2;
+}
+
+/**
+ * Appends the text of some HTML to out, without its tags, with entities
+ * decoded and with runs of whitespace collapsed to single spaces.
+ *
+ * @param out	Where the text goes.
+ * @param html	The HTML.
+ * @param len	Its length.
+ */
+void html_append_text(GString *out, const gchar *html, gsize len)
+{
+	gsize i = 0;
+
+	while (i < len)
+	{
+		gchar c = html[i];
+
+		if (c == '<')
+		{
+			const gchar *gt = memchr(html + i, '>', len - i);
+			if (gt == NULL)
+				break;
+			i = (gt - html) + 1;
+		}
+		else if (c == '&')
+			i += append_entity(out, html + i, len - i);
+		else if (g_ascii_isspace(c))
+		{
+			append_space(out);
+			i++;
+		}
+		else
+		{
+			g_string_append_c(out, c);
+			i++;
+		}
+	}
+}
@@ -0,0 +1,46 @@
+/*
+ * html-util.h - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef HTML_UTIL_H
+#define HTML_UTIL_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Just enough HTML scanning for the pages gtk-doc and friends generate:
+ * tags are looked at one at a time as the text between '<' and '>', there
+ * is no tree and nothing is validated.  Tag text always starts after the
+ * '<' and doesn't include the '>'.
+ *
+ * See html-util.c for documentation for these functions
+ */
+
+gboolean html_tag_is(const gchar *tag, gsize tag_len, const gchar *name);
+const gchar *html_tag_attribute(const gchar *tag, gsize tag_len,
+								const gchar *name, gsize *value_len);
+const gchar *html_tag_anchor(const gchar *tag, gsize tag_len, gsize *name_len);
+void html_append_text(GString *out, const gchar *html, gsize len);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,519 @@
+/*
+ * index-client.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <glib.h>
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
+
+#include "book-index.h"
+#include "index-protocol.h"
+#include "index-client.h"
+
+/* how long a freshly started daemon gets to start listening */
+#define INDEX_CLIENT_SPAWN_WAIT_MS		5000
+#define INDEX_CLIENT_SPAWN_POLL_MS		50
+
+/* how long a client with a timeout leaves a daemon that timed out alone */
+#define INDEX_CLIENT_BACKOFF_US			(5 * G_USEC_PER_SEC)
+
+#define NO_BOOK		G_MAXUINT32
+
+struct _IndexClient
+{
+	gchar *socket_path;
+	gchar **spawn_argv;			/* starts the daemon, NULL to never */
+	GSocketConnection *connection;	/* NULL after it failed */
+	GInputStream *input;		/* buffered over the connection */
+	GOutputStream *output;
+	GByteArray *out;			/* the request being sent */
+	IndexMsg in;				/* the reply being read */
+	guint timeout;				/* seconds a reply may take, 0 for no limit */
+	gint64 retry_time;			/* monotonic, no requests before this */
+
+	guint32 generation;			/* of the daemon's books, 0 for none yet */
+	GPtrArray *daemon_paths;	/* the daemon's books... */
+	GArray *daemon_mtimes;		/* ...and when they were indexed */
+	GPtrArray *books;			/* the client's books, referenced */
+	GArray *map;				/* daemon book -> client book or NO_BOOK */
+};
+
+static void index_client_disconnect(IndexClient *client)
+{
+	if (client->connection == NULL)
+		return;
+
+	g_object_unref(client->input);
+	g_object_unref(client->connection);
+	client->connection = NULL;
+	client->input = NULL;
+	client->output = NULL;
+
+	/* a new daemon numbers its generations from the start again */
+	client->generation = 0;
+}
+
+static gboolean try_connect(IndexClient *client, GError **error)
+{
+	GSocketClient *socket_client;
+	GSocketAddress *address;
+
+	socket_client = g_socket_client_new();
+	address = g_unix_socket_address_new(client->socket_path);
+	client->connection = g_socket_client_connect(socket_client,
+		G_SOCKET_CONNECTABLE(address), NULL, error);
+	g_object_unref(address);
+	g_object_unref(socket_client);
+
+	if (client->connection == NULL)
+		return FALSE;
+
+	client->input = g_buffered_input_stream_new(
+		g_io_stream_get_input_stream(G_IO_STREAM(client->connection)));
+	client->output = g_io_stream_get_output_stream(G_IO_STREAM(client->connection));
+	g_socket_set_timeout(g_socket_connection_get_socket(client->connection),
+						 client->timeout);
+	return TRUE;
+}
+
+/* Connects, starting the daemon and waiting for it if nothing listens */
+static gboolean index_client_reconnect(IndexClient *client, GError **error)
+{
+	GError *spawn_error = NULL;
+	guint waited;
+
+	if (try_connect(client, NULL))
+		return TRUE;
+
+	if (client->spawn_argv == NULL)
+		return try_connect(client, error);
+
+	/* another Geany may be starting one right now, the loser of the race
+	 * for the socket just exits */
+	if (!g_spawn_async(NULL, client->spawn_argv, NULL, 0, NULL, NULL, NULL,
+					   &spawn_error))
+	{
+		g_propagate_error(error, spawn_error);
+		return FALSE;
+	}
+
+	for (waited = 0; waited < INDEX_CLIENT_SPAWN_WAIT_MS;
+		 waited += INDEX_CLIENT_SPAWN_POLL_MS)
+	{
+		g_usleep(INDEX_CLIENT_SPAWN_POLL_MS * 1000);
+		if (try_connect(client, NULL))
+			return TRUE;
+	}
+
+	return try_connect(client, error);
+}
+
+/**
+ * Connects to the index daemon.  Blocks, for up to a few seconds if the
+ * daemon has to be started, so it shouldn't be called from the main loop.
+ *
+ * @param socket_path	Where the daemon listens, see
+ * 						index_protocol_socket_path().
+ * @param spawn_argv	Command line starting the daemon if it isn't
+ * 						running, NULL to only use a running one.
+ * @param error			Return location for a GError or NULL.
+ *
+ * @return	A new IndexClient, free it with index_client_free(), or NULL
+ * 			if there's no daemon to connect to.
+ */
+IndexClient *index_client_connect(const gchar *socket_path, gchar **spawn_argv,
+								  GError **error)
+{
+	IndexClient *client = g_new0(IndexClient, 1);
+
+	client->socket_path = g_strdup(socket_path);
+	client->spawn_argv = g_strdupv(spawn_argv);
+	client->out = g_byte_array_new();
+	client->daemon_paths = g_ptr_array_new_with_free_func(g_free);
+	client->daemon_mtimes = g_array_new(FALSE, FALSE, sizeof(gint64));
+	client->map = g_array_new(FALSE, FALSE, sizeof(guint32));
+
+	if (!index_client_reconnect(client, error))
+	{
+		index_client_free(client);
+		return NULL;
+	}
+
+	return client;
+}
+
+void index_client_free(IndexClient *client)
+{
+	if (client == NULL)
+		return;
+
+	index_client_disconnect(client);
+	index_msg_clear(&client->in);
+	g_byte_array_unref(client->out);
+	g_ptr_array_unref(client->daemon_paths);
+	g_array_free(client->daemon_mtimes, TRUE);
+	g_array_free(client->map, TRUE);
+	if (client->books != NULL)
+		g_ptr_array_unref(client->books);
+	g_strfreev(client->spawn_argv);
+	g_free(client->socket_path);
+	g_free(client);
+}
+
+/**
+ * Limits how long the daemon has to answer, for a client used from the
+ * main loop.  A request that times out fails with G_IO_ERROR_TIMED_OUT
+ * and, so a hung daemon doesn't cost that much time on every call, the
+ * calls for a few seconds after it fail straight away.
+ *
+ * @param client	The index client.
+ * @param seconds	The limit, 0 for none.
+ */
+void index_client_set_timeout(IndexClient *client, guint seconds)
+{
+	client->timeout = seconds;
+	if (client->connection != NULL)
+		g_socket_set_timeout(g_socket_connection_get_socket(client->connection),
+							 seconds);
+}
+
+/* Works out which of the client's books each of the daemon's is */
+static void index_client_map_books(IndexClient *client)
+{
+	GHashTable *by_path;
+	guint i;
+
+	g_array_set_size(client->map, client->daemon_paths->len);
+	by_path = g_hash_table_new(g_str_hash, g_str_equal);
+	for (i = 0; client->books != NULL && i < client->books->len; i++)
+	{
+		BookIndex *book = g_ptr_array_index(client->books, i);
+		g_hash_table_insert(by_path, book->path, GUINT_TO_POINTER(i + 1));
+	}
+
+	for (i = 0; i < client->daemon_paths->len; i++)
+	{
+		guint local = GPOINTER_TO_UINT(g_hash_table_lookup(by_path,
+			g_ptr_array_index(client->daemon_paths, i)));
+		guint32 mapped = NO_BOOK;
+
+		/* the same file indexed at another time may have other keywords */
+		if (local != 0)
+		{
+			BookIndex *book = g_ptr_array_index(client->books, local - 1);
+			if (book->mtime == g_array_index(client->daemon_mtimes, gint64, i))
+				mapped = local - 1;
+		}
+		g_array_index(client->map, guint32, i) = mapped;
+	}
+
+	g_hash_table_destroy(by_path);
+}
+
+/**
+ * Sets the books results are numbered in.
+ *
+ * @param client	The index client.
+ * @param books		Array of the plugin's BookIndex, a reference is kept on
+ * 					it.  Setting the same array again does nothing.
+ */
+void index_client_set_books(IndexClient *client, GPtrArray *books)
+{
+	if (books == client->books)
+		return;
+
+	if (books != NULL)
+		g_ptr_array_ref(books);
+	if (client->books != NULL)
+		g_ptr_array_unref(client->books);
+	client->books = books;
+
+	index_client_map_books(client);
+}
+
+static gboolean invalid_reply(GError **error)
+{
+	g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+				"Malformed reply from the index daemon");
+	return FALSE;
+}
+
+static gboolean read_books(IndexClient *client, GError **error)
+{
+	IndexMsg *msg = &client->in;
+	guint32 generation, n, i;
+
+	if (!index_msg_get_u32(msg, &generation) || !index_msg_get_u32(msg, &n))
+		return invalid_reply(error);
+
+	g_ptr_array_set_size(client->daemon_paths, 0);
+	g_array_set_size(client->daemon_mtimes, 0);
+	for (i = 0; i < n; i++)
+	{
+		gint64 mtime;
+		gchar *path;
+
+		if (!index_msg_get_i64(msg, &mtime) || !index_msg_get_str(msg, &path))
+			return invalid_reply(error);
+		g_ptr_array_add(client->daemon_paths, path);
+		g_array_append_val(client->daemon_mtimes, mtime);
+	}
+
+	client->generation = generation;
+	index_client_map_books(client);
+	return TRUE;
+}
+
+/* Hands on a batch of results, numbered in the client's books */
+static gboolean read_results(IndexClient *client, IndexClientFunc func,
+							 gpointer user_data, GError **error)
+{
+	IndexMsg *msg = &client->in;
+	IndexRef refs[INDEX_PROTOCOL_BATCH];
+	guint32 n, i, n_refs = 0;
+
+	if (!index_msg_get_u32(msg, &n) || n > INDEX_PROTOCOL_BATCH)
+		return invalid_reply(error);
+
+	for (i = 0; i < n; i++)
+	{
+		guint32 book, keyword;
+
+		if (!index_msg_get_u32(msg, &book) || !index_msg_get_u32(msg, &keyword))
+			return invalid_reply(error);
+		if (book >= client->map->len ||
+			g_array_index(client->map, guint32, book) == NO_BOOK)
+			continue;
+
+		refs[n_refs].book = g_array_index(client->map, guint32, book);
+		refs[n_refs].keyword = keyword;
+		n_refs++;
+	}
+
+	if (n_refs > 0)
+		func(refs, n_refs, user_data);
+	return TRUE;
+}
+
+/*
+ * Sends the request in client->out and reads the reply up to its END,
+ * which is left in client->in.  A request that can't be sent is sent
+ * again over a new connection, once.  Any other failure drops the
+ * connection since there may be half a reply left on it.
+ */
+static gboolean index_client_request(IndexClient *client, IndexClientFunc func,
+									 gpointer user_data, GCancellable *cancellable,
+									 GError **error)
+{
+	GError *send_error = NULL;
+
+	if (client->retry_time > g_get_monotonic_time())
+	{
+		g_set_error(error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT,
+					"The index daemon didn't answer in time");
+		return FALSE;
+	}
+
+	if (client->connection == NULL && !index_client_reconnect(client, error))
+		return FALSE;
+
+	if (!index_msg_send(client->output, client->out, cancellable, &send_error))
+	{
+		index_client_disconnect(client);
+		if (g_cancellable_is_cancelled(cancellable) ||
+			!index_client_reconnect(client, NULL))
+		{
+			g_propagate_error(error, send_error);
+			return FALSE;
+		}
+		g_error_free(send_error);
+
+		/* the request carries the generation, which just went back to 0 */
+		memset(client->out->data + INDEX_PROTOCOL_HEADER, 0, 4);
+		if (!index_msg_send(client->output, client->out, cancellable, error))
+		{
+			index_client_disconnect(client);
+			return FALSE;
+		}
+	}
+
+	for (;;)
+	{
+		gboolean ok = TRUE;
+		gchar *message;
+
+		if (!index_msg_receive(client->input, &client->in, cancellable, &send_error))
+		{
+			if (g_error_matches(send_error, G_IO_ERROR, G_IO_ERROR_TIMED_OUT))
+				client->retry_time = g_get_monotonic_time() + INDEX_CLIENT_BACKOFF_US;
+			g_propagate_error(error, send_error);
+			index_client_disconnect(client);
+			return FALSE;
+		}
+
+		switch (client->in.type)
+		{
+			case INDEX_MSG_BOOKS:
+				ok = read_books(client, error);
+				break;
+			case INDEX_MSG_RESULTS:
+				ok = read_results(client, func, user_data, error);
+				break;
+			case INDEX_MSG_END:
+				return TRUE;
+			case INDEX_MSG_ERROR:
+				if (!index_msg_get_str(&client->in, &message))
+					message = g_strdup("Unknown error");
+				g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED,
+							"Index daemon: %s", message);
+				g_free(message);
+				return FALSE;
+			default:
+				ok = invalid_reply(error);
+				break;
+		}
+
+		if (!ok)
+		{
+			index_client_disconnect(client);
+			return FALSE;
+		}
+	}
+}
+
+/* Reads the END both kinds of request finish with */
+static gboolean read_end(IndexClient *client, gboolean *has_more,
+						 IndexResume *resume, guint32 *n_exact, GError **error)
+{
+	IndexMsg *msg = &client->in;
+	IndexResume pos;
+	guint32 score;
+	guint8 more;
+
+	if (!index_msg_get_u8(msg, &more) ||
+		!index_msg_get_u32(msg, &pos.next_entry) ||
+		!index_msg_get_u32(msg, &pos.last_entry) ||
+		!index_msg_get_u32(msg, &score) ||
+		!index_msg_get_u32(msg, n_exact))
+	{
+		index_client_disconnect(client);
+		return invalid_reply(error);
+	}
+	pos.last_score = (gint32) score;
+
+	if (has_more != NULL)
+		*has_more = more != 0;
+	if (resume != NULL)
+		*resume = pos;
+	return TRUE;
+}
+
+/* The request is built after the generation is known */
+static void begin_request(IndexClient *client, IndexMsgType type)
+{
+	index_msg_init(client->out, type);
+	index_msg_put_u32(client->out, client->generation);
+}
+
+/**
+ * Searches the daemon's index for keywords, a page of results at a time.
+ *
+ * @param client		The index client.
+ * @param query			What was typed.
+ * @param mode			Prefix or fuzzy matching, with the same ranking as
+ * 						search_index_prefix_range() and
+ * 						fuzzy_index_search().
+ * @param max			Most results to return.
+ * @param after			Where the last page stopped, NULL for the first.
+ * @param resume		Return location for where this page stopped, or
+ * 						NULL.
+ * @param has_more		Return location for whether there may be results
+ * 						after these, or NULL.
+ * @param func			Called with each batch of results, in order.
+ * @param user_data		Passed to func.
+ * @param cancellable	Optional GCancellable, NULL to ignore.
+ * @param error			Return location for a GError or NULL.
+ *
+ * @return	FALSE if the daemon couldn't be asked, func may have been
+ * 			called with some of the results by then.
+ */
+gboolean index_client_search(IndexClient *client, const gchar *query,
+							 IndexSearchMode mode, guint max,
+							 const IndexResume *after, IndexResume *resume,
+							 gboolean *has_more, IndexClientFunc func,
+							 gpointer user_data, GCancellable *cancellable,
+							 GError **error)
+{
+	guint32 n_exact;
+
+	g_return_val_if_fail(client != NULL, FALSE);
+
+	begin_request(client, INDEX_MSG_SEARCH);
+	index_msg_put_u8(client->out, mode);
+	index_msg_put_u32(client->out, max);
+	index_msg_put_u8(client->out, after != NULL);
+	index_msg_put_u32(client->out, after != NULL ? after->next_entry : 0);
+	index_msg_put_u32(client->out, after != NULL ? after->last_entry : 0);
+	index_msg_put_u32(client->out, after != NULL ? (guint32) after->last_score : 0);
+	index_msg_put_str(client->out, query);
+
+	return index_client_request(client, func, user_data, cancellable, error) &&
+		read_end(client, has_more, resume, &n_exact, error);
+}
+
+static void append_refs(const IndexRef *refs, guint n_refs, gpointer user_data)
+{
+	g_array_append_vals(user_data, refs, n_refs);
+}
+
+/**
+ * Looks up the documentation of a symbol, like symbol_table_resolve()
+ * does in a local index.
+ *
+ * @param client	The index client.
+ * @param name		The symbol.
+ * @param refs		Array of IndexRef the keywords named exactly name are
+ * 					appended to, or if there are none, the first one named
+ * 					like it ignoring case.
+ * @param n_exact	Return location for how many of refs are named exactly
+ * 					name.
+ * @param error		Return location for a GError or NULL.
+ *
+ * @return	FALSE if the daemon couldn't be asked.
+ */
+gboolean index_client_lookup(IndexClient *client, const gchar *name,
+							 GArray *refs, guint *n_exact, GError **error)
+{
+	guint32 exact;
+
+	g_return_val_if_fail(client != NULL, FALSE);
+
+	begin_request(client, INDEX_MSG_LOOKUP);
+	index_msg_put_str(client->out, name);
+
+	if (!index_client_request(client, append_refs, refs, NULL, error) ||
+		!read_end(client, NULL, NULL, &exact, error))
+		return FALSE;
+
+	/* keywords of books the client doesn't have were left out */
+	*n_exact = MIN(exact, refs->len);
+	return TRUE;
+}
@@ -0,0 +1,80 @@
+/*
+ * index-client.h - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef INDEX_CLIENT_H
+#define INDEX_CLIENT_H
+
+#include <glib.h>
+#include <gio/gio.h>
+#include "index-protocol.h"
+
+G_BEGIN_DECLS
+
+/*
+ * A connection to the index daemon, see dhp-indexd.c, which keeps one
+ * keyword index for every Geany of the user instead of each building its
+ * own.  Results come back as (book, keyword) pairs numbered in the books
+ * the client was given, which are the plugin's own, mapped from the same
+ * snapshot the daemon loads.  Keywords of books the two disagree about,
+ * one of them having reloaded before the other, are left out.
+ *
+ * Calls block until the daemon answers, which for a local socket is a few
+ * microseconds plus the query itself, or until the client's timeout runs
+ * out.  Lookups made before the daemon has loaded the books fail rather
+ * than wait for it.  A client may be used from any one
+ * thread at a time; a dropped connection is made again, and the daemon
+ * started again, by the next call.
+ *
+ * See index-client.c for documentation for these functions
+ */
+
+typedef struct _IndexClient		IndexClient;
+typedef struct _IndexRef		IndexRef;
+
+struct _IndexRef
+{
+	guint32 book;				/* index into the client's books */
+	guint32 keyword;			/* index into the book's keywords */
+};
+
+/* Called with each batch of results as it arrives */
+typedef void (*IndexClientFunc) (const IndexRef *refs, guint n_refs,
+								 gpointer user_data);
+
+IndexClient *index_client_connect(const gchar *socket_path,
+								  gchar **spawn_argv, GError **error);
+void index_client_free(IndexClient *client);
+void index_client_set_timeout(IndexClient *client, guint seconds);
+
+void index_client_set_books(IndexClient *client, GPtrArray *books);
+
+gboolean index_client_search(IndexClient *client, const gchar *query,
+							 IndexSearchMode mode, guint max,
+							 const IndexResume *after, IndexResume *resume,
+							 gboolean *has_more, IndexClientFunc func,
+							 gpointer user_data, GCancellable *cancellable,
+							 GError **error);
+gboolean index_client_lookup(IndexClient *client, const gchar *name,
+							 GArray *refs, guint *n_exact, GError **error);
+
+G_END_DECLS
+
+#endif
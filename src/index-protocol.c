@@ -0,0 +1,203 @@
+/*
+ * index-protocol.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <string.h>
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "index-protocol.h"
+
+/**
+ * Gets where the index daemon of the current user listens, in the user's
+ * runtime directory so it goes away with the session.
+ *
+ * @return	A newly allocated path, free it with g_free().
+ */
+gchar *index_protocol_socket_path(void)
+{
+	return g_build_filename(g_get_user_runtime_dir(), "geany-devhelp",
+							"index.sock", NULL);
+}
+
+/**
+ * Starts a message, the body is added with the index_msg_put_*()
+ * functions and the header filled in by index_msg_send().
+ *
+ * @param msg	An empty, or already sent, byte array to build it in.
+ * @param type	What the message is.
+ */
+void index_msg_init(GByteArray *msg, IndexMsgType type)
+{
+	g_byte_array_set_size(msg, INDEX_PROTOCOL_HEADER);
+	msg->data[4] = type;
+}
+
+void index_msg_put_u8(GByteArray *msg, guint8 value)
+{
+	g_byte_array_append(msg, &value, 1);
+}
+
+void index_msg_put_u32(GByteArray *msg, guint32 value)
+{
+	value = GUINT32_TO_LE(value);
+	g_byte_array_append(msg, (const guint8 *) &value, 4);
+}
+
+void index_msg_put_i64(GByteArray *msg, gint64 value)
+{
+	value = GINT64_TO_LE(value);
+	g_byte_array_append(msg, (const guint8 *) &value, 8);
+}
+
+void index_msg_put_str(GByteArray *msg, const gchar *str)
+{
+	gsize len = strlen(str);
+
+	index_msg_put_u32(msg, len);
+	g_byte_array_append(msg, (const guint8 *) str, len);
+}
+
+/**
+ * Fills in the header of a message and writes all of it.
+ *
+ * @param stream		Where to write it.
+ * @param msg			The message, started with index_msg_init().
+ * @param cancellable	Optional GCancellable, NULL to ignore.
+ * @param error			Return location for a GError or NULL.
+ *
+ * @return	FALSE if it couldn't be written.
+ */
+gboolean index_msg_send(GOutputStream *stream, GByteArray *msg,
+						GCancellable *cancellable, GError **error)
+{
+	guint32 len = GUINT32_TO_LE(msg->len - INDEX_PROTOCOL_HEADER);
+
+	memcpy(msg->data, &len, 4);
+
+	return g_output_stream_write_all(stream, msg->data, msg->len, NULL,
+									 cancellable, error);
+}
+
+/* Reads exactly len bytes, the end of the stream in between is an error */
+static gboolean read_exactly(GInputStream *stream, guint8 *buffer, gsize len,
+							 GCancellable *cancellable, GError **error)
+{
+	gsize n_read;
+
+	if (!g_input_stream_read_all(stream, buffer, len, &n_read, cancellable, error))
+		return FALSE;
+
+	if (n_read != len)
+	{
+		g_set_error(error, G_IO_ERROR, G_IO_ERROR_CLOSED,
+					"Connection closed");
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/**
+ * Reads the next message.
+ *
+ * @param stream		Where to read it from, it should be buffered.
+ * @param msg			Where to put it, zero filled the first time and
+ * 						freed with index_msg_clear() after the last.
+ * @param cancellable	Optional GCancellable, NULL to ignore.
+ * @param error			Return location for a GError or NULL.
+ *
+ * @return	FALSE if the connection was closed, failed or the peer sent
+ * 			something that isn't a message.
+ */
+gboolean index_msg_receive(GInputStream *stream, IndexMsg *msg,
+						   GCancellable *cancellable, GError **error)
+{
+	guint8 header[INDEX_PROTOCOL_HEADER];
+	guint32 len;
+
+	if (!read_exactly(stream, header, INDEX_PROTOCOL_HEADER, cancellable, error))
+		return FALSE;
+
+	memcpy(&len, header, 4);
+	len = GUINT32_FROM_LE(len);
+	if (len > INDEX_PROTOCOL_MAX_BODY)
+	{
+		g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+					"Message of %u bytes is too big", len);
+		return FALSE;
+	}
+
+	if (msg->data == NULL)
+		msg->data = g_byte_array_new();
+	g_byte_array_set_size(msg->data, len);
+	msg->type = header[4];
+	msg->pos = 0;
+
+	return read_exactly(stream, msg->data->data, len, cancellable, error);
+}
+
+/* The index_msg_get_*() functions return FALSE if the body is too short */
+gboolean index_msg_get_u8(IndexMsg *msg, guint8 *value)
+{
+	if (msg->pos + 1 > msg->data->len)
+		return FALSE;
+	*value = msg->data->data[msg->pos++];
+	return TRUE;
+}
+
+gboolean index_msg_get_u32(IndexMsg *msg, guint32 *value)
+{
+	if (msg->pos + 4 > msg->data->len)
+		return FALSE;
+	memcpy(value, msg->data->data + msg->pos, 4);
+	*value = GUINT32_FROM_LE(*value);
+	msg->pos += 4;
+	return TRUE;
+}
+
+gboolean index_msg_get_i64(IndexMsg *msg, gint64 *value)
+{
+	if (msg->pos + 8 > msg->data->len)
+		return FALSE;
+	memcpy(value, msg->data->data + msg->pos, 8);
+	*value = GINT64_FROM_LE(*value);
+	msg->pos += 8;
+	return TRUE;
+}
+
+/* str is newly allocated and NUL terminated */
+gboolean index_msg_get_str(IndexMsg *msg, gchar **str)
+{
+	guint32 len;
+
+	if (!index_msg_get_u32(msg, &len) || len > msg->data->len - msg->pos)
+		return FALSE;
+	*str = g_strndup((const gchar *) msg->data->data + msg->pos, len);
+	msg->pos += len;
+	return TRUE;
+}
+
+void index_msg_clear(IndexMsg *msg)
+{
+	if (msg->data != NULL)
+		g_byte_array_unref(msg->data);
+	msg->data = NULL;
+	msg->pos = 0;
+}
@@ -0,0 +1,119 @@
+/*
+ * index-protocol.h - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef INDEX_PROTOCOL_H
+#define INDEX_PROTOCOL_H
+
+#include <glib.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/*
+ * What the plugin and the index daemon (dhp-indexd) say to each other over
+ * the daemon's Unix socket.  Every message is a 5 byte header, the length
+ * of the body as a little endian guint32 and the type as a byte, followed
+ * by the body.  Numbers in bodies are little endian, strings are a guint32
+ * length and that many bytes with no NUL.
+ *
+ * Results never carry names or URIs, only (book, keyword) pairs: the
+ * plugin has the same books mapped from the same snapshot and reads the
+ * rest from them.  Books are numbered in the daemon's array, which is sent
+ * once per generation, that is every time the daemon loads the books, so
+ * the client can map them onto its own by path and mtime.
+ *
+ * A request is answered by an optional BOOKS message, if the client's
+ * generation is out of date, then any number of RESULTS batches and an
+ * END.  A connection handles one request at a time.
+ *
+ * See index-protocol.c for documentation for these functions
+ */
+
+/* bytes before the body of a message */
+#define INDEX_PROTOCOL_HEADER		5
+
+/* (book, keyword) pairs per RESULTS message */
+#define INDEX_PROTOCOL_BATCH		64
+
+/* bodies bigger than this are a broken peer, not a big book list */
+#define INDEX_PROTOCOL_MAX_BODY		(16 * 1024 * 1024)
+
+typedef enum
+{
+	/* client: u32 generation, u8 mode, u32 max, u8 resume,
+	 * u32 next_entry, u32 last_entry, i32 last_score, str query */
+	INDEX_MSG_SEARCH = 1,
+	/* client: u32 generation, str name */
+	INDEX_MSG_LOOKUP,
+	/* daemon: u32 generation, u32 n, n * (i64 mtime, str path) */
+	INDEX_MSG_BOOKS,
+	/* daemon: u32 n, n * (u32 book, u32 keyword) */
+	INDEX_MSG_RESULTS,
+	/* daemon: u8 has_more, u32 next_entry, u32 last_entry,
+	 * i32 last_score, u32 n_exact */
+	INDEX_MSG_END,
+	/* daemon: str message */
+	INDEX_MSG_ERROR
+} IndexMsgType;
+
+typedef enum
+{
+	INDEX_SEARCH_PREFIX,
+	INDEX_SEARCH_FUZZY
+} IndexSearchMode;
+
+/* Where a page of search results stopped, for the next page to go on from */
+typedef struct
+{
+	guint32 next_entry;			/* prefix searches: first entry not sent */
+	guint32 last_entry;			/* fuzzy searches: the worst match sent... */
+	gint32 last_score;			/* ...and its score */
+} IndexResume;
+
+/* A received message, pos is how far into data it has been read */
+typedef struct
+{
+	IndexMsgType type;
+	GByteArray *data;
+	guint pos;
+} IndexMsg;
+
+gchar *index_protocol_socket_path(void);
+
+void index_msg_init(GByteArray *msg, IndexMsgType type);
+void index_msg_put_u8(GByteArray *msg, guint8 value);
+void index_msg_put_u32(GByteArray *msg, guint32 value);
+void index_msg_put_i64(GByteArray *msg, gint64 value);
+void index_msg_put_str(GByteArray *msg, const gchar *str);
+gboolean index_msg_send(GOutputStream *stream, GByteArray *msg,
+						GCancellable *cancellable, GError **error);
+
+gboolean index_msg_receive(GInputStream *stream, IndexMsg *msg,
+						   GCancellable *cancellable, GError **error);
+gboolean index_msg_get_u8(IndexMsg *msg, guint8 *value);
+gboolean index_msg_get_u32(IndexMsg *msg, guint32 *value);
+gboolean index_msg_get_i64(IndexMsg *msg, gint64 *value);
+gboolean index_msg_get_str(IndexMsg *msg, gchar **str);
+void index_msg_clear(IndexMsg *msg);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,407 @@
+/*
+ * index-snapshot.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "book-index.h"
+#include "index-snapshot.h"
+#include "work-pool.h"
+
+/*
+ * File layout, all in host byte order since the snapshot never leaves the
+ * machine it was written on:
+ *
+ *   SnapshotHeader
+ *   SnapshotBook[n_books]
+ *   for each book: path, BookKeyword[n_keywords], BookChapter[n_chapters],
+ *                  string pool
+ *
+ * Everything is padded to 8 bytes so the arrays can be used in place.
+ *
+ * The file is only ever replaced whole, so one whose size and book table
+ * match the header is one that was written completely.  Only the header
+ * and the book table are checked when loading: the keywords, chapters and
+ * strings are left alone so they don't get paged in until they're used.
+ */
+#define SNAPSHOT_MAGIC		"GDHINDEX"
+#define SNAPSHOT_VERSION	3
+
+typedef struct
+{
+	gchar magic[8];
+	guint32 version;
+	guint32 n_books;
+	guint64 size;				/* of the whole file */
+	guint8 digest[16];			/* MD5 of the SnapshotBook table */
+} SnapshotHeader;
+
+typedef struct
+{
+	gint64 mtime;
+	guint32 path;				/* file offsets */
+	guint32 path_len;
+	guint32 keywords;
+	guint32 n_keywords;
+	guint32 chapters;
+	guint32 n_chapters;
+	guint32 strings;
+	guint32 strings_len;
+	guint32 title;				/* offsets in the book's string pool */
+	guint32 name;
+	guint32 base;
+	guint32 link;
+} SnapshotBook;
+
+/* a book that has to be parsed again, run on the work pool */
+typedef struct
+{
+	const gchar *path;
+	gint64 mtime;
+	BookParseFunc parse;
+	BookIndex *book;			/* the result or NULL on error */
+	GError *error;
+	gint64 elapsed;				/* time spent parsing, in microseconds */
+} ParseJob;
+
+#define ALIGN8(n)	(((n) + 7) & ~((gsize) 7))
+
+/* Checks a book entry's arrays and strings are inside of the file */
+static gboolean snapshot_book_valid(const SnapshotBook *entry,
+									const gchar *data, gsize size)
+{
+	if (entry->path > size || entry->path_len >= size - entry->path ||
+		data[entry->path + entry->path_len] != '\0')
+		return FALSE;
+	if (entry->strings > size || entry->strings_len == 0 ||
+		entry->strings_len > size - entry->strings)
+		return FALSE;
+	if (entry->keywords > size || entry->keywords % 8 != 0 ||
+		entry->n_keywords > (size - entry->keywords) / sizeof(BookKeyword))
+		return FALSE;
+	if (entry->chapters > size || entry->chapters % 8 != 0 ||
+		entry->n_chapters > (size - entry->chapters) / sizeof(BookChapter))
+		return FALSE;
+	if (entry->title >= entry->strings_len || entry->name >= entry->strings_len ||
+		entry->base >= entry->strings_len || entry->link >= entry->strings_len)
+		return FALSE;
+
+	return TRUE;
+}
+
+/* MD5 of the book table, as stored in the header */
+static void snapshot_digest(const SnapshotBook *books, guint n_books,
+							guint8 digest[16])
+{
+	GChecksum *checksum = g_checksum_new(G_CHECKSUM_MD5);
+	gsize len = 16;
+
+	g_checksum_update(checksum, (const guchar *) books,
+					  n_books * sizeof(SnapshotBook));
+	g_checksum_get_digest(checksum, digest, &len);
+	g_checksum_free(checksum);
+}
+
+/* Maps the snapshot and returns a table of path -> SnapshotBook */
+static GHashTable *snapshot_map(const gchar *snapshot_path, GMappedFile **out_mapped)
+{
+	GMappedFile *mapped;
+	GHashTable *entries;
+	const SnapshotHeader *header;
+	const SnapshotBook *books;
+	const gchar *data;
+	guint8 digest[16];
+	gsize size;
+	guint i;
+
+	*out_mapped = NULL;
+
+	mapped = g_mapped_file_new(snapshot_path, FALSE, NULL);
+	if (mapped == NULL)
+		return NULL;
+
+	data = g_mapped_file_get_contents(mapped);
+	size = g_mapped_file_get_length(mapped);
+	header = (const SnapshotHeader *) data;
+
+	if (size < sizeof(SnapshotHeader) ||
+		memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+		header->version != SNAPSHOT_VERSION || header->size != size ||
+		header->n_books > (size - sizeof(SnapshotHeader)) / sizeof(SnapshotBook))
+	{
+		g_mapped_file_unref(mapped);
+		return NULL;
+	}
+
+	books = (const SnapshotBook *) (data + sizeof(SnapshotHeader));
+	snapshot_digest(books, header->n_books, digest);
+	if (memcmp(header->digest, digest, sizeof(digest)) != 0)
+	{
+		g_mapped_file_unref(mapped);
+		return NULL;
+	}
+
+	entries = g_hash_table_new(g_str_hash, g_str_equal);
+	for (i = 0; i < header->n_books; i++)
+	{
+		if (snapshot_book_valid(&books[i], data, size))
+			g_hash_table_insert(entries, (gpointer) (data + books[i].path),
+								(gpointer) &books[i]);
+	}
+
+	*out_mapped = mapped;
+
+	return entries;
+}
+
+static void parse_job_run(gpointer item, gpointer user_data)
+{
+	ParseJob *job = item;
+	gint64 start = g_get_monotonic_time();
+
+	job->book = job->parse(job->path, job->mtime, &job->error);
+	job->elapsed = g_get_monotonic_time() - start;
+}
+
+/**
+ * Loads the BookIndex for each of book_files, using the snapshot for any
+ * book that hasn't changed since the snapshot was written and parsing the
+ * others.  The books that need parsing are parsed in parallel, one thread
+ * per processor.  Books that fail to parse are skipped with a warning.
+ *
+ * @param snapshot_path	The snapshot file, it needn't exist.
+ * @param book_files	NULL terminated array of book files to load.
+ * @param parse			What parses a book file, book_index_parse_file()
+ * 						for Devhelp books.  Called from the worker threads.
+ * @param out_dirty		Set to TRUE if the snapshot is out of date and
+ * 						should be saved again, can be NULL.
+ *
+ * @return	A new array of BookIndex, in the same order as book_files.
+ */
+GPtrArray *index_snapshot_load(const gchar *snapshot_path, gchar **book_files,
+							   BookParseFunc parse, gboolean *out_dirty)
+{
+	GMappedFile *mapped = NULL;
+	GHashTable *entries = NULL;
+	GPtrArray *books;
+	BookIndex **slots;
+	ParseJob *jobs;
+	WorkPool *pool;
+	gboolean dirty = FALSE;
+	guint i, n_files, n_jobs = 0, n_used = 0;
+	gint64 start, parse_start, parse_wall = 0, parse_cpu = 0;
+
+	start = g_get_monotonic_time();
+
+	if (snapshot_path != NULL)
+		entries = snapshot_map(snapshot_path, &mapped);
+	if (entries == NULL)
+		dirty = TRUE;
+
+	n_files = g_strv_length(book_files);
+	slots = g_new0(BookIndex *, n_files);
+	jobs = g_new0(ParseJob, n_files);
+
+	/* unchanged books come straight from the snapshot, the rest are
+	 * queued up to be parsed */
+	for (i = 0; i < n_files; i++)
+	{
+		const SnapshotBook *entry = NULL;
+		gint64 mtime;
+
+		mtime = book_index_file_mtime(book_files[i]);
+		if (entries != NULL)
+			entry = g_hash_table_lookup(entries, book_files[i]);
+
+		if (entry != NULL && entry->mtime == mtime)
+		{
+			const gchar *data = g_mapped_file_get_contents(mapped);
+			slots[i] = book_index_new_mapped(mapped, book_files[i], mtime,
+											 entry->title, entry->name,
+											 entry->base, entry->link,
+											 (const BookKeyword *) (data + entry->keywords),
+											 entry->n_keywords,
+											 (const BookChapter *) (data + entry->chapters),
+											 entry->n_chapters,
+											 data + entry->strings,
+											 entry->strings_len);
+			n_used++;
+		}
+		else
+		{
+			jobs[n_jobs].path = book_files[i];
+			jobs[n_jobs].mtime = mtime;
+			jobs[n_jobs].parse = parse;
+			n_jobs++;
+		}
+	}
+
+	pool = work_pool_new(0, parse_job_run, NULL);
+	if (n_jobs > 0)
+	{
+		dirty = TRUE;
+		for (i = 0; i < n_jobs; i++)
+			work_pool_push(pool, &jobs[i]);
+
+		parse_start = g_get_monotonic_time();
+		work_pool_run(pool);
+		parse_wall = g_get_monotonic_time() - parse_start;
+	}
+
+	/* merge the parsed books back in, keeping the order of book_files */
+	n_jobs = 0;
+	books = g_ptr_array_new_with_free_func((GDestroyNotify) book_index_free);
+	for (i = 0; i < n_files; i++)
+	{
+		if (slots[i] == NULL)
+		{
+			ParseJob *job = &jobs[n_jobs++];
+
+			parse_cpu += job->elapsed;
+			if (job->book == NULL)
+			{
+				g_warning("Unable to parse book '%s': %s", job->path,
+						  job->error->message);
+				g_error_free(job->error);
+				continue;
+			}
+			slots[i] = job->book;
+		}
+		g_ptr_array_add(books, slots[i]);
+	}
+
+	g_debug("Devhelp: loaded %u books in %.1f ms, %u from the snapshot, "
+			"%u parsed in %.1f ms (%.1f ms of parsing) on %u threads, "
+			"%u stolen", books->len, (g_get_monotonic_time() - start) / 1000.0,
+			n_used, n_jobs, parse_wall / 1000.0, parse_cpu / 1000.0,
+			work_pool_get_n_threads(pool), work_pool_get_n_stolen(pool));
+
+	work_pool_free(pool);
+	g_free(jobs);
+	g_free(slots);
+
+	/* books that were removed also make the snapshot stale */
+	if (entries != NULL)
+	{
+		if (n_used != g_hash_table_size(entries))
+			dirty = TRUE;
+		g_hash_table_destroy(entries);
+	}
+	if (mapped != NULL)
+		g_mapped_file_unref(mapped);
+
+	if (out_dirty != NULL)
+		*out_dirty = dirty;
+
+	return books;
+}
+
+static void pad_to_8(GByteArray *buffer)
+{
+	static const guint8 zeros[8] = { 0 };
+	gsize padded = ALIGN8(buffer->len);
+
+	if (padded != buffer->len)
+		g_byte_array_append(buffer, zeros, padded - buffer->len);
+}
+
+/**
+ * Writes all books to the snapshot file.  The file is replaced atomically
+ * so any BookIndex still mapped from the old snapshot stays valid.
+ *
+ * @param snapshot_path	The snapshot file to write.
+ * @param books			Array of BookIndex to store.
+ * @param error			Return location for an error or NULL.
+ *
+ * @return	TRUE if the snapshot was written.
+ */
+gboolean index_snapshot_save(const gchar *snapshot_path, GPtrArray *books,
+							 GError **error)
+{
+	SnapshotHeader header;
+	SnapshotBook *entries;
+	GByteArray *buffer;
+	gboolean ok;
+	guint i;
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = SNAPSHOT_VERSION;
+	header.n_books = books->len;
+
+	buffer = g_byte_array_new();
+	g_byte_array_append(buffer, (const guint8 *) &header, sizeof(header));
+
+	/* entries are filled in as the data gets appended */
+	entries = g_new0(SnapshotBook, books->len);
+	g_byte_array_set_size(buffer, sizeof(header) + books->len * sizeof(SnapshotBook));
+
+	for (i = 0; i < books->len; i++)
+	{
+		const BookIndex *book = g_ptr_array_index(books, i);
+		SnapshotBook *entry = &entries[i];
+
+		entry->mtime = book->mtime;
+		entry->title = book->title;
+		entry->name = book->name;
+		entry->base = book->base;
+		entry->link = book->link;
+
+		entry->path = buffer->len;
+		entry->path_len = strlen(book->path);
+		g_byte_array_append(buffer, (const guint8 *) book->path, entry->path_len + 1);
+		pad_to_8(buffer);
+
+		entry->keywords = buffer->len;
+		entry->n_keywords = book->n_keywords;
+		if (book->n_keywords > 0)
+			g_byte_array_append(buffer, (const guint8 *) book->keywords,
+								book->n_keywords * sizeof(BookKeyword));
+		pad_to_8(buffer);
+
+		entry->chapters = buffer->len;
+		entry->n_chapters = book->n_chapters;
+		if (book->n_chapters > 0)
+			g_byte_array_append(buffer, (const guint8 *) book->chapters,
+								book->n_chapters * sizeof(BookChapter));
+		pad_to_8(buffer);
+
+		entry->strings = buffer->len;
+		entry->strings_len = book->strings_len;
+		g_byte_array_append(buffer, (const guint8 *) book->strings, book->strings_len);
+		pad_to_8(buffer);
+	}
+
+	memcpy(buffer->data + sizeof(header), entries, books->len * sizeof(SnapshotBook));
+	g_free(entries);
+
+	header.size = buffer->len;
+	snapshot_digest((const SnapshotBook *) (buffer->data + sizeof(header)),
+					books->len, header.digest);
+	memcpy(buffer->data, &header, sizeof(header));
+
+	ok = g_file_set_contents(snapshot_path, (const gchar *) buffer->data,
+							 buffer->len, error);
+	g_byte_array_free(buffer, TRUE);
+
+	return ok;
+}
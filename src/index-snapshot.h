@@ -0,0 +1,48 @@
+/*
+ * index-snapshot.h - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef INDEX_SNAPSHOT_H
+#define INDEX_SNAPSHOT_H
+
+#include <glib.h>
+#include "book-index.h"
+
+G_BEGIN_DECLS
+
+/*
+ * The snapshot is a binary dump of every BookIndex, keyed on each book
+ * file's path and modification time.  It's memory mapped when loading so
+ * books that haven't changed cost nothing to parse and only the pages that
+ * get used are ever read from disk.  Books that have changed are parsed
+ * again, in parallel, and the rest of the snapshot stays valid.  Each
+ * documentation provider has a snapshot of its own, see doc-provider.c.
+ *
+ * See index-snapshot.c for documentation for these functions
+ */
+
+GPtrArray *index_snapshot_load(const gchar *snapshot_path, gchar **book_files,
+							   BookParseFunc parse, gboolean *out_dirty);
+gboolean index_snapshot_save(const gchar *snapshot_path, GPtrArray *books,
+							 GError **error);
+
+G_END_DECLS
+
+#endif
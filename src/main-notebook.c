@@ -24,9 +24,124 @@
 #include "plugin.h"
 #include "main-notebook.h"
 
-static gboolean holds_main_notebook(GtkWidget *widget);
+/* Key of the registry on Geany's main window */
+#define REGISTRY_KEY	"main_notebook_registry"
+
+/* 
+ * Shared by every plugin using the main_notebook, it lives on the main
+ * window so plugins with their own copy of this file find the same one.
+ * Only ever add fields to the end of it.
+ */
+typedef struct
+{
+	gint ref_count;				/* plugins holding the notebook */
+	GtkWidget *notebook;		/* NULL once destroyed */
+	gulong destroy_id;
+	gboolean adopted;			/* made by a plugin without the registry */
+} MainNotebookRegistry;
+
 static GtkWidget *create_main_notebook(void);
 
+static MainNotebookRegistry *get_registry(void)
+{
+	return g_object_get_data(G_OBJECT(geany->main_widgets->window), REGISTRY_KEY);
+}
+
+/* Destroy notify of the registry, called when it's removed from the window
+ * or the window itself goes away */
+static void registry_free(gpointer data)
+{
+	MainNotebookRegistry *reg = data;
+	
+	if (reg->notebook != NULL)
+		g_signal_handler_disconnect(reg->notebook, reg->destroy_id);
+	g_free(reg);
+}
+
+/* Something other than main_notebook_release() destroyed the notebook */
+static void on_notebook_destroy(GtkWidget *notebook, gpointer user_data)
+{
+	MainNotebookRegistry *reg = user_data;
+	
+	reg->notebook = NULL;
+}
+
+/* 
+ * The main_notebook made by a plugin with an older copy of this file, which
+ * only hooks it up on the main window.  That key isn't cleared when the
+ * notebook is destroyed, so it only counts while it's still in the window.
+ */
+static GtkWidget *find_main_notebook(void)
+{
+	GtkWidget *notebook = g_object_get_data(G_OBJECT(geany->main_widgets->window),
+		"main_notebook");
+	
+	if (notebook != NULL && GTK_IS_NOTEBOOK(notebook) &&
+		gtk_widget_get_toplevel(notebook) == geany->main_widgets->window)
+		return notebook;
+	return NULL;
+}
+
+static MainNotebookRegistry *ensure_registry(void)
+{
+	MainNotebookRegistry *reg = get_registry();
+	
+	if (reg == NULL)
+	{
+		reg = g_new0(MainNotebookRegistry, 1);
+		g_object_set_data_full(G_OBJECT(geany->main_widgets->window),
+			REGISTRY_KEY, reg, registry_free);
+	}
+	return reg;
+}
+
+/* Gets the main_notebook, adopting one another plugin made or creating it */
+static GtkWidget *ensure_main_notebook(MainNotebookRegistry *reg)
+{
+	if (reg->notebook != NULL)
+		return reg->notebook;
+	
+	reg->notebook = find_main_notebook();
+	reg->adopted = (reg->notebook != NULL);
+	if (reg->notebook == NULL)
+		reg->notebook = create_main_notebook();
+	if (reg->notebook == NULL)
+		return NULL;
+	reg->destroy_id = g_signal_connect(reg->notebook, "destroy",
+		G_CALLBACK(on_notebook_destroy), reg);
+	
+	return reg->notebook;
+}
+
+/* 
+ * Drops the registry and puts Geany's UI back the way it was, unless the
+ * notebook belongs to a plugin that doesn't use the registry or still has
+ * pages other than the code one.  Plugins with an older copy of this file
+ * take no reference, so their pages are all that says they still use it;
+ * the notebook and its "main_notebook" key are left for them.
+ */
+static void remove_main_notebook(MainNotebookRegistry *reg)
+{
+	GtkWidget *main_notebook = reg->notebook, *doc_nb_parent, *vbox;
+	gboolean adopted = reg->adopted;
+	
+	/* frees reg */
+	g_object_set_data(G_OBJECT(geany->main_widgets->window), REGISTRY_KEY, NULL);
+	
+	if (main_notebook == NULL || adopted ||
+		gtk_notebook_get_n_pages(GTK_NOTEBOOK(main_notebook)) > 1)
+		return;
+	
+	g_object_set_data(G_OBJECT(geany->main_widgets->window), "main_notebook", NULL);
+	
+	doc_nb_parent = gtk_widget_get_parent(main_notebook);
+	
+	vbox = ui_lookup_widget(geany->main_widgets->window, "vbox1");
+	gtk_widget_reparent(geany->main_widgets->notebook, vbox);
+	gtk_widget_destroy(main_notebook);
+	gtk_widget_reparent(geany->main_widgets->notebook, doc_nb_parent);
+}
+
 /**
  * Checks to see if the main_notebook exists in Geany's UI.
  * 
@@ -34,106 +149,96 @@ static GtkWidget *create_main_notebook(void);
  */
 gboolean main_notebook_exists(void)
 {
-	return holds_main_notebook(geany->main_widgets->window);
+	MainNotebookRegistry *reg = get_registry();
+	
+	return (reg != NULL && reg->notebook != NULL) || find_main_notebook() != NULL;
 }
 
 /**
- * Checks to see if the notebook needs to be destroyed, as in whether it
- * even exists or if it only contains the code tab (ie. last tab).  This
- * function gets called from main_notebook_destroy() to ensure that you
- * can't pull the rug out from under another plugin using the notebook.
+ * Gets a reference to the main_notebook, creating it if no other plugin
+ * is using it yet.  A main_notebook made by a plugin with an older copy of
+ * this file is used rather than adding another one, and left to that
+ * plugin to remove.  Every call must be paired with a call to
+ * main_notebook_release().
  * 
- * @return	TRUE if there are no other plugins using the main notebook
- * 				and it's safe to destroy or FALSE if it should be left
- * 				alone.
+ * @return The main_notebook, or NULL if it couldn't be created.
  */
-gboolean main_notebook_needs_destroying(void)
+GtkWidget *main_notebook_acquire(void)
 {
-	if (main_notebook_exists())
-	{
-		GtkWidget *nb = main_notebook_get();
-		return (gtk_notebook_get_n_pages(GTK_NOTEBOOK(nb)) > 1) ? FALSE : TRUE;
-	}
-	return FALSE;
+	MainNotebookRegistry *reg = ensure_registry();
+	
+	if (ensure_main_notebook(reg) == NULL)
+		return NULL;
+	
+	reg->ref_count++;
+	
+	return reg->notebook;
 }
 
 /**
- * Puts Geany's UI back to the way it was before the main_notebook was
- * added in.  This function won't actually do anything if another plugin
- * is still using the main_notebook.
+ * Drops a reference taken with main_notebook_acquire().  When the last
+ * plugin lets go the main_notebook is removed and Geany's UI is put back
+ * to the way it was.
  */
-void main_notebook_destroy(void)
-{	
-	if (!main_notebook_needs_destroying())
+void main_notebook_release(void)
+{
+	MainNotebookRegistry *reg = get_registry();
+	
+	g_return_if_fail(reg != NULL && reg->ref_count > 0);
+	
+	if (--reg->ref_count > 0)
 		return;
-		
-	GtkWidget *main_notebook, *doc_nb_parent, *vbox;
-
-	main_notebook = ui_lookup_widget(geany->main_widgets->window, 
-									"main_notebook");
+	
+	remove_main_notebook(reg);
+}
 
-	doc_nb_parent = gtk_widget_get_parent(main_notebook);
+/**
+ * Checks whether releasing a reference would remove the main_notebook,
+ * that is whether this is the only plugin still using it.
+ * 
+ * @return	TRUE if there are no other plugins using the main notebook
+ * 				or FALSE if it will be left alone.
+ */
+gboolean main_notebook_needs_destroying(void)
+{
+	MainNotebookRegistry *reg = get_registry();
 	
-	vbox = ui_lookup_widget(geany->main_widgets->window, "vbox1");
-	gtk_widget_reparent(geany->main_widgets->notebook, vbox);
-	gtk_widget_destroy(main_notebook);
-	gtk_widget_reparent(geany->main_widgets->notebook, doc_nb_parent);
+	return reg != NULL && reg->notebook != NULL && !reg->adopted &&
+		reg->ref_count <= 1;
 }
 
 /**
- * Checks to see if the main_notebook already exists and if it does, it
- * returns a pointer to it, if not, it creates the main_notebook.  This 
- * function should be called by plugins wishing to use the main_notebook
- * to ensure that there is no conflict with other plugins.
+ * Gets the main_notebook, creating it if it doesn't exist, without taking
+ * a reference, kept for older callers.  Use main_notebook_acquire() so
+ * other plugins leave it alone while it's used.
  * 
- * @return The main_notebook that already existed or was created.  If
- * 			 there was a problem creating/getting the main_notebook,
- * 			 NULL is returned.
+ * @return The main_notebook, or NULL if it couldn't be created.
  */
 GtkWidget *main_notebook_get(void)
 {
-	if (main_notebook_exists())
-		return ui_lookup_widget(geany->main_widgets->window, "main_notebook");
-	else
-		return create_main_notebook();
+	return ensure_main_notebook(ensure_registry());
 }
 
-/* we need this since ui_lookup_widget() doesn't seem to realize when
- * the main_notebook widget is destroyed and so keeps returning something
- * even when main_notebook is gone. */
-static gboolean holds_main_notebook(GtkWidget *widget)
+/**
+ * Removes the main_notebook if no plugin holds a reference to it, kept
+ * for older callers paired with main_notebook_get().
+ */
+void main_notebook_destroy(void)
 {
-    gboolean found = FALSE;
-    const gchar *widget_name = gtk_widget_get_name(widget);
-    
-    if (widget_name != NULL && g_strcmp0(widget_name, "main_notebook") == 0)
-        found = TRUE;
-    if (GTK_IS_CONTAINER(widget))
-    {
-        GList *children, *iter;
-        
-        children = gtk_container_get_children(GTK_CONTAINER(widget));
-        
-        for (iter=children; !found && iter; iter=g_list_next(iter))
-            found = holds_main_notebook(iter->data);
-            
-        g_list_free(children);
-    }
-    
-    return found;
+	MainNotebookRegistry *reg = get_registry();
+	
+	if (reg != NULL && reg->ref_count == 0)
+		remove_main_notebook(reg);
 }
 
 /* 
- * Creates the main_notebook if it doesn't already exist and returns a
- * pointer to it.  If it does already exist, the function returns NULL.
+ * Creates the main_notebook and moves Geany's document notebook into its
+ * first page.
  */
 static GtkWidget *create_main_notebook(void)
 {
 	GtkWidget *main_notebook, *doc_nb_box, *doc_nb_parent, *code_label, *vbox;
 
-	if (main_notebook_exists())
-		return NULL;
-	
 	code_label = gtk_label_new(_("Code"));
 	main_notebook = gtk_notebook_new();
 	doc_nb_box = gtk_vbox_new(FALSE, 0);
@@ -25,16 +25,19 @@
 #include <gtk/gtk.h>
 
 /* 
- * When you need the main_notebook, you call main_notebook_get() which 
+ * When you need the main_notebook, you call main_notebook_acquire() which 
  * will get an existing main_notebook or create one if it doesn't exist.  
- * When you are done with the main_notebook, call main_notebook_destroy() 
+ * When you are done with the main_notebook, call main_notebook_release() 
  * and it will be destroyed and the UI will be put back to normal only 
- * if no other plugins are still using it.
+ * if no other plugins are still using it.  The reference count is kept
+ * on Geany's main window so it's shared by every plugin using this file.
  * 
  * See main-notebook.c for documentation for these functions
  */
 
 gboolean main_notebook_exists(void);
+GtkWidget *main_notebook_acquire(void);
+void main_notebook_release(void);
 GtkWidget *main_notebook_get(void);
 gboolean main_notebook_needs_destroying(void);
 void main_notebook_destroy(void);
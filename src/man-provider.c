@@ -0,0 +1,453 @@
+/*
+ * man-provider.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+/*
+ * The manual pages, one book per section directory (man3 and so on) of
+ * each man directory.  Indexing only reads the directories, the name of a
+ * page file is all there is to know about it, and a section directory's
+ * modification time changes whenever a page is installed or removed, so
+ * it's what the snapshot keys the book on.  Pages are formatted by man
+ * when they're opened.
+ */
+
+#include <string.h>
+
+#include <glib.h>
+#include <gio/gio.h>
+
+#include "book-index.h"
+#include "doc-provider.h"
+
+#define MAN_SCHEME			"man"
+#define MAN_URI_PREFIX		MAN_SCHEME "://"
+
+/* columns man formats pages to */
+#define MAN_WIDTH			"80"
+
+/* what compressed pages end with */
+static const gchar *compression_suffixes[] = {
+	".gz", ".bz2", ".xz", ".lzma", ".zst", ".Z", NULL
+};
+
+/* environment variables overridden when running man */
+static const gchar *man_env[] = {
+	"MANPAGER=cat",
+	"PAGER=cat",
+	"MANWIDTH=" MAN_WIDTH,
+	"MAN_KEEP_FORMATTING=1",	/* keep the overstrikes for bold... */
+	"GROFF_NO_SGR=1",			/* ...rather than escape sequences */
+	NULL
+};
+
+typedef enum
+{
+	MAN_STYLE_NONE,
+	MAN_STYLE_BOLD,
+	MAN_STYLE_ITALIC
+} ManStyle;
+
+/*
+ * Splits a page file name such as "printf.3.gz" into the page name and
+ * section, returns FALSE if it isn't one.
+ */
+static gboolean split_page_name(const gchar *file_name, gchar **name,
+								gchar **section)
+{
+	gsize len = strlen(file_name);
+	const gchar *dot;
+	guint i;
+
+	for (i = 0; compression_suffixes[i] != NULL; i++)
+	{
+		if (g_str_has_suffix(file_name, compression_suffixes[i]))
+		{
+			len -= strlen(compression_suffixes[i]);
+			break;
+		}
+	}
+
+	dot = g_strrstr_len(file_name, len, ".");
+	if (file_name[0] == '.' || dot == NULL || dot == file_name ||
+		dot == file_name + len - 1)
+		return FALSE;
+
+	*name = g_strndup(file_name, dot - file_name);
+	*section = g_strndup(dot + 1, file_name + len - dot - 1);
+
+	return TRUE;
+}
+
+/* Man directories in MANPATH, or the usual places if it isn't set */
+static gchar **man_get_dirs(void)
+{
+	const gchar * const *system_dirs;
+	const gchar *manpath = g_getenv("MANPATH");
+	GPtrArray *dirs = g_ptr_array_new();
+	guint i;
+
+	if (manpath != NULL && manpath[0] != '\0')
+	{
+		gchar **paths = g_strsplit(manpath, G_SEARCHPATH_SEPARATOR_S, -1);
+
+		/* empty entries stand for man's defaults, which aren't known here */
+		for (i = 0; paths[i] != NULL; i++)
+		{
+			if (paths[i][0] != '\0')
+				g_ptr_array_add(dirs, g_strdup(paths[i]));
+		}
+		g_strfreev(paths);
+	}
+	else
+	{
+		g_ptr_array_add(dirs, g_build_filename(g_get_user_data_dir(), "man", NULL));
+		system_dirs = g_get_system_data_dirs();
+		for (i = 0; system_dirs[i] != NULL; i++)
+			g_ptr_array_add(dirs, g_build_filename(system_dirs[i], "man", NULL));
+	}
+
+	g_ptr_array_add(dirs, NULL);
+
+	return (gchar **) g_ptr_array_free(dirs, FALSE);
+}
+
+static gint compare_strings(gconstpointer a, gconstpointer b)
+{
+	return strcmp(*(const gchar * const *) a, *(const gchar * const *) b);
+}
+
+/* The man:// URI of a page, escaped so spaces, '%' and '#' in its path
+ * survive WebKit parsing it */
+static gchar *man_page_uri(const gchar *dir, const gchar *file_name)
+{
+	gchar *path = g_build_filename(dir, file_name, NULL);
+	gchar *escaped = g_uri_escape_string(path,
+		G_URI_RESERVED_CHARS_ALLOWED_IN_PATH, FALSE);
+	gchar *uri = g_strconcat(MAN_URI_PREFIX, escaped, NULL);
+
+	g_free(escaped);
+	g_free(path);
+	return uri;
+}
+
+/* The section directories of every man directory, localized ones aside */
+static gchar **man_find_files(void)
+{
+	GHashTable *seen;
+	GPtrArray *files, *sections;
+	gchar **dirs;
+	guint i, j;
+
+	seen = g_hash_table_new(g_str_hash, g_str_equal);
+	files = g_ptr_array_new();
+	sections = g_ptr_array_new();
+
+	dirs = man_get_dirs();
+	for (i = 0; dirs[i] != NULL; i++)
+	{
+		GDir *gdir = g_dir_open(dirs[i], 0, NULL);
+		const gchar *name;
+
+		/* the same directory can be listed more than once */
+		if (gdir == NULL || g_hash_table_lookup(seen, dirs[i]) != NULL)
+		{
+			if (gdir != NULL)
+				g_dir_close(gdir);
+			continue;
+		}
+		g_hash_table_insert(seen, dirs[i], GINT_TO_POINTER(1));
+
+		while ((name = g_dir_read_name(gdir)) != NULL)
+		{
+			gchar *path;
+
+			if (!g_str_has_prefix(name, "man") || name[3] == '\0')
+				continue;
+
+			path = g_build_filename(dirs[i], name, NULL);
+			if (g_file_test(path, G_FILE_TEST_IS_DIR))
+				g_ptr_array_add(sections, path);
+			else
+				g_free(path);
+		}
+		g_dir_close(gdir);
+
+		g_ptr_array_sort(sections, compare_strings);
+		for (j = 0; j < sections->len; j++)
+			g_ptr_array_add(files, g_ptr_array_index(sections, j));
+		g_ptr_array_set_size(sections, 0);
+	}
+
+	g_ptr_array_free(sections, TRUE);
+	g_hash_table_destroy(seen);
+	g_strfreev(dirs);
+	g_ptr_array_add(files, NULL);
+
+	return (gchar **) g_ptr_array_free(files, FALSE);
+}
+
+/* Makes a book of the pages in one section directory */
+static BookIndex *man_parse_file(const gchar *path, gint64 mtime,
+								 GError **error)
+{
+	BookBuilder *builder;
+	GPtrArray *pages;
+	GDir *gdir;
+	const gchar *file_name;
+	gchar *dir_name, *root, *title, *intro = NULL;
+	guint i;
+
+	gdir = g_dir_open(path, 0, error);
+	if (gdir == NULL)
+		return NULL;
+
+	pages = g_ptr_array_new_with_free_func(g_free);
+	while ((file_name = g_dir_read_name(gdir)) != NULL)
+		g_ptr_array_add(pages, g_strdup(file_name));
+	g_dir_close(gdir);
+	g_ptr_array_sort(pages, compare_strings);
+
+	/* intro(N) is the closest thing a section has to a front page */
+	for (i = 0; i < pages->len && intro == NULL; i++)
+	{
+		file_name = g_ptr_array_index(pages, i);
+		if (g_str_has_prefix(file_name, "intro."))
+			intro = man_page_uri(path, file_name);
+	}
+
+	dir_name = g_path_get_basename(path);
+	root = g_path_get_dirname(path);
+	title = g_strdup_printf("Manual pages, section %s (%s)", dir_name + 3, root);
+	builder = book_builder_new(title, dir_name, path, intro);
+	g_free(title);
+	g_free(root);
+	g_free(intro);
+
+	for (i = 0; i < pages->len; i++)
+	{
+		gchar *name, *section, *link;
+		BookKeywordType type = BOOK_KEYWORD_OTHER;
+
+		file_name = g_ptr_array_index(pages, i);
+		if (!split_page_name(file_name, &name, &section))
+			continue;
+
+		/* system calls and library functions, mostly */
+		if (section[0] == '2' || section[0] == '3')
+			type = BOOK_KEYWORD_FUNCTION;
+
+		link = man_page_uri(path, file_name);
+		book_builder_add_keyword(builder, name, link, type);
+		g_free(link);
+		g_free(name);
+		g_free(section);
+	}
+
+	g_ptr_array_free(pages, TRUE);
+	g_free(dir_name);
+
+	return book_builder_finish(builder, path, mtime);
+}
+
+static void append_escaped(GString *html, const gchar *text, gsize len)
+{
+	gsize i;
+
+	for (i = 0; i < len; i++)
+	{
+		switch (text[i])
+		{
+			case '&':	g_string_append(html, "&amp;"); break;
+			case '<':	g_string_append(html, "&lt;"); break;
+			case '>':	g_string_append(html, "&gt;"); break;
+			default:	g_string_append_c(html, text[i]); break;
+		}
+	}
+}
+
+static void append_style(GString *html, ManStyle from, ManStyle to)
+{
+	static const gchar *closing[] = { "", "</b>", "</i>" };
+	static const gchar *opening[] = { "", "<b>", "<i>" };
+
+	g_string_append(html, closing[from]);
+	g_string_append(html, opening[to]);
+}
+
+/* Makes man's output valid UTF-8, it's in the locale's encoding */
+static gchar *man_output_to_utf8(gchar *output)
+{
+	gchar *converted;
+
+	if (g_utf8_validate(output, -1, NULL))
+		return output;
+
+	converted = g_locale_to_utf8(output, -1, NULL, NULL, NULL);
+	if (converted == NULL)
+		converted = g_convert_with_fallback(output, -1, "UTF-8", "ISO-8859-1",
+											"?", NULL, NULL, NULL);
+	g_free(output);
+
+	return converted;
+}
+
+/*
+ * Turns what man wrote to a terminal into HTML, text must be valid UTF-8.
+ * Bold is the character struck over itself, "c\bc", underlining is "_\bc"
+ * which is shown as italic like browsers show man pages.
+ */
+static void append_man_text(GString *html, const gchar *text)
+{
+	const gchar *p = text;
+	ManStyle style = MAN_STYLE_NONE;
+
+	while (*p != '\0')
+	{
+		const gchar *c = p, *next = g_utf8_next_char(p);
+		ManStyle c_style = MAN_STYLE_NONE;
+
+		/* the last character struck is the one that shows */
+		while (next[0] == '\b' && next[1] != '\0')
+		{
+			const gchar *over = next + 1;
+			const gchar *after = g_utf8_next_char(over);
+
+			if (after - over == next - c && memcmp(c, over, next - c) == 0)
+				c_style = MAN_STYLE_BOLD;
+			else if (*c == '_')
+				c_style = MAN_STYLE_ITALIC;
+			c = over;
+			next = after;
+		}
+
+		if (c_style != style)
+		{
+			append_style(html, style, c_style);
+			style = c_style;
+		}
+		append_escaped(html, c, next - c);
+		p = next;
+	}
+
+	append_style(html, style, MAN_STYLE_NONE);
+}
+
+/* The environment with the man_env variables replaced */
+static gchar **man_environment(void)
+{
+	GPtrArray *env = g_ptr_array_new();
+	gchar **names = g_listenv();
+	guint i, j;
+
+	for (i = 0; names[i] != NULL; i++)
+	{
+		gsize len = strlen(names[i]);
+		gboolean overridden = FALSE;
+
+		for (j = 0; man_env[j] != NULL && !overridden; j++)
+			overridden = (strncmp(man_env[j], names[i], len) == 0 &&
+						  man_env[j][len] == '=');
+		if (!overridden)
+			g_ptr_array_add(env, g_strconcat(names[i], "=",
+											 g_getenv(names[i]), NULL));
+	}
+	for (j = 0; man_env[j] != NULL; j++)
+		g_ptr_array_add(env, g_strdup(man_env[j]));
+	g_strfreev(names);
+	g_ptr_array_add(env, NULL);
+
+	return (gchar **) g_ptr_array_free(env, FALSE);
+}
+
+/* Formats the page of a man:// URI with man and wraps it up as HTML */
+static gchar *man_render_page(const gchar *uri, GError **error)
+{
+	gchar *argv[] = { "man", "-l", NULL, NULL };
+	gchar **envp;
+	gchar *path = NULL, *output = NULL, *base, *name, *section;
+	gint status;
+	gboolean ok;
+	GString *html;
+
+	if (g_str_has_prefix(uri, MAN_URI_PREFIX))
+		path = g_uri_unescape_string(uri + strlen(MAN_URI_PREFIX), NULL);
+	if (path == NULL || !g_path_is_absolute(path))
+	{
+		g_set_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_ARGUMENT,
+					"'%s' isn't a manual page", uri);
+		g_free(path);
+		return NULL;
+	}
+
+	argv[2] = path;
+	envp = man_environment();
+	ok = g_spawn_sync(NULL, argv, envp,
+					  G_SPAWN_SEARCH_PATH | G_SPAWN_STDERR_TO_DEV_NULL,
+					  NULL, NULL, &output, NULL, &status, error);
+	g_strfreev(envp);
+	if (!ok)
+	{
+		g_free(path);
+		return NULL;
+	}
+
+	if (status != 0 || output[0] == '\0')
+	{
+		g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED,
+					"man couldn't format '%s'", path);
+		g_free(output);
+		g_free(path);
+		return NULL;
+	}
+	output = man_output_to_utf8(output);
+
+	html = g_string_sized_new(strlen(output) + 256);
+	base = g_path_get_basename(path);
+	g_free(path);
+	if (split_page_name(base, &name, &section))
+	{
+		g_string_append(html, "<html><head><title>");
+		append_escaped(html, name, strlen(name));
+		g_string_append_c(html, '(');
+		append_escaped(html, section, strlen(section));
+		g_string_append(html, ")</title></head>\n");
+		g_free(name);
+		g_free(section);
+	}
+	else
+		g_string_append(html, "<html><head></head>\n");
+	g_free(base);
+
+	g_string_append(html, "<body><pre>");
+	append_man_text(html, output);
+	g_string_append(html, "</pre></body></html>\n");
+	g_free(output);
+
+	return g_string_free(html, FALSE);
+}
+
+const DocProvider man_provider = {
+	"man",
+	man_get_dirs,
+	man_find_files,
+	man_parse_file,
+	MAN_SCHEME,
+	man_render_page
+};
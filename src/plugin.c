@@ -24,10 +24,12 @@
 #include <gtk/gtk.h>
 #include <gdk/gdkkeysyms.h> /* for keybindings */
 #include <geanyplugin.h>
-#include <devhelp/dh-search.h>
 
 #include "plugin.h"
 #include "devhelpplugin.h"
+#include "stats.h"
+
+#define STATS_FILE "stats.json"
 
 PLUGIN_VERSION_CHECK(200)
 
@@ -44,8 +46,20 @@ DevhelpPlugin *dev_help_plugin = NULL;
 
 static gchar *default_config = NULL;
 static gchar *user_config = NULL;
+static gchar *user_config_dir = NULL;
 static gboolean move_sidebar_tabs_bottom;
 static gboolean show_in_msg_window;
+static gint webview_idle_timeout;
+static gint webview_max_views;
+static gint webview_max_memory;
+static gboolean prefetch_on_idle;
+static gboolean fulltext_search;
+static gboolean hover_tooltips;
+static gboolean index_daemon;
+static gboolean stats_on;
+static gint stats_threshold;
+static gint prefetch_delay;
+static GHashTable *filetype_books = NULL;	/* filetype -> book names */
 
 /* keybindings */
 enum
@@ -53,6 +67,8 @@ enum
 	KB_DEVHELP_TOGGLE_CONTENTS,
 	KB_DEVHELP_TOGGLE_SEARCH,
 	KB_DEVHELP_SEARCH_SYMBOL,
+	KB_DEVHELP_OPEN_SYMBOL,
+	KB_DEVHELP_DUMP_STATS,
 	KB_COUNT
 };
 
@@ -71,12 +87,38 @@ static void kb_activate(guint key_id)
 		{
 			gchar *current_tag = devhelp_plugin_get_current_tag();
 			if (current_tag == NULL) return;
-			dh_search_set_search_string(
-				DH_SEARCH(dev_help_plugin->search), current_tag, NULL);
+			devhelp_plugin_search(dev_help_plugin, current_tag);
 			devhelp_plugin_activate_tabs(dev_help_plugin, FALSE);
+			if (dev_help_plugin->tabs_toggled)
+				devhelp_plugin_open_prefetched(dev_help_plugin, current_tag);
 			g_free(current_tag);
 			break;
 		}
+		case KB_DEVHELP_OPEN_SYMBOL:
+		{
+			gchar *current_tag = devhelp_plugin_get_current_tag();
+			if (current_tag == NULL) return;
+			devhelp_plugin_open_symbol(dev_help_plugin, current_tag);
+			g_free(current_tag);
+			break;
+		}
+		case KB_DEVHELP_DUMP_STATS:
+		{
+			GError *error = NULL;
+			gchar *path;
+			if (user_config_dir == NULL) return;
+			path = g_build_filename(user_config_dir, STATS_FILE, NULL);
+			if (stats_dump(path, &error))
+				ui_set_statusbar(TRUE, _("Devhelp statistics written to '%s'"), path);
+			else
+			{
+				ui_set_statusbar(TRUE, _("Unable to write Devhelp statistics: %s"),
+								 error->message);
+				g_error_free(error);
+			}
+			g_free(path);
+			break;
+		}
 	}
 }
 
@@ -93,22 +135,76 @@ show_in_msg_window_toggled(GtkToggleButton *togglebutton, gpointer user_data)
 {
 	show_in_msg_window = gtk_toggle_button_get_active(
 								GTK_TOGGLE_BUTTON(togglebutton));
+	devhelp_plugin_set_in_message_window(dev_help_plugin, show_in_msg_window);
+}
+
+static void 
+webview_idle_timeout_changed(GtkSpinButton *spinbutton, gpointer user_data)
+{
+	webview_idle_timeout = gtk_spin_button_get_value_as_int(spinbutton);
+	devhelp_plugin_set_webview_idle_timeout(dev_help_plugin, webview_idle_timeout);
+}
+
+static void 
+webview_limits_changed(GtkSpinButton *spinbutton, gpointer user_data)
+{
+	gint *setting = user_data;
+	
+	*setting = gtk_spin_button_get_value_as_int(spinbutton);
+	devhelp_plugin_set_webview_limits(dev_help_plugin, webview_max_views,
+									  webview_max_memory);
+}
+
+static void 
+prefetch_on_idle_toggled(GtkToggleButton *togglebutton, gpointer user_data)
+{
+	prefetch_on_idle = gtk_toggle_button_get_active(
+								GTK_TOGGLE_BUTTON(togglebutton));
+	devhelp_plugin_set_prefetch(dev_help_plugin, prefetch_on_idle, prefetch_delay);
+}
+
+static void 
+fulltext_search_toggled(GtkToggleButton *togglebutton, gpointer user_data)
+{
+	fulltext_search = gtk_toggle_button_get_active(
+								GTK_TOGGLE_BUTTON(togglebutton));
+	devhelp_plugin_set_fulltext(dev_help_plugin, fulltext_search);
+}
+
+static void 
+hover_tooltips_toggled(GtkToggleButton *togglebutton, gpointer user_data)
+{
+	hover_tooltips = gtk_toggle_button_get_active(
+								GTK_TOGGLE_BUTTON(togglebutton));
+	devhelp_plugin_set_hover_tooltips(dev_help_plugin, hover_tooltips);
+}
+
+static void 
+index_daemon_toggled(GtkToggleButton *togglebutton, gpointer user_data)
+{
+	/* the books are already loaded one way or the other */
+	index_daemon = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(togglebutton));
+}
+
+static void 
+stats_on_toggled(GtkToggleButton *togglebutton, gpointer user_data)
+{
+	stats_on = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(togglebutton));
+	stats_set_enabled(stats_on);
+}
+
+static void 
+stats_threshold_changed(GtkSpinButton *spinbutton, gpointer user_data)
+{
+	stats_threshold = gtk_spin_button_get_value_as_int(spinbutton);
+	stats_set_threshold(stats_threshold);
 }
 
 static void 
 configure_dialog_response(GtkDialog *dialog, gint response_id, gpointer user_data)
 {
-	static gboolean message_shown = FALSE;
-	if (response_id == GTK_RESPONSE_OK || response_id == GTK_RESPONSE_APPLY) {
+	if (response_id == GTK_RESPONSE_OK || response_id == GTK_RESPONSE_APPLY)
 		plugin_store_preferences();
-		if (!message_shown) 
-		{
-			dialogs_show_msgbox(GTK_MESSAGE_INFO, "Settings for whether to use "
-				"the message window or not will only take effect upon "
-				"reloading the Devhelp plugin or restarting Geany.");
-			message_shown = TRUE;
-		}
-	}
 }
 
 gint plugin_load_preferences()
@@ -119,6 +215,11 @@ gint plugin_load_preferences()
 	
 	kf = g_key_file_new();
 	
+	if (filetype_books == NULL)
+		filetype_books = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+											   (GDestroyNotify) g_strfreev);
+	g_hash_table_remove_all(filetype_books);
+	
 	error = NULL;
 	if (!g_key_file_load_from_file(kf, user_config, G_KEY_FILE_NONE, &error))
 	{
@@ -155,6 +256,156 @@ gint plugin_load_preferences()
 		rcode++;
 	}
 	
+	error = NULL;
+	webview_idle_timeout = g_key_file_get_integer(kf, "general",
+												  "webview_idle_timeout",
+												  &error);
+	if (error)
+	{
+		g_warning("Unable to load 'webview_idle_timeout' setting: %s",
+				  error->message);
+		g_error_free(error);
+		error = NULL;
+		webview_idle_timeout = 0;
+		rcode++;
+	}
+	
+	error = NULL;
+	webview_max_views = g_key_file_get_integer(kf, "general",
+											   "webview_max_views",
+											   &error);
+	if (error)
+	{
+		g_warning("Unable to load 'webview_max_views' setting: %s",
+				  error->message);
+		g_error_free(error);
+		error = NULL;
+		webview_max_views = 4;
+		rcode++;
+	}
+	
+	error = NULL;
+	webview_max_memory = g_key_file_get_integer(kf, "general",
+												"webview_max_memory",
+												&error);
+	if (error)
+	{
+		g_warning("Unable to load 'webview_max_memory' setting: %s",
+				  error->message);
+		g_error_free(error);
+		error = NULL;
+		webview_max_memory = 256;
+		rcode++;
+	}
+	
+	error = NULL;
+	prefetch_on_idle = g_key_file_get_boolean(kf, "general",
+											  "prefetch_on_idle",
+											  &error);
+	if (error)
+	{
+		g_warning("Unable to load 'prefetch_on_idle' setting: %s",
+				  error->message);
+		g_error_free(error);
+		error = NULL;
+		rcode++;
+	}
+	
+	error = NULL;
+	prefetch_delay = g_key_file_get_integer(kf, "general",
+											"prefetch_delay",
+											&error);
+	if (error)
+	{
+		g_warning("Unable to load 'prefetch_delay' setting: %s",
+				  error->message);
+		g_error_free(error);
+		error = NULL;
+		prefetch_delay = 500;
+		rcode++;
+	}
+	
+	error = NULL;
+	fulltext_search = g_key_file_get_boolean(kf, "general",
+											 "fulltext_search",
+											 &error);
+	if (error)
+	{
+		g_warning("Unable to load 'fulltext_search' setting: %s",
+				  error->message);
+		g_error_free(error);
+		error = NULL;
+		fulltext_search = TRUE;
+		rcode++;
+	}
+	
+	error = NULL;
+	hover_tooltips = g_key_file_get_boolean(kf, "general",
+											"hover_tooltips",
+											&error);
+	if (error)
+	{
+		g_warning("Unable to load 'hover_tooltips' setting: %s",
+				  error->message);
+		g_error_free(error);
+		error = NULL;
+		hover_tooltips = TRUE;
+		rcode++;
+	}
+	
+	error = NULL;
+	index_daemon = g_key_file_get_boolean(kf, "general", "index_daemon", &error);
+	if (error)
+	{
+		g_warning("Unable to load 'index_daemon' setting: %s",
+				  error->message);
+		g_error_free(error);
+		error = NULL;
+		index_daemon = FALSE;
+		rcode++;
+	}
+	
+	error = NULL;
+	stats_on = g_key_file_get_boolean(kf, "general", "stats_enabled", &error);
+	if (error)
+	{
+		g_warning("Unable to load 'stats_enabled' setting: %s",
+				  error->message);
+		g_error_free(error);
+		error = NULL;
+		stats_on = FALSE;
+		rcode++;
+	}
+	
+	error = NULL;
+	stats_threshold = g_key_file_get_integer(kf, "general", "stats_threshold",
+											 &error);
+	if (error)
+	{
+		g_warning("Unable to load 'stats_threshold' setting: %s",
+				  error->message);
+		g_error_free(error);
+		error = NULL;
+		stats_threshold = 0;
+		rcode++;
+	}
+	
+	/* the books each filetype is looked up in, eg. Python=python*;pygobject */
+	if (g_key_file_has_group(kf, "filetype_books"))
+	{
+		gchar **filetypes = g_key_file_get_keys(kf, "filetype_books", NULL, NULL);
+		guint i;
+		
+		for (i = 0; filetypes != NULL && filetypes[i] != NULL; i++)
+		{
+			gchar **books = g_key_file_get_string_list(kf, "filetype_books",
+													   filetypes[i], NULL, NULL);
+			if (books != NULL)
+				g_hash_table_insert(filetype_books, g_strdup(filetypes[i]), books);
+		}
+		g_strfreev(filetypes);
+	}
+	
 	g_key_file_free(kf);
 	
 	return rcode;	
@@ -165,6 +416,8 @@ gint plugin_store_preferences()
 	gchar *config_text;
 	GError *error;
 	GKeyFile *kf;
+	GHashTableIter iter;
+	gpointer key, value;
 	gint rcode=0;
 	
 	kf = g_key_file_new();
@@ -174,6 +427,32 @@ gint plugin_store_preferences()
 						   move_sidebar_tabs_bottom);
 	g_key_file_set_boolean(kf, "general", "show_in_message_window",
 						   show_in_msg_window);
+	g_key_file_set_integer(kf, "general", "webview_idle_timeout",
+						   webview_idle_timeout);
+	g_key_file_set_integer(kf, "general", "webview_max_views",
+						   webview_max_views);
+	g_key_file_set_integer(kf, "general", "webview_max_memory",
+						   webview_max_memory);
+	g_key_file_set_boolean(kf, "general", "prefetch_on_idle",
+						   prefetch_on_idle);
+	g_key_file_set_integer(kf, "general", "prefetch_delay",
+						   prefetch_delay);
+	g_key_file_set_boolean(kf, "general", "fulltext_search",
+						   fulltext_search);
+	g_key_file_set_boolean(kf, "general", "hover_tooltips",
+						   hover_tooltips);
+	g_key_file_set_boolean(kf, "general", "index_daemon",
+						   index_daemon);
+	g_key_file_set_boolean(kf, "general", "stats_enabled",
+						   stats_on);
+	g_key_file_set_integer(kf, "general", "stats_threshold",
+						   stats_threshold);
+	
+	g_hash_table_iter_init(&iter, filetype_books);
+	while (g_hash_table_iter_next(&iter, &key, &value))
+		g_key_file_set_string_list(kf, "filetype_books", key,
+								   (const gchar * const *) value,
+								   g_strv_length(value));
 	
 	config_text = g_key_file_to_data(kf, NULL, NULL);
 	g_key_file_free(kf);
@@ -192,9 +471,14 @@ gint plugin_store_preferences()
 	return rcode;	
 }
 
+/* Directory holding devhelp.conf and the plugin's caches */
+const gchar *plugin_get_config_dir()
+{
+	return user_config_dir;
+}
+
 gboolean plugin_config_init()
 {
-	gchar *user_config_dir;
 	gboolean rcode = TRUE;
 	
 	default_config = g_build_path(G_DIR_SEPARATOR_S,
@@ -217,9 +501,9 @@ gboolean plugin_config_init()
 	if (g_mkdir_with_parents(user_config_dir, S_IRUSR | S_IWUSR | S_IXUSR) != 0) {
 		g_warning(_("Unable to create config dir at '%s'"), user_config_dir);
 		g_free(user_config_dir);
+		user_config_dir = NULL;
 		return FALSE;
 	}
-	g_free(user_config_dir);
 	
 	/* copy default config into user config if it doesn't exist */
 	if (!g_file_test(user_config, G_FILE_TEST_EXISTS))
@@ -252,6 +536,7 @@ gboolean plugin_config_init()
 
 GtkWidget *plugin_configure(GtkDialog *dialog)
 {
+	GtkWidget *hbox, *label, *spin_button;
 	GtkWidget *vbox = gtk_vbox_new(FALSE, 6);
 	
 	GtkWidget *check_button = gtk_check_button_new_with_label(
@@ -266,6 +551,73 @@ GtkWidget *plugin_configure(GtkDialog *dialog)
 	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(check_button), show_in_msg_window);
 	g_signal_connect(check_button, "toggled", G_CALLBACK(show_in_msg_window_toggled), NULL);
 	
+	hbox = gtk_hbox_new(FALSE, 6);
+	label = gtk_label_new(_("Unload documentation view after (seconds, 0 = never):"));
+	spin_button = gtk_spin_button_new_with_range(0, 86400, 30);
+	gtk_spin_button_set_value(GTK_SPIN_BUTTON(spin_button), webview_idle_timeout);
+	gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(hbox), spin_button, FALSE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, TRUE, 0);
+	g_signal_connect(spin_button, "value-changed", G_CALLBACK(webview_idle_timeout_changed), NULL);
+	
+	hbox = gtk_hbox_new(FALSE, 6);
+	label = gtk_label_new(_("Documentation tabs kept loaded:"));
+	spin_button = gtk_spin_button_new_with_range(1, 64, 1);
+	gtk_spin_button_set_value(GTK_SPIN_BUTTON(spin_button), webview_max_views);
+	gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(hbox), spin_button, FALSE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, TRUE, 0);
+	g_signal_connect(spin_button, "value-changed", G_CALLBACK(webview_limits_changed), &webview_max_views);
+	
+	hbox = gtk_hbox_new(FALSE, 6);
+	label = gtk_label_new(_("Memory for documentation tabs (MB, 0 = no limit):"));
+	spin_button = gtk_spin_button_new_with_range(0, 8192, 32);
+	gtk_spin_button_set_value(GTK_SPIN_BUTTON(spin_button), webview_max_memory);
+	gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(hbox), spin_button, FALSE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, TRUE, 0);
+	g_signal_connect(spin_button, "value-changed", G_CALLBACK(webview_limits_changed), &webview_max_memory);
+	
+	check_button = gtk_check_button_new_with_label(
+						_("Preload documentation for the symbol under the cursor."));
+	gtk_box_pack_start(GTK_BOX(vbox), check_button, FALSE, TRUE, 0);
+	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(check_button), prefetch_on_idle);
+	g_signal_connect(check_button, "toggled", G_CALLBACK(prefetch_on_idle_toggled), NULL);
+	
+	check_button = gtk_check_button_new_with_label(
+						_("Index the text of documentation pages for searching."));
+	gtk_box_pack_start(GTK_BOX(vbox), check_button, FALSE, TRUE, 0);
+	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(check_button), fulltext_search);
+	g_signal_connect(check_button, "toggled", G_CALLBACK(fulltext_search_toggled), NULL);
+	
+	check_button = gtk_check_button_new_with_label(
+						_("Show a summary of the documentation when hovering over a symbol."));
+	gtk_box_pack_start(GTK_BOX(vbox), check_button, FALSE, TRUE, 0);
+	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(check_button), hover_tooltips);
+	g_signal_connect(check_button, "toggled", G_CALLBACK(hover_tooltips_toggled), NULL);
+	
+	check_button = gtk_check_button_new_with_label(
+						_("Share one documentation index between Geany windows "
+						  "(takes effect after a restart)."));
+	gtk_box_pack_start(GTK_BOX(vbox), check_button, FALSE, TRUE, 0);
+	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(check_button), index_daemon);
+	g_signal_connect(check_button, "toggled", G_CALLBACK(index_daemon_toggled), NULL);
+	
+	check_button = gtk_check_button_new_with_label(
+						_("Record how long documentation operations take."));
+	gtk_box_pack_start(GTK_BOX(vbox), check_button, FALSE, TRUE, 0);
+	gtk_toggle_button_set_active(GTK_TOGGLE_BUTTON(check_button), stats_on);
+	g_signal_connect(check_button, "toggled", G_CALLBACK(stats_on_toggled), NULL);
+	
+	hbox = gtk_hbox_new(FALSE, 6);
+	label = gtk_label_new(_("Log recorded operations slower than (ms, 0 = never):"));
+	spin_button = gtk_spin_button_new_with_range(0, 60000, 50);
+	gtk_spin_button_set_value(GTK_SPIN_BUTTON(spin_button), stats_threshold);
+	gtk_box_pack_start(GTK_BOX(hbox), label, FALSE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(hbox), spin_button, FALSE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, TRUE, 0);
+	g_signal_connect(spin_button, "value-changed", G_CALLBACK(stats_threshold_changed), NULL);
+	
 	g_signal_connect(dialog, "response", G_CALLBACK(configure_dialog_response), NULL);
 	
 	return vbox;
@@ -274,14 +626,34 @@ GtkWidget *plugin_configure(GtkDialog *dialog)
 void plugin_init(GeanyData *data)
 {
 	GeanyKeyGroup *key_group;
+	GHashTableIter iter;
+	gpointer key, value;
+	gint64 start = g_get_monotonic_time();
 
 	plugin_module_make_resident(geany_plugin);
+	
+	/* books are loaded in a separate thread */
+	if (!g_thread_supported())
+		g_thread_init(NULL);
 
 	plugin_config_init();				   
 	plugin_load_preferences();
+	stats_set_enabled(stats_on);
+	stats_set_threshold(stats_threshold);
 	
 	dev_help_plugin = devhelp_plugin_new(move_sidebar_tabs_bottom,
-										 show_in_msg_window);
+										 show_in_msg_window, index_daemon);
+	devhelp_plugin_set_webview_idle_timeout(dev_help_plugin, webview_idle_timeout);
+	devhelp_plugin_set_webview_limits(dev_help_plugin, webview_max_views,
+									  webview_max_memory);
+	devhelp_plugin_set_prefetch(dev_help_plugin, prefetch_on_idle, prefetch_delay);
+	devhelp_plugin_set_fulltext(dev_help_plugin, fulltext_search);
+	devhelp_plugin_set_hover_tooltips(dev_help_plugin, hover_tooltips);
+	
+	g_hash_table_iter_init(&iter, filetype_books);
+	while (g_hash_table_iter_next(&iter, &key, &value))
+		devhelp_plugin_set_filetype_books(dev_help_plugin, key,
+										  (const gchar * const *) value);
 
 	/* setup keybindings */
 	key_group = plugin_set_key_group(geany_plugin, "devhelp", KB_COUNT, NULL);
@@ -292,7 +664,13 @@ void plugin_init(GeanyData *data)
 		0, 0, "devhelp_toggle_search", _("Toggle Devhelp (Search Tab)"), NULL);
 	keybindings_set_item(key_group, KB_DEVHELP_SEARCH_SYMBOL, kb_activate,
 		0, 0, "devhelp_search_symbol", _("Search for Current Symbol/Tag"), NULL);
+	keybindings_set_item(key_group, KB_DEVHELP_OPEN_SYMBOL, kb_activate,
+		0, 0, "devhelp_open_symbol", _("Open Documentation for Current Symbol/Tag"), NULL);
+	keybindings_set_item(key_group, KB_DEVHELP_DUMP_STATS, kb_activate,
+		0, 0, "devhelp_dump_stats", _("Write Devhelp Statistics to the Config Directory"), NULL);
 	
+	/* the clock was read before the settings said whether to time */
+	stats_record(STATS_PLUGIN_INIT, g_get_monotonic_time() - start);
 }
 
 void plugin_cleanup(void)
@@ -301,6 +679,10 @@ void plugin_cleanup(void)
 	
 	g_object_unref(dev_help_plugin);
 	
+	/* the module stays loaded, the next plugin_init() mustn't find these */
+	g_hash_table_destroy(filetype_books);
+	filetype_books = NULL;
 	g_free(default_config);
 	g_free(user_config);
+	g_free(user_config_dir);
 }
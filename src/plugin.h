@@ -35,5 +35,6 @@ extern DevhelpPlugin *dev_help_plugin;
 gint plugin_load_preferences();
 gint plugin_store_preferences();
 gboolean plugin_config_init();
+const gchar *plugin_get_config_dir();
 
 #endif
@@ -0,0 +1,502 @@
+/*
+ * search-index.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "book-index.h"
+#include "search-index.h"
+#include "fuzzy-match.h"
+
+/*
+ * The index is laid out the same in memory as in its cache file, so a
+ * cached one is used in place, in host byte order like the keyword
+ * snapshot:
+ *
+ *   SearchIndexHeader
+ *   SearchIndexEntry[n_entries]	sorted on the folded name
+ *   guint32 next_same[n_entries]
+ *   guint32 exact[n_exact]			open addressed on the exact name
+ *   keys							folded names, NUL separated
+ */
+#define SEARCH_INDEX_MAGIC		"GDHSRIDX"
+#define SEARCH_INDEX_VERSION	1
+
+typedef struct
+{
+	gchar magic[8];
+	guint32 version;
+	guint32 n_entries;
+	guint32 n_exact;
+	guint32 keys_len;
+	guint8 books[16];			/* digest of the books it was built from */
+} SearchIndexHeader;
+
+#define entry_key(index, i)	((index)->keys + (index)->entries[(i)].key)
+
+static gint compare_entries(gconstpointer a, gconstpointer b, gpointer user_data)
+{
+	const SearchIndexEntry *ea = a, *eb = b;
+	const gchar *keys = user_data;
+	gint cmp;
+
+	cmp = strcmp(keys + ea->key, keys + eb->key);
+	if (cmp != 0)
+		return cmp;
+	if (ea->book != eb->book)
+		return (ea->book < eb->book) ? -1 : 1;
+	return (ea->keyword < eb->keyword) ? -1 : (ea->keyword > eb->keyword);
+}
+
+/**
+ * Case folds text the same way keys are folded in the index.  Plain ASCII,
+ * which is nearly every keyword, takes a fast path.
+ *
+ * @return	A newly allocated folded copy of text.
+ */
+gchar *search_index_fold(const gchar *text)
+{
+	const gchar *p;
+
+	for (p = text; *p != '\0'; p++)
+	{
+		if ((guchar) *p >= 0x80)
+			return g_utf8_casefold(text, -1);
+	}
+	return g_ascii_strdown(text, -1);
+}
+
+/*
+ * Digest of what the index depends on: each book's path, modification time
+ * and number of keywords, in order.  Only the BookIndex headers are read,
+ * none of the keywords.
+ */
+static void books_digest(GPtrArray *books, guint8 digest[16])
+{
+	GChecksum *checksum = g_checksum_new(G_CHECKSUM_MD5);
+	gsize len = 16;
+	guint i;
+
+	for (i = 0; i < books->len; i++)
+	{
+		const BookIndex *book = g_ptr_array_index(books, i);
+		guint32 n_keywords = book->n_keywords;
+
+		g_checksum_update(checksum, (const guchar *) book->path,
+						  strlen(book->path) + 1);
+		g_checksum_update(checksum, (const guchar *) &book->mtime,
+						  sizeof(book->mtime));
+		g_checksum_update(checksum, (const guchar *) &n_keywords,
+						  sizeof(n_keywords));
+	}
+	g_checksum_get_digest(checksum, digest, &len);
+	g_checksum_free(checksum);
+}
+
+static gsize index_size(const SearchIndexHeader *header)
+{
+	return sizeof(SearchIndexHeader) +
+		(gsize) header->n_entries * sizeof(SearchIndexEntry) +
+		(gsize) (header->n_entries + header->n_exact) * sizeof(guint32) +
+		header->keys_len;
+}
+
+/* Points index's arrays into data, laid out as described above */
+static void index_attach(SearchIndex *index, const gchar *data)
+{
+	const SearchIndexHeader *header = (const SearchIndexHeader *) data;
+
+	index->header = header;
+	index->n_entries = header->n_entries;
+	index->entries = (const SearchIndexEntry *) (header + 1);
+	index->next_same = (const guint32 *) (index->entries + header->n_entries);
+	index->exact = index->next_same + header->n_entries;
+	index->n_exact = header->n_exact;
+	index->keys = (const gchar *) (index->exact + header->n_exact);
+}
+
+/* Bucket of exact holding name's first entry, or the empty one it'd go in */
+static guint exact_bucket(SearchIndex *index, const gchar *name)
+{
+	guint mask = index->n_exact - 1;
+	guint i = g_str_hash(name) & mask;
+	guint n;
+
+	for (n = 0; n < index->n_exact; n++)
+	{
+		guint32 found = index->exact[i];
+
+		if (found == 0 || (found <= index->n_entries &&
+			strcmp(search_index_entry_name(index, found - 1), name) == 0))
+			break;
+		i = (i + 1) & mask;
+	}
+	return i;
+}
+
+/**
+ * Builds the sorted index over every keyword of books.  Only reads books
+ * so it can be run from any thread.
+ *
+ * @param books	Array of BookIndex, a reference is kept on it.
+ *
+ * @return	A new SearchIndex, release it with search_index_unref().
+ */
+SearchIndex *search_index_new(GPtrArray *books)
+{
+	SearchIndex *index;
+	SearchIndexHeader *header;
+	SearchIndexEntry *entries;
+	guint32 *next_same, *exact;
+	GString *keys;
+	guint i, j, n = 0, n_exact = 2;
+
+	for (i = 0; i < books->len; i++)
+		n += ((BookIndex *) g_ptr_array_index(books, i))->n_keywords;
+
+	index = g_new0(SearchIndex, 1);
+	index->ref_count = 1;
+	index->books = g_ptr_array_ref(books);
+	entries = g_new(SearchIndexEntry, n);
+
+	keys = g_string_sized_new(n * 24);
+	n = 0;
+	for (i = 0; i < books->len; i++)
+	{
+		const BookIndex *book = g_ptr_array_index(books, i);
+
+		for (j = 0; j < book->n_keywords; j++)
+		{
+			gchar *folded = search_index_fold(book_index_keyword_name(book, j));
+
+			entries[n].key = keys->len;
+			entries[n].book = i;
+			entries[n].keyword = j;
+			g_string_append(keys, folded);
+			g_string_append_c(keys, '\0');
+			g_free(folded);
+			n++;
+		}
+	}
+
+	g_qsort_with_data(entries, n, sizeof(SearchIndexEntry), compare_entries,
+					  keys->str);
+
+	/* at most half full, so probing always ends at an empty bucket */
+	while (n_exact < 2 * n)
+		n_exact *= 2;
+
+	header = g_malloc0(sizeof(SearchIndexHeader));
+	memcpy(header->magic, SEARCH_INDEX_MAGIC, sizeof(header->magic));
+	header->version = SEARCH_INDEX_VERSION;
+	header->n_entries = n;
+	header->n_exact = n_exact;
+	header->keys_len = keys->len;
+	books_digest(books, header->books);
+
+	index->data = g_realloc(header, index_size(header));
+	index_attach(index, index->data);
+	memcpy((gpointer) index->entries, entries, n * sizeof(SearchIndexEntry));
+	memcpy((gpointer) index->keys, keys->str, keys->len);
+	g_string_free(keys, TRUE);
+	g_free(entries);
+
+	/* chain the entries of each name in sorted order, so walk backwards */
+	next_same = (guint32 *) index->next_same;
+	exact = (guint32 *) index->exact;
+	memset(exact, 0, n_exact * sizeof(guint32));
+	for (i = n; i-- > 0; )
+	{
+		guint bucket = exact_bucket(index, search_index_entry_name(index, i));
+
+		next_same[i] = exact[bucket];
+		exact[bucket] = i + 1;
+	}
+
+	return index;
+}
+
+/**
+ * Maps an index saved by search_index_save() if it was built from the same
+ * books, which is checked on their paths, modification times and keyword
+ * counts alone.  Nothing past the header is read, so the index costs
+ * nothing to load and only the pages searched are ever read from disk.
+ *
+ * @param path	The cache file, it needn't exist.
+ * @param books	Array of BookIndex to use, a reference is kept on it.
+ *
+ * @return	A new SearchIndex or NULL if there's none for books in path.
+ */
+SearchIndex *search_index_load(const gchar *path, GPtrArray *books)
+{
+	SearchIndex *index;
+	GMappedFile *mapped;
+	const SearchIndexHeader *header;
+	const gchar *data;
+	guint8 digest[16];
+	gsize size;
+
+	mapped = g_mapped_file_new(path, FALSE, NULL);
+	if (mapped == NULL)
+		return NULL;
+
+	data = g_mapped_file_get_contents(mapped);
+	size = g_mapped_file_get_length(mapped);
+	header = (const SearchIndexHeader *) data;
+	books_digest(books, digest);
+
+	/* the file is only ever replaced whole, so one with the right header
+	 * and size is one that was written for these books */
+	if (size < sizeof(SearchIndexHeader) ||
+		memcmp(header->magic, SEARCH_INDEX_MAGIC, sizeof(header->magic)) != 0 ||
+		header->version != SEARCH_INDEX_VERSION ||
+		memcmp(header->books, digest, sizeof(digest)) != 0 ||
+		header->n_exact == 0 ||
+		(header->n_exact & (header->n_exact - 1)) != 0 ||
+		index_size(header) != size ||
+		(header->keys_len > 0 && data[size - 1] != '\0'))
+	{
+		g_mapped_file_unref(mapped);
+		return NULL;
+	}
+
+	index = g_new0(SearchIndex, 1);
+	index->ref_count = 1;
+	index->books = g_ptr_array_ref(books);
+	index->mapped = mapped;
+	index_attach(index, data);
+
+	return index;
+}
+
+/**
+ * Writes index to path for search_index_load().  The file is replaced
+ * atomically so an index still mapped from the old one stays valid.
+ *
+ * @param index	The index to save.
+ * @param path	The cache file to write.
+ * @param error	Return location for an error or NULL.
+ *
+ * @return	TRUE if the index was written.
+ */
+gboolean search_index_save(SearchIndex *index, const gchar *path,
+						   GError **error)
+{
+	return g_file_set_contents(path, (const gchar *) index->header,
+							   index_size(index->header), error);
+}
+
+/**
+ * The fuzzy index over the same entries, built the first time it's asked
+ * for so loading an index doesn't pay for it.  Can be called from any
+ * thread.
+ */
+FuzzyIndex *search_index_get_fuzzy(SearchIndex *index)
+{
+	static GStaticMutex lock = G_STATIC_MUTEX_INIT;
+	FuzzyIndex *fuzzy;
+
+	g_static_mutex_lock(&lock);
+	if (index->fuzzy == NULL)
+		index->fuzzy = fuzzy_index_new(index);
+	fuzzy = index->fuzzy;
+	g_static_mutex_unlock(&lock);
+
+	return fuzzy;
+}
+
+SearchIndex *search_index_ref(SearchIndex *index)
+{
+	g_atomic_int_inc(&index->ref_count);
+	return index;
+}
+
+void search_index_unref(SearchIndex *index)
+{
+	if (index == NULL || !g_atomic_int_dec_and_test(&index->ref_count))
+		return;
+
+	fuzzy_index_free(index->fuzzy);
+	if (index->mapped != NULL)
+		g_mapped_file_unref(index->mapped);
+	g_free(index->data);
+	g_ptr_array_unref(index->books);
+	g_free(index);
+}
+
+/* First entry whose key is >= folded */
+static guint lower_bound(SearchIndex *index, const gchar *folded)
+{
+	guint lo = 0, hi = index->n_entries;
+
+	while (lo < hi)
+	{
+		guint mid = lo + (hi - lo) / 2;
+		if (strcmp(entry_key(index, mid), folded) < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
+/**
+ * Finds the keywords starting with text, ignoring case.  The exact matches,
+ * if any, are at the start of the range.
+ *
+ * @param index	The index to search.
+ * @param text	The prefix to look for.
+ * @param start	Return location for the first matching entry.
+ * @param end	Return location for one past the last matching entry.
+ *
+ * @return	TRUE if anything matched.
+ */
+gboolean search_index_prefix_range(SearchIndex *index, const gchar *text,
+								   guint *start, guint *end)
+{
+	gchar *folded;
+	gsize len;
+	guint lo, hi;
+
+	folded = search_index_fold(text);
+	len = strlen(folded);
+
+	*start = lower_bound(index, folded);
+
+	lo = *start;
+	hi = index->n_entries;
+	while (lo < hi)
+	{
+		guint mid = lo + (hi - lo) / 2;
+		if (strncmp(entry_key(index, mid), folded, len) <= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	*end = lo;
+
+	g_free(folded);
+
+	return *start < *end;
+}
+
+/**
+ * Finds the keywords named text, ignoring case.  Arguments are the same
+ * as for search_index_prefix_range().
+ *
+ * @return	TRUE if anything matched.
+ */
+gboolean search_index_exact_range(SearchIndex *index, const gchar *text,
+								  guint *start, guint *end)
+{
+	gchar *folded;
+	guint lo, hi;
+
+	folded = search_index_fold(text);
+
+	*start = lower_bound(index, folded);
+
+	lo = *start;
+	hi = index->n_entries;
+	while (lo < hi)
+	{
+		guint mid = lo + (hi - lo) / 2;
+		if (strcmp(entry_key(index, mid), folded) <= 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	*end = lo;
+
+	g_free(folded);
+
+	return *start < *end;
+}
+
+/**
+ * Finds the first keyword named exactly name (case matters) with a single
+ * hash table probe, more only where names collide.  Further keywords with
+ * the same name, from other books, are found with search_index_lookup_next().
+ *
+ * @param index	The index to search.
+ * @param name	The exact keyword name.
+ * @param entry	Return location for the entry.
+ *
+ * @return	TRUE if there is a keyword with that name.
+ */
+gboolean search_index_lookup(SearchIndex *index, const gchar *name, guint *entry)
+{
+	guint found = index->exact[exact_bucket(index, name)];
+
+	if (found == 0 || found > index->n_entries)
+		return FALSE;
+	*entry = found - 1;
+	return TRUE;
+}
+
+/**
+ * Moves entry on to the next keyword with the same name.
+ *
+ * @return	FALSE if there are no more, entry is left alone.
+ */
+gboolean search_index_lookup_next(SearchIndex *index, guint *entry)
+{
+	guint next = index->next_same[*entry];
+
+	if (next == 0 || next > index->n_entries)
+		return FALSE;
+	*entry = next - 1;
+	return TRUE;
+}
+
+/* Number of keywords named exactly name */
+guint search_index_count(SearchIndex *index, const gchar *name)
+{
+	guint entry, n = 0;
+
+	if (!search_index_lookup(index, name, &entry))
+		return 0;
+	do
+		n++;
+	while (search_index_lookup_next(index, &entry));
+
+	return n;
+}
+
+const BookIndex *search_index_entry_book(SearchIndex *index, guint entry)
+{
+	return g_ptr_array_index(index->books, index->entries[entry].book);
+}
+
+/* The keyword's name as written in the book */
+const gchar *search_index_entry_name(SearchIndex *index, guint entry)
+{
+	return book_index_keyword_name(search_index_entry_book(index, entry),
+								   index->entries[entry].keyword);
+}
+
+/* Newly allocated URI of the keyword's documentation */
+gchar *search_index_entry_uri(SearchIndex *index, guint entry)
+{
+	return book_index_get_uri(search_index_entry_book(index, entry),
+							  index->entries[entry].keyword);
+}
@@ -0,0 +1,102 @@
+/*
+ * search-index.h - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef SEARCH_INDEX_H
+#define SEARCH_INDEX_H
+
+#include <glib.h>
+#include "book-index.h"
+
+G_BEGIN_DECLS
+
+/*
+ * The search index is an array of every keyword of every book sorted on
+ * its case folded name.  All of the keywords starting with some prefix are
+ * a contiguous range of it which is found with two binary searches.
+ *
+ * Each index also carries a FuzzyIndex over the same entries, see
+ * fuzzy-match.c, and a hash table from exact keyword name to its entries
+ * so looking up a symbol is a single probe.
+ *
+ * The sorted entries and the hash table can be saved next to the keyword
+ * snapshot and memory mapped on the next start, so an index for books
+ * that haven't changed is neither folded nor sorted again.  The fuzzy
+ * index is only built once something asks for it.
+ *
+ * An index is immutable once built and reference counted so it can be
+ * searched from any thread while a newer one is being built.
+ *
+ * See search-index.c for documentation for these functions
+ */
+
+typedef struct _SearchIndex			SearchIndex;
+typedef struct _SearchIndexEntry	SearchIndexEntry;
+
+struct _SearchIndexEntry
+{
+	guint32 key;				/* offset of the folded name in keys */
+	guint32 book;				/* index into books */
+	guint32 keyword;			/* index into the book's keywords */
+};
+
+struct _SearchIndex
+{
+	volatile gint ref_count;
+	GPtrArray *books;			/* array of BookIndex, referenced */
+	const SearchIndexEntry *entries;	/* sorted on key */
+	guint n_entries;
+	const gchar *keys;			/* case folded names, NUL separated */
+	const guint32 *exact;		/* open addressed name -> first entry + 1 */
+	guint n_exact;				/* buckets in exact, a power of two */
+	const guint32 *next_same;	/* next entry + 1 with the same name or 0 */
+	struct _FuzzyIndex *fuzzy;	/* see search_index_get_fuzzy() */
+
+	/* storage, the arrays above point into it */
+	const void *header;
+	GMappedFile *mapped;		/* when loaded from a file */
+	gchar *data;				/* when built */
+};
+
+SearchIndex *search_index_new(GPtrArray *books);
+SearchIndex *search_index_load(const gchar *path, GPtrArray *books);
+gboolean search_index_save(SearchIndex *index, const gchar *path,
+						   GError **error);
+struct _FuzzyIndex *search_index_get_fuzzy(SearchIndex *index);
+SearchIndex *search_index_ref(SearchIndex *index);
+void search_index_unref(SearchIndex *index);
+
+gchar *search_index_fold(const gchar *text);
+gboolean search_index_prefix_range(SearchIndex *index, const gchar *text,
+								   guint *start, guint *end);
+gboolean search_index_exact_range(SearchIndex *index, const gchar *text,
+								  guint *start, guint *end);
+
+gboolean search_index_lookup(SearchIndex *index, const gchar *name, guint *entry);
+gboolean search_index_lookup_next(SearchIndex *index, guint *entry);
+guint search_index_count(SearchIndex *index, const gchar *name);
+
+const BookIndex *search_index_entry_book(SearchIndex *index, guint entry);
+const gchar *search_index_entry_name(SearchIndex *index, guint entry);
+gchar *search_index_entry_uri(SearchIndex *index, guint entry);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,762 @@
+/*
+ * search-panel.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <gtk/gtk.h>
+#include <geanyplugin.h>
+
+#include "book-index.h"
+#include "search-index.h"
+#include "search-panel.h"
+#include "fuzzy-match.h"
+#include "fulltext-index.h"
+#include "index-client.h"
+#include "search-result-model.h"
+#include "stats.h"
+
+/* results fetched per query and per "Show more", the scans only keep this
+ * many so a one letter query costs no more than a long one */
+#define SEARCH_PANEL_PAGE_SIZE		200
+
+/* width of the book column, every column needs one in fixed height mode */
+#define SEARCH_PANEL_BOOK_WIDTH		120
+
+/* typing faster than this doesn't start a search for every keystroke */
+#define SEARCH_PANEL_DEBOUNCE_MS	60
+
+enum
+{
+	LINK_SELECTED,
+	LAST_SIGNAL
+};
+
+static guint panel_signals[LAST_SIGNAL] = { 0 };
+
+/* Where the results of a query stopped, for "Show more" to go on from */
+typedef struct
+{
+	guint next_entry;			/* prefix queries: first entry not shown */
+	FuzzyMatch last_match;		/* fuzzy queries: the worst match shown */
+	FulltextHit last_hit;		/* full text queries: the worst hit shown */
+	IndexResume remote;			/* queries through the index daemon */
+} SearchResume;
+
+/*
+ * One query on its way through the search thread.  It holds references
+ * to the panel and the index so neither goes away before the results are
+ * handed back to the main loop.
+ */
+typedef struct
+{
+	DevhelpSearchPanel *panel;
+	SearchIndex *index;
+	FulltextIndex *fulltext;	/* set for full text queries */
+	IndexClient *client;		/* set to ask the index daemon, the panel's */
+	GPtrArray *books;			/* what the daemon's results point into */
+	gchar *text;
+	gboolean fuzzy;
+	gint generation;
+	GCancellable *cancellable;
+	gint64 keystroke_time;
+	gboolean resume;			/* go on from pos rather than start over */
+	SearchResume pos;			/* where to start, then where it stopped */
+	gboolean has_more;			/* there may be results after these */
+	GArray *results;			/* entry numbers, FulltextHits for full
+								 * text queries or IndexRefs for the
+								 * daemon's, NULL if not run */
+} SearchJob;
+
+struct _DevhelpSearchPanelPrivate
+{
+	GtkWidget *entry;
+	GtkWidget *fuzzy_check;
+	GtkWidget *text_check;
+	GtkWidget *tree_view;
+	GtkWidget *more_button;
+	DevhelpSearchResultModel *model;
+	SearchResume resume;		/* of the results shown */
+	SearchIndex *index;
+	FulltextIndex *fulltext;	/* NULL until the pages are indexed */
+	IndexClient *client;		/* searched instead of index if set, only
+								 * ever used from the search thread */
+	GPtrArray *books;			/* the books of the client's results */
+
+	GThreadPool *pool;			/* runs the queries */
+	volatile gint generation;	/* bumped for every new query */
+	GCancellable *cancellable;	/* of the newest query in flight */
+	guint debounce_id;
+	gint64 keystroke_time;		/* of the last change to the entry */
+	gboolean activate_pending;	/* Enter pressed before results arrived */
+
+	/* keystroke to results shown latency, in microseconds */
+	gint64 latency_last;
+	gint64 latency_max;
+	gint64 latency_total;
+	guint n_latencies;
+};
+
+static void devhelp_search_panel_dispose	(GObject *object);
+static void devhelp_search_panel_finalize	(GObject *object);
+
+G_DEFINE_TYPE(DevhelpSearchPanel, devhelp_search_panel, GTK_TYPE_VBOX)
+
+
+static void devhelp_search_panel_class_init(DevhelpSearchPanelClass *klass)
+{
+	GObjectClass *g_object_class;
+
+	g_object_class = G_OBJECT_CLASS(klass);
+
+	g_object_class->dispose = devhelp_search_panel_dispose;
+	g_object_class->finalize = devhelp_search_panel_finalize;
+
+	panel_signals[LINK_SELECTED] = g_signal_new("link-selected",
+		G_TYPE_FROM_CLASS(klass),
+		G_SIGNAL_RUN_LAST,
+		G_STRUCT_OFFSET(DevhelpSearchPanelClass, link_selected),
+		NULL, NULL,
+		g_cclosure_marshal_VOID__STRING,
+		G_TYPE_NONE, 1, G_TYPE_STRING);
+
+	g_type_class_add_private((gpointer)klass, sizeof(DevhelpSearchPanelPrivate));
+}
+
+
+/*
+ * Runs when the panel is destroyed with its notebook.  A job still in
+ * flight keeps the panel itself alive, but not its widgets, so it's
+ * superseded here and its results get dropped when they come back.
+ */
+static void devhelp_search_panel_dispose(GObject *object)
+{
+	DevhelpSearchPanelPrivate *priv = DEVHELP_SEARCH_PANEL(object)->priv;
+
+	g_atomic_int_inc(&priv->generation);
+	if (priv->cancellable != NULL)
+	{
+		g_cancellable_cancel(priv->cancellable);
+		g_object_unref(priv->cancellable);
+		priv->cancellable = NULL;
+	}
+	if (priv->debounce_id != 0)
+	{
+		g_source_remove(priv->debounce_id);
+		priv->debounce_id = 0;
+	}
+	priv->tree_view = NULL;
+	priv->more_button = NULL;
+
+	G_OBJECT_CLASS(devhelp_search_panel_parent_class)->dispose(object);
+}
+
+
+static void devhelp_search_panel_finalize(GObject *object)
+{
+	DevhelpSearchPanel *self;
+
+	g_return_if_fail(object != NULL);
+	g_return_if_fail(DEVHELP_IS_SEARCH_PANEL(object));
+
+	self = DEVHELP_SEARCH_PANEL(object);
+
+	/* every job holds a reference so none can be left by now */
+	g_thread_pool_free(self->priv->pool, TRUE, TRUE);
+	index_client_free(self->priv->client);
+	if (self->priv->books != NULL)
+		g_ptr_array_unref(self->priv->books);
+	search_index_unref(self->priv->index);
+	fulltext_index_unref(self->priv->fulltext);
+	g_object_unref(self->priv->model);
+
+	G_OBJECT_CLASS(devhelp_search_panel_parent_class)->finalize(object);
+}
+
+static void search_job_free(SearchJob *job)
+{
+	g_object_unref(job->panel);
+	search_index_unref(job->index);
+	fulltext_index_unref(job->fulltext);
+	if (job->books != NULL)
+		g_ptr_array_unref(job->books);
+	g_object_unref(job->cancellable);
+	if (job->results != NULL)
+		g_array_free(job->results, TRUE);
+	g_free(job->text);
+	g_free(job);
+}
+
+static void search_panel_record_latency(DevhelpSearchPanel *self, gint64 latency)
+{
+	DevhelpSearchPanelPrivate *priv = self->priv;
+
+	priv->latency_last = latency;
+	priv->latency_max = MAX(priv->latency_max, latency);
+	priv->latency_total += latency;
+	priv->n_latencies++;
+
+	g_debug("Devhelp search latency: %" G_GINT64_FORMAT " us", latency);
+	stats_record(STATS_SEARCH, latency);
+}
+
+static void search_panel_set_model(DevhelpSearchPanel *self,
+								   DevhelpSearchResultModel *model)
+{
+	gtk_tree_view_set_model(GTK_TREE_VIEW(self->priv->tree_view), GTK_TREE_MODEL(model));
+	g_object_unref(self->priv->model);
+	self->priv->model = model;
+}
+
+/* Puts the results of a finished job in the list, on the main loop */
+static gboolean on_search_done(gpointer user_data)
+{
+	SearchJob *job = user_data;
+	DevhelpSearchPanel *self = job->panel;
+	DevhelpSearchPanelPrivate *priv = self->priv;
+
+	/* a newer query superseded this one, or the panel is gone, drop it */
+	if (job->results == NULL || priv->tree_view == NULL ||
+		job->generation != g_atomic_int_get(&priv->generation))
+	{
+		search_job_free(job);
+		return FALSE;
+	}
+
+	/* this was the newest query, nothing is in flight anymore */
+	if (priv->cancellable != NULL)
+	{
+		g_object_unref(priv->cancellable);
+		priv->cancellable = NULL;
+	}
+
+	/* only the numbers go in the model, rows are read from the index when
+	 * they're drawn */
+	if (job->resume)
+		devhelp_search_result_model_append(priv->model, job->results);
+	else
+	{
+		DevhelpSearchResultModel *model;
+
+		if (job->client != NULL && job->fulltext == NULL)
+			model = devhelp_search_result_model_new_refs(job->books);
+		else
+			model = devhelp_search_result_model_new(job->index, job->fulltext);
+		devhelp_search_result_model_append(model, job->results);
+		search_panel_set_model(self, model);
+
+		search_panel_record_latency(self, g_get_monotonic_time() - job->keystroke_time);
+	}
+
+	priv->resume = job->pos;
+	if (job->has_more)
+		gtk_widget_show(priv->more_button);
+
+	if (priv->activate_pending)
+	{
+		GtkTreePath *path = gtk_tree_path_new_first();
+		priv->activate_pending = FALSE;
+		gtk_tree_view_set_cursor(GTK_TREE_VIEW(priv->tree_view), path, NULL, FALSE);
+		gtk_tree_path_free(path);
+	}
+
+	search_job_free(job);
+
+	return FALSE;
+}
+
+static void append_refs(const IndexRef *refs, guint n_refs, gpointer user_data)
+{
+	g_array_append_vals(user_data, refs, n_refs);
+}
+
+/* Runs a query in the search thread, keeping only a page of the best
+ * results after where the last page stopped */
+static void search_thread(gpointer data, gpointer user_data)
+{
+	SearchJob *job = data;
+	DevhelpSearchPanel *self = user_data;
+	guint i, start, end;
+
+	if (job->generation == g_atomic_int_get(&self->priv->generation) &&
+		!g_cancellable_is_cancelled(job->cancellable))
+	{
+		GArray *results;
+
+		if (job->fulltext != NULL)
+		{
+			guint n_hits;
+
+			results = g_array_sized_new(FALSE, FALSE, sizeof(FulltextHit),
+										SEARCH_PANEL_PAGE_SIZE);
+			g_array_set_size(results, SEARCH_PANEL_PAGE_SIZE);
+			n_hits = fulltext_index_search(job->fulltext, job->text,
+										   (FulltextHit *) results->data,
+										   SEARCH_PANEL_PAGE_SIZE,
+										   job->resume ? &job->pos.last_hit : NULL,
+										   job->cancellable);
+			g_array_set_size(results, n_hits);
+			if (n_hits > 0)
+				job->pos.last_hit = g_array_index(results, FulltextHit, n_hits - 1);
+			job->has_more = (n_hits == SEARCH_PANEL_PAGE_SIZE);
+		}
+		else if (job->client != NULL)
+		{
+			GError *error = NULL;
+
+			/* the daemon ranks and pages them the same way as below */
+			results = g_array_sized_new(FALSE, FALSE, sizeof(IndexRef), 64);
+			index_client_set_books(job->client, job->books);
+			if (!index_client_search(job->client, job->text,
+					job->fuzzy ? INDEX_SEARCH_FUZZY : INDEX_SEARCH_PREFIX,
+					SEARCH_PANEL_PAGE_SIZE, job->resume ? &job->pos.remote : NULL,
+					&job->pos.remote, &job->has_more, append_refs, results,
+					job->cancellable, &error))
+			{
+				if (!g_cancellable_is_cancelled(job->cancellable))
+					g_warning(_("Unable to search the documentation: %s"),
+							  error->message);
+				g_error_free(error);
+			}
+		}
+		else if (job->fuzzy)
+		{
+			FuzzyMatch *matches = g_new(FuzzyMatch, SEARCH_PANEL_PAGE_SIZE);
+			guint n_matches;
+
+			results = g_array_sized_new(FALSE, FALSE, sizeof(guint), 64);
+
+			n_matches = fuzzy_index_search(search_index_get_fuzzy(job->index),
+										   job->text, matches,
+										   SEARCH_PANEL_PAGE_SIZE,
+										   job->resume ? &job->pos.last_match : NULL,
+										   job->cancellable);
+			for (i = 0; i < n_matches; i++)
+				g_array_append_val(results, matches[i].entry);
+			if (n_matches > 0)
+				job->pos.last_match = matches[n_matches - 1];
+			job->has_more = (n_matches == SEARCH_PANEL_PAGE_SIZE);
+			g_free(matches);
+		}
+		else
+		{
+			/* the range is already in order, the next page just starts
+			 * further into it */
+			results = g_array_sized_new(FALSE, FALSE, sizeof(guint), 64);
+			if (search_index_prefix_range(job->index, job->text, &start, &end))
+			{
+				if (job->resume)
+					start = MAX(start, job->pos.next_entry);
+				for (i = start; i < end && i - start < SEARCH_PANEL_PAGE_SIZE; i++)
+					g_array_append_val(results, i);
+				job->pos.next_entry = i;
+				job->has_more = (i < end);
+			}
+		}
+
+		if (g_cancellable_is_cancelled(job->cancellable))
+			g_array_free(results, TRUE);
+		else
+			job->results = results;
+	}
+
+	g_idle_add(on_search_done, job);
+}
+
+/* Drops whatever query is in flight, its results won't be shown */
+static void search_panel_cancel(DevhelpSearchPanel *self)
+{
+	DevhelpSearchPanelPrivate *priv = self->priv;
+
+	g_atomic_int_inc(&priv->generation);
+	if (priv->cancellable != NULL)
+	{
+		g_cancellable_cancel(priv->cancellable);
+		g_object_unref(priv->cancellable);
+		priv->cancellable = NULL;
+	}
+}
+
+/* Hands a query for the current entry text and options to the search
+ * thread, resuming after the results shown if resume is set */
+static void search_panel_push_job(DevhelpSearchPanel *self, gboolean resume)
+{
+	DevhelpSearchPanelPrivate *priv = self->priv;
+	SearchJob *job;
+
+	job = g_new0(SearchJob, 1);
+	job->panel = g_object_ref(self);
+	if (priv->index != NULL)
+		job->index = search_index_ref(priv->index);
+	if (priv->client != NULL)
+	{
+		job->client = priv->client;
+		job->books = g_ptr_array_ref(priv->books);
+	}
+	job->text = g_strdup(gtk_entry_get_text(GTK_ENTRY(priv->entry)));
+	job->fuzzy = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(priv->fuzzy_check));
+	if (priv->fulltext != NULL &&
+		gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(priv->text_check)))
+		job->fulltext = fulltext_index_ref(priv->fulltext);
+	job->generation = g_atomic_int_get(&priv->generation);
+	job->cancellable = g_cancellable_new();
+	job->keystroke_time = priv->keystroke_time;
+	job->resume = resume;
+	if (resume)
+		job->pos = priv->resume;
+
+	priv->cancellable = g_object_ref(job->cancellable);
+
+	g_thread_pool_push(priv->pool, job, NULL);
+}
+
+/*
+ * Starts a search for the entry text, cancelling the one in flight.  An
+ * empty entry or no index just clears the list.
+ */
+static void search_panel_run_query(DevhelpSearchPanel *self)
+{
+	DevhelpSearchPanelPrivate *priv = self->priv;
+	const gchar *text;
+
+	/* destroyed, setting the index on the way out doesn't search */
+	if (priv->tree_view == NULL)
+		return;
+
+	if (priv->debounce_id != 0)
+	{
+		g_source_remove(priv->debounce_id);
+		priv->debounce_id = 0;
+	}
+
+	search_panel_cancel(self);
+	gtk_widget_hide(priv->more_button);
+
+	text = gtk_entry_get_text(GTK_ENTRY(priv->entry));
+	if ((priv->index == NULL && priv->client == NULL) || text[0] == '\0')
+	{
+		search_panel_set_model(self, devhelp_search_result_model_new(NULL, NULL));
+		priv->activate_pending = FALSE;
+		return;
+	}
+
+	search_panel_push_job(self, FALSE);
+}
+
+/* Fetches the page of results after the ones shown */
+static void on_more_clicked(GtkButton *button, gpointer user_data)
+{
+	DevhelpSearchPanel *self = user_data;
+
+	/* the results shown are about to be replaced anyway */
+	if (self->priv->debounce_id != 0 || self->priv->cancellable != NULL ||
+		(self->priv->index == NULL && self->priv->client == NULL))
+		return;
+
+	search_panel_cancel(self);
+	gtk_widget_hide(self->priv->more_button);
+
+	self->priv->keystroke_time = g_get_monotonic_time();
+	search_panel_push_job(self, TRUE);
+}
+
+static gboolean on_debounce_timeout(gpointer user_data)
+{
+	DevhelpSearchPanel *self = user_data;
+
+	self->priv->debounce_id = 0;
+	search_panel_run_query(self);
+
+	return FALSE;
+}
+
+static void on_entry_changed(GtkEditable *editable, gpointer user_data)
+{
+	DevhelpSearchPanel *self = user_data;
+
+	self->priv->keystroke_time = g_get_monotonic_time();
+
+	if (self->priv->debounce_id != 0)
+		g_source_remove(self->priv->debounce_id);
+	self->priv->debounce_id = g_timeout_add(SEARCH_PANEL_DEBOUNCE_MS,
+											on_debounce_timeout, self);
+}
+
+static void on_mode_toggled(GtkToggleButton *togglebutton, gpointer user_data)
+{
+	DevhelpSearchPanel *self = user_data;
+
+	/* full text searches don't look at keyword names */
+	gtk_widget_set_sensitive(self->priv->fuzzy_check,
+		!gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(self->priv->text_check)));
+
+	self->priv->keystroke_time = g_get_monotonic_time();
+	search_panel_run_query(self);
+}
+
+/* Enter in the entry selects the best (first) result */
+static void on_entry_activate(GtkEntry *entry, gpointer user_data)
+{
+	DevhelpSearchPanel *self = user_data;
+	GtkTreePath *path;
+
+	/* results for what was typed aren't in yet, select the first one once
+	 * they are */
+	if (self->priv->debounce_id != 0 || self->priv->cancellable != NULL)
+	{
+		self->priv->activate_pending = TRUE;
+		if (self->priv->debounce_id != 0)
+			search_panel_run_query(self);
+		return;
+	}
+
+	path = gtk_tree_path_new_first();
+	gtk_tree_view_set_cursor(GTK_TREE_VIEW(self->priv->tree_view), path, NULL, FALSE);
+	gtk_tree_path_free(path);
+}
+
+static void on_selection_changed(GtkTreeSelection *selection, gpointer user_data)
+{
+	DevhelpSearchPanel *self = user_data;
+	GtkTreeModel *model;
+	GtkTreeIter iter;
+	gchar *uri;
+
+	if (!gtk_tree_selection_get_selected(selection, &model, &iter))
+		return;
+
+	gtk_tree_model_get(model, &iter, SEARCH_RESULT_MODEL_COL_URI, &uri, -1);
+	if (uri != NULL)
+		g_signal_emit(self, panel_signals[LINK_SELECTED], 0, uri);
+	g_free(uri);
+}
+
+static void devhelp_search_panel_init(DevhelpSearchPanel *self)
+{
+	DevhelpSearchPanelPrivate *priv;
+	GtkWidget *sw, *hbox;
+	GtkCellRenderer *renderer;
+	GtkTreeViewColumn *column;
+
+	self->priv = G_TYPE_INSTANCE_GET_PRIVATE(self,
+		DEVHELP_TYPE_SEARCH_PANEL, DevhelpSearchPanelPrivate);
+	priv = self->priv;
+
+	priv->index = NULL;
+	priv->fulltext = NULL;
+	priv->client = NULL;
+	priv->books = NULL;
+	priv->model = devhelp_search_result_model_new(NULL, NULL);
+	priv->pool = g_thread_pool_new(search_thread, self, 1, FALSE, NULL);
+	priv->generation = 0;
+	priv->cancellable = NULL;
+	priv->debounce_id = 0;
+	priv->keystroke_time = 0;
+	priv->activate_pending = FALSE;
+	priv->latency_last = priv->latency_max = priv->latency_total = 0;
+	priv->n_latencies = 0;
+
+	gtk_box_set_spacing(GTK_BOX(self), 6);
+	gtk_container_set_border_width(GTK_CONTAINER(self), 6);
+
+	hbox = gtk_hbox_new(FALSE, 6);
+	priv->entry = gtk_entry_new();
+	gtk_box_pack_start(GTK_BOX(hbox), priv->entry, TRUE, TRUE, 0);
+	priv->fuzzy_check = gtk_check_button_new_with_label(_("Fuzzy"));
+	gtk_widget_set_tooltip_text(priv->fuzzy_check,
+		_("Match keywords containing the search characters in order, "
+		  "best matches first"));
+	gtk_box_pack_start(GTK_BOX(hbox), priv->fuzzy_check, FALSE, TRUE, 0);
+	priv->text_check = gtk_check_button_new_with_label(_("Text"));
+	gtk_widget_set_tooltip_text(priv->text_check,
+		_("Search the text of the documentation pages"));
+	gtk_widget_set_sensitive(priv->text_check, FALSE);
+	gtk_box_pack_start(GTK_BOX(hbox), priv->text_check, FALSE, TRUE, 0);
+	gtk_box_pack_start(GTK_BOX(self), hbox, FALSE, TRUE, 0);
+
+	/* in fixed height mode the view only asks the model for the rows on
+	 * screen, not for every row to measure it */
+	priv->tree_view = gtk_tree_view_new_with_model(GTK_TREE_MODEL(priv->model));
+	gtk_tree_view_set_headers_visible(GTK_TREE_VIEW(priv->tree_view), FALSE);
+
+	renderer = gtk_cell_renderer_text_new();
+	g_object_set(renderer, "ellipsize", PANGO_ELLIPSIZE_END, NULL);
+	column = gtk_tree_view_column_new_with_attributes(NULL, renderer,
+		"text", SEARCH_RESULT_MODEL_COL_NAME, NULL);
+	gtk_tree_view_column_set_sizing(column, GTK_TREE_VIEW_COLUMN_FIXED);
+	gtk_tree_view_column_set_expand(column, TRUE);
+	gtk_tree_view_append_column(GTK_TREE_VIEW(priv->tree_view), column);
+
+	renderer = gtk_cell_renderer_text_new();
+	g_object_set(renderer, "sensitive", FALSE, "ellipsize", PANGO_ELLIPSIZE_END, NULL);
+	column = gtk_tree_view_column_new_with_attributes(NULL, renderer,
+		"text", SEARCH_RESULT_MODEL_COL_BOOK, NULL);
+	gtk_tree_view_column_set_sizing(column, GTK_TREE_VIEW_COLUMN_FIXED);
+	gtk_tree_view_column_set_fixed_width(column, SEARCH_PANEL_BOOK_WIDTH);
+	gtk_tree_view_append_column(GTK_TREE_VIEW(priv->tree_view), column);
+
+	gtk_tree_view_set_fixed_height_mode(GTK_TREE_VIEW(priv->tree_view), TRUE);
+
+	sw = gtk_scrolled_window_new(NULL, NULL);
+	gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(sw),
+		GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+	gtk_scrolled_window_set_shadow_type(GTK_SCROLLED_WINDOW(sw), GTK_SHADOW_IN);
+	gtk_container_add(GTK_CONTAINER(sw), priv->tree_view);
+	gtk_box_pack_start(GTK_BOX(self), sw, TRUE, TRUE, 0);
+
+	/* only shown while there may be more results than the ones listed */
+	priv->more_button = gtk_button_new_with_label(_("Show more"));
+	gtk_widget_set_tooltip_text(priv->more_button,
+		_("List the next results of the search"));
+	gtk_widget_set_no_show_all(priv->more_button, TRUE);
+	gtk_box_pack_start(GTK_BOX(self), priv->more_button, FALSE, TRUE, 0);
+
+	g_signal_connect(priv->entry, "changed", G_CALLBACK(on_entry_changed), self);
+	g_signal_connect(priv->entry, "activate", G_CALLBACK(on_entry_activate), self);
+	g_signal_connect(priv->fuzzy_check, "toggled", G_CALLBACK(on_mode_toggled), self);
+	g_signal_connect(priv->text_check, "toggled", G_CALLBACK(on_mode_toggled), self);
+	g_signal_connect(priv->more_button, "clicked", G_CALLBACK(on_more_clicked), self);
+	g_signal_connect(
+		gtk_tree_view_get_selection(GTK_TREE_VIEW(priv->tree_view)),
+		"changed", G_CALLBACK(on_selection_changed), self);
+}
+
+/**
+ * Creates a new, empty, search panel.  It won't show any results until
+ * devhelp_search_panel_set_index() is called.
+ */
+GtkWidget *devhelp_search_panel_new(void)
+{
+	return g_object_new(DEVHELP_TYPE_SEARCH_PANEL, NULL);
+}
+
+/**
+ * Sets the index the panel searches, the current search is run again.
+ *
+ * @param panel	The search panel.
+ * @param index	The new index, a reference is taken on it.
+ */
+void devhelp_search_panel_set_index(DevhelpSearchPanel *panel, SearchIndex *index)
+{
+	g_return_if_fail(DEVHELP_IS_SEARCH_PANEL(panel));
+
+	if (index != NULL)
+		search_index_ref(index);
+	search_index_unref(panel->priv->index);
+	panel->priv->index = index;
+
+	panel->priv->keystroke_time = g_get_monotonic_time();
+	search_panel_run_query(panel);
+}
+
+/**
+ * Makes the panel search through the index daemon rather than an index of
+ * its own, the current search is run again.  Full text searches still use
+ * the panel's full text index.
+ *
+ * @param panel		The search panel.
+ * @param client	A connection to the daemon, the panel takes it over and
+ * 					only uses it from its search thread.  Can only be set
+ * 					once, NULL keeps that one when the books change.
+ * @param books		The books the daemon's results are numbered in, a
+ * 					reference is taken on it.
+ */
+void devhelp_search_panel_set_client(DevhelpSearchPanel *panel,
+									 IndexClient *client, GPtrArray *books)
+{
+	g_return_if_fail(DEVHELP_IS_SEARCH_PANEL(panel));
+	g_return_if_fail(books != NULL);
+	g_return_if_fail((client == NULL) != (panel->priv->client == NULL));
+
+	/* the search thread hands the books to the client with each job */
+	if (client != NULL)
+		panel->priv->client = client;
+	g_ptr_array_ref(books);
+	if (panel->priv->books != NULL)
+		g_ptr_array_unref(panel->priv->books);
+	panel->priv->books = books;
+
+	panel->priv->keystroke_time = g_get_monotonic_time();
+	search_panel_run_query(panel);
+}
+
+/**
+ * Sets the full text index the panel searches when "Text" is checked.
+ * Until this is called the check button is insensitive.
+ *
+ * @param panel		The search panel.
+ * @param fulltext	The new index, a reference is taken on it.
+ */
+void devhelp_search_panel_set_fulltext(DevhelpSearchPanel *panel,
+									   FulltextIndex *fulltext)
+{
+	g_return_if_fail(DEVHELP_IS_SEARCH_PANEL(panel));
+
+	if (fulltext != NULL)
+		fulltext_index_ref(fulltext);
+	fulltext_index_unref(panel->priv->fulltext);
+	panel->priv->fulltext = fulltext;
+
+	gtk_widget_set_sensitive(panel->priv->text_check, fulltext != NULL);
+
+	if (gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(panel->priv->text_check)))
+	{
+		panel->priv->keystroke_time = g_get_monotonic_time();
+		search_panel_run_query(panel);
+	}
+}
+
+/**
+ * Puts text in the search entry, which runs a search for it.
+ */
+void devhelp_search_panel_set_search_string(DevhelpSearchPanel *panel,
+											const gchar *text)
+{
+	g_return_if_fail(DEVHELP_IS_SEARCH_PANEL(panel));
+
+	gtk_entry_set_text(GTK_ENTRY(panel->priv->entry), text);
+	gtk_editable_set_position(GTK_EDITABLE(panel->priv->entry), -1);
+
+	/* no need to wait for more typing */
+	search_panel_run_query(panel);
+}
+
+/**
+ * Gets the keystroke to results shown latency of the searches so far.
+ *
+ * @param panel		The search panel.
+ * @param last_us	Return location for the latency of the last search.
+ * @param avg_us	Return location for the average latency.
+ * @param max_us	Return location for the worst latency.
+ *
+ * @return	The number of searches the figures cover.
+ */
+guint devhelp_search_panel_get_latency(DevhelpSearchPanel *panel, gint64 *last_us,
+									   gint64 *avg_us, gint64 *max_us)
+{
+	DevhelpSearchPanelPrivate *priv = panel->priv;
+
+	if (last_us != NULL)
+		*last_us = priv->latency_last;
+	if (avg_us != NULL)
+		*avg_us = priv->n_latencies ? priv->latency_total / priv->n_latencies : 0;
+	if (max_us != NULL)
+		*max_us = priv->latency_max;
+
+	return priv->n_latencies;
+}
@@ -0,0 +1,91 @@
+/*
+ * search-panel.h - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef SEARCH_PANEL_H
+#define SEARCH_PANEL_H
+
+#include <gtk/gtk.h>
+#include "search-index.h"
+#include "fulltext-index.h"
+#include "index-client.h"
+
+G_BEGIN_DECLS
+
+#define DEVHELP_TYPE_SEARCH_PANEL			(devhelp_search_panel_get_type())
+#define DEVHELP_SEARCH_PANEL(obj)			(G_TYPE_CHECK_INSTANCE_CAST((obj),\
+			DEVHELP_TYPE_SEARCH_PANEL, DevhelpSearchPanel))
+#define DEVHELP_SEARCH_PANEL_CLASS(klass)	(G_TYPE_CHECK_CLASS_CAST((klass),\
+			DEVHELP_TYPE_SEARCH_PANEL, DevhelpSearchPanelClass))
+#define DEVHELP_IS_SEARCH_PANEL(obj)		(G_TYPE_CHECK_INSTANCE_TYPE((obj),\
+			DEVHELP_TYPE_SEARCH_PANEL))
+
+typedef struct _DevhelpSearchPanel			DevhelpSearchPanel;
+typedef struct _DevhelpSearchPanelClass		DevhelpSearchPanelClass;
+typedef struct _DevhelpSearchPanelPrivate	DevhelpSearchPanelPrivate;
+
+/*
+ * The sidebar "Search" tab: an entry and a list of the keywords matching
+ * it from a SearchIndex.  Emits "link-selected" with the URI of the
+ * keyword when a result is selected.
+ *
+ * Once a FulltextIndex is set the "Text" check button searches the text
+ * of the pages instead of the keyword names.
+ *
+ * With an IndexClient set keyword queries go to the index daemon instead,
+ * see index-client.h, and no SearchIndex is needed.
+ *
+ * Queries run on a search thread once typing pauses.  Each one gets a
+ * generation number and a newer query cancels any still running, only
+ * the results of the newest query are put in the list, all at once.
+ *
+ * A query only keeps a page of the best results.  "Show more" runs it
+ * again from where the page stopped and adds the next page to the list.
+ */
+struct _DevhelpSearchPanel
+{
+	GtkVBox parent;
+
+	DevhelpSearchPanelPrivate *priv;
+};
+
+struct _DevhelpSearchPanelClass
+{
+	GtkVBoxClass parent_class;
+
+	void (*link_selected) (DevhelpSearchPanel *panel, const gchar *uri);
+};
+
+GType devhelp_search_panel_get_type(void);
+GtkWidget *devhelp_search_panel_new(void);
+
+void devhelp_search_panel_set_index(DevhelpSearchPanel *panel, SearchIndex *index);
+void devhelp_search_panel_set_client(DevhelpSearchPanel *panel,
+									 IndexClient *client, GPtrArray *books);
+void devhelp_search_panel_set_fulltext(DevhelpSearchPanel *panel,
+									   FulltextIndex *fulltext);
+void devhelp_search_panel_set_search_string(DevhelpSearchPanel *panel,
+											const gchar *text);
+guint devhelp_search_panel_get_latency(DevhelpSearchPanel *panel, gint64 *last_us,
+									   gint64 *avg_us, gint64 *max_us);
+
+G_END_DECLS
+
+#endif
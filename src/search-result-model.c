@@ -0,0 +1,367 @@
+/*
+ * search-result-model.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <gtk/gtk.h>
+
+#include "book-index.h"
+#include "search-index.h"
+#include "fulltext-index.h"
+#include "index-client.h"
+#include "search-result-model.h"
+
+/* an iter is just the row number */
+#define ITER_ROW(iter)	GPOINTER_TO_UINT((iter)->user_data)
+
+struct _DevhelpSearchResultModelPrivate
+{
+	gint stamp;
+	SearchIndex *index;
+	FulltextIndex *fulltext;	/* set if the results are FulltextHits */
+	GPtrArray *books;			/* set if they are IndexRefs into these */
+	GArray *results;			/* entry numbers, FulltextHits or IndexRefs */
+};
+
+static void devhelp_search_result_model_finalize	(GObject *object);
+static void devhelp_search_result_model_iface_init	(GtkTreeModelIface *iface);
+
+G_DEFINE_TYPE_WITH_CODE(DevhelpSearchResultModel, devhelp_search_result_model,
+	G_TYPE_OBJECT,
+	G_IMPLEMENT_INTERFACE(GTK_TYPE_TREE_MODEL, devhelp_search_result_model_iface_init))
+
+
+static void devhelp_search_result_model_class_init(DevhelpSearchResultModelClass *klass)
+{
+	GObjectClass *g_object_class;
+
+	g_object_class = G_OBJECT_CLASS(klass);
+
+	g_object_class->finalize = devhelp_search_result_model_finalize;
+
+	g_type_class_add_private((gpointer)klass, sizeof(DevhelpSearchResultModelPrivate));
+}
+
+static void devhelp_search_result_model_init(DevhelpSearchResultModel *self)
+{
+	self->priv = G_TYPE_INSTANCE_GET_PRIVATE(self,
+		DEVHELP_TYPE_SEARCH_RESULT_MODEL, DevhelpSearchResultModelPrivate);
+
+	self->priv->stamp = g_random_int();
+}
+
+static void devhelp_search_result_model_finalize(GObject *object)
+{
+	DevhelpSearchResultModel *self;
+
+	g_return_if_fail(object != NULL);
+	g_return_if_fail(DEVHELP_IS_SEARCH_RESULT_MODEL(object));
+
+	self = DEVHELP_SEARCH_RESULT_MODEL(object);
+
+	g_array_free(self->priv->results, TRUE);
+	search_index_unref(self->priv->index);
+	fulltext_index_unref(self->priv->fulltext);
+	if (self->priv->books != NULL)
+		g_ptr_array_unref(self->priv->books);
+
+	G_OBJECT_CLASS(devhelp_search_result_model_parent_class)->finalize(object);
+}
+
+/**
+ * Creates an empty model for the results of one query.
+ *
+ * @param index		The index entry numbers are looked up in, or NULL for a
+ * 					model that stays empty.  A reference is kept on it.
+ * @param fulltext	The index the results are FulltextHits of, NULL if they
+ * 					are entry numbers.  A reference is kept on it.
+ *
+ * @return	A new DevhelpSearchResultModel.
+ */
+DevhelpSearchResultModel *devhelp_search_result_model_new(SearchIndex *index,
+														  FulltextIndex *fulltext)
+{
+	DevhelpSearchResultModel *model;
+	DevhelpSearchResultModelPrivate *priv;
+
+	model = g_object_new(DEVHELP_TYPE_SEARCH_RESULT_MODEL, NULL);
+	priv = model->priv;
+
+	if (index != NULL)
+		priv->index = search_index_ref(index);
+	if (fulltext != NULL)
+		priv->fulltext = fulltext_index_ref(fulltext);
+	priv->results = g_array_new(FALSE, FALSE,
+		fulltext != NULL ? sizeof(FulltextHit) : sizeof(guint));
+
+	return model;
+}
+
+/**
+ * Creates an empty model for results the index daemon sent, see
+ * index_client_search().
+ *
+ * @param books	The books the IndexRefs point into, a reference is kept
+ * 				on it.
+ *
+ * @return	A new DevhelpSearchResultModel.
+ */
+DevhelpSearchResultModel *devhelp_search_result_model_new_refs(GPtrArray *books)
+{
+	DevhelpSearchResultModel *model;
+
+	model = g_object_new(DEVHELP_TYPE_SEARCH_RESULT_MODEL, NULL);
+	model->priv->books = g_ptr_array_ref(books);
+	model->priv->results = g_array_new(FALSE, FALSE, sizeof(IndexRef));
+
+	return model;
+}
+
+/**
+ * Adds results after the ones already in the model.
+ *
+ * @param model		The search result model.
+ * @param results	Array of entry numbers, or of FulltextHits if the model
+ * 					was made with a FulltextIndex, or of IndexRefs if it
+ * 					was made with devhelp_search_result_model_new_refs().
+ * 					They're copied.
+ */
+void devhelp_search_result_model_append(DevhelpSearchResultModel *model,
+										GArray *results)
+{
+	DevhelpSearchResultModelPrivate *priv;
+	GtkTreePath *path;
+	GtkTreeIter iter;
+	guint row;
+
+	g_return_if_fail(DEVHELP_IS_SEARCH_RESULT_MODEL(model));
+	g_return_if_fail(g_array_get_element_size(results) ==
+					 g_array_get_element_size(model->priv->results));
+
+	priv = model->priv;
+	row = priv->results->len;
+	g_array_append_vals(priv->results, results->data, results->len);
+
+	iter.stamp = priv->stamp;
+	iter.user_data2 = iter.user_data3 = NULL;
+	path = gtk_tree_path_new_from_indices(row, -1);
+	for (; row < priv->results->len; row++)
+	{
+		iter.user_data = GUINT_TO_POINTER(row);
+		gtk_tree_model_row_inserted(GTK_TREE_MODEL(model), path, &iter);
+		gtk_tree_path_next(path);
+	}
+	gtk_tree_path_free(path);
+}
+
+
+static GtkTreeModelFlags search_result_model_get_flags(GtkTreeModel *tree_model)
+{
+	return GTK_TREE_MODEL_ITERS_PERSIST | GTK_TREE_MODEL_LIST_ONLY;
+}
+
+static gint search_result_model_get_n_columns(GtkTreeModel *tree_model)
+{
+	return SEARCH_RESULT_MODEL_N_COLUMNS;
+}
+
+static GType search_result_model_get_column_type(GtkTreeModel *tree_model, gint index)
+{
+	switch (index)
+	{
+		case SEARCH_RESULT_MODEL_COL_NAME:
+		case SEARCH_RESULT_MODEL_COL_BOOK:
+		case SEARCH_RESULT_MODEL_COL_URI:
+			return G_TYPE_STRING;
+		default:
+			return G_TYPE_INVALID;
+	}
+}
+
+static inline void set_iter(DevhelpSearchResultModelPrivate *priv, GtkTreeIter *iter,
+							guint row)
+{
+	iter->stamp = priv->stamp;
+	iter->user_data = GUINT_TO_POINTER(row);
+	iter->user_data2 = NULL;
+	iter->user_data3 = NULL;
+}
+
+static gboolean search_result_model_get_iter(GtkTreeModel *tree_model,
+											 GtkTreeIter *iter, GtkTreePath *path)
+{
+	DevhelpSearchResultModelPrivate *priv = DEVHELP_SEARCH_RESULT_MODEL(tree_model)->priv;
+	gint *indices = gtk_tree_path_get_indices(path);
+
+	if (gtk_tree_path_get_depth(path) != 1 || indices[0] < 0 ||
+		(guint) indices[0] >= priv->results->len)
+		return FALSE;
+
+	set_iter(priv, iter, indices[0]);
+	return TRUE;
+}
+
+static GtkTreePath *search_result_model_get_path(GtkTreeModel *tree_model,
+												 GtkTreeIter *iter)
+{
+	DevhelpSearchResultModelPrivate *priv = DEVHELP_SEARCH_RESULT_MODEL(tree_model)->priv;
+
+	g_return_val_if_fail(iter->stamp == priv->stamp, NULL);
+
+	return gtk_tree_path_new_from_indices(ITER_ROW(iter), -1);
+}
+
+static void search_result_model_get_value(GtkTreeModel *tree_model, GtkTreeIter *iter,
+										  gint column, GValue *value)
+{
+	DevhelpSearchResultModelPrivate *priv = DEVHELP_SEARCH_RESULT_MODEL(tree_model)->priv;
+	guint row = ITER_ROW(iter);
+	const BookIndex *book;
+
+	g_return_if_fail(iter->stamp == priv->stamp);
+
+	g_value_init(value, search_result_model_get_column_type(tree_model, column));
+
+	/* the model keeps the indexes and books alive, no need to copy names */
+	if (priv->fulltext != NULL)
+	{
+		const FulltextHit *hit = &g_array_index(priv->results, FulltextHit, row);
+
+		book = fulltext_index_hit_book(priv->fulltext, hit);
+		switch (column)
+		{
+			case SEARCH_RESULT_MODEL_COL_NAME:
+				g_value_set_static_string(value,
+					fulltext_index_hit_title(priv->fulltext, hit));
+				break;
+			case SEARCH_RESULT_MODEL_COL_URI:
+				g_value_take_string(value, fulltext_index_hit_uri(priv->fulltext, hit));
+				break;
+		}
+	}
+	else if (priv->books != NULL)
+	{
+		const IndexRef *ref = &g_array_index(priv->results, IndexRef, row);
+
+		book = g_ptr_array_index(priv->books, ref->book);
+		switch (column)
+		{
+			case SEARCH_RESULT_MODEL_COL_NAME:
+				g_value_set_static_string(value,
+					book_index_keyword_name(book, ref->keyword));
+				break;
+			case SEARCH_RESULT_MODEL_COL_URI:
+				g_value_take_string(value, book_index_get_uri(book, ref->keyword));
+				break;
+		}
+	}
+	else
+	{
+		guint entry = g_array_index(priv->results, guint, row);
+
+		book = search_index_entry_book(priv->index, entry);
+		switch (column)
+		{
+			case SEARCH_RESULT_MODEL_COL_NAME:
+				g_value_set_static_string(value,
+					search_index_entry_name(priv->index, entry));
+				break;
+			case SEARCH_RESULT_MODEL_COL_URI:
+				g_value_take_string(value, search_index_entry_uri(priv->index, entry));
+				break;
+		}
+	}
+
+	if (column == SEARCH_RESULT_MODEL_COL_BOOK)
+		g_value_set_static_string(value, book_index_str(book, book->title));
+}
+
+static gboolean search_result_model_iter_next(GtkTreeModel *tree_model,
+											  GtkTreeIter *iter)
+{
+	DevhelpSearchResultModelPrivate *priv = DEVHELP_SEARCH_RESULT_MODEL(tree_model)->priv;
+	guint row = ITER_ROW(iter);
+
+	g_return_val_if_fail(iter->stamp == priv->stamp, FALSE);
+
+	if (row + 1 >= priv->results->len)
+		return FALSE;
+	set_iter(priv, iter, row + 1);
+	return TRUE;
+}
+
+static gboolean search_result_model_iter_children(GtkTreeModel *tree_model,
+												  GtkTreeIter *iter,
+												  GtkTreeIter *parent)
+{
+	DevhelpSearchResultModelPrivate *priv = DEVHELP_SEARCH_RESULT_MODEL(tree_model)->priv;
+
+	if (parent != NULL || priv->results->len == 0)
+		return FALSE;
+	set_iter(priv, iter, 0);
+	return TRUE;
+}
+
+static gboolean search_result_model_iter_has_child(GtkTreeModel *tree_model,
+												   GtkTreeIter *iter)
+{
+	return FALSE;
+}
+
+static gint search_result_model_iter_n_children(GtkTreeModel *tree_model,
+												GtkTreeIter *iter)
+{
+	DevhelpSearchResultModelPrivate *priv = DEVHELP_SEARCH_RESULT_MODEL(tree_model)->priv;
+
+	return (iter == NULL) ? (gint) priv->results->len : 0;
+}
+
+static gboolean search_result_model_iter_nth_child(GtkTreeModel *tree_model,
+												   GtkTreeIter *iter,
+												   GtkTreeIter *parent, gint n)
+{
+	DevhelpSearchResultModelPrivate *priv = DEVHELP_SEARCH_RESULT_MODEL(tree_model)->priv;
+
+	if (parent != NULL || n < 0 || (guint) n >= priv->results->len)
+		return FALSE;
+	set_iter(priv, iter, n);
+	return TRUE;
+}
+
+static gboolean search_result_model_iter_parent(GtkTreeModel *tree_model,
+												GtkTreeIter *iter, GtkTreeIter *child)
+{
+	return FALSE;
+}
+
+static void devhelp_search_result_model_iface_init(GtkTreeModelIface *iface)
+{
+	iface->get_flags = search_result_model_get_flags;
+	iface->get_n_columns = search_result_model_get_n_columns;
+	iface->get_column_type = search_result_model_get_column_type;
+	iface->get_iter = search_result_model_get_iter;
+	iface->get_path = search_result_model_get_path;
+	iface->get_value = search_result_model_get_value;
+	iface->iter_next = search_result_model_iter_next;
+	iface->iter_children = search_result_model_iter_children;
+	iface->iter_has_child = search_result_model_iter_has_child;
+	iface->iter_n_children = search_result_model_iter_n_children;
+	iface->iter_nth_child = search_result_model_iter_nth_child;
+	iface->iter_parent = search_result_model_iter_parent;
+}
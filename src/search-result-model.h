@@ -0,0 +1,85 @@
+/*
+ * search-result-model.h - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef SEARCH_RESULT_MODEL_H
+#define SEARCH_RESULT_MODEL_H
+
+#include <gtk/gtk.h>
+#include "search-index.h"
+#include "fulltext-index.h"
+
+G_BEGIN_DECLS
+
+#define DEVHELP_TYPE_SEARCH_RESULT_MODEL		(devhelp_search_result_model_get_type())
+#define DEVHELP_SEARCH_RESULT_MODEL(obj)		(G_TYPE_CHECK_INSTANCE_CAST((obj),\
+			DEVHELP_TYPE_SEARCH_RESULT_MODEL, DevhelpSearchResultModel))
+#define DEVHELP_SEARCH_RESULT_MODEL_CLASS(klass)	(G_TYPE_CHECK_CLASS_CAST((klass),\
+			DEVHELP_TYPE_SEARCH_RESULT_MODEL, DevhelpSearchResultModelClass))
+#define DEVHELP_IS_SEARCH_RESULT_MODEL(obj)		(G_TYPE_CHECK_INSTANCE_TYPE((obj),\
+			DEVHELP_TYPE_SEARCH_RESULT_MODEL))
+
+typedef struct _DevhelpSearchResultModel			DevhelpSearchResultModel;
+typedef struct _DevhelpSearchResultModelClass		DevhelpSearchResultModelClass;
+typedef struct _DevhelpSearchResultModelPrivate		DevhelpSearchResultModelPrivate;
+
+/*
+ * A read only list of search results, either entry numbers of a
+ * SearchIndex, FulltextHits or the IndexRefs the index daemon sends.  Only
+ * the numbers are stored, names, books and URIs are read from the index,
+ * or the books, when a row is drawn, so a view in fixed height mode only
+ * ever looks at the rows that are on screen.
+ *
+ * Results are only ever appended, a page at a time as the search is
+ * resumed.
+ *
+ * See search-result-model.c for documentation for these functions
+ */
+struct _DevhelpSearchResultModel
+{
+	GObject parent;
+
+	DevhelpSearchResultModelPrivate *priv;
+};
+
+struct _DevhelpSearchResultModelClass
+{
+	GObjectClass parent_class;
+};
+
+enum
+{
+	SEARCH_RESULT_MODEL_COL_NAME,
+	SEARCH_RESULT_MODEL_COL_BOOK,		/* title of the book */
+	SEARCH_RESULT_MODEL_COL_URI,
+	SEARCH_RESULT_MODEL_N_COLUMNS
+};
+
+GType devhelp_search_result_model_get_type(void);
+DevhelpSearchResultModel *devhelp_search_result_model_new(SearchIndex *index,
+														  FulltextIndex *fulltext);
+DevhelpSearchResultModel *devhelp_search_result_model_new_refs(GPtrArray *books);
+
+void devhelp_search_result_model_append(DevhelpSearchResultModel *model,
+										GArray *results);
+
+G_END_DECLS
+
+#endif
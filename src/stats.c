@@ -0,0 +1,242 @@
+/*
+ * stats.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "stats.h"
+
+/* values under this get a bucket each */
+#define STATS_LINEAR			8
+/* buckets per power of two above that */
+#define STATS_SUB_BUCKETS		4
+/* up to 2^40 us, about 12 days */
+#define STATS_MAX_POWER			40
+#define STATS_N_BUCKETS \
+	(STATS_LINEAR + (STATS_MAX_POWER - 3) * STATS_SUB_BUCKETS)
+
+typedef struct
+{
+	guint64 count;
+	gint64 total;
+	gint64 min;
+	gint64 max;
+	guint64 buckets[STATS_N_BUCKETS];
+} Histogram;
+
+static const gchar *operation_names[STATS_N_OPERATIONS] = {
+	"plugin_init",
+	"plugin_new",
+	"widgets",
+	"book_load",
+	"home_load",
+	"page_load",
+	"search",
+	"main_notebook"
+};
+
+gboolean stats_enabled = FALSE;
+
+static guint threshold = 0;			/* ms, 0 to never log */
+static Histogram histograms[STATS_N_OPERATIONS];
+static GStaticMutex lock = G_STATIC_MUTEX_INIT;
+
+static guint bucket_for(gint64 us)
+{
+	guint power;
+
+	if (us < STATS_LINEAR)
+		return (guint) MAX(us, 0);
+
+	power = g_bit_storage((gulong) us) - 1;
+	if (power >= STATS_MAX_POWER)
+		return STATS_N_BUCKETS - 1;
+
+	return STATS_LINEAR + (power - 3) * STATS_SUB_BUCKETS +
+		((us >> (power - 2)) & (STATS_SUB_BUCKETS - 1));
+}
+
+/* The largest value that lands in bucket */
+static gint64 bucket_limit(guint bucket)
+{
+	guint power, sub;
+
+	if (bucket < STATS_LINEAR)
+		return bucket;
+
+	power = 3 + (bucket - STATS_LINEAR) / STATS_SUB_BUCKETS;
+	sub = (bucket - STATS_LINEAR) % STATS_SUB_BUCKETS;
+
+	return ((gint64) (STATS_SUB_BUCKETS + sub + 1) << (power - 2)) - 1;
+}
+
+/**
+ * Turns timing on or off.  What was recorded is kept either way.
+ */
+void stats_set_enabled(gboolean enabled)
+{
+	stats_enabled = enabled;
+}
+
+/**
+ * Sets how long an operation can take before it's logged.
+ *
+ * @param threshold_ms	Milliseconds, 0 to never log.
+ */
+void stats_set_threshold(guint threshold_ms)
+{
+	threshold = threshold_ms;
+}
+
+/**
+ * Records how long an operation took.  Does nothing if timing is off.
+ *
+ * @param op	The operation.
+ * @param us	How long it took, in microseconds.
+ */
+void stats_record(StatsOperation op, gint64 us)
+{
+	Histogram *h;
+
+	if (!stats_enabled || op >= STATS_N_OPERATIONS)
+		return;
+
+	h = &histograms[op];
+	us = MAX(us, 0);
+
+	g_static_mutex_lock(&lock);
+	if (h->count == 0 || us < h->min)
+		h->min = us;
+	if (us > h->max)
+		h->max = us;
+	h->count++;
+	h->total += us;
+	h->buckets[bucket_for(us)]++;
+	g_static_mutex_unlock(&lock);
+
+	if (threshold > 0 && us >= (gint64) threshold * 1000)
+		g_message("Devhelp: %s took %.1f ms", operation_names[op], us / 1000.0);
+}
+
+/**
+ * Records an operation that started at start, as returned by
+ * stats_begin().  Does nothing if start is 0.
+ */
+void stats_end(StatsOperation op, gint64 start)
+{
+	if (start != 0)
+		stats_record(op, g_get_monotonic_time() - start);
+}
+
+/* Forgets everything that was recorded */
+void stats_reset(void)
+{
+	g_static_mutex_lock(&lock);
+	memset(histograms, 0, sizeof(histograms));
+	g_static_mutex_unlock(&lock);
+}
+
+/* Upper limit of the bucket the value at fraction of the way up falls in */
+static gint64 percentile(const Histogram *h, gdouble fraction)
+{
+	guint64 rank = (guint64) (fraction * h->count + 0.5), seen = 0;
+	guint i;
+
+	rank = CLAMP(rank, 1, h->count);
+	for (i = 0; i < STATS_N_BUCKETS; i++)
+	{
+		seen += h->buckets[i];
+		if (seen >= rank)
+			return MIN(bucket_limit(i), h->max);
+	}
+	return h->max;
+}
+
+/**
+ * Writes out everything recorded as JSON: for each operation the count,
+ * total, min, max, mean and percentiles in microseconds, and the non
+ * empty buckets as [largest value, count] pairs.
+ *
+ * @return	A newly allocated string.
+ */
+gchar *stats_to_json(void)
+{
+	GString *json = g_string_new(NULL);
+	Histogram copy[STATS_N_OPERATIONS];
+	guint op, i;
+
+	g_static_mutex_lock(&lock);
+	memcpy(copy, histograms, sizeof(copy));
+	g_static_mutex_unlock(&lock);
+
+	g_string_append_printf(json, "{\n  \"enabled\": %s,\n  \"threshold_ms\": %u,\n"
+		"  \"operations\": {", stats_enabled ? "true" : "false", threshold);
+
+	for (op = 0; op < STATS_N_OPERATIONS; op++)
+	{
+		const Histogram *h = &copy[op];
+		gboolean first = TRUE;
+
+		g_string_append_printf(json, "%s\n    \"%s\": {\"count\": %" G_GUINT64_FORMAT,
+			op > 0 ? "," : "", operation_names[op], h->count);
+		if (h->count > 0)
+		{
+			g_string_append_printf(json, ", \"total_us\": %" G_GINT64_FORMAT
+				", \"min_us\": %" G_GINT64_FORMAT ", \"max_us\": %" G_GINT64_FORMAT
+				", \"mean_us\": %" G_GINT64_FORMAT ", \"p50_us\": %" G_GINT64_FORMAT
+				", \"p90_us\": %" G_GINT64_FORMAT ", \"p99_us\": %" G_GINT64_FORMAT,
+				h->total, h->min, h->max, h->total / (gint64) h->count,
+				percentile(h, 0.5), percentile(h, 0.9), percentile(h, 0.99));
+		}
+		g_string_append(json, ", \"buckets\": [");
+		for (i = 0; i < STATS_N_BUCKETS; i++)
+		{
+			if (h->buckets[i] == 0)
+				continue;
+			g_string_append_printf(json, "%s[%" G_GINT64_FORMAT ", %" G_GUINT64_FORMAT "]",
+				first ? "" : ", ", bucket_limit(i), h->buckets[i]);
+			first = FALSE;
+		}
+		g_string_append(json, "]}");
+	}
+	g_string_append(json, "\n  }\n}\n");
+
+	return g_string_free(json, FALSE);
+}
+
+/**
+ * Writes stats_to_json() to a file.
+ *
+ * @param path	The file to write, it's replaced.
+ * @param error	Return location for an error, or NULL.
+ *
+ * @return	TRUE on success.
+ */
+gboolean stats_dump(const gchar *path, GError **error)
+{
+	gchar *json = stats_to_json();
+	gboolean ok = g_file_set_contents(path, json, -1, error);
+
+	g_free(json);
+	return ok;
+}
@@ -0,0 +1,73 @@
+/*
+ * stats.h - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Latency histograms of the operations users notice, to find out where the
+ * time goes when the plugin feels slow.  Each operation has a histogram
+ * with four buckets per power of two microseconds, which keeps percentiles
+ * within 25% whatever the scale, from microseconds to minutes.
+ *
+ * Timing is off by default.  While it is, stats_begin() returns 0 without
+ * reading the clock and stats_end() does nothing with a 0 start, so the
+ * cost of an instrumented operation is a test of a global.
+ *
+ * Operations can finish on any thread, recording takes a lock.
+ *
+ * See stats.c for documentation for these functions
+ */
+
+typedef enum
+{
+	STATS_PLUGIN_INIT,			/* plugin_init() */
+	STATS_PLUGIN_NEW,			/* devhelp_plugin_new() */
+	STATS_WIDGETS,				/* building the plugin's widgets */
+	STATS_BOOK_LOAD,			/* starting to load books to the sidebar filled */
+	STATS_HOME_LOAD,			/* the home page, from creating its view */
+	STATS_PAGE_LOAD,			/* a link opened to its page loaded */
+	STATS_SEARCH,				/* keystroke to search results shown */
+	STATS_MAIN_NOTEBOOK,		/* main_notebook_acquire() */
+	STATS_N_OPERATIONS
+} StatsOperation;
+
+extern gboolean stats_enabled;
+
+/* Start time of an operation, 0 if timing is off */
+#define stats_begin()	(G_UNLIKELY(stats_enabled) ? g_get_monotonic_time() : 0)
+
+void stats_set_enabled(gboolean enabled);
+void stats_set_threshold(guint threshold_ms);
+void stats_end(StatsOperation op, gint64 start);
+void stats_record(StatsOperation op, gint64 us);
+void stats_reset(void);
+gchar *stats_to_json(void);
+gboolean stats_dump(const gchar *path, GError **error);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,554 @@
+/*
+ * summary-store.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+
+#include "book-index.h"
+#include "cache-util.h"
+#include "html-util.h"
+#include "summary-store.h"
+#include "work-pool.h"
+
+/*
+ * Cache file layout, see cache-util.h:
+ *
+ *   SumHeader
+ *   SumEntry[n_keywords]		in the order of the book's keywords
+ *   string pool				NUL separated, offset 0 is ""
+ */
+#define SUMMARY_MAGIC		"GDHSUMRY"
+#define SUMMARY_VERSION		1
+
+/* how far past a keyword's anchor its signature and summary are looked for */
+#define SUMMARY_SCAN_LIMIT		32768
+
+/* longer text is cut short, in characters */
+#define MAX_SIGNATURE_CHARS		200
+#define MAX_SUMMARY_CHARS		300
+
+typedef struct
+{
+	gchar magic[8];
+	guint32 version;
+	guint32 n_keywords;
+	gint64 mtime;				/* of the book when it was extracted */
+	guint32 strings_len;
+	guint32 n_found;			/* keywords that have a signature or summary */
+} SumHeader;
+
+typedef struct
+{
+	guint32 signature;			/* offsets in the string pool, 0 for none */
+	guint32 summary;
+} SumEntry;
+
+/* One book's summaries, read from the cache or freshly extracted */
+typedef struct
+{
+	gchar *data;
+	const SumHeader *header;
+	const SumEntry *entries;
+	const gchar *strings;
+} SumBook;
+
+struct _SummaryStore
+{
+	volatile gint ref_count;
+	GPtrArray *books;			/* array of BookIndex, referenced */
+	SumBook *sum_books;			/* one for each of books */
+};
+
+/* Shared by the workers extracting books */
+typedef struct
+{
+	SummaryStore *store;
+	gchar *cache_dir;
+	GCancellable *cancellable;
+	volatile gint n_extracted;
+} ExtractContext;
+
+/* Cuts text down to max_chars characters, at a word if there's one near */
+static void clip_text(GString *text, glong max_chars)
+{
+	const gchar *end, *space;
+
+	if (text->len > 0 && text->str[text->len - 1] == ' ')
+		g_string_truncate(text, text->len - 1);
+	if (text->len > 0 && text->str[0] == ' ')
+		g_string_erase(text, 0, 1);
+
+	if (g_utf8_strlen(text->str, text->len) <= max_chars)
+		return;
+
+	end = g_utf8_offset_to_pointer(text->str, max_chars);
+	space = g_strrstr_len(text->str, end - text->str, " ");
+	if (space != NULL && end - space < 24)
+		end = space;
+	g_string_truncate(text, end - text->str);
+	g_string_append(text, "\342\200\246");
+}
+
+/* Puts the text of some HTML in the pool, cut to max_chars */
+static guint32 pool_add_html(GString *pool, GString *scratch, const gchar *html,
+							 gsize len, glong max_chars)
+{
+	g_string_truncate(scratch, 0);
+	html_append_text(scratch, html, len);
+	clip_text(scratch, max_chars);
+
+	/* pages that aren't UTF-8 are left without summaries */
+	if (scratch->len == 0 || !g_utf8_validate(scratch->str, scratch->len, NULL))
+		return 0;
+	return cache_util_pool_add(pool, scratch->str, scratch->len);
+}
+
+/*
+ * Finds the signature and summary of whatever is documented at pos.  The
+ * first <pre> is taken as the signature and the first paragraph with some
+ * text as the summary.  The keyword's own heading usually comes right after
+ * its anchor, the next heading or rule is where the next thing starts.
+ */
+static void extract_entry(GString *pool, GString *scratch, const gchar *html,
+						  gsize len, gsize pos, SumEntry *entry)
+{
+	gsize limit = MIN(len, pos + SUMMARY_SCAN_LIMIT);
+	gboolean seen_heading = FALSE;
+
+	entry->signature = 0;
+	entry->summary = 0;
+
+	while (pos < limit)
+	{
+		const gchar *lt = memchr(html + pos, '<', limit - pos);
+		const gchar *tag, *gt, *close;
+		gsize tag_len;
+
+		if (lt == NULL)
+			break;
+		tag = lt + 1;
+		gt = memchr(tag, '>', limit - (tag - html));
+		if (gt == NULL)
+			break;
+		tag_len = gt - tag;
+		pos = (gt - html) + 1;
+
+		if (tag[0] == 'h' && tag_len >= 2 && g_ascii_isdigit(tag[1]))
+		{
+			if (seen_heading || entry->signature != 0)
+				break;
+			seen_heading = TRUE;
+		}
+		else if (html_tag_is(tag, tag_len, "hr"))
+			break;
+		else if (html_tag_is(tag, tag_len, "pre") && entry->signature == 0)
+		{
+			close = g_strstr_len(html + pos, limit - pos, "</pre");
+			if (close == NULL)
+				break;
+			entry->signature = pool_add_html(pool, scratch, html + pos,
+											 close - (html + pos),
+											 MAX_SIGNATURE_CHARS);
+			pos = close - html;
+		}
+		else if (html_tag_is(tag, tag_len, "p"))
+		{
+			close = g_strstr_len(html + pos, limit - pos, "</p");
+			if (close == NULL)
+				break;
+			entry->summary = pool_add_html(pool, scratch, html + pos,
+										   close - (html + pos),
+										   MAX_SUMMARY_CHARS);
+			pos = close - html;
+			if (entry->summary != 0)
+				break;
+		}
+	}
+}
+
+/* Records where each anchor of a page ends, in a single pass over it */
+static void find_anchors(GHashTable *anchors, const gchar *html, gsize len)
+{
+	gsize i = 0;
+
+	while (i < len)
+	{
+		const gchar *lt = memchr(html + i, '<', len - i);
+		const gchar *tag, *gt, *name;
+		gsize tag_len, name_len;
+
+		if (lt == NULL)
+			break;
+		tag = lt + 1;
+		gt = memchr(tag, '>', len - (tag - html));
+		if (gt == NULL)
+			break;
+		tag_len = gt - tag;
+		i = (gt - html) + 1;
+
+		/* the first one wins, like in a browser */
+		name = html_tag_anchor(tag, tag_len, &name_len);
+		if (name != NULL)
+		{
+			gchar *key = g_strndup(name, name_len);
+			if (g_hash_table_lookup(anchors, key) == NULL)
+				g_hash_table_insert(anchors, key, GSIZE_TO_POINTER(i + 1));
+			else
+				g_free(key);
+		}
+	}
+}
+
+/* Extracts the entries of the keywords linking to one page */
+static guint extract_page(const BookIndex *book, const gchar *page,
+						  GArray *keywords, SumEntry *entries, GString *pool,
+						  GString *scratch, GHashTable *anchors)
+{
+	gchar *path = g_build_filename(book_index_str(book, book->base), page, NULL);
+	GMappedFile *mapped = g_mapped_file_new(path, FALSE, NULL);
+	const gchar *html, *body;
+	gsize len, start;
+	guint i, n_found = 0;
+
+	g_free(path);
+	if (mapped == NULL)
+		return 0;
+
+	html = g_mapped_file_get_contents(mapped);
+	len = g_mapped_file_get_length(mapped);
+
+	g_hash_table_remove_all(anchors);
+	find_anchors(anchors, html, len);
+
+	/* keywords without an anchor are about the whole page */
+	body = g_strstr_len(html, len, "<body");
+	start = (body != NULL) ? (gsize) (body - html) : 0;
+
+	for (i = 0; i < keywords->len; i++)
+	{
+		guint keyword = g_array_index(keywords, guint, i);
+		const gchar *link = book_index_str(book, book->keywords[keyword].link);
+		const gchar *hash = strchr(link, '#');
+		gsize pos = start;
+
+		if (hash != NULL)
+		{
+			pos = GPOINTER_TO_SIZE(g_hash_table_lookup(anchors, hash + 1));
+			if (pos == 0)
+				continue;
+			pos--;
+		}
+
+		extract_entry(pool, scratch, html, len, pos, &entries[keyword]);
+		if (entries[keyword].signature != 0 || entries[keyword].summary != 0)
+			n_found++;
+	}
+
+	g_mapped_file_unref(mapped);
+
+	return n_found;
+}
+
+static void free_keywords(gpointer data)
+{
+	g_array_free(data, TRUE);
+}
+
+/* Extracts the summaries of a book's keywords and lays them out as a blob */
+static gchar *extract_book(const BookIndex *book, gint64 mtime,
+						   GCancellable *cancellable, gsize *out_size)
+{
+	GHashTable *pages, *anchors;
+	GHashTableIter iter;
+	gpointer key, value;
+	SumEntry *entries;
+	SumHeader header;
+	GString *pool, *scratch;
+	gchar *data;
+	guint i, n_found = 0;
+
+	/* keywords grouped by page so each page is only read once */
+	pages = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free_keywords);
+	for (i = 0; i < book->n_keywords; i++)
+	{
+		const gchar *link = book_index_str(book, book->keywords[i].link);
+		const gchar *hash = strchr(link, '#');
+		gchar *page = hash ? g_strndup(link, hash - link) : g_strdup(link);
+		GArray *keywords;
+
+		/* URIs aren't files in the book, man pages for one */
+		if (page[0] == '\0' || strstr(page, "://") != NULL)
+		{
+			g_free(page);
+			continue;
+		}
+		keywords = g_hash_table_lookup(pages, page);
+		if (keywords == NULL)
+		{
+			keywords = g_array_new(FALSE, FALSE, sizeof(guint));
+			g_hash_table_insert(pages, page, keywords);
+		}
+		else
+			g_free(page);
+		g_array_append_val(keywords, i);
+	}
+
+	entries = g_new0(SumEntry, book->n_keywords);
+	pool = g_string_new_len("", 1);
+	scratch = g_string_new(NULL);
+	anchors = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+	g_hash_table_iter_init(&iter, pages);
+	while (g_hash_table_iter_next(&iter, &key, &value))
+	{
+		n_found += extract_page(book, key, value, entries, pool, scratch, anchors);
+		if (g_cancellable_is_cancelled(cancellable))
+			break;
+	}
+
+	if (g_cancellable_is_cancelled(cancellable))
+		data = NULL;
+	else
+	{
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, SUMMARY_MAGIC, sizeof(header.magic));
+		header.version = SUMMARY_VERSION;
+		header.n_keywords = book->n_keywords;
+		header.mtime = mtime;
+		header.strings_len = pool->len;
+		header.n_found = n_found;
+
+		*out_size = sizeof(header) + book->n_keywords * sizeof(SumEntry) + pool->len;
+		data = g_malloc(*out_size);
+		memcpy(data, &header, sizeof(header));
+		memcpy(data + sizeof(header), entries, book->n_keywords * sizeof(SumEntry));
+		memcpy(data + sizeof(header) + book->n_keywords * sizeof(SumEntry),
+			   pool->str, pool->len);
+	}
+
+	g_hash_table_destroy(anchors);
+	g_string_free(scratch, TRUE);
+	g_string_free(pool, TRUE);
+	g_free(entries);
+	g_hash_table_destroy(pages);
+
+	return data;
+}
+
+/* Points sb's arrays into data, checking that everything fits in size */
+static gboolean sum_book_attach(SumBook *sb, const gchar *data, gsize size,
+								const BookIndex *book, gint64 mtime)
+{
+	const SumHeader *header = (const SumHeader *) data;
+	const SumEntry *entries;
+	guint64 need;
+	guint i;
+
+	if (size < sizeof(SumHeader) ||
+		memcmp(header->magic, SUMMARY_MAGIC, sizeof(header->magic)) != 0 ||
+		header->version != SUMMARY_VERSION || header->mtime != mtime ||
+		header->n_keywords != book->n_keywords || header->strings_len == 0)
+		return FALSE;
+
+	need = sizeof(SumHeader) + (guint64) header->n_keywords * sizeof(SumEntry) +
+		header->strings_len;
+	if (need != size || data[size - 1] != '\0')
+		return FALSE;
+
+	entries = (const SumEntry *) (data + sizeof(SumHeader));
+	for (i = 0; i < header->n_keywords; i++)
+	{
+		if (entries[i].signature >= header->strings_len ||
+			entries[i].summary >= header->strings_len)
+			return FALSE;
+	}
+
+	sb->header = header;
+	sb->entries = entries;
+	sb->strings = (const gchar *) (entries + header->n_keywords);
+
+	return TRUE;
+}
+
+/* Reads one book's summaries from the cache or extracts them, on a worker */
+static void load_book(gpointer item, gpointer user_data)
+{
+	ExtractContext *ctx = user_data;
+	guint i = GPOINTER_TO_UINT(item) - 1;
+	const BookIndex *book = g_ptr_array_index(ctx->store->books, i);
+	SumBook *sb = &ctx->store->sum_books[i];
+	gchar *path = NULL, *data;
+	gint64 mtime;
+	gsize size;
+
+	if (g_cancellable_is_cancelled(ctx->cancellable) || book->n_keywords == 0)
+		return;
+
+	mtime = cache_util_book_mtime(book);
+
+	if (ctx->cache_dir != NULL)
+	{
+		path = cache_util_book_path(ctx->cache_dir, book, ".sum");
+		if (g_file_get_contents(path, &data, &size, NULL))
+		{
+			if (sum_book_attach(sb, data, size, book, mtime))
+			{
+				sb->data = data;
+				g_free(path);
+				return;
+			}
+			g_free(data);
+		}
+	}
+
+	data = extract_book(book, mtime, ctx->cancellable, &size);
+	if (data != NULL && sum_book_attach(sb, data, size, book, mtime))
+	{
+		sb->data = data;
+		g_atomic_int_inc(&ctx->n_extracted);
+		if (path != NULL)
+			cache_util_save(path, data, size, "summaries");
+	}
+	else
+		g_free(data);
+
+	g_free(path);
+}
+
+/**
+ * Loads the summaries of every book's keywords, extracting the ones that
+ * aren't in cache_dir or have changed.  Books are done in parallel and this
+ * returns once they're all done, so call it from a thread of its own.
+ *
+ * @param books			Array of BookIndex, a reference is kept on it.
+ * @param cache_dir		Directory to keep the per book summaries in, or NULL
+ * 						to always extract them.
+ * @param cancellable	Stops the extracting early, books not done yet are
+ * 						left without summaries.  Can be NULL.
+ *
+ * @return	A new SummaryStore, release it with summary_store_unref().
+ */
+SummaryStore *summary_store_new(GPtrArray *books, const gchar *cache_dir,
+								GCancellable *cancellable)
+{
+	SummaryStore *store;
+	ExtractContext ctx;
+	WorkPool *pool;
+	guint64 n_found = 0;
+	gint64 start = g_get_monotonic_time();
+	guint i;
+
+	store = g_new0(SummaryStore, 1);
+	store->ref_count = 1;
+	store->books = g_ptr_array_ref(books);
+	store->sum_books = g_new0(SumBook, books->len);
+
+	ctx.store = store;
+	ctx.cache_dir = (cache_dir != NULL &&
+		g_mkdir_with_parents(cache_dir, 0700) == 0) ? g_strdup(cache_dir) : NULL;
+	ctx.cancellable = cancellable;
+	ctx.n_extracted = 0;
+
+	pool = work_pool_new(0, load_book, &ctx);
+	for (i = 0; i < books->len; i++)
+		work_pool_push(pool, GUINT_TO_POINTER(i + 1));
+	work_pool_run(pool);
+
+	for (i = 0; i < books->len; i++)
+	{
+		if (store->sum_books[i].header != NULL)
+			n_found += store->sum_books[i].header->n_found;
+	}
+
+	g_debug("Devhelp summaries: %" G_GUINT64_FORMAT " keywords of %u books, "
+			"%d extracted, in %.1f ms on %u threads", n_found, books->len,
+			g_atomic_int_get(&ctx.n_extracted),
+			(g_get_monotonic_time() - start) / 1000.0,
+			work_pool_get_n_threads(pool));
+
+	work_pool_free(pool);
+	g_free(ctx.cache_dir);
+
+	return store;
+}
+
+SummaryStore *summary_store_ref(SummaryStore *store)
+{
+	g_atomic_int_inc(&store->ref_count);
+	return store;
+}
+
+void summary_store_unref(SummaryStore *store)
+{
+	guint i;
+
+	if (store == NULL || !g_atomic_int_dec_and_test(&store->ref_count))
+		return;
+
+	for (i = 0; i < store->books->len; i++)
+		g_free(store->sum_books[i].data);
+	g_free(store->sum_books);
+	g_ptr_array_unref(store->books);
+	g_free(store);
+}
+
+/* The books the store was built from, its book numbers index into these */
+GPtrArray *summary_store_get_books(SummaryStore *store)
+{
+	return store->books;
+}
+
+/**
+ * Gets the signature and summary of a keyword.  Never touches the disk.
+ *
+ * @param store		The summary store.
+ * @param book		Index of the book in the store's books.
+ * @param keyword	Index of the keyword in the book.
+ * @param signature	Return location for the signature, NULL if it has none.
+ * @param summary	Return location for the summary, NULL if it has none.
+ *
+ * @return	FALSE if the keyword has neither.
+ */
+gboolean summary_store_lookup(SummaryStore *store, guint book, guint keyword,
+							  const gchar **signature, const gchar **summary)
+{
+	const SumBook *sb;
+	const SumEntry *entry;
+
+	if (book >= store->books->len)
+		return FALSE;
+
+	sb = &store->sum_books[book];
+	if (sb->header == NULL || keyword >= sb->header->n_keywords)
+		return FALSE;
+
+	entry = &sb->entries[keyword];
+	if (entry->signature == 0 && entry->summary == 0)
+		return FALSE;
+
+	*signature = entry->signature ? sb->strings + entry->signature : NULL;
+	*summary = entry->summary ? sb->strings + entry->summary : NULL;
+
+	return TRUE;
+}
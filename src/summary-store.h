@@ -0,0 +1,62 @@
+/*
+ * summary-store.h - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef SUMMARY_STORE_H
+#define SUMMARY_STORE_H
+
+#include <glib.h>
+#include <gio/gio.h>
+#include "book-index.h"
+
+G_BEGIN_DECLS
+
+/*
+ * The signature and first paragraph of every keyword, pulled out of the
+ * books' HTML ahead of time so showing them is only a lookup.
+ *
+ * Each book has a table with one (signature, summary) pair of string
+ * offsets per keyword, in the same order as the book's keywords, and a
+ * string pool.  A book's table is written to the cache directory as one
+ * blob and read back the next time, it's only extracted again when the
+ * book or its directory changes.  Books are extracted on a WorkPool.
+ *
+ * Everything, including reading the cache, happens in summary_store_new()
+ * so the store can be built on a thread of its own and then looked up from
+ * the main thread without ever touching the disk.  A SummaryStore is
+ * immutable once built and reference counted.
+ *
+ * See summary-store.c for documentation for these functions
+ */
+
+typedef struct _SummaryStore	SummaryStore;
+
+SummaryStore *summary_store_new(GPtrArray *books, const gchar *cache_dir,
+								GCancellable *cancellable);
+SummaryStore *summary_store_ref(SummaryStore *store);
+void summary_store_unref(SummaryStore *store);
+
+GPtrArray *summary_store_get_books(SummaryStore *store);
+gboolean summary_store_lookup(SummaryStore *store, guint book, guint keyword,
+							  const gchar **signature, const gchar **summary);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,282 @@
+/*
+ * symbol-table.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <glib.h>
+
+#include "search-index.h"
+#include "symbol-table.h"
+
+/* symbols resolved per idle callback, small enough not to be noticed */
+#define SYMBOL_TABLE_CHUNK	2048
+
+typedef struct
+{
+	guint refs;					/* sources the symbol is in */
+	gboolean resolved;			/* docs are up to date with the index */
+	SymbolDocs docs;
+} Symbol;
+
+struct _SymbolTable
+{
+	SearchIndex *index;			/* NULL until the books are loaded */
+	GHashTable *symbols;		/* name -> Symbol */
+	GHashTable *sources;		/* source -> GPtrArray of its names */
+	GQueue pending;				/* names still to be resolved */
+	guint idle_id;
+};
+
+/**
+ * Creates an empty symbol table with no index to resolve symbols with.
+ *
+ * @return	A new SymbolTable, free it with symbol_table_free().
+ */
+SymbolTable *symbol_table_new(void)
+{
+	SymbolTable *table = g_new0(SymbolTable, 1);
+
+	table->symbols = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+	table->sources = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL,
+										   (GDestroyNotify) g_ptr_array_unref);
+	g_queue_init(&table->pending);
+
+	return table;
+}
+
+static void clear_pending(SymbolTable *table)
+{
+	gchar *name;
+
+	while ((name = g_queue_pop_head(&table->pending)) != NULL)
+		g_free(name);
+}
+
+void symbol_table_free(SymbolTable *table)
+{
+	if (table == NULL)
+		return;
+
+	if (table->idle_id != 0)
+		g_source_remove(table->idle_id);
+	clear_pending(table);
+	g_hash_table_destroy(table->sources);
+	g_hash_table_destroy(table->symbols);
+	search_index_unref(table->index);
+	g_free(table);
+}
+
+/**
+ * Looks a name up in an index directly, exact names first then ignoring
+ * case, the same way the symbols of a table are resolved.
+ *
+ * @param index	The index to look in.
+ * @param name	The symbol.
+ * @param docs	Return location for what documents it.
+ */
+void symbol_table_resolve(SearchIndex *index, const gchar *name, SymbolDocs *docs)
+{
+	guint entry, end;
+
+	docs->documented = FALSE;
+	docs->entry = 0;
+	docs->n_exact = 0;
+
+	if (search_index_lookup(index, name, &entry))
+	{
+		docs->documented = TRUE;
+		docs->entry = entry;
+		do
+			docs->n_exact++;
+		while (search_index_lookup_next(index, &entry));
+	}
+	else if (search_index_exact_range(index, name, &entry, &end))
+	{
+		docs->documented = TRUE;
+		docs->entry = entry;
+	}
+}
+
+static void resolve_symbol(SymbolTable *table, const gchar *name, Symbol *symbol)
+{
+	symbol_table_resolve(table->index, name, &symbol->docs);
+	symbol->resolved = TRUE;
+}
+
+static gboolean on_resolve_idle(gpointer user_data)
+{
+	SymbolTable *table = user_data;
+	guint i;
+
+	for (i = 0; i < SYMBOL_TABLE_CHUNK; i++)
+	{
+		gchar *name = g_queue_pop_head(&table->pending);
+		Symbol *symbol;
+
+		if (name == NULL)
+			break;
+
+		/* it may have been removed, or looked up already, since */
+		symbol = g_hash_table_lookup(table->symbols, name);
+		if (symbol != NULL && !symbol->resolved)
+			resolve_symbol(table, name, symbol);
+		g_free(name);
+	}
+
+	if (g_queue_is_empty(&table->pending))
+	{
+		table->idle_id = 0;
+		return FALSE;
+	}
+	return TRUE;
+}
+
+static void queue_symbol(SymbolTable *table, const gchar *name)
+{
+	if (table->index == NULL)
+		return;
+
+	g_queue_push_tail(&table->pending, g_strdup(name));
+	if (table->idle_id == 0)
+		table->idle_id = g_idle_add_full(G_PRIORITY_LOW, on_resolve_idle, table,
+										 NULL);
+}
+
+/**
+ * Sets the index symbols are resolved with.  Every symbol is resolved
+ * again, in the background.
+ *
+ * @param table	The symbol table.
+ * @param index	The new index or NULL, a reference is taken on it.
+ */
+void symbol_table_set_index(SymbolTable *table, SearchIndex *index)
+{
+	GHashTableIter iter;
+	gpointer key, value;
+
+	if (index != NULL)
+		search_index_ref(index);
+	search_index_unref(table->index);
+	table->index = index;
+
+	clear_pending(table);
+
+	g_hash_table_iter_init(&iter, table->symbols);
+	while (g_hash_table_iter_next(&iter, &key, &value))
+	{
+		((Symbol *) value)->resolved = FALSE;
+		queue_symbol(table, key);
+	}
+}
+
+static void release_names(SymbolTable *table, GPtrArray *names)
+{
+	guint i;
+
+	for (i = 0; i < names->len; i++)
+	{
+		Symbol *symbol = g_hash_table_lookup(table->symbols, names->pdata[i]);
+
+		if (symbol != NULL && --symbol->refs == 0)
+			g_hash_table_remove(table->symbols, names->pdata[i]);
+	}
+}
+
+/**
+ * Sets the symbols of a source, replacing the ones it had.  Symbols that
+ * weren't in the table yet are resolved in the background.
+ *
+ * @param table		The symbol table.
+ * @param source	Number of the source, SYMBOL_TABLE_GLOBAL_SOURCE for the
+ * 					global tags.
+ * @param names		Array of symbol names, they're copied.
+ */
+void symbol_table_set_source(SymbolTable *table, guint source, GPtrArray *names)
+{
+	GPtrArray *copy, *old;
+	guint i;
+
+	copy = g_ptr_array_new_with_free_func(g_free);
+	for (i = 0; i < names->len; i++)
+	{
+		const gchar *name = names->pdata[i];
+		Symbol *symbol = g_hash_table_lookup(table->symbols, name);
+
+		if (symbol == NULL)
+		{
+			symbol = g_new0(Symbol, 1);
+			g_hash_table_insert(table->symbols, g_strdup(name), symbol);
+			queue_symbol(table, name);
+		}
+		symbol->refs++;
+		g_ptr_array_add(copy, g_strdup(name));
+	}
+
+	/* the new ones are added first so symbols in both never go away */
+	old = g_hash_table_lookup(table->sources, GUINT_TO_POINTER(source));
+	if (old != NULL)
+		release_names(table, old);
+	g_hash_table_insert(table->sources, GUINT_TO_POINTER(source), copy);
+}
+
+/**
+ * Drops the symbols of a source, symbols no other source has are removed.
+ */
+void symbol_table_remove_source(SymbolTable *table, guint source)
+{
+	GPtrArray *old = g_hash_table_lookup(table->sources, GUINT_TO_POINTER(source));
+
+	if (old == NULL)
+		return;
+
+	release_names(table, old);
+	g_hash_table_remove(table->sources, GUINT_TO_POINTER(source));
+}
+
+/**
+ * Gets the documentation of a symbol.  Symbols in the table are resolved
+ * right away if that hasn't happened yet, others are looked up in the
+ * index without being added.
+ *
+ * @param table	The symbol table.
+ * @param name	The symbol.
+ * @param docs	Return location for what documents it.
+ *
+ * @return	FALSE if there's no index yet.
+ */
+gboolean symbol_table_lookup(SymbolTable *table, const gchar *name,
+							 SymbolDocs *docs)
+{
+	Symbol *symbol, scratch;
+
+	if (table->index == NULL)
+		return FALSE;
+
+	symbol = g_hash_table_lookup(table->symbols, name);
+	if (symbol == NULL)
+	{
+		resolve_symbol(table, name, &scratch);
+		symbol = &scratch;
+	}
+	else if (!symbol->resolved)
+		resolve_symbol(table, name, symbol);
+	*docs = symbol->docs;
+
+	return TRUE;
+}
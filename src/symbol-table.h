@@ -0,0 +1,70 @@
+/*
+ * symbol-table.h - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include <glib.h>
+#include "search-index.h"
+
+G_BEGIN_DECLS
+
+/*
+ * The documentation of the symbols Geany's tag manager knows about: the
+ * functions, types and macros of the open documents and of the global tags
+ * files.  Symbols come in sets from numbered sources (one per document)
+ * and each is resolved against the SearchIndex once, in the background on
+ * the main loop, so asking about a symbol later is a single probe of this
+ * table.  Symbols nothing documents are remembered as such, so looking
+ * them up never touches the index at all.
+ *
+ * See symbol-table.c for documentation for these functions
+ */
+
+/* the source number of the global tags */
+#define SYMBOL_TABLE_GLOBAL_SOURCE	G_MAXUINT
+
+typedef struct _SymbolTable		SymbolTable;
+typedef struct _SymbolDocs		SymbolDocs;
+
+struct _SymbolDocs
+{
+	gboolean documented;		/* FALSE if no keyword has this name, not
+								 * even ignoring case */
+	guint entry;				/* first such keyword in the index */
+	guint n_exact;				/* keywords named exactly like the symbol,
+								 * following entry if there are any */
+};
+
+SymbolTable *symbol_table_new(void);
+void symbol_table_free(SymbolTable *table);
+
+void symbol_table_set_index(SymbolTable *table, SearchIndex *index);
+void symbol_table_set_source(SymbolTable *table, guint source, GPtrArray *names);
+void symbol_table_remove_source(SymbolTable *table, guint source);
+
+gboolean symbol_table_lookup(SymbolTable *table, const gchar *name,
+							 SymbolDocs *docs);
+void symbol_table_resolve(SearchIndex *index, const gchar *name, SymbolDocs *docs);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,62 @@
+/*
+ * tag-util.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+
+#include <glib.h>
+
+#include "tag-util.h"
+
+/**
+ * Replaces the characters of str that aren't in wordchars with spaces and
+ * trims the whitespace from both ends.  Works in place.
+ *
+ * @param str		String to clean.
+ * @param wordchars	Characters that can be part of a tag.
+ *
+ * @return	str.
+ */
+gchar *tag_util_clean(gchar *str, const gchar *wordchars)
+{
+	return g_strstrip(g_strcanon(str, wordchars, ' '));
+}
+
+/**
+ * Cleans text with tag_util_clean() and takes it over as the tag.
+ *
+ * @param text		Newly allocated text, or NULL.
+ * @param wordchars	Characters that can be part of a tag.
+ *
+ * @return	text, or NULL if there's no tag left in it, in which case text is
+ * 			freed.
+ */
+gchar *tag_util_take(gchar *text, const gchar *wordchars)
+{
+	if (text == NULL)
+		return NULL;
+
+	if (tag_util_clean(text, wordchars)[0] == '\0')
+	{
+		g_free(text);
+		return NULL;
+	}
+
+	return text;
+}
@@ -0,0 +1,46 @@
+/*
+ * tag-util.h - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+
+#ifndef TAG_UTIL_H
+#define TAG_UTIL_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * Turning a selection or the word at the cursor into a tag to look up.
+ * Kept apart from the editor so it can be timed without Geany, see
+ * bench/dhp-bench.c.
+ *
+ * See tag-util.c for documentation for these functions
+ */
+
+/* selections longer than this aren't treated as a tag */
+#define TAG_UTIL_MAX_LENGTH 256
+
+gchar *tag_util_clean(gchar *str, const gchar *wordchars);
+gchar *tag_util_take(gchar *text, const gchar *wordchars);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,263 @@
+/*
+ * work-pool.c - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "work-pool.h"
+
+/* more threads than this only add contention on the disk */
+#define WORK_POOL_MAX_THREADS	64
+
+/* one worker's queue of items */
+typedef struct
+{
+	GStaticMutex lock;			/* works before threads are initialized */
+	GQueue items;
+} WorkQueue;
+
+/* what each thread is started with */
+typedef struct
+{
+	WorkPool *pool;
+	guint index;
+} Worker;
+
+struct _WorkPool
+{
+	WorkPoolFunc func;
+	gpointer user_data;
+
+	WorkQueue *queues;
+	guint n_threads;
+	guint next_queue;			/* where the next pushed item goes */
+	guint n_items;
+
+	guint n_ran;				/* threads the last run actually used */
+	volatile gint n_stolen;
+};
+
+/**
+ * Gets the number of processors that are online.
+ *
+ * @return	The number of processors, at least 1.
+ */
+guint work_pool_get_n_cpus(void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+	glong n = sysconf(_SC_NPROCESSORS_ONLN);
+
+	if (n > 0)
+		return (guint) n;
+#endif
+	return 1;
+}
+
+/**
+ * Creates a new pool, nothing is started until work_pool_run().
+ *
+ * @param n_threads	Number of threads to run on, including the one calling
+ * 					work_pool_run(), 0 for one per processor.
+ * @param func		Function called for each item, from any of the threads.
+ * @param user_data	Passed to func.
+ *
+ * @return	A new WorkPool, free it with work_pool_free().
+ */
+WorkPool *work_pool_new(guint n_threads, WorkPoolFunc func, gpointer user_data)
+{
+	WorkPool *pool;
+	guint i;
+
+	g_return_val_if_fail(func != NULL, NULL);
+
+	if (n_threads == 0)
+		n_threads = work_pool_get_n_cpus();
+	n_threads = CLAMP(n_threads, 1, WORK_POOL_MAX_THREADS);
+
+	pool = g_new0(WorkPool, 1);
+	pool->func = func;
+	pool->user_data = user_data;
+	pool->n_threads = n_threads;
+	pool->queues = g_new0(WorkQueue, n_threads);
+	for (i = 0; i < n_threads; i++)
+	{
+		g_static_mutex_init(&pool->queues[i].lock);
+		g_queue_init(&pool->queues[i].items);
+	}
+
+	return pool;
+}
+
+/**
+ * Frees a pool.  Items that were never run are dropped.
+ */
+void work_pool_free(WorkPool *pool)
+{
+	guint i;
+
+	if (pool == NULL)
+		return;
+
+	for (i = 0; i < pool->n_threads; i++)
+	{
+		g_static_mutex_free(&pool->queues[i].lock);
+		g_queue_clear(&pool->queues[i].items);
+	}
+	g_free(pool->queues);
+	g_free(pool);
+}
+
+/**
+ * Adds an item to be run.  Must not be called while work_pool_run() is
+ * running.
+ */
+void work_pool_push(WorkPool *pool, gpointer item)
+{
+	g_queue_push_tail(&pool->queues[pool->next_queue].items, item);
+	pool->next_queue = (pool->next_queue + 1) % pool->n_threads;
+	pool->n_items++;
+}
+
+/* Takes the next item from the front of a worker's own queue */
+static gpointer work_queue_pop(WorkQueue *queue)
+{
+	gpointer item;
+
+	g_static_mutex_lock(&queue->lock);
+	item = g_queue_pop_head(&queue->items);
+	g_static_mutex_unlock(&queue->lock);
+
+	return item;
+}
+
+/* Takes an item from the back of another worker's queue */
+static gpointer work_queue_steal(WorkQueue *queue)
+{
+	gpointer item;
+
+	g_static_mutex_lock(&queue->lock);
+	item = g_queue_pop_tail(&queue->items);
+	g_static_mutex_unlock(&queue->lock);
+
+	return item;
+}
+
+/*
+ * Runs items until every queue is empty.  Nothing gets pushed while the
+ * workers run, so once a worker finds nothing to steal it's done.
+ */
+static gpointer worker_thread(gpointer user_data)
+{
+	Worker *worker = user_data;
+	WorkPool *pool = worker->pool;
+	gpointer item;
+	guint i;
+
+	for (;;)
+	{
+		item = work_queue_pop(&pool->queues[worker->index]);
+
+		/* try the others, starting with the next worker along so thieves
+		 * spread out instead of all hitting the first queue */
+		for (i = 1; item == NULL && i < pool->n_threads; i++)
+		{
+			item = work_queue_steal(&pool->queues[(worker->index + i) % pool->n_threads]);
+			if (item != NULL)
+				g_atomic_int_inc(&pool->n_stolen);
+		}
+
+		if (item == NULL)
+			break;
+
+		pool->func(item, pool->user_data);
+	}
+
+	return NULL;
+}
+
+/**
+ * Runs every item that was pushed and waits for them all to finish.  The
+ * calling thread is one of the workers.  If threads can't be created the
+ * items are simply all run on the calling thread.
+ */
+void work_pool_run(WorkPool *pool)
+{
+	GThread **threads;
+	Worker *workers;
+	guint i, n_started;
+
+	n_started = MIN(pool->n_threads, MAX(pool->n_items, 1));
+	if (!g_thread_supported())
+		n_started = 1;
+
+	threads = g_new0(GThread *, n_started);
+	workers = g_new0(Worker, n_started);
+
+	for (i = 0; i < n_started; i++)
+	{
+		workers[i].pool = pool;
+		workers[i].index = i;
+	}
+
+	/* workers that fail to start leave their queue to be stolen from */
+	pool->n_ran = 1;
+	for (i = 1; i < n_started; i++)
+	{
+		GError *error = NULL;
+
+		threads[i] = g_thread_create(worker_thread, &workers[i], TRUE, &error);
+		if (threads[i] != NULL)
+			pool->n_ran++;
+		else
+		{
+			g_warning("Unable to start worker thread: %s", error->message);
+			g_error_free(error);
+		}
+	}
+
+	worker_thread(&workers[0]);
+
+	for (i = 1; i < n_started; i++)
+	{
+		if (threads[i] != NULL)
+			g_thread_join(threads[i]);
+	}
+
+	pool->n_items = 0;
+	pool->next_queue = 0;
+
+	g_free(threads);
+	g_free(workers);
+}
+
+/* Number of threads the last work_pool_run() used, 0 before the first */
+guint work_pool_get_n_threads(WorkPool *pool)
+{
+	return pool->n_ran;
+}
+
+/* Number of items that were run by a worker other than the one they were
+ * pushed to, a rough measure of how uneven the work was */
+guint work_pool_get_n_stolen(WorkPool *pool)
+{
+	return (guint) g_atomic_int_get(&pool->n_stolen);
+}
@@ -0,0 +1,60 @@
+/*
+ * work-pool.h - Part of the Geany Devhelp Plugin
+ *
+ * Copyright 2011 Matthew Brush <mbrush@leftclick.ca>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA 02110-1301, USA.
+ */
+
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/*
+ * A fixed batch of work items run on one thread per core.  Each worker has
+ * its own queue, the items are dealt out to the queues round robin when
+ * they're pushed.  A worker takes items from the front of its own queue and
+ * once that's empty it steals from the back of the others', so a few big
+ * items (a huge book among many small ones) don't leave the other cores
+ * idle while one worker is still busy with its share.
+ *
+ * All items are pushed before work_pool_run() and no more can be added
+ * while it runs, which is all loading books needs.
+ *
+ * See work-pool.c for documentation for these functions
+ */
+
+typedef struct _WorkPool	WorkPool;
+
+typedef void (*WorkPoolFunc) (gpointer item, gpointer user_data);
+
+guint work_pool_get_n_cpus(void);
+
+WorkPool *work_pool_new(guint n_threads, WorkPoolFunc func, gpointer user_data);
+void work_pool_free(WorkPool *pool);
+
+void work_pool_push(WorkPool *pool, gpointer item);
+void work_pool_run(WorkPool *pool);
+
+guint work_pool_get_n_threads(WorkPool *pool);
+guint work_pool_get_n_stolen(WorkPool *pool);
+
+G_END_DECLS
+
+#endif